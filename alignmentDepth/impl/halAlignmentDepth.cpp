@@ -0,0 +1,432 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include <cassert>
+#include <sstream>
+#include <algorithm>
+#include "halAlignmentDepth.h"
+
+using namespace std;
+using namespace hal;
+
+/** Given a Sequence (chromosome) and a (sequence-relative) coordinate
+ * range, print the alignmability wiggle with respect to the genomes
+ * in the target set */
+static void printSequence(DepthWriter& writer, const Sequence* sequence, 
+                          const set<const Genome*>& targetSet,
+                          hal_size_t start, hal_size_t length, 
+                          hal_size_t step, bool countDupes, bool noAncestors,
+                          const SegmentDepth* segmentDepth)
+{
+  hal_size_t seqLen = sequence->getSequenceLength();
+  if (seqLen == 0)
+  {
+    return;
+  }
+  /** If the length is 0, we do from the start position until the end
+   * of the sequence */
+  if (length == 0)
+  {
+    length = seqLen - start;
+  }
+  hal_size_t last = start + length;
+  if (last > seqLen)
+  {
+    stringstream ss;
+    ss << "Specified range [" << start << "," << length << "] is"
+       << "out of range for sequence " << sequence->getName() 
+       << ", which has length " << seqLen;
+    throw (hal_exception(ss.str()));
+  }
+
+  writer.beginSequence(sequence, start, step);
+  if (segmentDepth != NULL)
+  {
+    // a window at a time, so we never hold the depth of a whole chromosome
+    hal_index_t seqStart = sequence->getStartPosition();
+    vector<hal_size_t> depth;
+    for (hal_size_t winStart = start; winStart < last; 
+         winStart += SegmentDepth::windowSize)
+    {
+      hal_size_t winLast = min(last, winStart + SegmentDepth::windowSize) - 1;
+      depth.assign(winLast - winStart + 1, 0);
+      segmentDepth->getDepth(seqStart + (hal_index_t)winStart, 
+                             seqStart + (hal_index_t)winLast, depth);
+      // first position in the window that is on the step
+      hal_size_t i = (step - (winStart - start) % step) % step;
+      while (i < depth.size())
+      {
+        hal_size_t runLength = 1;
+        if (step == 1)
+        {
+          for (; i + runLength < depth.size() && 
+                  depth[i + runLength] == depth[i]; ++runLength);
+        }
+        writer.write(depth[i], runLength);
+        i += step == 1 ? runLength : step;
+      }
+    }
+    writer.endSequence();
+    return;
+  }
+
+  /** The ColumnIterator is fundamental structure used in this example to
+   * traverse the alignment.  It essientially generates the multiple alignment
+   * on the fly according to the given reference (in this case the target
+   * sequence).  Since this is the sequence interface, the positions
+   * are sequence relative.  Note that we must specify the last position
+   * in advance when we get the iterator.  This will limit it following
+   * duplications out of the desired range while we are iterating. */
+  hal_size_t pos = start;
+  ColumnIteratorConstPtr colIt = sequence->getColumnIterator(&targetSet,
+                                                             0, pos,
+                                                             last - 1,
+                                                             false,
+                                                             noAncestors);
+  /** Since the column iterator stores coordinates in Genome coordinates
+   * internally, we have to switch back to genome coordinates.  */
+  // convert to genome coordinates
+  pos += sequence->getStartPosition();
+  last += sequence->getStartPosition();
+  // keep track of unique genomes
+  set<const Genome*> genomeSet;
+  while (pos < last)
+  {
+    genomeSet.clear();
+    hal_size_t count = 0;
+    /** ColumnIterator::ColumnMap maps a Sequence to a list of bases
+     * the bases in the map form the alignment column.  Some sequences
+     * in the map can have no bases (for efficiency reasons) */ 
+    const ColumnIterator::ColumnMap* cmap = colIt->getColumnMap();
+
+    /** For every sequence in the map */
+    for (ColumnIterator::ColumnMap::const_iterator i = cmap->begin();
+         i != cmap->end(); ++i)
+    {
+      if (countDupes == true)
+      {
+        // countDupes enabled: we just count everything
+        count += i->second->size();
+      }
+      else if (!i->second->empty())
+      {
+        // just counting unique genomes: add it if there's at least one base
+        genomeSet.insert(i->first->getGenome());
+      }
+    }
+    if (countDupes == false) 
+    {
+      count = genomeSet.size();
+    }
+    // don't want to include reference base in output
+    --count;
+
+    writer.write(count);
+    
+    /** lastColumn checks if we are at the last column (inclusive)
+     * in range.  So we need to check at end of iteration instead
+     * of beginning (which would be more convenient).  Need to 
+     * merge global fix from other branch */
+    if (colIt->lastColumn() == true)
+    {
+      break;
+    }
+
+    pos += step;    
+    // last is one past the end of the range
+    if (pos >= last)
+    {
+      break;
+    }
+    if (step == 1)
+    {
+      /** Move the iterator one position to the right */
+      colIt->toRight();
+      
+      /** This is some tuning code that will probably be hidden from 
+       * the interface at some point.  It is a good idea to use for now
+       * though */
+      // erase empty entries from the column.  helps when there are 
+      // millions of sequences (ie from fastas with lots of scaffolds)
+      if (pos % 1000 == 0)
+      {
+        colIt->defragment();
+      }
+    }
+    else
+    {
+      /** Reset the iterator to a non-contiguous position */
+      colIt->toSite(pos, last - 1);
+    }
+  }
+  writer.endSequence();
+}
+
+/** Map a range of genome-level coordinates to potentially multiple sequence
+ * ranges.  For example, if a genome contains two chromosomes ChrA and ChrB,
+ * both of which are of length 500, then the genome-coordinates would be
+ * [0,499] for ChrA and [500,999] for ChrB. All aspects of the HAL API
+ * use these global coordinates (chromosomes concatenated together) except
+ * for the hal::Sequence interface.  We can convert between the two by 
+ * adding or subtracting the sequence start position (in the example it woudl
+ * be 0 for ChrA and 500 for ChrB) */
+void hal::printGenome(DepthWriter& writer,
+                      const Genome* genome, const Sequence* sequence,
+                      const set<const Genome*>& targetSet,
+                      hal_size_t start, hal_size_t length, hal_size_t step,
+                      bool countDupes, bool noAncestors,
+                      const SegmentDepth* segmentDepth)
+{
+  if (sequence != NULL)
+  {
+    printSequence(writer, sequence, targetSet, start, length, step, countDupes,
+                  noAncestors, segmentDepth);
+  }
+  else
+  {
+    if (start + length > genome->getSequenceLength())
+    {
+      stringstream ss;
+      ss << "Specified range [" << start << "," << length << "] is"
+         << "out of range for genome " << genome->getName() 
+         << ", which has length " << genome->getSequenceLength();
+      throw (hal_exception(ss.str()));
+    }
+    if (length == 0)
+    {
+      length = genome->getSequenceLength() - start;
+    }
+
+    SequenceIteratorConstPtr seqIt = genome->getSequenceIterator();
+    SequenceIteratorConstPtr seqEndIt = genome->getSequenceEndIterator();
+    hal_size_t runningLength = 0;
+    for (; seqIt != seqEndIt; seqIt->toNext())
+    {
+      const Sequence* sequence = seqIt->getSequence();
+      hal_size_t seqLen = sequence->getSequenceLength();
+      hal_size_t seqStart = (hal_size_t)sequence->getStartPosition();
+
+      if (start + length >= seqStart && 
+          start < seqStart + seqLen &&
+          runningLength < length)
+      {
+        hal_size_t readStart = seqStart >= start ? 0 : start - seqStart;
+        hal_size_t readLen = min(seqLen - readStart, length);
+        readLen = min(readLen, length - runningLength);
+        printSequence(writer, sequence, targetSet, readStart, readLen, step,
+                      countDupes, noAncestors, segmentDepth);
+        runningLength += readLen;
+      }
+    }
+  }
+}
+
+
+DepthWriter::DepthWriter(ostream& outStream, bool bedGraph) :
+  _outStream(outStream),
+  _bedGraph(bedGraph),
+  _runStart(0),
+  _runLength(0),
+  _runCount(0)
+{
+}
+
+void DepthWriter::beginSequence(const Sequence* sequence, hal_size_t start, 
+                                hal_size_t step)
+{
+  _sequenceName = sequence->getName();
+  _runStart = start;
+  _runLength = 0;
+  _runCount = 0;
+  if (_bedGraph == false)
+  {
+    // note wig coordinates are 1-based for some reason so we shift to right
+    _outStream << "fixedStep chrom=" << _sequenceName << " start=" 
+               << start + 1 << " step=" << step << "\n";
+  }
+}
+
+void DepthWriter::write(hal_size_t count, hal_size_t length)
+{
+  if (_bedGraph == false)
+  {
+    for (hal_size_t i = 0; i < length; ++i)
+    {
+      _outStream << count << '\n';
+    }
+  }
+  else
+  {
+    if (_runLength > 0 && count != _runCount)
+    {
+      flushRun();
+    }
+    _runCount = count;
+    _runLength += length;
+  }
+}
+
+void DepthWriter::endSequence()
+{
+  flushRun();
+}
+
+void DepthWriter::flushRun()
+{
+  if (_bedGraph == true && _runLength > 0)
+  {
+    // bedGraph is 0-based and half-open like bed
+    _outStream << _sequenceName << '\t' << _runStart << '\t' 
+               << _runStart + _runLength << '\t' << _runCount << '\n';
+    _runStart += _runLength;
+    _runLength = 0;
+  }
+}
+
+const hal_size_t SegmentDepth::windowSize = 1000000;
+
+SegmentDepth::SegmentDepth(const Genome* refGenome, 
+                           const set<const Genome*>& targetSet,
+                           bool countDupes, bool noAncestors) :
+  _refGenome(refGenome),
+  _countDupes(countDupes)
+{
+  // same scope as the column iterator: the spanning tree of the reference
+  // and the targets, which are all the genomes if none are given.
+  set<const Genome*> targets = targetSet;
+  if (targets.empty() == true)
+  {
+    const Alignment* alignment = refGenome->getAlignment();
+    getGenomesInSubTree(alignment->openGenome(alignment->getRootName()),
+                        targets);
+  }
+  set<const Genome*> inputSet = targets;
+  inputSet.insert(refGenome);
+  _coalescenceLimit = getLowestCommonAncestor(inputSet);
+
+  for (set<const Genome*>::const_iterator i = targets.begin(); 
+       i != targets.end(); ++i)
+  {
+    // the reference only counts (for its paralogs) when counting dupes
+    if ((*i == refGenome && countDupes == false) ||
+        (noAncestors == true && (*i)->getNumChildren() > 0))
+    {
+      continue;
+    }
+    SegmentDepthTarget target;
+    target._genome = *i;
+    inputSet.clear();
+    inputSet.insert(refGenome);
+    inputSet.insert(*i);
+    target._mrca = getLowestCommonAncestor(inputSet);
+    inputSet.clear();
+    inputSet.insert(_coalescenceLimit);
+    inputSet.insert(*i);
+    getGenomesInSpanningTree(inputSet, target._path);
+    _targets.push_back(target);
+  }
+}
+
+void SegmentDepth::getDepth(hal_index_t start, hal_index_t last,
+                            vector<hal_size_t>& depth) const
+{
+  assert(depth.size() == (size_t)(last - start + 1));
+  SegmentIteratorConstPtr refSeg;
+  hal_index_t endIndex;
+  if (_refGenome->getParent() != NULL)
+  {
+    refSeg = _refGenome->getTopSegmentIterator();
+    endIndex = (hal_index_t)_refGenome->getNumTopSegments();
+  }
+  else if (_refGenome->getNumBottomSegments() > 0)
+  {
+    refSeg = _refGenome->getBottomSegmentIterator();
+    endIndex = (hal_index_t)_refGenome->getNumBottomSegments();
+  }
+  else
+  {
+    // nothing is aligned to anything
+    return;
+  }
+
+  // map every reference segment in range to every target
+  vector<set<MappedSegmentConstPtr> > mappedSegments(_targets.size());
+  refSeg->toSite(start, false);
+  hal_offset_t startOffset = start - refSeg->getStartPosition();
+  hal_offset_t endOffset = 0;
+  if (last <= refSeg->getEndPosition())
+  {
+    endOffset = refSeg->getEndPosition() - last;
+  }
+  refSeg->slice(startOffset, endOffset);
+  while (refSeg->getArrayIndex() < endIndex &&
+         refSeg->getStartPosition() <= last)
+  {
+    for (size_t i = 0; i < _targets.size(); ++i)
+    {
+      refSeg->getMappedSegments(mappedSegments[i], _targets[i]._genome,
+                                &_targets[i]._path, true, 0, 
+                                _coalescenceLimit, _targets[i]._mrca);
+    }
+    refSeg->toRight(last);
+  }
+
+  // add up the intervals of reference bases covered in each target, 
+  // merging them first if each target only counts once
+  vector<hal_index_t> delta(depth.size() + 1, 0);
+  vector<pair<hal_index_t, hal_index_t> > intervals;
+  for (size_t i = 0; i < _targets.size(); ++i)
+  {
+    intervals.clear();
+    set<MappedSegmentConstPtr>::const_iterator j;
+    for (j = mappedSegments[i].begin(); j != mappedSegments[i].end(); ++j)
+    {
+      SlicedSegmentConstPtr source = (*j)->getSource();
+      hal_index_t first = min(source->getStartPosition(), 
+                              source->getEndPosition());
+      hal_index_t second = max(source->getStartPosition(), 
+                               source->getEndPosition());
+      if (_targets[i]._genome == _refGenome &&
+          min((*j)->getStartPosition(), (*j)->getEndPosition()) == first)
+      {
+        // the reference bases themselves
+        continue;
+      }
+      intervals.push_back(pair<hal_index_t, hal_index_t>(
+                            max(first, start), min(second, last)));
+    }
+    if (_countDupes == false)
+    {
+      sort(intervals.begin(), intervals.end());
+      size_t merged = 0;
+      for (size_t k = 1; k < intervals.size(); ++k)
+      {
+        if (intervals[k].first <= intervals[merged].second + 1)
+        {
+          intervals[merged].second = max(intervals[merged].second,
+                                         intervals[k].second);
+        }
+        else
+        {
+          intervals[++merged] = intervals[k];
+        }
+      }
+      intervals.resize(min(intervals.size(), merged + 1));
+    }
+    for (size_t k = 0; k < intervals.size(); ++k)
+    {
+      ++delta[intervals[k].first - start];
+      --delta[intervals[k].second - start + 1];
+    }
+  }
+  hal_index_t running = 0;
+  for (size_t k = 0; k < depth.size(); ++k)
+  {
+    running += delta[k];
+    assert(running >= 0);
+    depth[k] += (hal_size_t)running;
+  }
+}
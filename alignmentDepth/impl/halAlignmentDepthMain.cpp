@@ -7,8 +7,8 @@
 #include <cstdlib>
 #include <iostream>
 #include <fstream>
-#include <algorithm>
-#include "hal.h"
+#include <vector>
+#include "halAlignmentDepth.h"
 
 using namespace std;
 using namespace hal;
@@ -33,23 +33,13 @@ using namespace hal;
  * So if a base in the reference genome is aligned to a base in a genome
  * that is not under root or in the target list, it will not count to the
  * alignment depth.
+ *
+ * By default the depth is read off a column iterator one base at a time.
+ * With --bySegment, whole reference segments are instead mapped to each
+ * target genome (as halLiftover does) and the depth is summed over the
+ * mapped intervals, which is far faster on big alignments.
  */
 
-/** Print the alignment depth wiggle for a subrange of a given sequence to
- * the output stream. */
-static void printSequence(ostream& outStream, const Sequence* sequence, 
-                          const set<const Genome*>& targetSet,
-                          hal_size_t start, hal_size_t length, hal_size_t step,
-                          bool countDupes, bool noAncestors);
-
-/** If given genome-relative coordinates, map them to a series of 
- * sequence subranges */
-static void printGenome(ostream& outStream,
-                        const Genome* genome, const Sequence* sequence,
-                        const set<const Genome*>& targetSet,
-                        hal_size_t start, hal_size_t length, hal_size_t step,
-                        bool countDupes, bool noAncestors);
-
 static const hal_size_t StringBufferSize = 1024;
 
 static CLParserPtr initParser()
@@ -91,6 +81,17 @@ static CLParserPtr initParser()
                                false);
   optionsParser->addOptionFlag("noAncestors", 
                                "do not count ancestral genomes.", false);
+  optionsParser->addOptionFlag("bySegment",
+                               "compute the depth by mapping whole segments "
+                               "to each target genome rather than column by "
+                               "column.  Much faster, but paralogies are "
+                               "followed as in halLiftover, so values can "
+                               "differ from the default around "
+                               "duplications.", false);
+  optionsParser->addOptionFlag("bedGraph",
+                               "write bedGraph (one line for each run of "
+                               "bases with the same depth) instead of "
+                               "fixedStep wiggle.  Requires --step 1", false);
   optionsParser->setDescription("Make alignment depth wiggle plot for a genome. "
                                 "By default, this is a count of the number of "
                                 "other unique genomes each base aligns to, "
@@ -113,6 +114,8 @@ int main(int argc, char** argv)
   hal_size_t step;
   bool countDupes;
   bool noAncestors;
+  bool bySegment;
+  bool bedGraph;
   try
   {
     optionsParser->parseOptions(argc, argv);
@@ -127,12 +130,22 @@ int main(int argc, char** argv)
     step = optionsParser->getOption<hal_size_t>("step");
     countDupes = optionsParser->getFlag("countDupes");
     noAncestors = optionsParser->getFlag("noAncestors");
+    bySegment = optionsParser->getFlag("bySegment");
+    bedGraph = optionsParser->getFlag("bedGraph");
 
     if (rootGenomeName != "\"\"" && targetGenomes != "\"\"")
     {
       throw hal_exception("--rootGenome and --targetGenomes options are "
                           " mutually exclusive");
     }
+    if (step == 0)
+    {
+      throw hal_exception("--step must be at least 1");
+    }
+    if (bedGraph == true && step != 1)
+    {
+      throw hal_exception("--bedGraph can only be used with --step 1");
+    }
   }
   catch(exception& e)
   {
@@ -239,8 +252,16 @@ int main(int argc, char** argv)
       }
     }
     
-    printGenome(outStream, refGenome, refSequence, targetSet, start, length, 
-                step, countDupes, noAncestors);
+    SegmentDepth* segmentDepth = NULL;
+    if (bySegment == true)
+    {
+      segmentDepth = new SegmentDepth(refGenome, targetSet, countDupes,
+                                      noAncestors);
+    }
+    DepthWriter writer(outStream, bedGraph);
+    printGenome(writer, refGenome, refSequence, targetSet, start, length, 
+                step, countDupes, noAncestors, segmentDepth);
+    delete segmentDepth;
     
   }
   catch(hal_exception& e)
@@ -257,184 +278,3 @@ int main(int argc, char** argv)
   return 0;
 }
 
-/** Given a Sequence (chromosome) and a (sequence-relative) coordinate
- * range, print the alignmability wiggle with respect to the genomes
- * in the target set */
-void printSequence(ostream& outStream, const Sequence* sequence, 
-                   const set<const Genome*>& targetSet,
-                   hal_size_t start, hal_size_t length, hal_size_t step,
-                   bool countDupes, bool noAncestors)
-{
-  hal_size_t seqLen = sequence->getSequenceLength();
-  if (seqLen == 0)
-  {
-    return;
-  }
-  /** If the length is 0, we do from the start position until the end
-   * of the sequence */
-  if (length == 0)
-  {
-    length = seqLen - start;
-  }
-  hal_size_t last = start + length;
-  if (last > seqLen)
-  {
-    stringstream ss;
-    ss << "Specified range [" << start << "," << length << "] is"
-       << "out of range for sequence " << sequence->getName() 
-       << ", which has length " << seqLen;
-    throw (hal_exception(ss.str()));
-  }
-
-  const Genome* genome = sequence->getGenome();
-  string sequenceName = sequence->getName();
-  string genomeName = genome->getName();
-
-  /** The ColumnIterator is fundamental structure used in this example to
-   * traverse the alignment.  It essientially generates the multiple alignment
-   * on the fly according to the given reference (in this case the target
-   * sequence).  Since this is the sequence interface, the positions
-   * are sequence relative.  Note that we must specify the last position
-   * in advance when we get the iterator.  This will limit it following
-   * duplications out of the desired range while we are iterating. */
-  hal_size_t pos = start;
-  ColumnIteratorConstPtr colIt = sequence->getColumnIterator(&targetSet,
-                                                             0, pos,
-                                                             last - 1,
-                                                             false,
-                                                             noAncestors);
-  // note wig coordinates are 1-based for some reason so we shift to right
-  outStream << "fixedStep chrom=" << sequenceName << " start=" << start + 1
-            << " step=" << step << "\n";
-  
-  /** Since the column iterator stores coordinates in Genome coordinates
-   * internally, we have to switch back to genome coordinates.  */
-  // convert to genome coordinates
-  pos += sequence->getStartPosition();
-  last += sequence->getStartPosition();
-  // keep track of unique genomes
-  set<const Genome*> genomeSet;
-  while (pos <= last)
-  {
-    genomeSet.clear();
-    hal_size_t count = 0;
-    /** ColumnIterator::ColumnMap maps a Sequence to a list of bases
-     * the bases in the map form the alignment column.  Some sequences
-     * in the map can have no bases (for efficiency reasons) */ 
-    const ColumnIterator::ColumnMap* cmap = colIt->getColumnMap();
-
-    /** For every sequence in the map */
-    for (ColumnIterator::ColumnMap::const_iterator i = cmap->begin();
-         i != cmap->end(); ++i)
-    {
-      if (countDupes == true)
-      {
-        // countDupes enabled: we just count everything
-        count += i->second->size();
-      }
-      else if (!i->second->empty())
-      {
-        // just counting unique genomes: add it if there's at least one base
-        genomeSet.insert(i->first->getGenome());
-      }
-    }
-    if (countDupes == false) 
-    {
-      count = genomeSet.size();
-    }
-    // don't want to include reference base in output
-    --count;
-
-    outStream << count << '\n';
-    
-    /** lastColumn checks if we are at the last column (inclusive)
-     * in range.  So we need to check at end of iteration instead
-     * of beginning (which would be more convenient).  Need to 
-     * merge global fix from other branch */
-    if (colIt->lastColumn() == true)
-    {
-      break;
-    }
-
-    pos += step;    
-    if (step == 1)
-    {
-      /** Move the iterator one position to the right */
-      colIt->toRight();
-      
-      /** This is some tuning code that will probably be hidden from 
-       * the interface at some point.  It is a good idea to use for now
-       * though */
-      // erase empty entries from the column.  helps when there are 
-      // millions of sequences (ie from fastas with lots of scaffolds)
-      if (pos % 1000 == 0)
-      {
-        colIt->defragment();
-      }
-    }
-    else
-    {
-      /** Reset the iterator to a non-contiguous position */
-      colIt->toSite(pos, last);
-    }
-  }
-}
-
-/** Map a range of genome-level coordinates to potentially multiple sequence
- * ranges.  For example, if a genome contains two chromosomes ChrA and ChrB,
- * both of which are of length 500, then the genome-coordinates would be
- * [0,499] for ChrA and [500,999] for ChrB. All aspects of the HAL API
- * use these global coordinates (chromosomes concatenated together) except
- * for the hal::Sequence interface.  We can convert between the two by 
- * adding or subtracting the sequence start position (in the example it woudl
- * be 0 for ChrA and 500 for ChrB) */
-void printGenome(ostream& outStream,
-                 const Genome* genome, const Sequence* sequence,
-                 const set<const Genome*>& targetSet,
-                 hal_size_t start, hal_size_t length, hal_size_t step,
-                 bool countDupes, bool noAncestors)
-{
-  if (sequence != NULL)
-  {
-    printSequence(outStream, sequence, targetSet, start, length, step, countDupes,
-                  noAncestors);
-  }
-  else
-  {
-    if (start + length > genome->getSequenceLength())
-    {
-      stringstream ss;
-      ss << "Specified range [" << start << "," << length << "] is"
-         << "out of range for genome " << genome->getName() 
-         << ", which has length " << genome->getSequenceLength();
-      throw (hal_exception(ss.str()));
-    }
-    if (length == 0)
-    {
-      length = genome->getSequenceLength() - start;
-    }
-
-    SequenceIteratorConstPtr seqIt = genome->getSequenceIterator();
-    SequenceIteratorConstPtr seqEndIt = genome->getSequenceEndIterator();
-    hal_size_t runningLength = 0;
-    for (; seqIt != seqEndIt; seqIt->toNext())
-    {
-      const Sequence* sequence = seqIt->getSequence();
-      hal_size_t seqLen = sequence->getSequenceLength();
-      hal_size_t seqStart = (hal_size_t)sequence->getStartPosition();
-
-      if (start + length >= seqStart && 
-          start < seqStart + seqLen &&
-          runningLength < length)
-      {
-        hal_size_t readStart = seqStart >= start ? 0 : start - seqStart;
-        hal_size_t readLen = min(seqLen - readStart, length);
-        readLen = min(readLen, length - runningLength);
-        printSequence(outStream, sequence, targetSet, readStart, readLen, step,
-                      countDupes, noAncestors);
-        runningLength += readLen;
-      }
-    }
-  }
-}
-
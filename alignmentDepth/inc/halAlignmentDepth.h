@@ -0,0 +1,81 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _HALALIGNMENTDEPTH_H
+#define _HALALIGNMENTDEPTH_H
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <set>
+#include "hal.h"
+
+namespace hal {
+
+/** Writes the depth of consecutive positions along a sequence, either
+ * one value per line (fixedStep wiggle) or one line per run of equal 
+ * values (bedGraph) */
+class DepthWriter
+{
+public:
+   DepthWriter(std::ostream& outStream, bool bedGraph);
+   void beginSequence(const Sequence* sequence, hal_size_t start, 
+                      hal_size_t step);
+   /** depth of the next length positions (each written on its own
+    * line unless writing bedGraph) */
+   void write(hal_size_t count, hal_size_t length = 1);
+   void endSequence();
+protected:
+   void flushRun();
+   std::ostream& _outStream;
+   bool _bedGraph;
+   std::string _sequenceName;
+   hal_size_t _runStart;
+   hal_size_t _runLength;
+   hal_size_t _runCount;
+};
+
+/** Everything needed to map reference segments to a target genome,
+ * worked out once up front */
+struct SegmentDepthTarget
+{
+   const Genome* _genome;
+   const Genome* _mrca;
+   std::set<const Genome*> _path;
+};
+
+/** Depth computed from mapped segments rather than columns */
+struct SegmentDepth
+{
+   SegmentDepth(const Genome* refGenome, 
+                const std::set<const Genome*>& targetSet,
+                bool countDupes, bool noAncestors);
+   /** Add the depth of every base of the genome range [start, last] to 
+    * depth (which must have last - start + 1 elements, all 0) */
+   void getDepth(hal_index_t start, hal_index_t last, 
+                 std::vector<hal_size_t>& depth) const;
+
+   const Genome* _refGenome;
+   const Genome* _coalescenceLimit;
+   std::vector<SegmentDepthTarget> _targets;
+   bool _countDupes;
+   static const hal_size_t windowSize;
+};
+
+/** Print the alignment depth of the genome range [start, start + length)
+ * (or of the sequence range if sequence is not NULL; the whole thing if
+ * length is 0), one sequence subrange at a time.  If segmentDepth is not
+ * NULL, it is used instead of a column iterator. */
+void printGenome(DepthWriter& writer,
+                 const Genome* genome, const Sequence* sequence,
+                 const std::set<const Genome*>& targetSet,
+                 hal_size_t start, hal_size_t length, hal_size_t step,
+                 bool countDupes, bool noAncestors,
+                 const SegmentDepth* segmentDepth);
+
+}
+
+#endif
@@ -0,0 +1,277 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include <cstdio>
+#include <sstream>
+#include "hal.h"
+#include "halAlignmentDepth.h"
+#include "halAlignmentDepthTests.h"
+#include "halRandomData.h"
+
+extern "C" {
+#include "commonC.h"
+}
+
+using namespace std;
+using namespace hal;
+
+/** The depth output of the whole reference genome */
+static string getDepth(const Genome* refGenome,
+                       const set<const Genome*>& targetSet,
+                       hal_size_t step, bool countDupes, bool noAncestors,
+                       bool bySegment, bool bedGraph)
+{
+  stringstream ss;
+  DepthWriter writer(ss, bedGraph);
+  SegmentDepth* segmentDepth = NULL;
+  if (bySegment == true)
+  {
+    segmentDepth = new SegmentDepth(refGenome, targetSet, countDupes,
+                                    noAncestors);
+  }
+  printGenome(writer, refGenome, NULL, targetSet, 0, 0, step, countDupes,
+              noAncestors, segmentDepth);
+  delete segmentDepth;
+  return ss.str();
+}
+
+/** Expand bedGraph output into the equivalent (step 1) wiggle */
+static string bedGraphToWiggle(const string& bedGraph)
+{
+  stringstream in(bedGraph);
+  stringstream out;
+  string name;
+  string prevName;
+  hal_size_t start, end, count;
+  while (in >> name >> start >> end >> count)
+  {
+    if (name != prevName)
+    {
+      out << "fixedStep chrom=" << name << " start=" << start + 1
+          << " step=1\n";
+      prevName = name;
+    }
+    for (hal_size_t i = start; i < end; ++i)
+    {
+      out << count << '\n';
+    }
+  }
+  return out.str();
+}
+
+// root -> (leaf1, anc), anc -> (leaf2, leaf3).  Every genome is one
+// sequence of four segments of length 10.  Each child segment is
+// aligned to the parent segment (and reversal) listed here, or to
+// nothing, so there are no duplications.
+static const hal_size_t numSegments = 4;
+static const hal_size_t segmentLength = 10;
+static const char* childNames[] = {"leaf1", "anc", "leaf2", "leaf3"};
+static const char* parentNames[] = {"root", "root", "anc", "anc"};
+static const hal_index_t parentIndices[][4] = {
+  {0, 1, NULL_INDEX, 3},
+  {0, NULL_INDEX, 2, 3},
+  {0, 1, 2, NULL_INDEX},
+  {NULL_INDEX, 1, 2, 3}};
+static const bool parentReversed[][4] = {
+  {false, true, false, false},
+  {false, false, true, false},
+  {false, false, false, false},
+  {false, true, false, false}};
+
+void DepthBySegmentTest::createCallBack(AlignmentPtr alignment)
+{
+  Genome* root = alignment->addRootGenome("root");
+  for (size_t i = 0; i < 4; ++i)
+  {
+    alignment->addLeafGenome(childNames[i], parentNames[i], 1);
+  }
+  for (size_t i = 0; i < 5; ++i)
+  {
+    Genome* genome = i == 0 ? root : alignment->openGenome(childNames[i - 1]);
+    bool isLeaf = genome->getName().find("leaf") == 0;
+    vector<Sequence::Info> seqVec(1);
+    seqVec[0] = Sequence::Info(genome->getName() + "Seq",
+                               numSegments * segmentLength,
+                               genome != root ? numSegments : 0,
+                               isLeaf == false ? numSegments : 0);
+    genome->setDimensions(seqVec);
+    genome->setString(randomString(genome->getSequenceLength()));
+  }
+
+  for (size_t i = 0; i < 4; ++i)
+  {
+    Genome* child = alignment->openGenome(childNames[i]);
+    Genome* parent = child->getParent();
+    hal_index_t childIndex = parent->getChildIndex(child);
+    TopSegmentIteratorPtr topIt = child->getTopSegmentIterator();
+    BottomSegmentIteratorPtr botIt = parent->getBottomSegmentIterator();
+    for (hal_size_t j = 0; j < numSegments; ++j)
+    {
+      topIt->setCoordinates(j * segmentLength, segmentLength);
+      topIt->setParentIndex(parentIndices[i][j]);
+      topIt->setParentReversed(parentReversed[i][j]);
+      topIt->setNextParalogyIndex(NULL_INDEX);
+      topIt->setBottomParseIndex(child->getNumChildren() > 0 ?
+                                 (hal_index_t)j : NULL_INDEX);
+      botIt->setCoordinates(j * segmentLength, segmentLength);
+      botIt->setChildIndex(childIndex, NULL_INDEX);
+      botIt->setChildReversed(childIndex, false);
+      botIt->setTopParseIndex(parent->getParent() != NULL ?
+                              (hal_index_t)j : NULL_INDEX);
+      topIt->toRight();
+      botIt->toRight();
+    }
+    topIt = child->getTopSegmentIterator();
+    for (hal_size_t j = 0; j < numSegments; ++j, topIt->toRight())
+    {
+      if (parentIndices[i][j] != NULL_INDEX)
+      {
+        botIt = parent->getBottomSegmentIterator(parentIndices[i][j]);
+        botIt->setChildIndex(childIndex, j);
+        botIt->setChildReversed(childIndex, parentReversed[i][j]);
+      }
+    }
+  }
+}
+
+void DepthBySegmentTest::checkCallBack(AlignmentConstPtr alignment)
+{
+  validateAlignment(alignment);
+
+  // worked out by hand from the table above
+  const Genome* leaf2 = alignment->openGenome("leaf2");
+  set<const Genome*> targetSet;
+  CuAssertTrue(_testCase,
+               getDepth(leaf2, targetSet, 1, false, false, true, true) ==
+               "leaf2Seq\t0\t10\t3\n"
+               "leaf2Seq\t10\t20\t2\n"
+               "leaf2Seq\t20\t30\t3\n"
+               "leaf2Seq\t30\t40\t0\n");
+  CuAssertTrue(_testCase,
+               getDepth(leaf2, targetSet, 1, false, true, true, true) ==
+               "leaf2Seq\t0\t30\t1\n"
+               "leaf2Seq\t30\t40\t0\n");
+
+  // with no duplications, mapping segments must give the same depth as
+  // the column iterator, whatever the options
+  vector<set<const Genome*> > targetSets(3);
+  getGenomesInSubTree(alignment->openGenome("anc"), targetSets[1]);
+  targetSets[2].insert(alignment->openGenome("leaf1"));
+  targetSets[2].insert(alignment->openGenome("leaf3"));
+  for (size_t i = 0; i < 5; ++i)
+  {
+    const Genome* refGenome =
+       alignment->openGenome(i == 0 ? "root" : childNames[i - 1]);
+    for (size_t t = 0; t < targetSets.size(); ++t)
+    {
+      for (size_t flags = 0; flags < 4; ++flags)
+      {
+        bool countDupes = flags % 2 == 1;
+        bool noAncestors = flags / 2 == 1;
+        if (noAncestors == true && refGenome->getNumChildren() > 0)
+        {
+          continue;
+        }
+        for (hal_size_t step = 1; step <= 3; step += 2)
+        {
+          string byColumn = getDepth(refGenome, targetSets[t], step,
+                                     countDupes, noAncestors, false, false);
+          string bySegment = getDepth(refGenome, targetSets[t], step,
+                                      countDupes, noAncestors, true, false);
+          CuAssertTrue(_testCase, bySegment == byColumn);
+        }
+        string byColumn = getDepth(refGenome, targetSets[t], 1,
+                                   countDupes, noAncestors, false, true);
+        string bySegment = getDepth(refGenome, targetSets[t], 1,
+                                    countDupes, noAncestors, true, true);
+        CuAssertTrue(_testCase, bySegment == byColumn);
+      }
+    }
+  }
+}
+
+void DepthBedGraphTest::createCallBack(AlignmentPtr alignment)
+{
+  createRandomAlignment(alignment, 2, 1e-10, 6, 2, 30, 5, 20, 0);
+}
+
+void DepthBedGraphTest::checkCallBack(AlignmentConstPtr alignment)
+{
+  // bedGraph is only a different way of writing the same depths, with
+  // either way of computing them
+  set<const Genome*> genomes;
+  getGenomesInSubTree(alignment->openGenome(alignment->getRootName()),
+                      genomes);
+  set<const Genome*> targetSet;
+  for (set<const Genome*>::const_iterator i = genomes.begin();
+       i != genomes.end(); ++i)
+  {
+    for (size_t bySegment = 0; bySegment < 2; ++bySegment)
+    {
+      for (size_t countDupes = 0; countDupes < 2; ++countDupes)
+      {
+        string wiggle = getDepth(*i, targetSet, 1, countDupes == 1, false,
+                                 bySegment == 1, false);
+        string bedGraph = getDepth(*i, targetSet, 1, countDupes == 1, false,
+                                   bySegment == 1, true);
+        CuAssertTrue(_testCase, bedGraphToWiggle(bedGraph) == wiggle);
+      }
+    }
+  }
+}
+
+void halDepthBySegmentTest(CuTest *testCase)
+{
+  try
+  {
+    DepthBySegmentTest tester;
+    tester.check(testCase);
+  }
+  catch (exception& e)
+  {
+    cerr << e.what() << endl;
+    CuAssertTrue(testCase, false);
+  }
+  catch (...)
+  {
+    CuAssertTrue(testCase, false);
+  }
+}
+
+void halDepthBedGraphTest(CuTest *testCase)
+{
+  try
+  {
+    DepthBedGraphTest tester;
+    tester.check(testCase);
+  }
+  catch (...)
+  {
+    CuAssertTrue(testCase, false);
+  }
+}
+
+CuSuite* halAlignmentDepthTestSuite(void)
+{
+  CuSuite* suite = CuSuiteNew();
+  SUITE_ADD_TEST(suite, halDepthBySegmentTest);
+  SUITE_ADD_TEST(suite, halDepthBedGraphTest);
+  return suite;
+}
+
+int halAlignmentDepthRunAllTests(void) {
+   CuString *output = CuStringNew();
+   CuSuite* suite = CuSuiteNew();
+   CuSuiteAddSuite(suite, halAlignmentDepthTestSuite());
+   CuSuiteRun(suite);
+   CuSuiteSummary(suite, output);
+   CuSuiteDetails(suite, output);
+   printf("%s\n", output->buffer);
+   return suite->failCount > 0;
+ }
+
+int main(int argc, char *argv[]) {
+   return halAlignmentDepthRunAllTests();
+}
@@ -0,0 +1,30 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _HALALIGNMENTDEPTHTESTS_H
+#define _HALALIGNMENTDEPTHTESTS_H
+
+#include "halAlignmentTest.h"
+
+extern "C" {
+#include "CuTest.h"
+}
+
+struct DepthBySegmentTest : public AlignmentTest
+{
+   void createCallBack(hal::AlignmentPtr alignment);
+   void checkCallBack(hal::AlignmentConstPtr alignment);
+};
+
+struct DepthBedGraphTest : public AlignmentTest
+{
+   void createCallBack(hal::AlignmentPtr alignment);
+   void checkCallBack(hal::AlignmentConstPtr alignment);
+};
+
+CuSuite *halAlignmentDepthTestSuite();
+
+#endif
@@ -43,7 +43,9 @@ HDF5Alignment::HDF5Alignment() :
   _metaData(NULL),
   _tree(NULL),
   _dirty(false),
-  _inMemory(false)
+  _inMemory(false),
+  _cacheChunks(HDF5CLParser::DefaultCacheChunks),
+  _prefetch(HDF5CLParser::DefaultPrefetch)
 {
   // set defaults from the command-line parser
   HDF5CLParser defaultOptions(true);  
@@ -60,7 +62,9 @@ HDF5Alignment::HDF5Alignment(const H5::FileCreatPropList& fileCreateProps,
   _metaData(NULL),
   _tree(NULL),
   _dirty(false),
-  _inMemory(inMemory)
+  _inMemory(inMemory),
+  _cacheChunks(HDF5CLParser::DefaultCacheChunks),
+  _prefetch(HDF5CLParser::DefaultPrefetch)
 {
   _cprops.copy(fileCreateProps);
   _aprops.copy(fileAccessProps);
@@ -225,6 +229,12 @@ void HDF5Alignment::setOptionsFromParser(CLParserConstPtr parser) const
   hdf5Parser->applyToDCProps(_dcprops);
   hdf5Parser->applyToAProps(_aprops);
   _inMemory = hdf5Parser->getInMemory();
+  _cacheChunks = hdf5Parser->getCacheChunks();
+  _prefetch = hdf5Parser->getPrefetch();
+  if (hdf5Parser->getPerfStats() == true)
+  {
+    PerfStats::printAtExit();
+  }
   if (_inMemory == true)
   {
     int mdc;
@@ -278,7 +288,8 @@ Genome*  HDF5Alignment::insertGenome(const string& name,
   stTree_setParent(child, newNode);
   stTree_setBranchLength(child, lowerBranchLength);
 
-  HDF5Genome* genome = new HDF5Genome(name, this, _file, _dcprops, _inMemory);
+  HDF5Genome* genome = new HDF5Genome(name, this, _file, _dcprops, _inMemory,
+                                      _cacheChunks, _prefetch);
   _openGenomes.insert(pair<string, HDF5Genome*>(name, genome));
   _dirty = true;
   return genome;
@@ -309,7 +320,8 @@ Genome*  HDF5Alignment::addLeafGenome(const string& name,
   stTree_setBranchLength(node, branchLength);
   _nodeMap.insert(pair<string, stTree*>(name, node));
 
-  HDF5Genome* genome = new HDF5Genome(name, this, _file, _dcprops, _inMemory);
+  HDF5Genome* genome = new HDF5Genome(name, this, _file, _dcprops, _inMemory,
+                                      _cacheChunks, _prefetch);
   _openGenomes.insert(pair<string, HDF5Genome*>(name, genome));
   _dirty = true;
   return genome;
@@ -337,7 +349,8 @@ Genome* HDF5Alignment::addRootGenome(const string& name,
   _tree = node;
   _nodeMap.insert(pair<string, stTree*>(name, node));
 
-  HDF5Genome* genome = new HDF5Genome(name, this, _file, _dcprops, _inMemory);
+  HDF5Genome* genome = new HDF5Genome(name, this, _file, _dcprops, _inMemory,
+                                      _cacheChunks, _prefetch);
   _openGenomes.insert(pair<string, HDF5Genome*>(name, genome));
   _dirty = true;
   return genome;
@@ -467,7 +480,8 @@ const Genome* HDF5Alignment::openGenome(const string& name) const
   if (_nodeMap.find(name) != _nodeMap.end())
   {
     genome = new HDF5Genome(name, const_cast<HDF5Alignment*>(this), 
-                            _file, _dcprops, _inMemory);
+                            _file, _dcprops, _inMemory, _cacheChunks, 
+                            _prefetch);
     genome->read();
     _openGenomes.insert(pair<string, HDF5Genome*>(name, genome));
   }
@@ -484,7 +498,8 @@ Genome* HDF5Alignment::openGenome(const string& name)
   HDF5Genome* genome = NULL;
   if (_nodeMap.find(name) != _nodeMap.end())
   {
-    genome = new HDF5Genome(name, this, _file, _dcprops, _inMemory);
+    genome = new HDF5Genome(name, this, _file, _dcprops, _inMemory,
+                            _cacheChunks, _prefetch);
     genome->read();
     _openGenomes.insert(pair<string, HDF5Genome*>(name, genome));
   }
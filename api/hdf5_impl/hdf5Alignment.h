@@ -130,6 +130,8 @@ protected:
    bool _dirty;
    mutable std::map<std::string, HDF5Genome*> _openGenomes;
    mutable bool _inMemory;
+   mutable hsize_t _cacheChunks;
+   mutable bool _prefetch;
 };
 
 }
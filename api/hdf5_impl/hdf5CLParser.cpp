@@ -21,6 +21,9 @@ const hsize_t HDF5CLParser::DefaultCacheRDCElems = 599999;
 const hsize_t HDF5CLParser::DefaultCacheRDCBytes = 15728640;
 const double HDF5CLParser::DefaultCacheW0 = 0.75;
 const bool HDF5CLParser::DefaultInMemory = false;
+const hsize_t HDF5CLParser::DefaultCacheChunks = 4;
+const bool HDF5CLParser::DefaultPrefetch = false;
+const bool HDF5CLParser::DefaultPerfStats = false;
 
 HDF5CLParser::HDF5CLParser(bool createOptions) :
   CLParser()
@@ -39,8 +42,20 @@ HDF5CLParser::HDF5CLParser(bool createOptions) :
   addOption("cacheBytes", "maximum size in bytes of regular hdf5 cache",
             DefaultCacheRDCBytes);
   addOption("cacheW0", "w0 parameter fro hdf5 cache", DefaultCacheW0);
+  addOption("cacheChunks", "number of decompressed chunks kept in memory "
+            "(least recently used are dropped first) for each array.  "
+            "on top of (and independent from) the hdf5 cache",
+            DefaultCacheChunks);
   addOptionFlag("inMemory", "load all data in memory (and disable hdf5 cache)",
                 DefaultInMemory);
+  addOptionFlag("prefetch", "decompress the next chunk in a background "
+                "thread when an array is scanned in order.  needs "
+                "--cacheChunks > 1 and is ignored with --inMemory", 
+                DefaultPrefetch);
+  addOptionFlag("perfStats", "print counters of array pages read, sequence "
+                "lookups, column iterator moves and mapped segments to "
+                "stderr on exit.  needs HAL built with HAL_PERF_STATS=1",
+                DefaultPerfStats);
 #ifdef ENABLE_UDC
   addOption("udcCacheDir", "udc cache path for *input* hal file(s).",
             "\"\"");
@@ -75,3 +90,18 @@ bool HDF5CLParser::getInMemory() const
 {
   return getFlag("inMemory");
 }
+
+hsize_t HDF5CLParser::getCacheChunks() const
+{
+  return getOption<hsize_t>("cacheChunks");
+}
+
+bool HDF5CLParser::getPrefetch() const
+{
+  return getFlag("prefetch");
+}
+
+bool HDF5CLParser::getPerfStats() const
+{
+  return getFlag("perfStats");
+}
@@ -24,6 +24,9 @@ public:
    void applyToDCProps(H5::DSetCreatPropList& dcprops) const;
    void applyToAProps(H5::FileAccPropList& aprops) const;
    bool getInMemory() const;
+   hsize_t getCacheChunks() const;
+   bool getPrefetch() const;
+   bool getPerfStats() const;
 
    static const hsize_t DefaultChunkSize;
    static const hsize_t DefaultDeflate;
@@ -32,6 +35,9 @@ public:
    static const hsize_t DefaultCacheRDCBytes;
    static const double DefaultCacheW0;
    static const bool DefaultInMemory;
+   static const hsize_t DefaultCacheChunks;
+   static const bool DefaultPrefetch;
+   static const bool DefaultPerfStats;
 
 protected:
    // Nobody creates this class except through the interface. 
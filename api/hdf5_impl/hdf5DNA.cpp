@@ -0,0 +1,410 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include <cassert>
+#include <cstddef>
+#include <algorithm>
+#include <string>
+#include "halCommon.h"
+#include "hdf5DNA.h"
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+using namespace hal;
+
+// The 4-bit codes are small enough that decoding is a 16-entry table
+// lookup, which is exactly what SSSE3's pshufb does for 16 bytes at a
+// time.  Encoding goes through a 256-entry table in the other direction.
+// Both tables come in forward and reverse-complement flavours so that
+// reversed reads and writes take the same path as forward ones.
+
+static const char unpackTable[16] = {
+  'a', 'c', 'g', 't', 'n', 'x', 'x', 'x',
+  'A', 'C', 'G', 'T', 'N', 'X', 'X', 'X'
+};
+
+static const char unpackRCTable[16] = {
+  't', 'g', 'c', 'a', 'n', 'x', 'x', 'x',
+  'T', 'G', 'C', 'A', 'N', 'X', 'X', 'X'
+};
+
+/** char -> 4-bit code (-1 for anything that isn't a nucleotide) */
+struct HDF5DNAPackTable
+{
+   HDF5DNAPackTable(bool reversed);
+   signed char _code[256];
+};
+
+HDF5DNAPackTable::HDF5DNAPackTable(bool reversed)
+{
+  for (size_t i = 0; i < 256; ++i)
+  {
+    _code[i] = -1;
+  }
+  const string bases = "acgtn";
+  for (size_t i = 0; i < bases.length(); ++i)
+  {
+    char c = reversed ? reverseComplement(bases[i]) : bases[i];
+    unsigned char lower = (unsigned char)c;
+    unsigned char upper = (unsigned char)std::toupper(c);
+    _code[lower] = (signed char)i;
+    _code[upper] = (signed char)(i | 8U);
+  }
+}
+
+static const HDF5DNAPackTable packTable(false);
+static const HDF5DNAPackTable packRCTable(true);
+
+static void throwInvalidChar(char c)
+{
+  throw hal_exception(string("Trying to set invalid charachter: ") + c);
+}
+
+#ifdef __SSSE3__
+
+/** Decode 32 bases (16 bytes) at a time.  dest is where the first base
+ * goes (the others go to its left if reversed).  Returns the number of
+ * bases decoded */
+static hal_size_t unpackBlocks(hal_size_t length, const unsigned char* packed,
+                               char* dest, bool reversed)
+{
+  const __m128i table = _mm_loadu_si128(reinterpret_cast<const __m128i*>(
+                                          reversed ? unpackRCTable :
+                                          unpackTable));
+  const __m128i lowMask = _mm_set1_epi8(0x0f);
+  const __m128i flip = _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8,
+                                     7, 6, 5, 4, 3, 2, 1, 0);
+  hal_size_t i = 0;
+  for (; i + 32 <= length; i += 32, packed += 16)
+  {
+    __m128i bytes = _mm_loadu_si128(
+      reinterpret_cast<const __m128i*>(packed));
+    // even positions are in the high nibble
+    __m128i hi = _mm_and_si128(_mm_srli_epi16(bytes, 4), lowMask);
+    __m128i lo = _mm_and_si128(bytes, lowMask);
+    __m128i first = _mm_shuffle_epi8(table, _mm_unpacklo_epi8(hi, lo));
+    __m128i second = _mm_shuffle_epi8(table, _mm_unpackhi_epi8(hi, lo));
+    if (reversed == false)
+    {
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dest), first);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + 16), second);
+      dest += 32;
+    }
+    else
+    {
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dest - 15),
+                       _mm_shuffle_epi8(first, flip));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(dest - 31),
+                       _mm_shuffle_epi8(second, flip));
+      dest -= 32;
+    }
+  }
+  return i;
+}
+
+/** Encode 16 characters into their 4-bit codes.  Returns false if
+ * any of them isn't a nucleotide */
+static inline bool packCodes(__m128i chars, __m128i codeTable, __m128i& codes)
+{
+  // the low nibbles of a, c, g, t and n are all different (1, 3, 7, 4, e)
+  // so they index both the expected letter and its code.
+  const __m128i letterTable = _mm_setr_epi8(0, 'a', 0, 'c', 't', 0, 0, 'g',
+                                            0, 0, 0, 0, 0, 0, 'n', 0);
+  const __m128i lowMask = _mm_set1_epi8(0x0f);
+  const __m128i caseBit = _mm_set1_epi8(0x20);
+  __m128i idx = _mm_and_si128(chars, lowMask);
+  __m128i lower = _mm_or_si128(chars, caseBit);
+  __m128i valid = _mm_cmpeq_epi8(lower, _mm_shuffle_epi8(letterTable, idx));
+  if (_mm_movemask_epi8(valid) != 0xffff)
+  {
+    return false;
+  }
+  // capitals don't have the 0x20 bit: move it to 0x08
+  __m128i capital = _mm_andnot_si128(chars, caseBit);
+  capital = _mm_and_si128(_mm_srli_epi16(capital, 2), _mm_set1_epi8(0x08));
+  codes = _mm_or_si128(_mm_shuffle_epi8(codeTable, idx), capital);
+  return true;
+}
+
+/** Encode 32 bases (16 bytes) at a time, stopping at the first block
+ * that contains an invalid character (which the caller will then throw
+ * on).  Returns the number of bases encoded */
+static hal_size_t packBlocks(hal_size_t length, const char* inString,
+                             unsigned char* packed, bool reversed)
+{
+  const __m128i codeTable = reversed ?
+     _mm_setr_epi8(0, 3, 0, 2, 0, 0, 0, 1, 0, 0, 0, 0, 0, 0, 4, 0) :
+     _mm_setr_epi8(0, 0, 0, 1, 3, 0, 0, 2, 0, 0, 0, 0, 0, 0, 4, 0);
+  const __m128i flip = _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8,
+                                     7, 6, 5, 4, 3, 2, 1, 0);
+  // multiply-add adjacent bytes by (16, 1) to put even bases in the
+  // high nibble
+  const __m128i shift = _mm_set1_epi16(0x0110);
+  hal_size_t i = 0;
+  for (; i + 32 <= length; i += 32, packed += 16)
+  {
+    __m128i a, b;
+    if (reversed == false)
+    {
+      a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(inString + i));
+      b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(
+                            inString + i + 16));
+    }
+    else
+    {
+      const char* src = inString + length - i - 32;
+      a = _mm_shuffle_epi8(_mm_loadu_si128(
+                             reinterpret_cast<const __m128i*>(src + 16)),
+                           flip);
+      b = _mm_shuffle_epi8(_mm_loadu_si128(
+                             reinterpret_cast<const __m128i*>(src)), flip);
+    }
+    __m128i codesA, codesB;
+    if (packCodes(a, codeTable, codesA) == false ||
+        packCodes(b, codeTable, codesB) == false)
+    {
+      break;
+    }
+    __m128i wordsA = _mm_maddubs_epi16(codesA, shift);
+    __m128i wordsB = _mm_maddubs_epi16(codesB, shift);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(packed),
+                     _mm_packus_epi16(wordsA, wordsB));
+  }
+  return i;
+}
+
+#endif
+
+void HDF5DNA::unpackString(hal_index_t index, hal_size_t length,
+                           const unsigned char* packed, char* outString,
+                           bool reversed)
+{
+  assert(index >= 0);
+  if (length == 0)
+  {
+    return;
+  }
+  const char* table = reversed ? unpackRCTable : unpackTable;
+  char* dest = reversed ? outString + length - 1 : outString;
+  const ptrdiff_t step = reversed ? -1 : 1;
+  hal_size_t i = 0;
+  if (index % 2 != 0)
+  {
+    *dest = table[*packed & 15U];
+    dest += step;
+    ++packed;
+    ++i;
+  }
+#ifdef __SSSE3__
+  hal_size_t blockLength = unpackBlocks(length - i, packed, dest, reversed);
+  i += blockLength;
+  packed += blockLength / 2;
+  dest += step * (ptrdiff_t)blockLength;
+#endif
+  for (; i + 1 < length; i += 2, ++packed)
+  {
+    dest[0] = table[*packed >> 4];
+    dest[step] = table[*packed & 15U];
+    dest += 2 * step;
+  }
+  if (i < length)
+  {
+    *dest = table[*packed >> 4];
+  }
+}
+
+void HDF5DNA::packString(hal_index_t index, hal_size_t length,
+                         const char* inString, unsigned char* packed,
+                         bool reversed)
+{
+  assert(index >= 0);
+  if (length == 0)
+  {
+    return;
+  }
+  const signed char* table = reversed ? packRCTable._code : packTable._code;
+  const char* src = reversed ? inString + length - 1 : inString;
+  const ptrdiff_t step = reversed ? -1 : 1;
+  hal_size_t i = 0;
+  signed char code;
+  if (index % 2 != 0)
+  {
+    if ((code = table[(unsigned char)*src]) < 0)
+    {
+      throwInvalidChar(*src);
+    }
+    *packed = (*packed & 240U) | (unsigned char)code;
+    src += step;
+    ++packed;
+    ++i;
+  }
+#ifdef __SSSE3__
+  hal_size_t blockLength = packBlocks(length - i,
+                                      reversed ? inString : src,
+                                      packed, reversed);
+  i += blockLength;
+  packed += blockLength / 2;
+  src += step * (ptrdiff_t)blockLength;
+#endif
+  signed char code2;
+  for (; i + 1 < length; i += 2, ++packed)
+  {
+    if ((code = table[(unsigned char)src[0]]) < 0)
+    {
+      throwInvalidChar(src[0]);
+    }
+    if ((code2 = table[(unsigned char)src[step]]) < 0)
+    {
+      throwInvalidChar(src[step]);
+    }
+    *packed = (unsigned char)((code << 4) | code2);
+    src += 2 * step;
+  }
+  if (i < length)
+  {
+    if ((code = table[(unsigned char)*src]) < 0)
+    {
+      throwInvalidChar(*src);
+    }
+    *packed = (*packed & 15U) | (unsigned char)(code << 4);
+  }
+}
+
+// Counting doesn't need the letters, only the low 3 bits of each code
+// (the base) and the high bit (capital).  With SSE2 each kind of base is
+// counted by comparing 32 nibbles at a time against its code and
+// subtracting the all-ones matches from per-byte counters, which are
+// summed with psadbw before they can overflow.  Without it, a 16-entry
+// histogram of the codes is kept and folded at the end.
+
+#ifdef __SSE2__
+
+static inline hal_size_t sumBytes(__m128i counters)
+{
+  __m128i sums = _mm_sad_epu8(counters, _mm_setzero_si128());
+  return (hal_size_t)_mm_cvtsi128_si32(sums) +
+     (hal_size_t)_mm_cvtsi128_si32(_mm_srli_si128(sums, 8));
+}
+
+/** Count 32 bases (16 bytes) at a time.  Returns the number of bytes
+ * counted */
+static hal_size_t countBlocks(hal_size_t numBytes, const unsigned char* packed,
+                              BaseCounts& counts)
+{
+  const __m128i lowMask = _mm_set1_epi8(0x0f);
+  const __m128i baseMask = _mm_set1_epi8(0x07);
+  const __m128i capitalBit = _mm_set1_epi8(0x08);
+  hal_size_t baseTotals[5] = {0, 0, 0, 0, 0};
+  hal_size_t capitalTotal = 0;
+  hal_size_t i = 0;
+  while (i + 16 <= numBytes)
+  {
+    __m128i baseCounters[5];
+    for (size_t b = 0; b < 5; ++b)
+    {
+      baseCounters[b] = _mm_setzero_si128();
+    }
+    __m128i capitalCounter = _mm_setzero_si128();
+    // each byte adds at most 2 to a counter per iteration
+    for (size_t j = 0; j < 127 && i + 16 <= numBytes; ++j, i += 16)
+    {
+      __m128i bytes = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(packed + i));
+      __m128i hi = _mm_and_si128(_mm_srli_epi16(bytes, 4), lowMask);
+      __m128i lo = _mm_and_si128(bytes, lowMask);
+      __m128i hiBase = _mm_and_si128(hi, baseMask);
+      __m128i loBase = _mm_and_si128(lo, baseMask);
+      for (size_t b = 0; b < 5; ++b)
+      {
+        __m128i code = _mm_set1_epi8((char)b);
+        baseCounters[b] = _mm_sub_epi8(baseCounters[b],
+                                       _mm_cmpeq_epi8(hiBase, code));
+        baseCounters[b] = _mm_sub_epi8(baseCounters[b],
+                                       _mm_cmpeq_epi8(loBase, code));
+      }
+      capitalCounter = _mm_sub_epi8(
+        capitalCounter, _mm_cmpeq_epi8(_mm_and_si128(hi, capitalBit),
+                                       capitalBit));
+      capitalCounter = _mm_sub_epi8(
+        capitalCounter, _mm_cmpeq_epi8(_mm_and_si128(lo, capitalBit),
+                                       capitalBit));
+    }
+    for (size_t b = 0; b < 5; ++b)
+    {
+      baseTotals[b] += sumBytes(baseCounters[b]);
+    }
+    capitalTotal += sumBytes(capitalCounter);
+  }
+  counts._a += baseTotals[0];
+  counts._c += baseTotals[1];
+  counts._g += baseTotals[2];
+  counts._t += baseTotals[3];
+  counts._n += baseTotals[4];
+  counts._other += 2 * i - (baseTotals[0] + baseTotals[1] + baseTotals[2] +
+                            baseTotals[3] + baseTotals[4]);
+  counts._masked += 2 * i - capitalTotal;
+  return i;
+}
+
+#endif
+
+void HDF5DNA::countBases(hal_index_t index, hal_size_t length,
+                         const unsigned char* packed, BaseCounts& counts)
+{
+  assert(index >= 0);
+  if (length == 0)
+  {
+    return;
+  }
+  hal_size_t codeCounts[16];
+  std::fill(codeCounts, codeCounts + 16, 0);
+  hal_size_t i = 0;
+  if (index % 2 != 0)
+  {
+    ++codeCounts[*packed & 15U];
+    ++packed;
+    ++i;
+  }
+  hal_size_t numBytes = (length - i) / 2;
+#ifdef __SSE2__
+  hal_size_t blockBytes = countBlocks(numBytes, packed, counts);
+  packed += blockBytes;
+  i += 2 * blockBytes;
+  numBytes -= blockBytes;
+#endif
+  for (hal_size_t j = 0; j < numBytes; ++j, ++packed)
+  {
+    ++codeCounts[*packed >> 4];
+    ++codeCounts[*packed & 15U];
+  }
+  i += 2 * numBytes;
+  if (i < length)
+  {
+    ++codeCounts[*packed >> 4];
+  }
+
+  for (size_t code = 0; code < 16; ++code)
+  {
+    switch (code & 7U)
+    {
+    case 0U : counts._a += codeCounts[code]; break;
+    case 1U : counts._c += codeCounts[code]; break;
+    case 2U : counts._g += codeCounts[code]; break;
+    case 3U : counts._t += codeCounts[code]; break;
+    case 4U : counts._n += codeCounts[code]; break;
+    default : counts._other += codeCounts[code]; break;
+    }
+    if ((code & 8U) == 0)
+    {
+      counts._masked += codeCounts[code];
+    }
+  }
+}
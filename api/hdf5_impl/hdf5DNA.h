@@ -10,6 +10,7 @@
 #include <cstdlib>
 #include <H5Cpp.h>
 #include "halDefs.h"
+#include "halSegmentedSequence.h"
 
 namespace hal {
 
@@ -22,6 +23,38 @@ public:
    static char unpack(hal_index_t index, unsigned char packedChar);
    static void pack(char unpackedChar, hal_index_t index, 
                     unsigned char& packedChar);
+
+   /** Decode a run of consecutive bases.  The characters are the same
+    * as those returned by unpack() one at a time.
+    * @param index Genome position of the first base
+    * @param length Number of bases to decode
+    * @param packed Pointer to the byte containing the first base
+    * @param outString Buffer of at least length characters
+    * @param reversed If true, the reverse complement is written (ie
+    * the complement of base index goes into outString[length - 1]) */
+   static void unpackString(hal_index_t index, hal_size_t length,
+                            const unsigned char* packed, char* outString,
+                            bool reversed);
+
+   /** Encode a run of consecutive bases.  Throws a hal_exception
+    * if a character is not a nucleotide (see isNucleotide()).
+    * @param index Genome position of the first base
+    * @param length Number of bases to encode
+    * @param inString Buffer of at least length characters
+    * @param packed Pointer to the byte containing the first base
+    * @param reversed If true, the reverse complement of inString
+    * is stored */
+   static void packString(hal_index_t index, hal_size_t length,
+                          const char* inString, unsigned char* packed,
+                          bool reversed);
+
+   /** Count a run of consecutive bases without decoding them.
+    * @param index Genome position of the first base
+    * @param length Number of bases to count
+    * @param packed Pointer to the byte containing the first base
+    * @param counts Counts to add to */
+   static void countBases(hal_index_t index, hal_size_t length,
+                          const unsigned char* packed, BaseCounts& counts);
 };
 
 // inline members
@@ -8,6 +8,7 @@
 #define _HDF5DNAITERATOR_H
 
 #include <cassert>
+#include <algorithm>
 #include <H5Cpp.h>
 #include "halDNAIterator.h"
 #include "halCommon.h"
@@ -168,23 +169,65 @@ inline void HDF5DNAIterator::readString(std::string& outString,
 {
   assert(length == 0 || inRange() == true);
   outString.resize(length);
+  if (length == 0)
+  {
+    return;
+  }
 
-  for (hal_size_t i = 0; i < length; ++i)
+  // decode whole buffers of the array at a time, from left to right 
+  // regardless of orientation
+  hal_index_t first = _reversed ? _index - (hal_index_t)length + 1 : _index;
+  assert(first >= 0 && 
+         first + length <= _genome->_totalSequenceLength);
+  char* out = &outString[0];
+  hal_size_t done = 0;
+  while (done < length)
   {
-    outString[i] = getChar();
-    toRight();
+    hal_index_t pos = first + done;
+    hsize_t numBytes;
+    const unsigned char* packed = reinterpret_cast<const unsigned char*>(
+      _genome->_dnaArray.getRange(pos / 2, numBytes));
+    hal_size_t n = std::min(length - done, 
+                            (hal_size_t)(numBytes * 2 - pos % 2));
+    HDF5DNA::unpackString(pos, n, packed, 
+                          _reversed ? out + length - done - n : out + done,
+                          _reversed);
+    done += n;
   }
+  _index += _reversed ? -(hal_index_t)length : (hal_index_t)length;
 }
 
 inline void HDF5DNAIterator::writeString(const std::string& inString,
                                          hal_size_t length)
 {
   assert(length == 0 || inRange() == true);
-  for (hal_size_t i = 0; i < length; ++i)
+  assert(inString.length() >= length);
+  if (length == 0)
+  {
+    return;
+  }
+
+  hal_index_t first = _reversed ? _index - (hal_index_t)length + 1 : _index;
+  if (first < 0 || first + length > _genome->_totalSequenceLength)
+  {
+    throw hal_exception("Trying to set character out of range");
+  }
+  const char* in = inString.c_str();
+  hal_size_t done = 0;
+  while (done < length)
   {
-    setChar(inString[i]);
-    toRight();
+    hal_index_t pos = first + done;
+    hsize_t numBytes;
+    unsigned char* packed = reinterpret_cast<unsigned char*>(
+      _genome->_dnaArray.getUpdateRange(pos / 2, numBytes));
+    hal_size_t n = std::min(length - done, 
+                            (hal_size_t)(numBytes * 2 - pos % 2));
+    HDF5DNA::packString(pos, n, 
+                        _reversed ? in + length - done - n : in + done,
+                        packed, _reversed);
+    done += n;
   }
+  _index += _reversed ? -(hal_index_t)length : (hal_index_t)length;
 }
 
 }
@@ -6,7 +6,11 @@
 
 #include <cassert>
 #include <iostream>
+#include <cstring>
+#include <algorithm>
+#include <sys/time.h>
 #include "hdf5ExternalArray.h"
+#include "hdf5Prefetcher.h"
 
 using namespace hal;
 using namespace H5;
@@ -17,17 +21,29 @@ HDF5ExternalArray::HDF5ExternalArray() :
   _file(NULL),
   _size(0),
   _chunkSize(0),
-  _bufStart(0),
+  _bufStart(1),
   _bufEnd(0),
   _bufSize(0),
   _buf(NULL),
-  _dirty(false)
+  _dirty(false),
+  _curPage(0),
+  _maxPages(1),
+  _pageClock(0),
+  _cacheHits(0),
+  _cacheMisses(0),
+  _prefetcher(NULL),
+  _prefetch(false),
+  _prefetchSlot(1),
+  _lastPageStart(0),
+  _prefetchHits(0),
+  _perfCounters(NULL)
 {}
 
 /** Destructor */
 HDF5ExternalArray::~HDF5ExternalArray()
 {
-  delete [] _buf;
+  resetPages(1);
+  delete _prefetcher;
 }
 
 // Create a new dataset in specifed location
@@ -36,11 +52,20 @@ void HDF5ExternalArray::create(CommonFG* file,
                                const DataType& dataType,
                                hsize_t numElements,
                                const DSetCreatPropList* inCparms,
-                               hsize_t chunksInBuffer)
+                               hsize_t chunksInBuffer,
+                               hsize_t numPages)
 {
+  // stop reading from the previous dataset
+  setPrefetch(false);
+  delete _prefetcher;
+  _prefetcher = NULL;
+
   // copy in parameters
   _file = file;
   _path = path;
+#ifdef HAL_PERF_STATS
+  _perfCounters = PerfStats::getArrayCounters(_path);
+#endif
   _dataType = dataType;
   _size = numElements;
   _dataSize = _dataType.getSize();
@@ -75,27 +100,38 @@ void HDF5ExternalArray::create(CommonFG* file,
     _chunkSize = 0;
   }
   
-  // create the internal data buffer
-  _bufSize = _chunkSize > 1 ? _chunkSize : _size;  
-  _bufStart = 0;
-  _bufEnd = _bufStart + _bufSize - 1;
-  delete [] _buf;
-  _buf = new char[_bufSize * _dataSize];
-
   // create the hdf5 array
   _dataSet = _file->createDataSet(_path, _dataType, _dataSpace, cparms);
-  _chunkSpace = DataSpace(1, &_bufSize);
+
+  // the whole array fits in one buffer: no point in caching more.
+  resetPages(_chunkSize > 1 ? numPages : 1);
+
+  // the first buffer is fresh: nothing to read from the file
+  if (_size > 0)
+  {
+    hsize_t slot = newPage(0);
+    memset(_pages[slot]._buf, 0, _pages[slot]._size * _dataSize);
+    setCurrentPage(slot);
+  }
   assert(getSize() == numElements);
   assert(_bufSize > 0 || _size == 0);
 }
 
 // Load an existing dataset into memory
 void HDF5ExternalArray::load(CommonFG* file, const H5std_string& path,
-                             hsize_t chunksInBuffer)
+                             hsize_t chunksInBuffer, hsize_t numPages)
 {
+  // stop reading from the previous dataset
+  setPrefetch(false);
+  delete _prefetcher;
+  _prefetcher = NULL;
+
   // load up the parameters
   _file = file;
   _path = path;
+#ifdef HAL_PERF_STATS
+  _perfCounters = PerfStats::getArrayCounters(_path);
+#endif
   _dataSet = _file->openDataSet(_path);
   _dataType = _dataSet.getDataType();
   _dataSpace = _dataSet.getSpace();
@@ -126,47 +162,287 @@ void HDF5ExternalArray::load(CommonFG* file, const H5std_string& path,
     _chunkSize = 0;
   }
   
-  // create the internal data buffer
-  _bufSize = _chunkSize > 1 ? _chunkSize : _size;  
-  _bufEnd = _bufStart + _bufSize - 1;
-  // set out of range to ensure page happens
-  _bufStart = _bufEnd + 1;
-  delete [] _buf;
-  _buf = new char[_bufSize * _dataSize];
-
-  assert(_bufSize > 0 || _size == 0);
+  // nothing gets read until the first access (the current buffer
+  // range is left empty to ensure page happens)
+  resetPages(_chunkSize > 1 ? numPages : 1);
 }
 
-// Write the memory buffer back to the file 
+// Write all modified pages back to the file 
 void HDF5ExternalArray::write()
 {
-  if (_dirty == true)
+  if (_prefetchSlot < _pages.size())
+  {
+    finishPrefetch();
+  }
+  if (_curPage < _pages.size())
   {
-    _dataSpace.selectHyperslab(H5S_SELECT_SET, &_bufSize, &_bufStart);
-    _dataSet.write(_buf, _dataType, _chunkSpace, _dataSpace);
+    _pages[_curPage]._dirty = _dirty;
+  }
+  for (vector<Page>::iterator i = _pages.begin(); i != _pages.end(); ++i)
+  {
+    if (i->_dirty == true)
+    {
+      writePage(*i);
+    }
+  }
+  _dirty = false;
+}
+
+// Copy raw elements over from another array, buffer by buffer
+void HDF5ExternalArray::copyFrom(HDF5ExternalArray& source, 
+                                 hsize_t sourceIndex,
+                                 hsize_t index, hsize_t numElements)
+{
+  assert(&source != this);
+  if (source._dataSize != _dataSize)
+  {
+    throw hal_exception("error: attempt to copy between hdf5 arrays with "
+                        "different element sizes");
+  }
+  if (sourceIndex + numElements > source._size || 
+      index + numElements > _size)
+  {
+    throw hal_exception("error: attempt to copy hdf5 array out of bounds");
+  }
+  while (numElements > 0)
+  {
+    hsize_t sourceAvail = 0;
+    hsize_t destAvail = 0;
+    const char* sourceData = source.getRange(sourceIndex, sourceAvail);
+    char* destData = getUpdateRange(index, destAvail);
+    hsize_t n = min(numElements, min(sourceAvail, destAvail));
+    memcpy(destData, sourceData, n * _dataSize);
+    sourceIndex += n;
+    index += n;
+    numElements -= n;
   }
 }
 
 // Page chunk containing index i into memory 
 void HDF5ExternalArray::page(hsize_t i)
 {
-  if (_dirty == true)
+#ifdef HAL_PERF_STATS
+  struct timeval startTime;
+  gettimeofday(&startTime, NULL);
+#endif
+  if (_curPage < _pages.size())
+  {
+    _pages[_curPage]._dirty = _dirty;
+  }
+  hsize_t pageSize = _chunkSize > 1 ? _chunkSize : _size;  
+  hsize_t pageStart = (i / pageSize) * pageSize;
+
+  hsize_t slot;
+  map<hsize_t, hsize_t>::iterator mapIt = _pageMap.find(pageStart);
+  if (mapIt != _pageMap.end())
+  {
+    ++_cacheHits;
+    slot = mapIt->second;
+    if (slot == _prefetchSlot)
+    {
+      ++_prefetchHits;
+      finishPrefetch();
+    }
+  }
+  else
+  {
+    ++_cacheMisses;
+    slot = newPage(pageStart);
+    readPage(_pages[slot]);
+  }
+  setCurrentPage(slot);
+  if (_prefetch == true)
+  {
+    prefetch(pageStart, pageSize);
+  }
+  _lastPageStart = pageStart;
+  assert(_bufSize > 0 || _size == 0);
+#ifdef HAL_PERF_STATS
+  struct timeval endTime;
+  gettimeofday(&endTime, NULL);
+  __sync_fetch_and_add(&_perfCounters->_pageMicroseconds,
+                       (endTime.tv_sec - startTime.tv_sec) * 1000000 +
+                       endTime.tv_usec - startTime.tv_usec);
+#endif
+}
+
+void HDF5ExternalArray::setPrefetch(bool prefetch)
+{
+  if (_prefetchSlot < _pages.size())
+  {
+    finishPrefetch();
+  }
+  _prefetch = false;
+  if (prefetch == true && _maxPages > 1 && _chunkSize > 1 &&
+      HDF5Prefetcher::isSupported(_dataSet) == true)
+  {
+    // we need one hdf5 chunk per page
+    DSetCreatPropList cparms = _dataSet.getCreatePlist();
+    hsize_t chunkSize;
+    cparms.getChunk(1, &chunkSize);
+    _prefetch = chunkSize == _chunkSize;
+  }
+}
+
+void HDF5ExternalArray::prefetch(hsize_t pageStart, hsize_t pageSize)
+{
+  if (_prefetchSlot < _pages.size())
+  {
+    return;
+  }
+  hsize_t next;
+  if (pageStart == _lastPageStart + pageSize)
+  {
+    next = pageStart + pageSize;
+  }
+  else if (pageStart + pageSize == _lastPageStart && pageStart >= pageSize)
+  {
+    next = pageStart - pageSize;
+  }
+  else
+  {
+    return;
+  }
+  if (next >= _size || _pageMap.find(next) != _pageMap.end())
+  {
+    return;
+  }
+  if (_prefetcher == NULL)
+  {
+    _prefetcher = new HDF5Prefetcher(_dataSet);
+  }
+  hsize_t slot = newPage(next);
+  // make sure the new page doesn't get evicted right away
+  _pages[slot]._lastUse = ++_pageClock;
+  if (_prefetcher->start(next, _pages[slot]._buf, pageSize * _dataSize))
+  {
+    _prefetchSlot = slot;
+  }
+  else
+  {
+    readPage(_pages[slot]);
+  }
+}
+
+void HDF5ExternalArray::finishPrefetch()
+{
+  assert(_prefetchSlot < _pages.size() && _prefetcher != NULL);
+  hsize_t slot = _prefetchSlot;
+  _prefetchSlot = _maxPages;
+  if (_prefetcher->finish() == false)
   {
-    write();
+    readPage(_pages[slot]);
   }
-  _bufSize = _chunkSize > 1 ? _chunkSize : _size;  
-  _bufStart = (i / _bufSize) * _bufSize; // todo: review
-  _bufEnd = _bufStart + _bufSize - 1;  
+#ifdef HAL_PERF_STATS
+  else
+  {
+    __sync_fetch_and_add(&_perfCounters->_pageIns, 1);
+    __sync_fetch_and_add(&_perfCounters->_bytesInflated,
+                         _pages[slot]._size * _dataSize);
+  }
+#endif
+}
 
-  if (_bufEnd >= _size)
+hsize_t HDF5ExternalArray::newPage(hsize_t start)
+{
+  assert(start < _size);
+  hsize_t pageSize = _chunkSize > 1 ? _chunkSize : _size;  
+  hsize_t slot = _pages.size();
+  if (slot < _maxPages)
   {
-    _bufEnd = _size - 1;
-    _bufSize = _bufEnd - _bufStart + 1;
+    Page emptyPage;
+    emptyPage._buf = new char[pageSize * _dataSize];
+    _pages.push_back(emptyPage);
   }
+  else
+  {
+    // evict the least recently used page
+    slot = 0;
+    for (hsize_t j = 1; j < _pages.size(); ++j)
+    {
+      if (_pages[j]._lastUse < _pages[slot]._lastUse)
+      {
+        slot = j;
+      }
+    }
+    if (slot == _prefetchSlot)
+    {
+      finishPrefetch();
+    }
+    Page& oldPage = _pages[slot];
+    if (oldPage._dirty == true)
+    {
+      writePage(oldPage);
+    }
+    _pageMap.erase(oldPage._start);
+  }
+  Page& page = _pages[slot];
+  page._start = start;
+  page._size = min(pageSize, _size - start);
+  page._dirty = false;
+  page._lastUse = 0;
+  _pageMap.insert(pair<hsize_t, hsize_t>(start, slot));
+  return slot;
+}
+
+void HDF5ExternalArray::readPage(Page& page)
+{
+  DataSpace memSpace(1, &page._size);
+  _dataSpace.selectHyperslab(H5S_SELECT_SET, &page._size, &page._start);
+  _dataSet.read(page._buf, _dataType, memSpace, _dataSpace);
+#ifdef HAL_PERF_STATS
+  __sync_fetch_and_add(&_perfCounters->_pageIns, 1);
+  __sync_fetch_and_add(&_perfCounters->_bytesInflated,
+                       page._size * _dataSize);
+#endif
+}
+
+void HDF5ExternalArray::writePage(Page& page)
+{
+  // chunks read directly from the file would bypass what we write
+  // through the hdf5 cache.
+  if (_prefetch == true)
+  {
+    setPrefetch(false);
+  }
+  DataSpace memSpace(1, &page._size);
+  _dataSpace.selectHyperslab(H5S_SELECT_SET, &page._size, &page._start);
+  _dataSet.write(page._buf, _dataType, memSpace, _dataSpace);
+  page._dirty = false;
+}
 
-  _chunkSpace = DataSpace(1, &_bufSize);
-  _dataSpace.selectHyperslab(H5S_SELECT_SET, &_bufSize, &_bufStart);
-  _dataSet.read(_buf, _dataType, _chunkSpace, _dataSpace);
+void HDF5ExternalArray::resetPages(hsize_t numPages)
+{
+  if (_prefetchSlot < _pages.size())
+  {
+    finishPrefetch();
+  }
+  for (vector<Page>::iterator i = _pages.begin(); i != _pages.end(); ++i)
+  {
+    delete [] i->_buf;
+  }
+  _pages.clear();
+  _pageMap.clear();
+  _maxPages = max(numPages, (hsize_t)1);
+  _curPage = _maxPages;
+  _prefetchSlot = _maxPages;
+  _lastPageStart = _size;
+  _buf = NULL;
+  _bufSize = 0;
+  // set out of range to ensure page happens
+  _bufStart = 1;
+  _bufEnd = 0;
   _dirty = false;
-  assert(_bufSize > 0 || _size == 0);
+}
+
+void HDF5ExternalArray::setCurrentPage(hsize_t slot)
+{
+  Page& page = _pages[slot];
+  page._lastUse = ++_pageClock;
+  _curPage = slot;
+  _buf = page._buf;
+  _bufStart = page._start;
+  _bufSize = page._size;
+  _bufEnd = _bufStart + _bufSize - 1;
+  _dirty = page._dirty;
 }
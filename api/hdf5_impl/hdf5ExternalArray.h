@@ -8,11 +8,16 @@
 #define _HDF5EXTERNALARRAY_H
 
 #include <cassert>
+#include <vector>
+#include <map>
 #include <H5Cpp.h>
 #include "halDefs.h"
+#include "halPerfStats.h"
 
 namespace hal {
 
+class HDF5Prefetcher;
+
 /** 
  * Wrapper for a 1-dimensional HDF5 array of fixed length.  Array objects
  * are defined (and typed) by the input datatype.  The array is paged into
@@ -20,6 +25,13 @@ namespace hal {
  * We can't use compiler tpying of the input objects (and instead just 
  * expose the raw void* data) because the elements' sizes are not known
  * at compile time, and we don't want to move it around once its read.
+ * Several buffers (pages) can be kept in memory at once, in which case
+ * they are recycled in least-recently-used order so that access patterns
+ * that bounce between distant parts of the array don't have to re-read
+ * (and re-decompress) the same chunks over and over.  When prefetching
+ * is enabled, scanning the array one chunk after the other (in either
+ * direction) will start decompressing the next chunk in a background 
+ * thread (see HDF5Prefetcher).
  */
 class HDF5ExternalArray
 {
@@ -41,13 +53,15 @@ public:
      * 0: load entire array into buffer
      * 1: use default chunking (from dataset)
      * N: buffersize will be N chunks. 
+    * @param numPages Maximum number of buffers to keep in memory (LRU)
      */
    void create(H5::CommonFG* file, 
                const H5std_string& path, 
                const H5::DataType& dataType,
                hsize_t numElements,
                const H5::DSetCreatPropList* inCparms = NULL,
-               hsize_t chunksInBuffer = 1);
+               hsize_t chunksInBuffer = 1,
+               hsize_t numPages = 1);
  
    /** Load an existing dataset into memory
      * @param file Pointer to the HDF5 file in which to create array
@@ -56,11 +70,12 @@ public:
      * 0: load entire array into buffer
      * 1: use default chunking (from dataset)
      * N: buffersize will be N chunks. 
+    * @param numPages Maximum number of buffers to keep in memory (LRU)
      */
    void load(H5::CommonFG* file, const H5std_string& path,
-             hsize_t chunksInBuffer = 1);
+             hsize_t chunksInBuffer = 1, hsize_t numPages = 1);
    
-   /** Write the memory buffer back to the file */
+   /** Write all modified memory buffers back to the file */
    void write();
 
    /** Access the raw data at given index
@@ -73,6 +88,30 @@ public:
     */
    char* getUpdate(hsize_t i);
 
+   /** Access the raw data at given index for reading, along with the
+    * number of consecutive elements (starting at i) that are in the 
+    * same memory buffer and can be read through the returned pointer.
+    * @param i index of first element to retrieve
+    * @param numElements returns number of elements available */
+   const char* getRange(hsize_t i, hsize_t& numElements);
+
+   /** Access the raw data at given index for updating, along with the
+    * number of consecutive elements (starting at i) that are in the 
+    * same memory buffer and can be written through the returned pointer.
+    * @param i index of first element to retrieve
+    * @param numElements returns number of elements available */
+   char* getUpdateRange(hsize_t i, hsize_t& numElements);
+
+   /** Copy a run of raw elements from another array with the same
+    * element size, a memory buffer at a time rather than element by 
+    * element (the arrays can be in different files)
+    * @param source Array to copy from (must not be this array)
+    * @param sourceIndex Index of first element to read in source
+    * @param index Index of first element to overwrite in this array
+    * @param numElements Number of elements to copy */
+   void copyFrom(HDF5ExternalArray& source, hsize_t sourceIndex,
+                 hsize_t index, hsize_t numElements);
+
    /** Access typed value within element in a raw data array 
     * @param index Index of element (struct) in the array
     * @param offset Offset of value within struct (number of bytes) */
@@ -92,14 +131,75 @@ public:
    /** Number of elements in array */
    hsize_t getSize() const;
 
+   /** Size of an element in bytes */
+   hsize_t getDataSize() const;
+
    /** Get the HDF5 Datatype */
    const H5::DataType& getDataType() const;
+
+   /** Maximum number of buffers kept in memory */
+   hsize_t getNumPages() const;
+
+   /** Number of times a page was found in the memory cache */
+   hsize_t getCacheHits() const;
+
+   /** Number of times a page had to be read from the file */
+   hsize_t getCacheMisses() const;
+
+   /** Turn on or off background decompression of the next chunk during
+    * sequential scans.  Only has an effect on arrays that were load()ed
+    * with one chunk per buffer and at least two pages, and whose
+    * compression is supported by HDF5Prefetcher.  It is switched 
+    * back off as soon as anything is written to the array. */
+   void setPrefetch(bool prefetch);
+
+   /** Check if prefetching is enabled */
+   bool getPrefetch() const;
+
+   /** Number of page() calls served by a prefetched page (these are
+    * also counted as cache hits) */
+   hsize_t getPrefetchHits() const;
    
 protected:
 
-   /** Read chunk from file */
+   /** A buffer holding one (multi-)chunk of the array */
+   struct Page
+   {
+      hsize_t _start;
+      hsize_t _size;
+      char* _buf;
+      bool _dirty;
+      hsize_t _lastUse;
+   };
+
+   /** Make the page containing index i the current buffer, reading
+    * it from the file if it isn't already cached */
    void page(hsize_t i);
 
+   /** Get a free cache slot for the page starting at given index,
+    * evicting (and writing back if necessary) the least recently 
+    * used page if the cache is full */
+   hsize_t newPage(hsize_t start);
+
+   /** Read a page from the file */
+   void readPage(Page& page);
+
+   /** Write a page back to the file */
+   void writePage(Page& page);
+
+   /** Start reading the page next to the current one in the background
+    * if the last two pages were accessed in order */
+   void prefetch(hsize_t pageStart, hsize_t pageSize);
+
+   /** Wait for the pending background read to complete */
+   void finishPrefetch();
+
+   /** Free all pages (without writing) and reset the cache to given size */
+   void resetPages(hsize_t numPages);
+
+   /** Point the current buffer at the page in given slot */
+   void setCurrentPage(hsize_t slot);
+
    /** Pointer to file that owns this dataset */
    H5::CommonFG* _file;
    /** Path of dataset in file */
@@ -124,11 +224,36 @@ protected:
    hsize_t _bufSize;
    /** In-memory buffer */
    char* _buf;
-   /** Dimensional information for in-memory buffer */
-   H5::DataSpace _chunkSpace;
    /** Flag saying we should write to disk on write
     * or page-out calls (set by getUpdate()) */
    bool _dirty;
+   /** Cached pages (the current buffer is one of them) */
+   std::vector<Page> _pages;
+   /** Map start index of page to its slot in _pages */
+   std::map<hsize_t, hsize_t> _pageMap;
+   /** Slot in _pages of the current buffer */
+   hsize_t _curPage;
+   /** Maximum number of pages to keep in memory */
+   hsize_t _maxPages;
+   /** Counter used to timestamp pages for LRU eviction */
+   hsize_t _pageClock;
+   /** Number of page() calls served from memory */
+   hsize_t _cacheHits;
+   /** Number of page() calls that read from the file */
+   hsize_t _cacheMisses;
+   /** Background chunk reader (created on first use) */
+   HDF5Prefetcher* _prefetcher;
+   /** Flag saying if prefetching is enabled */
+   bool _prefetch;
+   /** Slot of the page being filled in the background (_maxPages if none) */
+   hsize_t _prefetchSlot;
+   /** Start index of the page read before the current one (_size if none) */
+   hsize_t _lastPageStart;
+   /** Number of page() calls that found a prefetched page */
+   hsize_t _prefetchHits;
+   /** Process-wide counters for arrays with this path (NULL unless
+    * HAL_PERF_STATS is defined) */
+   PerfStats::ArrayCounters* _perfCounters;
 
 private:
 
@@ -164,6 +289,22 @@ inline char* HDF5ExternalArray::getUpdate(hsize_t i)
   return _buf + (i - _bufStart) * _dataSize;
 }
 
+inline const char* HDF5ExternalArray::getRange(hsize_t i, 
+                                               hsize_t& numElements)
+{
+  const char* data = get(i);
+  numElements = _bufEnd - i + 1;
+  return data;
+}
+
+inline char* HDF5ExternalArray::getUpdateRange(hsize_t i, 
+                                               hsize_t& numElements)
+{
+  char* data = getUpdate(i);
+  numElements = _bufEnd - i + 1;
+  return data;
+}
+
 inline hsize_t HDF5ExternalArray::getSize() const
 {
   return _size;
@@ -188,10 +329,40 @@ inline void HDF5ExternalArray::setValue(hsize_t index, hsize_t offset, T val)
   *entry = val;
 }
 
+inline hsize_t HDF5ExternalArray::getDataSize() const
+{
+  return _dataSize;
+}
+
 inline const H5::DataType& HDF5ExternalArray::getDataType() const
 {
   return _dataType;
 }
 
+inline hsize_t HDF5ExternalArray::getNumPages() const
+{
+  return _maxPages;
+}
+
+inline hsize_t HDF5ExternalArray::getCacheHits() const
+{
+  return _cacheHits;
+}
+
+inline hsize_t HDF5ExternalArray::getCacheMisses() const
+{
+  return _cacheMisses;
+}
+
+inline bool HDF5ExternalArray::getPrefetch() const
+{
+  return _prefetch;
+}
+
+inline hsize_t HDF5ExternalArray::getPrefetchHits() const
+{
+  return _prefetchHits;
+}
+
 }
 #endif
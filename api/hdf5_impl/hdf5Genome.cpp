@@ -5,7 +5,9 @@
 #include <cassert>
 #include <iostream>
 #include <algorithm>
+#include <cstring>
 #include "H5Cpp.h"
+#include "halPerfStats.h"
 #include "hdf5Genome.h"
 #include "hdf5DNA.h"
 #include "hdf5TopSegment.h"
@@ -37,14 +39,19 @@ HDF5Genome::HDF5Genome(const string& name,
                        HDF5Alignment* alignment,
                        CommonFG* h5Parent,
                        const DSetCreatPropList& dcProps,
-                       bool inMemory) :
+                       bool inMemory,
+                       hsize_t numCacheChunks,
+                       bool prefetch) :
   _alignment(alignment),
   _h5Parent(h5Parent),
   _name(name),
   _numChildrenInBottomArray(0),
   _totalSequenceLength(0),
   _numChunksInArrayBuffer(inMemory ? 0 : 1),
-  _parentCache(NULL)
+  _numArrayBuffersInCache(inMemory ? 1 : numCacheChunks),
+  _prefetch(prefetch),
+  _parentCache(NULL),
+  _lastSequenceIndex(0)
 {
   _dcprops.copy(dcProps);
   assert(!name.empty());
@@ -162,17 +169,20 @@ void HDF5Genome::setDimensions(
     dnaDC.copy(_dcprops);
     dnaDC.setChunk(1, &chunk);
     _dnaArray.create(&_group, dnaArrayName, HDF5DNA::dataType(), 
-                     arrayLength, &dnaDC, _numChunksInArrayBuffer);
+                     arrayLength, &dnaDC, _numChunksInArrayBuffer,
+                     _numArrayBuffersInCache);
   }
   if (totalSeq > 0)
   {
     _sequenceIdxArray.create(&_group, sequenceIdxArrayName, 
                              HDF5Sequence::idxDataType(), 
-                             totalSeq + 1, &_dcprops, _numChunksInArrayBuffer);
+                             totalSeq + 1, &_dcprops, _numChunksInArrayBuffer,
+                             _numArrayBuffersInCache);
 
     _sequenceNameArray.create(&_group, sequenceNameArrayName, 
                               HDF5Sequence::nameDataType(maxName + 1), 
-                              totalSeq, &_dcprops, _numChunksInArrayBuffer);
+                              totalSeq, &_dcprops, _numChunksInArrayBuffer,
+                              _numArrayBuffersInCache);
 
     writeSequences(sequenceDimensions);    
   }
@@ -191,7 +201,7 @@ void HDF5Genome::updateTopDimensions(
   loadSequencePosCache();
   loadSequenceNameCache();
   vector<Sequence::UpdateInfo>::const_iterator i;
-  map<string, HDF5Sequence*>::iterator cacheIt;
+  map<string, hal_size_t>::iterator cacheIt;
   map<string, const Sequence::UpdateInfo*> inputMap;
   map<string, hal_size_t> currentTopD;
   // copy input into map, checking everything is already present
@@ -210,16 +220,18 @@ void HDF5Genome::updateTopDimensions(
   // keep a record of the number of segments in each existing 
   // segment (these can get muddled as we add the new ones in the next
   // loop to be sure by getting them in one shot)
-  // Note to self: iterating the map in this way skips zero-length 
-  // sequences (which are in the separate vector).  This is fine
+  // Note to self: this loop skips zero-length sequences.  This is fine
   // here since we will never update them, but seems like it could be 
   // dangerous if something were to change
-  map<hal_size_t, HDF5Sequence*>::iterator posCacheIt;
   map<string, const Sequence::UpdateInfo*>::iterator inputIt;
-  for (posCacheIt = _sequencePosCache.begin(); 
-       posCacheIt != _sequencePosCache.end(); ++posCacheIt)
+  hal_size_t numSequences = getNumSequences();
+  for (hal_size_t j = 0; j < numSequences; ++j)
   {
-    HDF5Sequence* sequence = posCacheIt->second;
+    if (_sequencePosCache[j + 1] == _sequencePosCache[j])
+    {
+      continue;
+    }
+    HDF5Sequence* sequence = getSequenceByIndex(j);
     inputIt = inputMap.find(sequence->getName());
     if (inputIt == inputMap.end())
     {
@@ -230,18 +242,18 @@ void HDF5Genome::updateTopDimensions(
   }
   // scan through existing sequences, updating as necessary
   // build summary of all new and unchanged dimensions in newDimensions
-  // Note to self: iterating the map in this way skips zero-length 
-  // sequences (which are in the separate vector).  This is fine
-  // here since we will never update them, but seems like it could be 
-  // dangerous if something were to change
+  // Note to self: this loop skips zero-length sequences too.
   map<string, hal_size_t>::iterator currentIt;
   vector<Sequence::UpdateInfo> newDimensions;
   Sequence::UpdateInfo newInfo;
   hal_size_t topArrayIndex = 0;
-  for (posCacheIt = _sequencePosCache.begin(); 
-       posCacheIt != _sequencePosCache.end(); ++posCacheIt)
+  for (hal_size_t j = 0; j < numSequences; ++j)
   {
-    HDF5Sequence* sequence = posCacheIt->second;
+    if (_sequencePosCache[j + 1] == _sequencePosCache[j])
+    {
+      continue;
+    }
+    HDF5Sequence* sequence = getSequenceByIndex(j);
     sequence->setTopSegmentArrayIndex(topArrayIndex);
     inputIt = inputMap.find(sequence->getName());
     if (inputIt != inputMap.end())
@@ -253,7 +265,7 @@ void HDF5Genome::updateTopDimensions(
     {
       currentIt = currentTopD.find(sequence->getName());
       assert(currentIt != currentTopD.end());
-      newInfo._name = posCacheIt->first;
+      newInfo._name = sequence->getName();
       newInfo._numSegments = currentIt->second;
       newDimensions.push_back(newInfo);
     }
@@ -269,7 +281,7 @@ void HDF5Genome::updateBottomDimensions(
   loadSequencePosCache();
   loadSequenceNameCache();
   vector<Sequence::UpdateInfo>::const_iterator i;
-  map<string, HDF5Sequence*>::iterator cacheIt;
+  map<string, hal_size_t>::iterator cacheIt;
   map<string, const Sequence::UpdateInfo*> inputMap;
   map<string, hal_size_t> currentBottomD;
   // copy input into map, checking everything is already present
@@ -288,16 +300,18 @@ void HDF5Genome::updateBottomDimensions(
   // keep a record of the number of segments in each existing 
   // segment (these can get muddled as we add the new ones in the next
   // loop to be sure by getting them in one shot)
-  // Note to self: iterating the map in this way skips zero-length 
-  // sequences (which are in the separate vector).  This is fine
+  // Note to self: this loop skips zero-length sequences.  This is fine
   // here since we will never update them, but seems like it could be 
   // dangerous if something were to change
-  map<hal_size_t, HDF5Sequence*>::iterator posCacheIt;
   map<string, const Sequence::UpdateInfo*>::iterator inputIt;
-  for (posCacheIt = _sequencePosCache.begin(); 
-       posCacheIt != _sequencePosCache.end(); ++posCacheIt)
+  hal_size_t numSequences = getNumSequences();
+  for (hal_size_t j = 0; j < numSequences; ++j)
   {
-    HDF5Sequence* sequence = posCacheIt->second;
+    if (_sequencePosCache[j + 1] == _sequencePosCache[j])
+    {
+      continue;
+    }
+    HDF5Sequence* sequence = getSequenceByIndex(j);
     inputIt = inputMap.find(sequence->getName());
     if (inputIt == inputMap.end())
     {
@@ -308,18 +322,18 @@ void HDF5Genome::updateBottomDimensions(
   }
   // scan through existing sequences, updating as necessary
   // build summary of all new and unchanged dimensions in newDimensions
-  // Note to self: iterating the map in this way skips zero-length 
-  // sequences (which are in the separate vector).  This is fine
-  // here since we will never update them, but seems like it could be 
-  // dangerous if something were to change
+  // Note to self: this loop skips zero-length sequences too.
   map<string, hal_size_t>::iterator currentIt;
   vector<Sequence::UpdateInfo> newDimensions;
   Sequence::UpdateInfo newInfo;
   hal_size_t bottomArrayIndex = 0;
-  for (posCacheIt = _sequencePosCache.begin(); 
-       posCacheIt != _sequencePosCache.end(); ++posCacheIt)
+  for (hal_size_t j = 0; j < numSequences; ++j)
   {
-    HDF5Sequence* sequence = posCacheIt->second;
+    if (_sequencePosCache[j + 1] == _sequencePosCache[j])
+    {
+      continue;
+    }
+    HDF5Sequence* sequence = getSequenceByIndex(j);
     sequence->setBottomSegmentArrayIndex(bottomArrayIndex);
     inputIt = inputMap.find(sequence->getName());
     if (inputIt != inputMap.end())
@@ -331,7 +345,7 @@ void HDF5Genome::updateBottomDimensions(
     {
       currentIt = currentBottomD.find(sequence->getName());
       assert(currentIt != currentBottomD.end());
-      newInfo._name = posCacheIt->first;
+      newInfo._name = sequence->getName();
       newInfo._numSegments = currentIt->second;
       newDimensions.push_back(newInfo);
     }
@@ -359,7 +373,8 @@ void HDF5Genome::setGenomeTopDimensions(
   }
   catch (H5::Exception){}
   _topArray.create(&_group, topArrayName, HDF5TopSegment::dataType(), 
-                   numTopSegments + 1, &_dcprops, _numChunksInArrayBuffer);
+                   numTopSegments + 1, &_dcprops, _numChunksInArrayBuffer,
+                   _numArrayBuffersInCache);
   _parentCache = NULL;
 }
 
@@ -394,7 +409,8 @@ void HDF5Genome::setGenomeBottomDimensions(
 
   _bottomArray.create(&_group, bottomArrayName, 
                       HDF5BottomSegment::dataType(numChildren), 
-                      numBottomSegments + 1, &botDC, _numChunksInArrayBuffer);
+                      numBottomSegments + 1, &botDC, _numChunksInArrayBuffer,
+                      _numArrayBuffersInCache);
   _numChildrenInBottomArray = numChildren;
   _childCache.clear();
 }
@@ -409,10 +425,10 @@ Sequence* HDF5Genome::getSequence(const string& name)
 {
   loadSequenceNameCache();
   Sequence* sequence = NULL;
-  map<string, HDF5Sequence*>::iterator mapIt = _sequenceNameCache.find(name);
+  map<string, hal_size_t>::iterator mapIt = _sequenceNameCache.find(name);
   if (mapIt != _sequenceNameCache.end())
   {
-    sequence = mapIt->second;
+    sequence = getSequenceByIndex(mapIt->second);
   }
   return sequence;
 }
@@ -421,47 +437,72 @@ const Sequence* HDF5Genome::getSequence(const string& name) const
 {
   loadSequenceNameCache();
   const Sequence* sequence = NULL;
-  map<string, HDF5Sequence*>::const_iterator mapIt = 
+  map<string, hal_size_t>::const_iterator mapIt = 
      _sequenceNameCache.find(name);
   if (mapIt != _sequenceNameCache.end())
   {
-    sequence = mapIt->second;
+    sequence = getSequenceByIndex(mapIt->second);
   }
   return sequence;
 }
 
 Sequence* HDF5Genome::getSequenceBySite(hal_size_t position)
+{
+  HAL_PERF_COUNT(SequenceBySiteCalls, 1);
+  hal_index_t index = getSequenceIndexBySite(position);
+  return index != NULL_INDEX ? getSequenceByIndex(index) : NULL;
+}
+
+const Sequence* HDF5Genome::getSequenceBySite(hal_size_t position) const
+{
+  HAL_PERF_COUNT(SequenceBySiteCalls, 1);
+  hal_index_t index = getSequenceIndexBySite(position);
+  return index != NULL_INDEX ? getSequenceByIndex(index) : NULL;
+}
+
+// lookups tend to come in runs on the same sequence, so check the 
+// last one before searching.  returns NULL_INDEX if position is
+// past the end of the genome
+hal_index_t HDF5Genome::getSequenceIndexBySite(hal_size_t position) const
 {
   loadSequencePosCache();
-  map<hal_size_t, HDF5Sequence*>::iterator i;
-  i = _sequencePosCache.upper_bound(position);
-  if (i != _sequencePosCache.end())
+  if (_lastSequenceIndex + 1 < _sequencePosCache.size() &&
+      position >= _sequencePosCache[_lastSequenceIndex] &&
+      position < _sequencePosCache[_lastSequenceIndex + 1])
   {
-    if (position >= (hal_size_t)i->second->getStartPosition())
-    {
-      assert(position < i->second->getStartPosition() +
-             i->second->getSequenceLength());
-      return i->second;
-    }
+    return (hal_index_t)_lastSequenceIndex;
   }
-  return NULL;
+  // the last of any zero-length sequences starting at the same place
+  // is the one that contains position
+  vector<hal_size_t>::const_iterator i = 
+     upper_bound(_sequencePosCache.begin(), _sequencePosCache.end(),
+                 position);
+  if (i == _sequencePosCache.begin() || i == _sequencePosCache.end())
+  {
+    return NULL_INDEX;
+  }
+  _lastSequenceIndex = (i - _sequencePosCache.begin()) - 1;
+  assert(position >= _sequencePosCache[_lastSequenceIndex] &&
+         position < _sequencePosCache[_lastSequenceIndex + 1]);
+  return (hal_index_t)_lastSequenceIndex;
 }
 
-const Sequence* HDF5Genome::getSequenceBySite(hal_size_t position) const
+HDF5Sequence* HDF5Genome::getSequenceByIndex(hal_size_t index) const
 {
-  loadSequencePosCache();
-  map<hal_size_t, HDF5Sequence*>::const_iterator i;
-  i = _sequencePosCache.upper_bound(position);
-  if (i != _sequencePosCache.end())
+  if (_sequenceCache.empty() == true)
   {
-    if (position >= (hal_size_t)i->second->getStartPosition())
-    {
-      assert(position < i->second->getStartPosition() +
-             i->second->getSequenceLength());
-      return i->second;
-    }
+    _sequenceCache.resize(getNumSequences(), NULL);
+  }
+  assert(index < _sequenceCache.size());
+  HDF5Sequence*& seq = _sequenceCache[index];
+  if (seq == NULL)
+  {
+    seq = new HDF5Sequence(const_cast<HDF5Genome*>(this),
+                           const_cast<HDF5ExternalArray*>(&_sequenceIdxArray),
+                           const_cast<HDF5ExternalArray*>(&_sequenceNameArray),
+                           index);
   }
-  return NULL;
+  return seq;
 }
 
 SequenceIteratorPtr HDF5Genome::getSequenceIterator(
@@ -585,6 +626,184 @@ const Alignment* HDF5Genome::getAlignment() const
   return _alignment;
 }
 
+// The copy methods below move raw records between the arrays of two
+// hdf5 genomes whenever the layouts agree, only rewriting the fields
+// that have to change, and fall back on the generic (segment by
+// segment) versions in Genome otherwise.
+
+void HDF5Genome::copyTopSegments(Genome *dest) const
+{
+  HDF5Genome* h5Dest = dynamic_cast<HDF5Genome*>(dest);
+  const Genome* inParent = getParent();
+  const Genome* outParent = dest->getParent();
+  hal_size_t n = dest->getNumTopSegments();
+  if (h5Dest == NULL || h5Dest == this || n == 0 || 
+      n != getNumTopSegments() || inParent == NULL || outParent == NULL)
+  {
+    Genome::copyTopSegments(dest);
+    return;
+  }
+
+  HDF5Genome* stripConstThis = const_cast<HDF5Genome*>(this);
+  h5Dest->_topArray.copyFrom(stripConstThis->_topArray, 0, 0, n + 1);
+
+  // the parent indices are only valid as-is if each parent sequence
+  // starts at the same bottom segment in both files.  otherwise shift 
+  // them by the difference, looking up the sequence by its first 
+  // bottom segment in the source parent.
+  vector<hal_index_t> inStarts;
+  vector<hal_index_t> deltas;
+  vector<const Sequence*> missing;
+  bool identity = true;
+  SequenceIteratorConstPtr seqIt = inParent->getSequenceIterator();
+  SequenceIteratorConstPtr seqEnd = inParent->getSequenceEndIterator();
+  for (; seqIt != seqEnd; seqIt->toNext())
+  {
+    const Sequence* inSeq = seqIt->getSequence();
+    if (inSeq->getNumBottomSegments() == 0)
+    {
+      continue;
+    }
+    const Sequence* outSeq = outParent->getSequence(inSeq->getName());
+    hal_index_t delta = outSeq == NULL ? 0 : 
+       outSeq->getBottomSegmentArrayIndex() - 
+       inSeq->getBottomSegmentArrayIndex();
+    identity = identity && outSeq != NULL && delta == 0;
+    inStarts.push_back(inSeq->getBottomSegmentArrayIndex());
+    deltas.push_back(delta);
+    missing.push_back(outSeq == NULL ? inSeq : NULL);
+  }
+  if (identity == true)
+  {
+    return;
+  }
+  for (hal_size_t i = 0; i < n; ++i)
+  {
+    hal_index_t parentIndex = h5Dest->_topArray.getValue<hal_index_t>(
+      i, HDF5TopSegment::parentIndexOffset);
+    if (parentIndex == NULL_INDEX)
+    {
+      continue;
+    }
+    size_t k = upper_bound(inStarts.begin(), inStarts.end(), parentIndex) -
+       inStarts.begin();
+    if (k == 0)
+    {
+      throw hal_exception("When copying top segments from " + getName() +
+                          ": parent index out of range");
+    }
+    --k;
+    if (missing[k] != NULL)
+    {
+      throw hal_exception("When copying top segments from " + getName() +
+                          " to " + dest->getName() + ": parent sequence " +
+                          missing[k]->getName() + " not found in " +
+                          outParent->getName());
+    }
+    if (deltas[k] != 0)
+    {
+      h5Dest->_topArray.setValue(i, HDF5TopSegment::parentIndexOffset,
+                                 parentIndex + deltas[k]);
+    }
+  }
+}
+
+void HDF5Genome::copyBottomSegments(Genome *dest) const
+{
+  HDF5Genome* h5Dest = dynamic_cast<HDF5Genome*>(dest);
+  hal_size_t n = getNumBottomSegments();
+  if (h5Dest == NULL || h5Dest == this || n != dest->getNumBottomSegments())
+  {
+    Genome::copyBottomSegments(dest);
+    return;
+  }
+
+  // records can only be copied in place if every sequence has the same
+  // coordinates and segment range in both genomes
+  SequenceIteratorConstPtr seqIt = getSequenceIterator(0);
+  SequenceIteratorConstPtr seqEnd = getSequenceEndIterator();
+  for (; seqIt != seqEnd; seqIt->toNext())
+  {
+    const Sequence* inSeq = seqIt->getSequence();
+    const Sequence* outSeq = dest->getSequence(inSeq->getName());
+    if (outSeq == NULL || 
+        outSeq->getStartPosition() != inSeq->getStartPosition() ||
+        outSeq->getNumBottomSegments() != inSeq->getNumBottomSegments() ||
+        (inSeq->getNumBottomSegments() > 0 &&
+         outSeq->getBottomSegmentArrayIndex() != 
+         inSeq->getBottomSegmentArrayIndex()))
+    {
+      Genome::copyBottomSegments(dest);
+      return;
+    }
+  }
+
+  // match up the child slots by name, as Genome::copyBottomSegments does
+  hal_size_t inNc = getNumChildren();
+  hal_size_t outNc = dest->getNumChildren();
+  vector<hal_size_t> inChildToOutChild(inNc, outNc);
+  bool identity = inNc == outNc && 
+     _numChildrenInBottomArray == h5Dest->_numChildrenInBottomArray;
+  for (hal_size_t inChild = 0; inChild < inNc; ++inChild)
+  {
+    for (hal_size_t outChild = 0; outChild < outNc; ++outChild)
+    {
+      if (getChild(inChild)->getName() == dest->getChild(outChild)->getName())
+      {
+        inChildToOutChild[inChild] = outChild;
+        break;
+      }
+    }
+    identity = identity && inChildToOutChild[inChild] == inChild;
+  }
+
+  assert(inNc <= _numChildrenInBottomArray && 
+         outNc <= h5Dest->_numChildrenInBottomArray);
+  HDF5ExternalArray& inArray = const_cast<HDF5Genome*>(this)->_bottomArray;
+  HDF5ExternalArray& outArray = h5Dest->_bottomArray;
+  if (identity == true)
+  {
+    outArray.copyFrom(inArray, 0, 0, n + 1);
+    return;
+  }
+
+  // otherwise copy the fixed part of each record in one go, then
+  // each child into its new slot
+  const size_t childSize = sizeof(hal_index_t) + sizeof(bool);
+  for (hal_size_t i = 0; i <= n; ++i)
+  {
+    const char* inRecord = inArray.get(i);
+    char* outRecord = outArray.getUpdate(i);
+    memcpy(outRecord, inRecord, HDF5BottomSegment::firstChildOffset);
+    for (hal_size_t inChild = 0; inChild < inNc && i < n; ++inChild)
+    {
+      hal_size_t outChild = inChildToOutChild[inChild];
+      if (outChild != outNc)
+      {
+        memcpy(outRecord + HDF5BottomSegment::firstChildOffset + 
+               outChild * childSize,
+               inRecord + HDF5BottomSegment::firstChildOffset + 
+               inChild * childSize, childSize);
+      }
+    }
+  }
+}
+
+void HDF5Genome::copySequence(Genome *dest) const
+{
+  HDF5Genome* h5Dest = dynamic_cast<HDF5Genome*>(dest);
+  if (h5Dest == NULL || h5Dest == this || containsDNAArray() == false ||
+      h5Dest->_dnaArray.getSize() != _dnaArray.getSize() ||
+      h5Dest->_totalSequenceLength != _totalSequenceLength)
+  {
+    Genome::copySequence(dest);
+    return;
+  }
+  // two bases per byte, packed the same way in both files
+  h5Dest->_dnaArray.copyFrom(const_cast<HDF5Genome*>(this)->_dnaArray, 0, 0,
+                             _dnaArray.getSize());
+}
+
 // SEGMENTED SEQUENCE INTERFACE
 
 const string& HDF5Genome::getName() const
@@ -731,6 +950,29 @@ void HDF5Genome::getSubString(string& outString, hal_size_t start,
   dnaIt.readString(outString, length);
 }
 
+void HDF5Genome::getBaseCounts(hal_size_t start, hal_size_t length,
+                               BaseCounts& counts) const
+{
+  if (start + length > _totalSequenceLength)
+  {
+    throw hal_exception("getBaseCounts: range out of bounds in genome " +
+                        _name);
+  }
+  // count whole buffers of the array at a time, like readString()
+  HDF5ExternalArray& dnaArray = const_cast<HDF5ExternalArray&>(_dnaArray);
+  hal_size_t done = 0;
+  while (done < length)
+  {
+    hal_index_t pos = (hal_index_t)(start + done);
+    hsize_t numBytes;
+    const unsigned char* packed = reinterpret_cast<const unsigned char*>(
+      dnaArray.getRange(pos / 2, numBytes));
+    hal_size_t n = min(length - done, (hal_size_t)(numBytes * 2 - pos % 2));
+    HDF5DNA::countBases(pos, n, packed, counts);
+    done += n;
+  }
+}
+
 void HDF5Genome::setSubString(const string& inString, 
                               hal_size_t start,
                               hal_size_t length)
@@ -799,20 +1041,26 @@ void HDF5Genome::read()
   try
   {
     _group.openDataSet(dnaArrayName);
-    _dnaArray.load(&_group, dnaArrayName, _numChunksInArrayBuffer);    
+    _dnaArray.load(&_group, dnaArrayName, _numChunksInArrayBuffer,
+                   _numArrayBuffersInCache);
+    _dnaArray.setPrefetch(_prefetch);
   }
   catch (H5::Exception){}
 
   try
   {
     _group.openDataSet(topArrayName);
-    _topArray.load(&_group, topArrayName, _numChunksInArrayBuffer);
+    _topArray.load(&_group, topArrayName, _numChunksInArrayBuffer,
+                   _numArrayBuffersInCache);
+    _topArray.setPrefetch(_prefetch);
   }
   catch (H5::Exception){}
   try
   {
     _group.openDataSet(bottomArrayName);
-    _bottomArray.load(&_group, bottomArrayName, _numChunksInArrayBuffer);
+    _bottomArray.load(&_group, bottomArrayName, _numChunksInArrayBuffer,
+                      _numArrayBuffersInCache);
+    _bottomArray.setPrefetch(_prefetch);
     _numChildrenInBottomArray = 
        HDF5BottomSegment::numChildrenFromDataType(_bottomArray.getDataType());
   }
@@ -823,14 +1071,16 @@ void HDF5Genome::read()
   {
     _group.openDataSet(sequenceIdxArrayName);
     _sequenceIdxArray.load(&_group, sequenceIdxArrayName, 
-                           _numChunksInArrayBuffer);
+                           _numChunksInArrayBuffer,
+                           _numArrayBuffersInCache);
   }
   catch (H5::Exception){}
   try
   {
     _group.openDataSet(sequenceNameArrayName);
     _sequenceNameArray.load(&_group, sequenceNameArrayName, 
-                            _numChunksInArrayBuffer);
+                            _numChunksInArrayBuffer,
+                            _numArrayBuffersInCache);
   }
   catch (H5::Exception){}
 
@@ -844,84 +1094,40 @@ void HDF5Genome::readSequences()
 
 void HDF5Genome::deleteSequenceCache()
 {
-  if (_sequencePosCache.size() > 0 || _zeroLenPosCache.size() > 0)
+  for (size_t i = 0; i < _sequenceCache.size(); ++i)
   {
-    map<hal_size_t, HDF5Sequence*>::iterator i;
-    for (i = _sequencePosCache.begin(); i != _sequencePosCache.end(); ++i)
-    {
-      delete i->second;
-    }
-    vector<HDF5Sequence*>::iterator z;
-    for (z = _zeroLenPosCache.begin(); z != _zeroLenPosCache.end(); ++z)
-    {
-      delete *z;
-    }
-  }
-  else if (_sequenceNameCache.size() > 0)
-  {
-    map<string, HDF5Sequence*>::iterator i;
-    for (i = _sequenceNameCache.begin(); i != _sequenceNameCache.end(); ++i)
-    {
-      delete i->second;
-    }
+    delete _sequenceCache[i];
   }
+  _sequenceCache.clear();
   _sequencePosCache.clear();
-  _zeroLenPosCache.clear();
-  _sequenceNameCache.clear(); // I share my pointers with above. 
+  _sequenceNameCache.clear();
+  _lastSequenceIndex = 0;
 }
 
 void HDF5Genome::loadSequencePosCache() const
 {
-  if (_sequencePosCache.size() > 0 || _zeroLenPosCache.size() > 0)
+  if (_sequencePosCache.size() > 0)
   {
     return;
   }
-  hal_size_t totalReadLen = 0;
   hal_size_t numSequences = _sequenceNameArray.getSize();
-  
-  if (_sequenceNameCache.size() > 0)
+  if (numSequences == 0)
   {
-    assert(_sequenceNameCache.size() == numSequences);
-    map<std::string, HDF5Sequence*>::iterator i;
-    for (i = _sequenceNameCache.begin(); i != _sequenceNameCache.end(); ++i)
-    {
-      if (i->second->getSequenceLength() > 0)
-      {
-        _sequencePosCache.insert(pair<hal_size_t, HDF5Sequence*>(
-                                   i->second->getStartPosition() +
-                                   i->second->getSequenceLength(), i->second));
-        totalReadLen += i->second->getSequenceLength();
-      }
-      else
-      {
-        _zeroLenPosCache.push_back(i->second);
-      }
-    }
+    return;
   }
-  else
+  // read the starts straight out of the index array (which has one 
+  // extra record at the end) rather than going through HDF5Sequence
+  _sequencePosCache.reserve(numSequences + 1);
+  for (hal_size_t i = 0; i <= numSequences; ++i)
   {
-    for (hal_size_t i = 0; i < numSequences; ++i)
-    {
-      HDF5Sequence* seq = 
-         new HDF5Sequence(const_cast<HDF5Genome*>(this),
-                          const_cast<HDF5ExternalArray*>(&_sequenceIdxArray),
-                          const_cast<HDF5ExternalArray*>(&_sequenceNameArray),
-                          i);
-      if (seq->getSequenceLength() > 0)
-      {
-        _sequencePosCache.insert(
-          pair<hal_size_t, HDF5Sequence*>(seq->getStartPosition() +
-                                          seq->getSequenceLength(), seq));
-        totalReadLen += seq->getSequenceLength();
-      }
-      else
-      {
-        _zeroLenPosCache.push_back(seq);
-      }
-    }
+    _sequencePosCache.push_back(
+      _sequenceIdxArray.getValue<hal_size_t>(i, HDF5Sequence::startOffset));
   }
+  hal_size_t totalReadLen = _sequencePosCache.back() - 
+     _sequencePosCache.front();
   if (_totalSequenceLength > 0 && totalReadLen != _totalSequenceLength)
   {
+    _sequencePosCache.clear();
     stringstream ss;
     ss << "Sequences for genome " << getName() << " have total length " 
        << totalReadLen << " but the (non-zero) DNA array contains "
@@ -938,36 +1144,11 @@ void HDF5Genome::loadSequenceNameCache() const
     return;
   }
   hal_size_t numSequences = _sequenceNameArray.getSize();
-  
-  if (_sequencePosCache.size() > 0 || _zeroLenPosCache.size() > 0)
-  {
-    assert(_sequencePosCache.size() + _zeroLenPosCache.size() == numSequences);
-    map<hal_size_t, HDF5Sequence*>::iterator i;
-    for (i = _sequencePosCache.begin(); i != _sequencePosCache.end(); ++i)
-    {
-      _sequenceNameCache.insert(pair<string, HDF5Sequence*>(
-                                  i->second->getName(), i->second));
-    }
-    vector<HDF5Sequence*>::iterator z;
-    for (z = _zeroLenPosCache.begin(); z != _zeroLenPosCache.end(); ++z)
-    {
-      _sequenceNameCache.insert(pair<string, HDF5Sequence*>(
-                                  (*z)->getName(), (*z)));
-    }
-  }
-  else
+  HDF5ExternalArray* nameArray = 
+     const_cast<HDF5ExternalArray*>(&_sequenceNameArray);
+  for (hal_size_t i = 0; i < numSequences; ++i)
   {
-    for (hal_size_t i = 0; i < numSequences; ++i)
-    {
-      HDF5Sequence* seq = 
-         new HDF5Sequence(const_cast<HDF5Genome*>(this),
-                          const_cast<HDF5ExternalArray*>(&_sequenceIdxArray),
-                          const_cast<HDF5ExternalArray*>(&_sequenceNameArray),
-                          i);
-
-      _sequenceNameCache.insert(
-        pair<string, HDF5Sequence*>(seq->getName(), seq));
-    }
+    _sequenceNameCache.insert(pair<string, hal_size_t>(nameArray->get(i), i));
   }
 }
   
@@ -988,20 +1169,18 @@ void HDF5Genome::writeSequences(const vector<Sequence::Info>&
     // write all the Sequence::Info into the hdf5 sequence record
     seq->set(startPosition, *i, topArrayIndex, bottomArrayIndex);
     // Keep the object pointer in our caches
-    if (seq->getSequenceLength() > 0)
-    {
-      _sequencePosCache.insert(
-        pair<hal_size_t, HDF5Sequence*>(startPosition + i->_length, seq));
-    }
-    else
-    {
-      _zeroLenPosCache.push_back(seq);
-    }
-    _sequenceNameCache.insert(pair<string, HDF5Sequence*>(i->_name, seq));
+    _sequenceCache.push_back(seq);
+    _sequencePosCache.push_back(startPosition);
+    _sequenceNameCache.insert(pair<string, hal_size_t>(
+                                i->_name, _sequenceCache.size() - 1));
     startPosition += i->_length;
     topArrayIndex += i->_numTopSegments;
     bottomArrayIndex += i->_numBottomSegments;
   }  
+  if (_sequenceCache.empty() == false)
+  {
+    _sequencePosCache.push_back(startPosition);
+  }
 }
 
 void HDF5Genome::resetBranchCaches()
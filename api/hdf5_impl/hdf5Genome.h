@@ -41,7 +41,9 @@ public:
               HDF5Alignment* alignment,
               H5::CommonFG* h5Parent,
               const H5::DSetCreatPropList& dcProps,
-              bool inMemory);
+              bool inMemory,
+              hsize_t numCacheChunks,
+              bool prefetch);
 
    virtual ~HDF5Genome();
 
@@ -96,6 +98,12 @@ public:
 
    const Alignment* getAlignment() const;
 
+   void copyTopSegments(Genome *dest) const;
+
+   void copyBottomSegments(Genome *dest) const;
+
+   void copySequence(Genome *dest) const;
+
    // SEGMENTED SEQUENCE INTERFACE
 
    hal_size_t getSequenceLength() const;
@@ -143,6 +151,9 @@ public:
    void getSubString(std::string& outString, hal_size_t start,
                              hal_size_t length) const;
 
+   void getBaseCounts(hal_size_t start, hal_size_t length,
+                      BaseCounts& counts) const;
+
    void setSubString(const std::string& intString, 
                              hal_size_t start,
                              hal_size_t length);
@@ -175,6 +186,8 @@ protected:
    void deleteSequenceCache();
    void loadSequencePosCache() const;
    void loadSequenceNameCache() const;
+   HDF5Sequence* getSequenceByIndex(hal_size_t index) const;
+   hal_index_t getSequenceIndexBySite(hal_size_t position) const;
    void setGenomeTopDimensions(
      const std::vector<hal::Sequence::UpdateInfo>& sequenceDimensions);
 
@@ -200,12 +213,18 @@ protected:
    hal_size_t _numChildrenInBottomArray;
    hal_size_t _totalSequenceLength;
    hal_size_t _numChunksInArrayBuffer;
+   hal_size_t _numArrayBuffersInCache;
+   bool _prefetch;
 
    mutable Genome* _parentCache;
    mutable std::vector<Genome*> _childCache;
-   mutable std::map<hal_size_t, HDF5Sequence*> _sequencePosCache;
-   mutable std::vector<HDF5Sequence*> _zeroLenPosCache;
-   mutable std::map<std::string, HDF5Sequence*> _sequenceNameCache;
+   // start position of every sequence (plus the end of the last one), 
+   // in array order, which is also position order
+   mutable std::vector<hal_size_t> _sequencePosCache;
+   // sequence objects are only created when asked for
+   mutable std::vector<HDF5Sequence*> _sequenceCache;
+   mutable std::map<std::string, hal_size_t> _sequenceNameCache;
+   mutable hal_size_t _lastSequenceIndex;
 
    static const std::string dnaArrayName;
    static const std::string topArrayName;
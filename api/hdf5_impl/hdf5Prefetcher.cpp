@@ -0,0 +1,213 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include "hdf5Prefetcher.h"
+
+// direct chunk reads are needed to keep all hdf5 calls on the main thread
+#if defined(H5_VERSION_GE) && defined(H5_HAVE_FILTER_DEFLATE)
+#if H5_VERSION_GE(1,10,2)
+#define HAL_HDF5_PREFETCH
+#include <zlib.h>
+#endif
+#endif
+
+using namespace hal;
+using namespace H5;
+using namespace std;
+
+HDF5Prefetcher::HDF5Prefetcher(const DataSet& dataSet) :
+  _dataSet(dataSet),
+  _deflated(false),
+  _threadStarted(false),
+  _busy(false),
+  _pending(false),
+  _success(false),
+  _stop(false),
+  _rawBytes(0),
+  _filterMask(0),
+  _out(NULL),
+  _outBytes(0)
+{
+  pthread_mutex_init(&_mutex, NULL);
+  pthread_cond_init(&_cond, NULL);
+  assert(isSupported(_dataSet) == true);
+  DSetCreatPropList cparms = _dataSet.getCreatePlist();
+  _deflated = cparms.getNfilters() > 0;
+}
+
+HDF5Prefetcher::~HDF5Prefetcher()
+{
+  if (_threadStarted == true)
+  {
+    pthread_mutex_lock(&_mutex);
+    _stop = true;
+    pthread_cond_broadcast(&_cond);
+    pthread_mutex_unlock(&_mutex);
+    pthread_join(_thread, NULL);
+  }
+  pthread_cond_destroy(&_cond);
+  pthread_mutex_destroy(&_mutex);
+}
+
+bool HDF5Prefetcher::isSupported(const DataSet& dataSet)
+{
+#ifdef HAL_HDF5_PREFETCH
+  DSetCreatPropList cparms = dataSet.getCreatePlist();
+  if (cparms.getLayout() != H5D_CHUNKED)
+  {
+    return false;
+  }
+  int numFilters = cparms.getNfilters();
+  for (int i = 0; i < numFilters; ++i)
+  {
+    unsigned int flags;
+    size_t cdNelmts = 0;
+    unsigned int filterConfig;
+    char name[64];
+    H5Z_filter_t filter = cparms.getFilter(i, flags, cdNelmts, NULL,
+                                           sizeof(name), name, filterConfig);
+    if (filter != H5Z_FILTER_DEFLATE)
+    {
+      return false;
+    }
+  }
+  return numFilters <= 1;
+#else
+  return false;
+#endif
+}
+
+bool HDF5Prefetcher::start(hsize_t chunkStart, char* buf, hsize_t bufBytes)
+{
+  assert(_busy == false);
+#ifdef HAL_HDF5_PREFETCH
+  hid_t dsetId = _dataSet.getId();
+  hsize_t rawBytes = 0;
+  H5E_BEGIN_TRY
+  {
+    if (H5Dget_chunk_storage_size(dsetId, &chunkStart, &rawBytes) < 0 ||
+        rawBytes == 0)
+    {
+      rawBytes = 0;
+    }
+  }
+  H5E_END_TRY;
+  if (rawBytes == 0)
+  {
+    // chunk was never written
+    return false;
+  }
+  if (_raw.size() < rawBytes)
+  {
+    _raw.resize(rawBytes);
+  }
+  uint32_t filterMask = 0;
+  herr_t status = -1;
+  H5E_BEGIN_TRY
+  {
+    status = H5Dread_chunk(dsetId, H5P_DEFAULT, &chunkStart, &filterMask,
+                           &_raw[0]);
+  }
+  H5E_END_TRY;
+  if (status < 0)
+  {
+    return false;
+  }
+
+  if (_threadStarted == false)
+  {
+    if (pthread_create(&_thread, NULL, threadMain, this) != 0)
+    {
+      return false;
+    }
+    _threadStarted = true;
+  }
+  pthread_mutex_lock(&_mutex);
+  _rawBytes = rawBytes;
+  _filterMask = filterMask;
+  _out = buf;
+  _outBytes = bufBytes;
+  _success = false;
+  _pending = true;
+  _busy = true;
+  pthread_cond_broadcast(&_cond);
+  pthread_mutex_unlock(&_mutex);
+  return true;
+#else
+  return false;
+#endif
+}
+
+bool HDF5Prefetcher::finish()
+{
+  assert(_busy == true);
+  pthread_mutex_lock(&_mutex);
+  while (_pending == true)
+  {
+    pthread_cond_wait(&_cond, &_mutex);
+  }
+  _busy = false;
+  bool success = _success;
+  pthread_mutex_unlock(&_mutex);
+  return success;
+}
+
+void* HDF5Prefetcher::threadMain(void* prefetcher)
+{
+  reinterpret_cast<HDF5Prefetcher*>(prefetcher)->run();
+  return NULL;
+}
+
+void HDF5Prefetcher::run()
+{
+  pthread_mutex_lock(&_mutex);
+  while (true)
+  {
+    while (_pending == false && _stop == false)
+    {
+      pthread_cond_wait(&_cond, &_mutex);
+    }
+    if (_stop == true)
+    {
+      break;
+    }
+    // the job's members are not touched by the main thread until
+    // _pending goes back to false, so we can work without the lock
+    pthread_mutex_unlock(&_mutex);
+    bool success = decode();
+    pthread_mutex_lock(&_mutex);
+    _success = success;
+    _pending = false;
+    pthread_cond_broadcast(&_cond);
+  }
+  pthread_mutex_unlock(&_mutex);
+}
+
+bool HDF5Prefetcher::decode()
+{
+#ifdef HAL_HDF5_PREFETCH
+  // bit 0 of the mask is set if the deflate filter was skipped
+  // for this chunk
+  if (_deflated == false || (_filterMask & 1))
+  {
+    if (_rawBytes != _outBytes)
+    {
+      return false;
+    }
+    memcpy(_out, &_raw[0], _outBytes);
+    return true;
+  }
+  uLongf outBytes = _outBytes;
+  int ret = uncompress(reinterpret_cast<Bytef*>(_out), &outBytes,
+                       reinterpret_cast<const Bytef*>(&_raw[0]), _rawBytes);
+  return ret == Z_OK && outBytes == _outBytes;
+#else
+  return false;
+#endif
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _HDF5PREFETCHER_H
+#define _HDF5PREFETCHER_H
+
+#include <vector>
+#include <pthread.h>
+#include <H5Cpp.h>
+#include "halDefs.h"
+
+namespace hal {
+
+/**
+ * Decompresses a single HDF5 chunk in a background thread.  The HDF5
+ * library itself is not (in general) thread-safe, so the compressed
+ * bytes of the chunk are read directly from the file by the calling
+ * thread, and only the zlib inflate is handed off to the worker.  This
+ * lets HDF5ExternalArray overlap decompression of the next chunk with
+ * whatever the caller is doing with the current one during sequential
+ * scans.  Only datasets whose filter pipeline is empty or just deflate
+ * can be prefetched, and only with HDF5 >= 1.10.2 (which provides
+ * direct chunk reads).  The worker thread is created on the first
+ * call to start().
+ */
+class HDF5Prefetcher
+{
+public:
+
+   /** Constructor
+    * @param dataSet Dataset whose chunks will be prefetched. Should 
+    * pass isSupported() */
+   HDF5Prefetcher(const H5::DataSet& dataSet);
+   ~HDF5Prefetcher();
+
+   /** Check if the chunks of a dataset can be decoded by the
+    * prefetcher (ie compiled with support and only deflate used) */
+   static bool isSupported(const H5::DataSet& dataSet);
+
+   /** Read the raw chunk beginning at the given array index and
+    * start decompressing it into buf in the background.
+    * @param chunkStart Index of first element of chunk in array
+    * @param buf Output buffer (must stay valid until finish())
+    * @param bufBytes Size of a full (uncompressed) chunk in bytes
+    * @return false if nothing was started (in which case finish() must
+    * not be called) */
+   bool start(hsize_t chunkStart, char* buf, hsize_t bufBytes);
+
+   /** Wait for the job given to start() to complete.
+    * @return true if the output buffer was successfully filled */
+   bool finish();
+
+   /** Check if a job is pending (ie start() without finish()) */
+   bool isBusy() const;
+
+protected:
+
+   static void* threadMain(void* prefetcher);
+   void run();
+   bool decode();
+
+   H5::DataSet _dataSet;
+   bool _deflated;
+   pthread_t _thread;
+   pthread_mutex_t _mutex;
+   pthread_cond_t _cond;
+   bool _threadStarted;
+   bool _busy;
+   bool _pending;
+   bool _success;
+   bool _stop;
+   std::vector<char> _raw;
+   hsize_t _rawBytes;
+   unsigned int _filterMask;
+   char* _out;
+   hsize_t _outBytes;
+
+private:
+   HDF5Prefetcher(const HDF5Prefetcher&);
+   HDF5Prefetcher& operator=(const HDF5Prefetcher&);
+};
+
+inline bool HDF5Prefetcher::isBusy() const
+{
+  return _busy;
+}
+
+}
+#endif
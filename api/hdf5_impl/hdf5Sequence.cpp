@@ -260,6 +260,17 @@ void HDF5Sequence::getSubString(std::string& outString, hal_size_t start,
   dnaIt.readString(outString, length);
 }
 
+void HDF5Sequence::getBaseCounts(hal_size_t start, hal_size_t length,
+                                 BaseCounts& counts) const
+{
+  if (start + length > getSequenceLength())
+  {
+    throw hal_exception("getBaseCounts: range out of bounds in sequence " +
+                        getName());
+  }
+  _genome->getBaseCounts(start + getStartPosition(), length, counts);
+}
+
 void HDF5Sequence::setSubString(const std::string& inString, 
                                 hal_size_t start,
                                 hal_size_t length)
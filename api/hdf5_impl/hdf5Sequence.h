@@ -19,6 +19,7 @@ class HDF5SequenceIterator;
 class HDF5Sequence : public Sequence
 {
    friend class HDF5SequenceIterator;
+   friend class HDF5Genome;
 
 public:
 
@@ -96,6 +97,9 @@ public:
    void getSubString(std::string& outString, hal_size_t start,
                              hal_size_t length) const;
 
+   void getBaseCounts(hal_size_t start, hal_size_t length,
+                      BaseCounts& counts) const;
+
    void setSubString(const std::string& intString, 
                              hal_size_t start,
                              hal_size_t length);
@@ -56,7 +56,7 @@ Sequence* HDF5SequenceIterator::getSequence()
          (hal_index_t)_sequence._genome->_sequenceNameArray.getSize()); 
   // don't return local sequence pointer.  give cached pointer from
   // genome instead (so it will not expire when iterator moves!)
-  return _sequence._genome->getSequence(_sequence.getName());
+  return _sequence._genome->getSequenceByIndex(_sequence._index);
 }
 
 const Sequence* HDF5SequenceIterator::getSequence() const
@@ -65,7 +65,7 @@ const Sequence* HDF5SequenceIterator::getSequence() const
          (hal_index_t)_sequence._genome->_sequenceNameArray.getSize());
   // don't return local sequence pointer.  give cached pointer from
   // genome instead (so it will not expire when iterator moves!)
-  return _sequence._genome->getSequence(_sequence.getName());
+  return _sequence._genome->getSequenceByIndex(_sequence._index);
 }
 
 bool HDF5SequenceIterator::equals(SequenceIteratorConstPtr other) const
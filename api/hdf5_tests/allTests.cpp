@@ -15,6 +15,7 @@ int hdf5RunAllTests(void) {
   CuSuiteAddSuite(suite, hdf5DNATypeTestSuite());
   CuSuiteAddSuite(suite, hdf5SegmentTypeTestSuite());
   CuSuiteAddSuite(suite, hdf5SequenceTypeTestSuite());
+  CuSuiteAddSuite(suite, hdf5GenomeCopyTestSuite());
   CuSuiteRun(suite);
   CuSuiteSummary(suite, output);
   CuSuiteDetails(suite, output);
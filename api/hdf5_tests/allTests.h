@@ -16,5 +16,6 @@ CuSuite *hdf5ExternalArrayTestSuite();
 CuSuite *hdf5DNATypeTestSuite();
 CuSuite *hdf5SegmentTypeTestSuite();
 CuSuite *hdf5SequenceTypeTestSuite();
+CuSuite *hdf5GenomeCopyTestSuite();
 
 #endif
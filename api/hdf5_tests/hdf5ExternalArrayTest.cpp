@@ -13,6 +13,7 @@
 #include <H5Cpp.h>
 #include "allTests.h"
 #include "hdf5ExternalArray.h"
+#include "hdf5Prefetcher.h"
 #include "hdf5Test.h"
 extern "C" {
 #include "commonC.h"
@@ -159,11 +160,139 @@ void hdf5ExternalArrayTestCompression(CuTest *testCase)
   }
 }
 
+void hdf5ExternalArrayTestPageCache(CuTest *testCase)
+{
+  static const hsize_t numPages = 3;
+  for (hsize_t chunkIdx = 0; chunkIdx < numSizes; ++chunkIdx)
+  {
+    hsize_t chunkSize = chunkSizes[chunkIdx];
+    setup();
+    try 
+    {
+      // write from both ends of the array at once, so that every 
+      // dirty page gets evicted and written back at least once
+      IntType datatype(PredType::NATIVE_HSIZE);
+      H5File file(H5std_string(fileName), H5F_ACC_TRUNC);
+      HDF5ExternalArray myArray;
+      DSetCreatPropList cparms;
+      if (chunkSize > 0)
+      {
+        cparms.setDeflate(2);
+        cparms.setChunk(1, &chunkSize);
+      }
+      myArray.create(&file, datasetName, datatype, N, &cparms, 1, numPages);
+      for (hsize_t i = 0; i < N / 2; ++i)
+      {
+        myArray.setValue<hsize_t>(i, 0, i);
+        myArray.setValue<hsize_t>(N - 1 - i, 0, N - 1 - i);
+      }
+      myArray.write();
+      file.flush(H5F_SCOPE_LOCAL);
+      file.close();
+      checkNumbers(testCase);
+
+      H5File rfile(H5std_string(fileName), H5F_ACC_RDONLY);
+      HDF5ExternalArray myrArray;
+      myrArray.load(&rfile, datasetName, 1, numPages);
+      for (hsize_t i = 0; i < N / 2; ++i)
+      {
+        const int64_t* val = 
+           reinterpret_cast<const int64_t*>(myrArray.get(i));
+        CuAssertTrue(testCase, *val == numbers[i]);
+        val = reinterpret_cast<const int64_t*>(myrArray.get(N - 1 - i));
+        CuAssertTrue(testCase, *val == numbers[N - 1 - i]);
+      }
+      if (chunkSize > 0 && chunkSize < N / 2)
+      {
+        // bouncing between two pages should only miss when we cross
+        // into a new chunk
+        CuAssertTrue(testCase, myrArray.getNumPages() == numPages);
+        CuAssertTrue(testCase, myrArray.getCacheHits() > 
+                     myrArray.getCacheMisses());
+        CuAssertTrue(testCase, myrArray.getCacheMisses() <= 
+                     2 * (N / chunkSize + 1));
+      }
+      else
+      {
+        CuAssertTrue(testCase, myrArray.getCacheMisses() <= 2);
+      }
+    }
+    catch(Exception& exception)
+    {
+      cerr << exception.getCDetailMsg() << endl;
+      CuAssertTrue(testCase, 0);
+    }
+    catch(...)
+    {
+      CuAssertTrue(testCase, 0);
+    }
+    teardown();
+  }
+}
+
+void hdf5ExternalArrayTestPrefetch(CuTest *testCase)
+{
+  for (hsize_t chunkIdx = 0; chunkIdx < numSizes; ++chunkIdx)
+  {
+    hsize_t chunkSize = chunkSizes[chunkIdx];
+    setup();
+    try 
+    {
+      writeNumbers(chunkSize);
+      
+      H5File file(H5std_string(fileName), H5F_ACC_RDONLY);
+      HDF5ExternalArray myArray;
+      myArray.load(&file, datasetName, 1, 2);
+      myArray.setPrefetch(true);
+
+      // scan forward then backward (prefetching, if supported by the 
+      // installed hdf5, works in both directions)
+      for (hsize_t i = 0; i < N; ++i)
+      {
+        const int64_t* val = reinterpret_cast<const int64_t*>(myArray.get(i));
+        CuAssertTrue(testCase, *val == numbers[i]);
+      }
+      for (hsize_t i = 0; i < N; ++i)
+      {
+        hsize_t j = N - 1 - i;
+        const int64_t* val = reinterpret_cast<const int64_t*>(myArray.get(j));
+        CuAssertTrue(testCase, *val == numbers[j]);
+      }
+      CuAssertTrue(testCase, myArray.getPrefetchHits() <= 
+                   myArray.getCacheHits());
+      if (chunkSize > 1 && chunkSize < N / 2 &&
+          HDF5Prefetcher::isSupported(file.openDataSet(datasetName)) == true)
+      {
+        // a sequential scan over several chunks must be served from
+        // prefetched pages at least some of the time
+        CuAssertTrue(testCase, myArray.getPrefetch() == true);
+        CuAssertTrue(testCase, myArray.getPrefetchHits() > 0);
+      }
+      if (chunkSize == 0)
+      {
+        CuAssertTrue(testCase, myArray.getPrefetch() == false);
+      }
+    }
+    catch(Exception& exception)
+    {
+      cerr << exception.getCDetailMsg() << endl;
+      CuAssertTrue(testCase, 0);
+    }
+    catch(...)
+    {
+      CuAssertTrue(testCase, 0);
+    }
+    teardown();
+  }
+}
+
 CuSuite* hdf5ExternalArrayTestSuite(void) 
 {
   CuSuite* suite = CuSuiteNew();
   SUITE_ADD_TEST(suite, hdf5ExternalArrayTestCreate);
   SUITE_ADD_TEST(suite, hdf5ExternalArrayTestLoad);
   SUITE_ADD_TEST(suite, hdf5ExternalArrayTestCompression);
+  SUITE_ADD_TEST(suite, hdf5ExternalArrayTestPageCache);
+  SUITE_ADD_TEST(suite, hdf5ExternalArrayTestPrefetch);
   return suite;
 }
@@ -0,0 +1,398 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+/**
+ * Test the HDF5Genome copy* overrides (which copy the raw arrays between
+ * files) against the generic segment-by-segment Genome::copy* methods
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <H5Cpp.h>
+#include "allTests.h"
+#include "hal.h"
+extern "C" {
+#include "commonC.h"
+}
+
+using namespace H5;
+using namespace hal;
+using namespace std;
+
+static const hal_size_t segLength = 4;
+static const hal_size_t rootSegs[] = {23, 31};
+static const hal_size_t leafSegs[] = {17, 29};
+static const char* rootSeqNames[] = {"rs1", "rs2"};
+static const char* leafSeqNames[] = {"ls1", "ls2"};
+
+/** How the destination alignment differs from the source.  The
+ * dimensions of each sequence are always the same. */
+struct CopyLayout
+{
+   // add the children to the root in the opposite order
+   bool swapChildren;
+   // add a third child to the root that isn't in the source
+   bool extraChild;
+   // give the root its sequences in the opposite order
+   bool swapSequences;
+};
+
+static AlignmentPtr createAlignment(const string& path, hsize_t chunkSize)
+{
+  DSetCreatPropList dcprops;
+  dcprops.setChunk(1, &chunkSize);
+  AlignmentPtr alignment = hdf5AlignmentInstance(FileCreatPropList::DEFAULT,
+                                                 FileAccPropList::DEFAULT,
+                                                 dcprops);
+  alignment->createNew(path);
+  return alignment;
+}
+
+static void addGenomes(AlignmentPtr alignment, const CopyLayout& layout)
+{
+  Genome* root = alignment->addRootGenome("root");
+  vector<Genome*> leaves;
+  if (layout.swapChildren == false)
+  {
+    leaves.push_back(alignment->addLeafGenome("leaf1", "root", 0.1));
+    leaves.push_back(alignment->addLeafGenome("leaf2", "root", 0.2));
+  }
+  else
+  {
+    leaves.push_back(alignment->addLeafGenome("leaf2", "root", 0.2));
+    leaves.push_back(alignment->addLeafGenome("leaf1", "root", 0.1));
+  }
+  if (layout.extraChild == true)
+  {
+    leaves.push_back(alignment->addLeafGenome("leaf3", "root", 0.3));
+  }
+
+  vector<Sequence::Info> seqVec;
+  for (size_t i = 0; i < 2; ++i)
+  {
+    size_t j = layout.swapSequences == true ? 1 - i : i;
+    seqVec.push_back(Sequence::Info(rootSeqNames[j], rootSegs[j] * segLength,
+                                    0, rootSegs[j]));
+  }
+  root->setDimensions(seqVec);
+  seqVec.clear();
+  for (size_t i = 0; i < 2; ++i)
+  {
+    seqVec.push_back(Sequence::Info(leafSeqNames[i], leafSegs[i] * segLength,
+                                    leafSegs[i], 0));
+  }
+  for (size_t i = 0; i < leaves.size(); ++i)
+  {
+    leaves[i]->setDimensions(seqVec);
+  }
+}
+
+/** Fill in the source genomes with values that differ from segment to
+ * segment (and include null indices) */
+static void fillGenomes(AlignmentPtr alignment)
+{
+  static const string bases = "ACGTNacgtn";
+  Genome* root = alignment->openGenome("root");
+  for (hal_size_t g = 0; g < 3; ++g)
+  {
+    Genome* genome = g == 0 ? root : root->getChild(g - 1);
+    hal_index_t n = genome->getSequenceLength();
+    DNAIteratorPtr dnaIt = genome->getDNAIterator();
+    for (; dnaIt->getArrayIndex() < n; dnaIt->toRight())
+    {
+      dnaIt->setChar(bases[(dnaIt->getArrayIndex() * 7 + g) % bases.size()]);
+    }
+  }
+
+  hal_index_t numBottom = root->getNumBottomSegments();
+  BottomSegmentIteratorPtr botIt = root->getBottomSegmentIterator();
+  for (; botIt->getArrayIndex() < numBottom; botIt->toRight())
+  {
+    hal_index_t i = botIt->getArrayIndex();
+    botIt->setCoordinates(i * segLength, segLength);
+    for (hal_size_t c = 0; c < 2; ++c)
+    {
+      hal_index_t numTop = root->getChild(c)->getNumTopSegments();
+      botIt->setChildIndex(c, (i + c) % 5 == 4 ? NULL_INDEX :
+                           (i * 2 + c) % numTop);
+      botIt->setChildReversed(c, (i + c) % 3 == 0);
+    }
+    botIt->setTopParseIndex(NULL_INDEX);
+  }
+
+  for (hal_size_t c = 0; c < 2; ++c)
+  {
+    Genome* leaf = root->getChild(c);
+    hal_index_t numTop = leaf->getNumTopSegments();
+    TopSegmentIteratorPtr topIt = leaf->getTopSegmentIterator();
+    for (; topIt->getArrayIndex() < numTop; topIt->toRight())
+    {
+      hal_index_t i = topIt->getArrayIndex();
+      topIt->setCoordinates(i * segLength, segLength);
+      topIt->setParentIndex(i % 4 == 3 ? NULL_INDEX :
+                            (i * 3 + c) % numBottom);
+      topIt->setParentReversed((i + c) % 2 == 1);
+      topIt->setBottomParseIndex(NULL_INDEX);
+      topIt->setNextParalogyIndex(i % 5 == 0 && i + 1 < numTop ? i + 1 :
+                                  NULL_INDEX);
+    }
+  }
+}
+
+/** Copy the source genomes into the destination, either through the
+ * (virtual) HDF5 overrides or through the generic Genome methods */
+static void copyGenomes(AlignmentConstPtr source, AlignmentPtr dest,
+                        bool generic)
+{
+  const char* names[] = {"root", "leaf1", "leaf2"};
+  for (size_t i = 0; i < 3; ++i)
+  {
+    const Genome* inGenome = source->openGenome(names[i]);
+    Genome* outGenome = dest->openGenome(names[i]);
+    if (generic == true)
+    {
+      inGenome->Genome::copyTopSegments(outGenome);
+      inGenome->Genome::copyBottomSegments(outGenome);
+      inGenome->Genome::copySequence(outGenome);
+    }
+    else
+    {
+      inGenome->copyTopSegments(outGenome);
+      inGenome->copyBottomSegments(outGenome);
+      inGenome->copySequence(outGenome);
+    }
+  }
+}
+
+/** Every field of every segment, and the DNA, must be the same in the
+ * two copies */
+static void checkSame(CuTest* testCase, AlignmentConstPtr fastCopy,
+                      AlignmentConstPtr genericCopy)
+{
+  const char* names[] = {"root", "leaf1", "leaf2"};
+  for (size_t i = 0; i < 3; ++i)
+  {
+    const Genome* g1 = fastCopy->openGenome(names[i]);
+    const Genome* g2 = genericCopy->openGenome(names[i]);
+    string s1, s2;
+    g1->getString(s1);
+    g2->getString(s2);
+    CuAssertTrue(testCase, s1 == s2);
+
+    hal_index_t n = g1->getNumTopSegments();
+    CuAssertTrue(testCase, n == (hal_index_t)g2->getNumTopSegments());
+    TopSegmentIteratorConstPtr top1 = g1->getTopSegmentIterator();
+    TopSegmentIteratorConstPtr top2 = g2->getTopSegmentIterator();
+    for (; top1->getArrayIndex() < n; top1->toRight(), top2->toRight())
+    {
+      CuAssertTrue(testCase,
+                   top1->getStartPosition() == top2->getStartPosition());
+      CuAssertTrue(testCase, top1->getLength() == top2->getLength());
+      CuAssertTrue(testCase,
+                   top1->getParentIndex() == top2->getParentIndex());
+      CuAssertTrue(testCase,
+                   top1->getParentReversed() == top2->getParentReversed());
+      CuAssertTrue(testCase,
+                   top1->getBottomParseIndex() ==
+                   top2->getBottomParseIndex());
+      CuAssertTrue(testCase,
+                   top1->getNextParalogyIndex() ==
+                   top2->getNextParalogyIndex());
+    }
+
+    n = g1->getNumBottomSegments();
+    CuAssertTrue(testCase, n == (hal_index_t)g2->getNumBottomSegments());
+    BottomSegmentIteratorConstPtr bot1 = g1->getBottomSegmentIterator();
+    BottomSegmentIteratorConstPtr bot2 = g2->getBottomSegmentIterator();
+    for (; bot1->getArrayIndex() < n; bot1->toRight(), bot2->toRight())
+    {
+      CuAssertTrue(testCase,
+                   bot1->getStartPosition() == bot2->getStartPosition());
+      CuAssertTrue(testCase, bot1->getLength() == bot2->getLength());
+      for (hal_size_t c = 0; c < g1->getNumChildren(); ++c)
+      {
+        CuAssertTrue(testCase,
+                     bot1->getChildIndex(c) == bot2->getChildIndex(c));
+        CuAssertTrue(testCase,
+                     bot1->getChildReversed(c) == bot2->getChildReversed(c));
+      }
+      CuAssertTrue(testCase,
+                   bot1->getTopParseIndex() == bot2->getTopParseIndex());
+    }
+  }
+}
+
+/** The copy must point to the same (by name) child slots and parent
+ * sequences as the source */
+static void checkRemapped(CuTest* testCase, AlignmentConstPtr source,
+                          AlignmentConstPtr copy, const CopyLayout& layout)
+{
+  const Genome* inRoot = source->openGenome("root");
+  const Genome* outRoot = copy->openGenome("root");
+  vector<hal_index_t> inChildToOutChild;
+  for (hal_size_t c = 0; c < inRoot->getNumChildren(); ++c)
+  {
+    const Genome* outLeaf = copy->openGenome(inRoot->getChild(c)->getName());
+    inChildToOutChild.push_back(outRoot->getChildIndex(outLeaf));
+    CuAssertTrue(testCase, inChildToOutChild.back() == 
+                 (hal_index_t)(layout.swapChildren == true ? 1 - c : c));
+  }
+
+  SequenceIteratorConstPtr seqIt = inRoot->getSequenceIterator();
+  SequenceIteratorConstPtr seqEnd = inRoot->getSequenceEndIterator();
+  for (; seqIt != seqEnd; seqIt->toNext())
+  {
+    const Sequence* inSeq = seqIt->getSequence();
+    const Sequence* outSeq = outRoot->getSequence(inSeq->getName());
+    CuAssertTrue(testCase, outSeq != NULL);
+    BottomSegmentIteratorConstPtr inBot = inSeq->getBottomSegmentIterator();
+    BottomSegmentIteratorConstPtr outBot = outSeq->getBottomSegmentIterator();
+    for (hal_size_t i = 0; i < inSeq->getNumBottomSegments(); ++i)
+    {
+      CuAssertTrue(testCase,
+                   inBot->getStartPosition() - inSeq->getStartPosition() ==
+                   outBot->getStartPosition() - outSeq->getStartPosition());
+      for (hal_size_t c = 0; c < inChildToOutChild.size(); ++c)
+      {
+        hal_index_t outC = inChildToOutChild[c];
+        CuAssertTrue(testCase,
+                     outBot->getChildIndex(outC) == inBot->getChildIndex(c));
+        CuAssertTrue(testCase,
+                     outBot->getChildReversed(outC) ==
+                     inBot->getChildReversed(c));
+      }
+      inBot->toRight();
+      outBot->toRight();
+    }
+  }
+
+  BottomSegmentIteratorConstPtr inBot = inRoot->getBottomSegmentIterator();
+  BottomSegmentIteratorConstPtr outBot = outRoot->getBottomSegmentIterator();
+  for (hal_size_t c = 0; c < inRoot->getNumChildren(); ++c)
+  {
+    const Genome* inLeaf = inRoot->getChild(c);
+    const Genome* outLeaf = copy->openGenome(inLeaf->getName());
+    TopSegmentIteratorConstPtr inTop = inLeaf->getTopSegmentIterator();
+    TopSegmentIteratorConstPtr outTop = outLeaf->getTopSegmentIterator();
+    hal_index_t n = inLeaf->getNumTopSegments();
+    for (; inTop->getArrayIndex() < n; inTop->toRight(), outTop->toRight())
+    {
+      if (inTop->getParentIndex() == NULL_INDEX)
+      {
+        CuAssertTrue(testCase, outTop->getParentIndex() == NULL_INDEX);
+        continue;
+      }
+      inBot->toParent(inTop);
+      outBot->toParent(outTop);
+      const Sequence* inSeq = inBot->getSequence();
+      const Sequence* outSeq = outBot->getSequence();
+      CuAssertTrue(testCase, inSeq->getName() == outSeq->getName());
+      CuAssertTrue(testCase,
+                   inBot->getArrayIndex() -
+                   inSeq->getBottomSegmentArrayIndex() ==
+                   outBot->getArrayIndex() -
+                   outSeq->getBottomSegmentArrayIndex());
+    }
+  }
+
+  if (layout.swapSequences == false)
+  {
+    string s1, s2;
+    inRoot->getString(s1);
+    outRoot->getString(s2);
+    CuAssertTrue(testCase, s1 == s2);
+  }
+}
+
+static void checkCopy(CuTest* testCase, const CopyLayout& layout)
+{
+  char* sourcePath = getTempFile();
+  char* fastPath = getTempFile();
+  char* genericPath = getTempFile();
+  try
+  {
+    // different chunk sizes, so the copied ranges don't line up
+    // with the pages of either array
+    CopyLayout sourceLayout = {false, false, false};
+    AlignmentPtr source = createAlignment(sourcePath, 7);
+    addGenomes(source, sourceLayout);
+    fillGenomes(source);
+    source->close();
+
+    AlignmentPtr readSource = hdf5AlignmentInstance();
+    readSource->open(sourcePath, true);
+    AlignmentPtr fastCopy = createAlignment(fastPath, 5);
+    addGenomes(fastCopy, layout);
+    AlignmentPtr genericCopy = createAlignment(genericPath, 5);
+    addGenomes(genericCopy, layout);
+    copyGenomes(readSource, fastCopy, false);
+    copyGenomes(readSource, genericCopy, true);
+    fastCopy->close();
+    genericCopy->close();
+
+    AlignmentPtr readFast = hdf5AlignmentInstance();
+    readFast->open(fastPath, true);
+    AlignmentPtr readGeneric = hdf5AlignmentInstance();
+    readGeneric->open(genericPath, true);
+    checkSame(testCase, readFast, readGeneric);
+    checkRemapped(testCase, readSource, readFast, layout);
+    readSource->close();
+    readFast->close();
+    readGeneric->close();
+  }
+  catch(hal_exception& e)
+  {
+    cerr << e.what() << endl;
+    CuAssertTrue(testCase, false);
+  }
+  catch(Exception& e)
+  {
+    cerr << e.getCDetailMsg() << endl;
+    CuAssertTrue(testCase, false);
+  }
+  removeTempFile(sourcePath);
+  removeTempFile(fastPath);
+  removeTempFile(genericPath);
+}
+
+void hdf5GenomeCopySameLayoutTest(CuTest *testCase)
+{
+  CopyLayout layout = {false, false, false};
+  checkCopy(testCase, layout);
+}
+
+void hdf5GenomeCopyChildRemapTest(CuTest *testCase)
+{
+  CopyLayout layout = {true, false, false};
+  checkCopy(testCase, layout);
+  layout.extraChild = true;
+  checkCopy(testCase, layout);
+}
+
+void hdf5GenomeCopyExtraChildTest(CuTest *testCase)
+{
+  CopyLayout layout = {false, true, false};
+  checkCopy(testCase, layout);
+}
+
+void hdf5GenomeCopyParentRemapTest(CuTest *testCase)
+{
+  CopyLayout layout = {false, false, true};
+  checkCopy(testCase, layout);
+  layout.swapChildren = true;
+  checkCopy(testCase, layout);
+}
+
+CuSuite* hdf5GenomeCopyTestSuite(void)
+{
+  CuSuite* suite = CuSuiteNew();
+  SUITE_ADD_TEST(suite, hdf5GenomeCopySameLayoutTest);
+  SUITE_ADD_TEST(suite, hdf5GenomeCopyChildRemapTest);
+  SUITE_ADD_TEST(suite, hdf5GenomeCopyExtraChildTest);
+  SUITE_ADD_TEST(suite, hdf5GenomeCopyParentRemapTest);
+  return suite;
+}
@@ -18,9 +18,11 @@ using namespace hal;
 typedef ColumnIteratorStack::LinkedBottomIterator LinkedBottomIterator;
 typedef ColumnIteratorStack::LinkedTopIterator LinkedTopIterator;
 typedef ColumnIteratorStack::Entry Entry;
+typedef ColumnIteratorStack::LinkPool LinkPool;
 
-Entry::Entry(const Sequence* seq, hal_index_t first, hal_index_t index,
-             hal_index_t last, hal_size_t size) : 
+Entry::Entry(LinkPool* pool, const Sequence* seq, hal_index_t first, 
+             hal_index_t index, hal_index_t last, hal_size_t size) : 
+  _pool(pool),
   _sequence(seq),
   _firstIndex(first),
   _index(index),
@@ -36,17 +38,17 @@ Entry::~Entry()
   freeLinks();
 }
 
-LinkedTopIterator* Entry::newTop()
+LinkedTopIterator* Entry::newTop(const Genome* genome)
 {
-  LinkedTopIterator* top = new LinkedTopIterator();
+  LinkedTopIterator* top = _pool->newTop(genome);
   top->_entry = this;
   _topLinks.push_back(top);
   return top;
 }
 
-LinkedBottomIterator* Entry::newBottom()
+LinkedBottomIterator* Entry::newBottom(const Genome* genome)
 {
-  LinkedBottomIterator* bottom = new LinkedBottomIterator();
+  LinkedBottomIterator* bottom = _pool->newBottom(genome);
   bottom->_entry = this;
   _bottomLinks.push_back(bottom);
   return bottom;
@@ -57,7 +59,7 @@ void Entry::freeLinks()
   size_t i;
   for (i = 0; i < _topLinks.size(); ++i)
   {
-    delete _topLinks[i];
+    _pool->freeTop(_topLinks[i]);
   }
   _topLinks.clear();
   _top._bottomParse = NULL;
@@ -66,13 +68,119 @@ void Entry::freeLinks()
 
   for (i = 0; i < _bottomLinks.size(); ++i)
   {
-    delete _bottomLinks[i];
+    _pool->freeBottom(_bottomLinks[i]);
   }
   _bottomLinks.clear();
   _bottom._topParse = NULL;
   _bottom._children.clear();
 }
 
+LinkPool::~LinkPool()
+{
+  for (size_t i = 0; i < _entries.size(); ++i)
+  {
+    delete _entries[i];
+  }
+  for (TopMap::iterator i = _tops.begin(); i != _tops.end(); ++i)
+  {
+    for (size_t j = 0; j < i->second.size(); ++j)
+    {
+      delete i->second[j];
+    }
+  }
+  for (BottomMap::iterator i = _bottoms.begin(); i != _bottoms.end(); ++i)
+  {
+    for (size_t j = 0; j < i->second.size(); ++j)
+    {
+      delete i->second[j];
+    }
+  }
+}
+
+Entry* LinkPool::newEntry(const Sequence* seq, hal_index_t first, 
+                          hal_index_t index, hal_index_t last, 
+                          hal_size_t size)
+{
+  if (_entries.empty() == true)
+  {
+    return new Entry(this, seq, first, index, last, size);
+  }
+  Entry* entry = _entries.back();
+  _entries.pop_back();
+  entry->_sequence = seq;
+  entry->_firstIndex = first;
+  entry->_index = index;
+  entry->_lastIndex = last;
+  entry->_cumulativeSize = size;
+  return entry;
+}
+
+// the entry's own iterators are cleared because they are created in 
+// the entry's sequence, which will generally differ next time around.
+void LinkPool::freeEntry(Entry* entry)
+{
+  assert(entry->_pool == this);
+  entry->freeLinks();
+  entry->_top._it = TopSegmentIteratorConstPtr();
+  entry->_top._dna = DNAIteratorConstPtr();
+  entry->_bottom._it = BottomSegmentIteratorConstPtr();
+  entry->_bottom._dna = DNAIteratorConstPtr();
+  _entries.push_back(entry);
+}
+
+LinkedTopIterator* LinkPool::newTop(const Genome* genome)
+{
+  vector<LinkedTopIterator*>& freeTops = _tops[genome];
+  if (freeTops.empty() == true)
+  {
+    LinkedTopIterator* top = new LinkedTopIterator();
+    top->_it = genome->getTopSegmentIterator();
+    top->_dna = genome->getDNAIterator();
+    return top;
+  }
+  LinkedTopIterator* top = freeTops.back();
+  freeTops.pop_back();
+  return top;
+}
+
+void LinkPool::freeTop(LinkedTopIterator* top)
+{
+  top->_bottomParse = NULL;
+  top->_parent = NULL;
+  top->_nextDup = NULL;
+  top->_entry = NULL;
+  _tops[top->_dna->getGenome()].push_back(top);
+}
+
+LinkedBottomIterator* LinkPool::newBottom(const Genome* genome)
+{
+  vector<LinkedBottomIterator*>& freeBottoms = _bottoms[genome];
+  if (freeBottoms.empty() == true)
+  {
+    LinkedBottomIterator* bottom = new LinkedBottomIterator();
+    bottom->_it = genome->getBottomSegmentIterator();
+    bottom->_dna = genome->getDNAIterator();
+    return bottom;
+  }
+  LinkedBottomIterator* bottom = freeBottoms.back();
+  freeBottoms.pop_back();
+  return bottom;
+}
+
+void LinkPool::freeBottom(LinkedBottomIterator* bottom)
+{
+  bottom->_topParse = NULL;
+  fill(bottom->_children.begin(), bottom->_children.end(), 
+       (LinkedTopIterator*)NULL);
+  bottom->_entry = NULL;
+  _bottoms[bottom->_dna->getGenome()].push_back(bottom);
+}
+
+ColumnIteratorStack::ColumnIteratorStack(LinkPool* pool) : _pool(pool)
+{
+  assert(_pool != NULL);
+}
+
 ColumnIteratorStack::~ColumnIteratorStack()
 {
   clear();
@@ -88,7 +196,7 @@ void ColumnIteratorStack::push(const Sequence* ref, hal_index_t index,
   {
     cumulative = top()->_cumulativeSize + lastIndex - index + 1;
   }
-  Entry* entry = new Entry(ref, index, index, lastIndex, cumulative);
+  Entry* entry = _pool->newEntry(ref, index, index, lastIndex, cumulative);
   _stack.push_back(entry);
 }
 
@@ -104,7 +212,7 @@ void ColumnIteratorStack::pushStack(ColumnIteratorStack& otherStack)
 void ColumnIteratorStack::popDelete()
 {
   assert(_stack.size() > 0);
-  delete _stack.back();
+  _pool->freeEntry(_stack.back());
   _stack.pop_back();
 }
 
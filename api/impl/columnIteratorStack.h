@@ -23,6 +23,7 @@ public:
 
    struct Entry;
    struct LinkedTopIterator; 
+   class LinkPool;
    struct LinkedBottomIterator 
    {
       LinkedBottomIterator() : _topParse(NULL), _entry(NULL) {}
@@ -47,12 +48,13 @@ public:
    
    struct Entry 
    {
-      Entry(const Sequence* seq, hal_index_t first, hal_index_t index,
-                   hal_index_t last, hal_size_t size);
+      Entry(LinkPool* pool, const Sequence* seq, hal_index_t first, 
+            hal_index_t index, hal_index_t last, hal_size_t size);
       ~Entry();
-      LinkedTopIterator* newTop();
-      LinkedBottomIterator* newBottom();
+      LinkedTopIterator* newTop(const Genome* genome);
+      LinkedBottomIterator* newBottom(const Genome* genome);
       void freeLinks();
+      LinkPool* _pool;
       const Sequence* _sequence;
       hal_index_t _firstIndex;
       hal_index_t _index;
@@ -63,9 +65,37 @@ public:
       std::vector<LinkedTopIterator*> _topLinks;
       std::vector<LinkedBottomIterator*> _bottomLinks;
    };
+
+   /** Free lists for entries and links so that they, along with the
+    * segment and DNA iterators that the links hold, are recycled instead 
+    * of reallocated every time the stack changes or the links are reset.
+    * Free links are kept by genome so that their iterators can be 
+    * reused as they are.  A pool can be shared by several stacks. */
+   class LinkPool
+   {
+   public:
+      ~LinkPool();
+      Entry* newEntry(const Sequence* seq, hal_index_t first, 
+                      hal_index_t index, hal_index_t last, hal_size_t size);
+      void freeEntry(Entry* entry);
+      LinkedTopIterator* newTop(const Genome* genome);
+      void freeTop(LinkedTopIterator* top);
+      LinkedBottomIterator* newBottom(const Genome* genome);
+      void freeBottom(LinkedBottomIterator* bottom);
+
+   protected:
+      typedef std::map<const Genome*, std::vector<LinkedTopIterator*> > 
+      TopMap;
+      typedef std::map<const Genome*, std::vector<LinkedBottomIterator*> > 
+      BottomMap;
+      std::vector<Entry*> _entries;
+      TopMap _tops;
+      BottomMap _bottoms;
+   };
    
 public:
    
+   ColumnIteratorStack(LinkPool* pool);
    ~ColumnIteratorStack();
    void push(const Sequence* ref, hal_index_t index, hal_index_t lastIndex);
    void pushStack(ColumnIteratorStack& otherStack);
@@ -79,6 +109,7 @@ public:
 
 protected:
 
+   LinkPool* _pool;
    std::vector<Entry*> _stack;
 };
 
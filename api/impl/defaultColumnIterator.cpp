@@ -15,6 +15,9 @@
 using namespace std;
 using namespace hal;
 
+// DNASets erased by defragment() that are kept for reuse
+static const size_t maxFreeDNASets = 1000;
+
 DefaultColumnIterator::DefaultColumnIterator(const Genome* reference, 
                                              const set<const Genome*>* targets,
                                              hal_index_t columnIndex,
@@ -26,6 +29,8 @@ DefaultColumnIterator::DefaultColumnIterator(const Genome* reference,
                                              bool unique,
                                              bool onlyOrthologs)
 :
+  _stack(&_linkPool),
+  _indelStack(&_linkPool),
   _maxInsertionLength(maxInsertLength),
   _noDupes(noDupes),
   _noAncestors(noAncestors),
@@ -82,13 +87,19 @@ DefaultColumnIterator::DefaultColumnIterator(const Genome* reference,
    
 DefaultColumnIterator::~DefaultColumnIterator()
 {
+  resetColMap();
   eraseColMap();
+  for (size_t i = 0; i < _freeDNASets.size(); ++i)
+  {
+    delete _freeDNASets[i];
+  }
   clearVisitCache();
   clearTree();
 }
 
 void DefaultColumnIterator::toRight() const
 {
+  HAL_PERF_COUNT(ColumnToRightCalls, 1);
   clearTree();
 
   // keep the current position so that when client calls
@@ -116,9 +127,12 @@ void DefaultColumnIterator::toRight() const
     }
 
     // compatible with old interface which allowed toRight() to go out
-    // of bounds without crashing.
+    // of bounds without crashing.  the rest of the range was visited
+    // already, so there is no column: don't leave the previous (or an
+    // abandoned) one in the map to be reported again
     if (_stack.size() == 1 && !_stack.topInBounds())
     {      
+      resetColMap();
       return;
     }
 
@@ -179,6 +193,7 @@ void DefaultColumnIterator::toSite(hal_index_t columnIndex,
                                    hal_index_t lastColumnIndex,
                                    bool clearCache) const
 {
+  HAL_PERF_COUNT(ColumnToSiteCalls, 1);
   clearTree();
 
   const Genome* reference = getReferenceGenome();
@@ -245,7 +260,14 @@ void DefaultColumnIterator::defragment() const
     ++next;
     if (i->second->empty())
     {
-      delete i->second;
+      if (_freeDNASets.size() < maxFreeDNASets)
+      {
+        _freeDNASets.push_back(i->second);
+      }
+      else
+      {
+        delete i->second;
+      }
       _colMap.erase(i);
     }
     i = next;
@@ -372,6 +394,7 @@ void DefaultColumnIterator::recursiveUpdate(bool init) const
 
     if (colMapInsert(topIt->_dna) == false)
     {
+      // reference base already visited: nothing claimed yet, skip it
       _break = true;
       return;
     }
@@ -433,6 +456,7 @@ void DefaultColumnIterator::recursiveUpdate(bool init) const
 
     if (colMapInsert(bottomIt->_dna) == false)
     {
+      // reference base already visited: nothing claimed yet, skip it
       _break = true;
       return;
     }
@@ -711,9 +735,7 @@ void DefaultColumnIterator::updateParent(LinkedTopIterator* topIt) const
     if (topIt->_parent == NULL)
     {
       assert(parentGenome != NULL);
-      topIt->_parent = topIt->_entry->newBottom();
-      topIt->_parent->_it = parentGenome->getBottomSegmentIterator();
-      topIt->_parent->_dna = parentGenome->getDNAIterator();
+      topIt->_parent = topIt->_entry->newBottom(parentGenome);
       hal_size_t numChildren = parentGenome->getNumChildren();
       if (numChildren > topIt->_parent->_children.size())
       {
@@ -735,7 +757,6 @@ void DefaultColumnIterator::updateParent(LinkedTopIterator* topIt) const
     topIt->_parent->_dna->setReversed(topIt->_parent->_it->getReversed());
     if (colMapInsert(topIt->_parent->_dna) == false)
     {
-      _break = true;
       return;
     }
     // cout << "child parent " << topIt->_parent->_dna->getArrayIndex() << endl;
@@ -775,9 +796,7 @@ void DefaultColumnIterator::updateChild(LinkedBottomIterator* bottomIt,
     if (bottomIt->_children[index] == NULL)
     {
       assert(childGenome != NULL);
-      bottomIt->_children[index] = bottomIt->_entry->newTop();
-      bottomIt->_children[index]->_it = childGenome->getTopSegmentIterator();
-      bottomIt->_children[index]->_dna = childGenome->getDNAIterator();
+      bottomIt->_children[index] = bottomIt->_entry->newTop(childGenome);
       bottomIt->_children[index]->_parent = bottomIt;
     }
     
@@ -790,7 +809,6 @@ void DefaultColumnIterator::updateChild(LinkedBottomIterator* bottomIt,
       bottomIt->_children[index]->_it->getReversed());
     if(colMapInsert(bottomIt->_children[index]->_dna) == false)
     {
-      _break = true;
       return;
     }
     handleInsertion(bottomIt->_children[index]->_it);
@@ -831,15 +849,14 @@ void DefaultColumnIterator::updateNextTopDup(LinkedTopIterator* topIt) const
      // no linked iterator for paralog. we create a new one and add link
     if (currentTopIt->_nextDup == NULL)
     {
-      currentTopIt->_nextDup = currentTopIt->_entry->newTop();
-      currentTopIt->_nextDup->_it = genome->getTopSegmentIterator();
-      currentTopIt->_nextDup->_dna = genome->getDNAIterator();
+      currentTopIt->_nextDup = currentTopIt->_entry->newTop(genome);
       currentTopIt->_nextDup->_parent = currentTopIt->_parent;
     }
     
     // advance the dups's iterator to match currentTopIt's (which should
-    // have already been updated)
-    currentTopIt->_nextDup->_it = currentTopIt->_it->copy();
+    // have already been updated).  the link keeps its own iterator,
+    // which we just move rather than allocating a copy every column
+    currentTopIt->_nextDup->_it->copy(currentTopIt->_it);
     currentTopIt->_nextDup->_it->toNextParalogy();
     currentTopIt->_nextDup->_dna->jumpTo(
       currentTopIt->_nextDup->_it->getStartPosition());
@@ -847,7 +864,6 @@ void DefaultColumnIterator::updateNextTopDup(LinkedTopIterator* topIt) const
       currentTopIt->_nextDup->_it->getReversed());
     if (colMapInsert(currentTopIt->_nextDup->_dna) == false)
     {
-      _break = true;
       return;
     }
     handleInsertion(currentTopIt->_nextDup->_it);
@@ -874,9 +890,7 @@ void DefaultColumnIterator::updateParseUp(LinkedBottomIterator* bottomIt)
     // no linked iterator for top parse, we create a new one
     if (bottomIt->_topParse == NULL)
     {
-      bottomIt->_topParse = bottomIt->_entry->newTop();
-      bottomIt->_topParse->_it = genome->getTopSegmentIterator();
-      bottomIt->_topParse->_dna = genome->getDNAIterator();
+      bottomIt->_topParse = bottomIt->_entry->newTop(genome);
       bottomIt->_topParse->_bottomParse = bottomIt;
     }
     
@@ -908,9 +922,7 @@ void DefaultColumnIterator::updateParseDown(LinkedTopIterator* topIt) const
     // no linked iterator for down parse, we create a new one
     if (topIt->_bottomParse == NULL)
     {
-      topIt->_bottomParse = topIt->_entry->newBottom();
-      topIt->_bottomParse->_it = genome->getBottomSegmentIterator();
-      topIt->_bottomParse->_dna = genome->getDNAIterator();
+      topIt->_bottomParse = topIt->_entry->newBottom(genome);
       topIt->_bottomParse->_topParse = topIt;
       hal_size_t numChildren = genome->getNumChildren();
       if (numChildren > topIt->_bottomParse->_children.size())
@@ -1006,6 +1018,13 @@ bool DefaultColumnIterator::colMapInsert(DNAIteratorConstPtr dnaIt) const
 
   bool found = false;
   VisitCache::iterator cacheIt = _visitCache.find(genome);
+  bool claim = _unique == true && cacheIt != _visitCache.end() &&
+     cacheIt->second->isBitmap() == true;
+  if (claim == true)
+  {
+    // claim the base so no other column (or thread) reports it
+    updateCache = true;
+  }
   if (updateCache == true)
   {
     if (cacheIt == _visitCache.end())
@@ -1034,7 +1053,16 @@ bool DefaultColumnIterator::colMapInsert(DNAIteratorConstPtr dnaIt) const
     }
     else
     {
-      DNASet* dnaSet = new DNASet();
+      DNASet* dnaSet;
+      if (_freeDNASets.empty() == true)
+      {
+        dnaSet = new DNASet();
+      }
+      else
+      {
+        dnaSet = _freeDNASets.back();
+        _freeDNASets.pop_back();
+      }
       dnaSet->push_back(dnaIt);
       _colMap.insert(i, ColumnMap::value_type(sequence, dnaSet));
     }
@@ -1045,6 +1073,16 @@ bool DefaultColumnIterator::colMapInsert(DNAIteratorConstPtr dnaIt) const
   {
     _leftmostRefPos = min(_leftmostRefPos, dnaIt->getArrayIndex());
   }
+
+  // a visited base usually means the whole column was visited before,
+  // so we stop building it.  but a claimed base can belong to a column
+  // that another iterator sharing the bitmap is building right now, and
+  // stopping would lose the bases we have already claimed.  so we just
+  // leave that branch to the iterator that claimed it
+  if (found == true && claim == false)
+  {
+    _break = true;
+  }
   return !found;
 }
 
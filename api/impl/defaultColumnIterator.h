@@ -87,6 +87,8 @@ protected:
    // seem like a dumb excercise though. 
    mutable std::set<const Genome*> _targets;
    mutable std::set<const Genome*> _scope;
+   // must come before the stacks, which give their entries back to it
+   mutable ColumnIteratorStack::LinkPool _linkPool;
    mutable ColumnIteratorStack _stack;
    mutable ColumnIteratorStack _indelStack;
    mutable const Sequence* _ref;
@@ -99,6 +101,7 @@ protected:
    mutable bool _reversed;
 
    mutable ColumnMap _colMap;
+   mutable std::vector<DNASet*> _freeDNASets;
    mutable TopSegmentIteratorConstPtr _top;
    mutable TopSegmentIteratorConstPtr _next;
    mutable VisitCache _visitCache;
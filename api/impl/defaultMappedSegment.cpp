@@ -451,6 +451,7 @@ hal_size_t DefaultMappedSegment::map(const DefaultSegmentIterator* source,
   {
     insertAndBreakOverlaps(*outIt, results);
   }
+  HAL_PERF_COUNT(MappedSegments, output.size());
 
   return output.size();
 }
@@ -14,6 +14,8 @@
 #include "halAlignmentInstance.h"
 #include "hdf5Alignment.h"
 #include "hdf5CLParser.h"
+#include "mmapAlignment.h"
+#include "mmapWriter.h"
 
 using namespace std;
 using namespace H5;
@@ -55,12 +57,31 @@ hal::hdf5AlignmentInstanceReadOnly(const FileCreatPropList& fileCreateProps,
   return AlignmentConstPtr(al);
 }
 
+AlignmentConstPtr hal::mmapAlignmentInstanceReadOnly()
+{
+  return AlignmentConstPtr(new MMapAlignment());
+}
+
+void hal::writeMMapAlignment(AlignmentConstPtr alignment, 
+                             const std::string& path)
+{
+  MMapWriter writer(alignment.get());
+  writer.write(path);
+}
+
+bool hal::isMMapAlignmentFile(const std::string& path)
+{
+  return MMapFile::isMMapFile(path);
+}
+
 AlignmentPtr hal::openHalAlignment(const std::string& path,
                                 CLParserConstPtr options)
 {
-  // detect which kind of file it is here (maybe by extension?)
-  // ...
-
+  if (isMMapAlignmentFile(path) == true)
+  {
+    throw hal_exception(path + " is a read-only mmap HAL file and cannot "
+                        "be opened for writing");
+  }
   AlignmentPtr alignment = hdf5AlignmentInstance();
   if (options.get() != NULL)
   {
@@ -73,10 +94,15 @@ AlignmentPtr hal::openHalAlignment(const std::string& path,
 AlignmentConstPtr hal::openHalAlignmentReadOnly(const std::string& path,
                                 CLParserConstPtr options)
 {
-  // detect which kind of file it is here (maybe by extension?)
-  // ...
-
-  AlignmentConstPtr alignment = hdf5AlignmentInstanceReadOnly();
+  AlignmentConstPtr alignment;
+  if (isMMapAlignmentFile(path) == true)
+  {
+    alignment = mmapAlignmentInstanceReadOnly();
+  }
+  else
+  {
+    alignment = hdf5AlignmentInstanceReadOnly();
+  }
   if (options.get() != NULL)
   {
     alignment->setOptionsFromParser(options);
@@ -84,3 +110,61 @@ AlignmentConstPtr hal::openHalAlignmentReadOnly(const std::string& path,
   alignment->open(path);
   return alignment;
 }
+
+bool hal::halAlignmentSupportsThreads(const std::string& path)
+{
+  if (isMMapAlignmentFile(path) == true)
+  {
+    return true;
+  }
+#ifdef H5_HAVE_THREADSAFE
+  return true;
+#else
+  return false;
+#endif
+}
+
+vector<AlignmentConstPtr> 
+hal::openHalAlignmentReadOnlyPerThread(const std::string& path,
+                                       CLParserConstPtr options,
+                                       hal_size_t numThreads)
+{
+  vector<AlignmentConstPtr> alignments;
+  if (numThreads > 1 && halAlignmentSupportsThreads(path) == false)
+  {
+    throw hal_exception("Cannot read " + path + " from multiple threads "
+                        "because the HDF5 library is not thread-safe.  "
+                        "Convert it with halMMapConvert or rebuild HDF5 "
+                        "with --enable-threadsafe");
+  }
+  if (isMMapAlignmentFile(path) == true)
+  {
+    alignments.assign(numThreads, openHalAlignmentReadOnly(path, options));
+  }
+  else
+  {
+    for (hal_size_t i = 0; i < numThreads; ++i)
+    {
+      alignments.push_back(openHalAlignmentReadOnly(path, options));
+    }
+  }
+  return alignments;
+}
+
+void hal::openAllGenomes(AlignmentConstPtr alignment)
+{
+  if (alignment->getNumGenomes() == 0)
+  {
+    return;
+  }
+  deque<string> bfQueue;
+  bfQueue.push_back(alignment->getRootName());
+  while (bfQueue.empty() == false)
+  {
+    string name = bfQueue.front();
+    bfQueue.pop_front();
+    alignment->openGenome(name);
+    vector<string> childNames = alignment->getChildNames(name);
+    bfQueue.insert(bfQueue.end(), childNames.begin(), childNames.end());
+  }
+}
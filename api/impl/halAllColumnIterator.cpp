@@ -0,0 +1,282 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include <cassert>
+#include "hal.h"
+#include "halAllColumnIterator.h"
+
+using namespace std;
+using namespace hal;
+
+AllColumnIterator::Scan::Scan(AlignmentConstPtr alignment,
+                              hal_size_t numParts,
+                              const string& tempDir) :
+  _numParts(numParts),
+  _numActive(numParts),
+  _numFinished(0),
+  _leaf(0)
+{
+  if (numParts == 0)
+  {
+    throw hal_exception("AllColumnIterator: the scan needs at least one "
+                        "part");
+  }
+  pthread_mutex_init(&_mutex, NULL);
+  pthread_cond_init(&_cond, NULL);
+  try
+  {
+    // depth-first, children in order
+    vector<string> stack;
+    if (alignment->getNumGenomes() > 0)
+    {
+      stack.push_back(alignment->getRootName());
+    }
+    while (stack.empty() == false)
+    {
+      string name = stack.back();
+      stack.pop_back();
+      const Genome* genome = alignment->openGenome(name);
+      if (genome == NULL)
+      {
+        throw hal_exception("AllColumnIterator: error opening genome " +
+                            name);
+      }
+      PositionCache* cache = new PositionCache();
+      _caches.insert(pair<string, PositionCache*>(name, cache));
+      cache->setBitmap(genome->getSequenceLength(), tempDir);
+      vector<string> children = alignment->getChildNames(name);
+      if (children.empty() == true)
+      {
+        _leafNames.push_back(name);
+      }
+      stack.insert(stack.end(), children.rbegin(), children.rend());
+    }
+  }
+  catch (...)
+  {
+    for (map<string, PositionCache*>::iterator i = _caches.begin();
+         i != _caches.end(); ++i)
+    {
+      delete i->second;
+    }
+    pthread_cond_destroy(&_cond);
+    pthread_mutex_destroy(&_mutex);
+    throw;
+  }
+}
+
+AllColumnIterator::Scan::~Scan()
+{
+  for (map<string, PositionCache*>::iterator i = _caches.begin();
+       i != _caches.end(); ++i)
+  {
+    delete i->second;
+  }
+  pthread_cond_destroy(&_cond);
+  pthread_mutex_destroy(&_mutex);
+}
+
+hal_size_t AllColumnIterator::Scan::getNumBytes() const
+{
+  hal_size_t numBytes = 0;
+  pthread_mutex_lock(&_mutex);
+  for (map<string, PositionCache*>::const_iterator i = _caches.begin();
+       i != _caches.end(); ++i)
+  {
+    numBytes += i->second->getNumBytes();
+  }
+  pthread_mutex_unlock(&_mutex);
+  return numBytes;
+}
+
+// wait for every other iterator to finish with the leaf
+void AllColumnIterator::Scan::finishGenome(hal_size_t leaf)
+{
+  pthread_mutex_lock(&_mutex);
+  assert(leaf == _leaf);
+  if (++_numFinished == _numActive)
+  {
+    endGenome();
+  }
+  else
+  {
+    while (_leaf == leaf)
+    {
+      pthread_cond_wait(&_cond, &_mutex);
+    }
+  }
+  pthread_mutex_unlock(&_mutex);
+}
+
+// an iterator is being destroyed, so nobody should wait for it
+void AllColumnIterator::Scan::leave()
+{
+  pthread_mutex_lock(&_mutex);
+  assert(_numActive > 0);
+  --_numActive;
+  if (_numActive > 0 && _numFinished == _numActive)
+  {
+    endGenome();
+  }
+  pthread_mutex_unlock(&_mutex);
+}
+
+// called with the mutex held
+void AllColumnIterator::Scan::endGenome()
+{
+  if (_leaf < _leafNames.size())
+  {
+    // usually every base of a leaf is claimed once it has been scanned
+    _caches[_leafNames[_leaf]]->compactBitmap();
+  }
+  _numFinished = 0;
+  ++_leaf;
+  pthread_cond_broadcast(&_cond);
+}
+
+AllColumnIterator::AllColumnIterator(AlignmentConstPtr alignment,
+                                     Scan* scan,
+                                     hal_size_t part,
+                                     bool noDupes,
+                                     bool noAncestors,
+                                     bool onlyOrthologs) :
+  _alignment(alignment),
+  _scan(scan),
+  _part(part),
+  _noDupes(noDupes),
+  _noAncestors(noAncestors),
+  _onlyOrthologs(onlyOrthologs),
+  _leaf(0),
+  _atEnd(false)
+{
+  if (part >= scan->getNumParts())
+  {
+    throw hal_exception("AllColumnIterator: part out of range");
+  }
+  try
+  {
+    for (map<string, PositionCache*>::iterator i = _scan->_caches.begin();
+         i != _scan->_caches.end(); ++i)
+    {
+      const Genome* genome = _alignment->openGenome(i->first);
+      if (genome == NULL)
+      {
+        throw hal_exception("AllColumnIterator: error opening genome " +
+                            i->first);
+      }
+      _visitCache.insert(ColumnIterator::VisitCache::value_type(genome,
+                                                                i->second));
+    }
+    toGenome();
+    if (_atEnd == false && emptyColumn() == true)
+    {
+      toRight();
+    }
+  }
+  catch (...)
+  {
+    releaseColumnIterator();
+    _scan->leave();
+    throw;
+  }
+}
+
+AllColumnIterator::~AllColumnIterator()
+{
+  releaseColumnIterator();
+  _scan->leave();
+}
+
+void AllColumnIterator::toRight()
+{
+  assert(_atEnd == false);
+  do
+  {
+    if (_colIt->lastColumn() == true)
+    {
+      nextGenome();
+    }
+    else
+    {
+      _colIt->toRight();
+    }
+  }
+  while (_atEnd == false && emptyColumn() == true);
+}
+
+// set up a column iterator on this part of the current leaf.  false if
+// the part is empty
+bool AllColumnIterator::startGenome()
+{
+  assert(_colIt.get() == NULL);
+  const Genome* genome =
+     _alignment->openGenome(_scan->_leafNames[_leaf]);
+  hal_size_t length = genome->getSequenceLength();
+  hal_size_t numParts = _scan->getNumParts();
+  hal_index_t first = (hal_index_t)(length * _part / numParts);
+  hal_index_t last = (hal_index_t)(length * (_part + 1) / numParts) - 1;
+  if (first > last)
+  {
+    return false;
+  }
+  _colIt = genome->getColumnIterator(NULL, 0, first, last, _noDupes,
+                                     _noAncestors, false, true,
+                                     _onlyOrthologs);
+  _colIt->setVisitCache(&_visitCache);
+  // so that we don't report the first column if it's already been
+  // visited
+  _colIt->toSite(first, last);
+  return true;
+}
+
+// move to the first leaf, starting with the current one, that has
+// anything in this part
+void AllColumnIterator::toGenome()
+{
+  while (_leaf < _scan->_leafNames.size() && startGenome() == false)
+  {
+    _scan->finishGenome(_leaf);
+    ++_leaf;
+  }
+  _atEnd = _leaf >= _scan->_leafNames.size();
+}
+
+void AllColumnIterator::nextGenome()
+{
+  releaseColumnIterator();
+  _scan->finishGenome(_leaf);
+  ++_leaf;
+  toGenome();
+}
+
+// the column iterator deletes its visit cache, but the bitmaps belong
+// to the scan
+void AllColumnIterator::releaseColumnIterator()
+{
+  if (_colIt.get() != NULL)
+  {
+    ColumnIterator::VisitCache* visitCache = _colIt->getVisitCache();
+    for (ColumnIterator::VisitCache::iterator i = _visitCache.begin();
+         i != _visitCache.end(); ++i)
+    {
+      visitCache->erase(i->first);
+    }
+    _colIt = ColumnIteratorConstPtr();
+  }
+}
+
+bool AllColumnIterator::emptyColumn() const
+{
+  const ColumnIterator::ColumnMap* colMap = _colIt->getColumnMap();
+  for (ColumnIterator::ColumnMap::const_iterator i = colMap->begin();
+       i != colMap->end(); ++i)
+  {
+    if (i->second->empty() == false)
+    {
+      return false;
+    }
+  }
+  return true;
+}
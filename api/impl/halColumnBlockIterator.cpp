@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include <algorithm>
+#include <cassert>
+#include "hal.h"
+#include "halColumnBlockIterator.h"
+
+using namespace std;
+using namespace hal;
+
+const hal_size_t ColumnBlockIterator::defaultMaxWidth = 1000;
+
+ColumnBlockIterator::ColumnBlockIterator(const SegmentedSequence* reference,
+                                         const set<const Genome*>* targets,
+                                         hal_index_t position,
+                                         hal_index_t lastPosition,
+                                         bool noDupes,
+                                         bool noAncestors,
+                                         bool unique,
+                                         hal_size_t maxWidth) :
+  _noAncestors(noAncestors),
+  _unique(unique),
+  _maxWidth(max(maxWidth, (hal_size_t)1)),
+  _width(0)
+{
+  const Sequence* sequence = dynamic_cast<const Sequence*>(reference);
+  _refGenome = sequence != NULL ? sequence->getGenome() :
+     dynamic_cast<const Genome*>(reference);
+  assert(_refGenome != NULL);
+  hal_index_t offset = sequence != NULL ? sequence->getStartPosition() : 0;
+  if (lastPosition == NULL_INDEX)
+  {
+    lastPosition = (hal_index_t)reference->getSequenceLength() - 1;
+  }
+  _lastIndex = offset + lastPosition;
+
+  // A segment boundary in a genome that isn't reported can still change
+  // the column, so the column iterator is asked to report every genome
+  // it visits (the same spanning tree it would visit anyway) and the
+  // rows are filtered here instead.
+  if (targets != NULL && targets->empty() == false)
+  {
+    _targets = *targets;
+    _targets.insert(_refGenome);
+    getGenomesInSpanningTree(_targets, _scope);
+  }
+  _colIt = reference->getColumnIterator(_scope.empty() ? NULL : &_scope,
+                                        0, position, lastPosition, noDupes,
+                                        false, false, unique, false);
+  readBlock();
+}
+
+ColumnBlockIterator::~ColumnBlockIterator()
+{
+
+}
+
+void ColumnBlockIterator::toRight()
+{
+  assert(lastBlock() == false);
+  if (_width == 1)
+  {
+    _colIt->toRight();
+  }
+  else
+  {
+    _colIt->toSite(_nextIndex, _lastIndex, false);
+  }
+  readBlock();
+}
+
+bool ColumnBlockIterator::isReported(const Genome* genome) const
+{
+  return (_targets.empty() || _targets.find(genome) != _targets.end()) &&
+     (_noAncestors == false || genome->getNumChildren() == 0);
+}
+
+// number of bases from the iterator's position to the end of its 
+// top and bottom segments (in the direction it is moving)
+hal_size_t ColumnBlockIterator::getRunLength(const DNAIteratorConstPtr& dnaIt)
+{
+  const Genome* genome = dnaIt->getGenome();
+  hal_index_t pos = dnaIt->getArrayIndex();
+  bool reversed = dnaIt->getReversed();
+  hal_index_t first;
+  hal_index_t last;
+  if (genome->getNumTopSegments() == 0 && genome->getNumBottomSegments() == 0)
+  {
+    const Sequence* sequence = dnaIt->getSequence();
+    first = sequence->getStartPosition();
+    last = sequence->getEndPosition();
+  }
+  else
+  {
+    first = 0;
+    last = (hal_index_t)genome->getSequenceLength() - 1;
+  }
+  if (genome->getNumTopSegments() > 0)
+  {
+    TopSegmentIteratorConstPtr& top = _topIts[genome];
+    if (top.get() == NULL)
+    {
+      top = genome->getTopSegmentIterator();
+    }
+    top->toSite(pos, false);
+    first = max(first, top->getStartPosition());
+    last = min(last, top->getEndPosition());
+  }
+  if (genome->getNumBottomSegments() > 0)
+  {
+    BottomSegmentIteratorConstPtr& bottom = _bottomIts[genome];
+    if (bottom.get() == NULL)
+    {
+      bottom = genome->getBottomSegmentIterator();
+    }
+    bottom->toSite(pos, false);
+    first = max(first, bottom->getStartPosition());
+    last = min(last, bottom->getEndPosition());
+  }
+  assert(pos >= first && pos <= last);
+  return reversed ? pos - first + 1 : last - pos + 1;
+}
+
+// the column iterator only caches reference positions, and the rest
+// of the block's columns are never visited by it.  so we do it here, 
+// or the iterator would report them again from any paralogous copies
+// further along the reference.
+void ColumnBlockIterator::cacheBlock()
+{
+  ColumnIterator::VisitCache* visitCache = _colIt->getVisitCache();
+  ColumnIterator::VisitCache::iterator cacheIt = 
+     visitCache->find(_refGenome);
+  if (cacheIt == visitCache->end())
+  {
+    cacheIt = visitCache->insert(ColumnIterator::VisitCache::value_type(
+                                   _refGenome, new PositionCache())).first;
+  }
+  PositionCache* posCache = cacheIt->second;
+  for (size_t row = 0; row < _sequences.size(); ++row)
+  {
+    if (_sequences[row]->getGenome() == _refGenome)
+    {
+      hal_index_t step = _reversed[row] ? -1 : 1;
+      for (hal_size_t i = 1; i < _width; ++i)
+      {
+        posCache->insert(_starts[row] + step * (hal_index_t)i);
+      }
+    }
+  }
+}
+
+void ColumnBlockIterator::readBlock()
+{
+  _refSequence = _colIt->getReferenceSequence();
+  _refPosition = _colIt->getReferenceSequencePosition();
+  hal_index_t refIndex = _refSequence->getStartPosition() + _refPosition;
+  assert(refIndex <= _lastIndex);
+  _width = min(_maxWidth, (hal_size_t)(_lastIndex - refIndex + 1));
+
+  const ColumnIterator::ColumnMap* cmap = _colIt->getColumnMap();
+  _sequences.clear();
+  _starts.clear();
+  _reversed.clear();
+  for (ColumnIterator::ColumnMap::const_iterator i = cmap->begin(); 
+       i != cmap->end(); ++i)
+  {
+    for (size_t j = 0; j < i->second->size(); ++j)
+    {
+      const DNAIteratorConstPtr& dnaIt = i->second->at(j);
+      if (_width > 1)
+      {
+        _width = min(_width, getRunLength(dnaIt));
+      }
+      if (isReported(i->first->getGenome()) == true)
+      {
+        _sequences.push_back(i->first);
+        _starts.push_back(dnaIt->getArrayIndex());
+        _reversed.push_back(dnaIt->getReversed());
+      }
+    }
+  }
+
+  // the iterators belong to the column iterator, which jumps them all
+  // to their next positions, so we can read with them directly
+  _bases.resize(_sequences.size() * _width);
+  size_t row = 0;
+  for (ColumnIterator::ColumnMap::const_iterator i = cmap->begin(); 
+       i != cmap->end(); ++i)
+  {
+    if (isReported(i->first->getGenome()) == true)
+    {
+      for (size_t j = 0; j < i->second->size(); ++j, ++row)
+      {
+        i->second->at(j)->readString(_buffer, _width);
+        copy(_buffer.begin(), _buffer.end(), _bases.begin() + row * _width);
+      }
+    }
+  }
+  assert(row == _sequences.size());
+
+  if (_width == 1)
+  {
+    _nextIndex = _colIt->lastColumn() ? _lastIndex + 1 : 
+       _colIt->getArrayIndex();
+  }
+  else
+  {
+    _nextIndex = refIndex + (hal_index_t)_width;
+    if (_unique == true)
+    {
+      cacheBlock();
+      ColumnIterator::VisitCache* visitCache = _colIt->getVisitCache();
+      PositionCache* posCache = visitCache->find(_refGenome)->second;
+      while (_nextIndex <= _lastIndex && posCache->find(_nextIndex) == true)
+      {
+        ++_nextIndex;
+      }
+    }
+  }
+}
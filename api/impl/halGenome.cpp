@@ -1,6 +1,7 @@
 #include <sstream>
 #include <assert.h>
 #include <map>
+#include <algorithm>
 #include <iostream>
 #include "halGenome.h"
 #include "halAlignment.h"
@@ -188,8 +189,6 @@ void Genome::copyBottomSegments(Genome *dest) const
     BottomSegmentIteratorPtr inBot = inSeq->getBottomSegmentIterator();
     BottomSegmentIteratorPtr outBot = outSeq->getBottomSegmentIterator();
 
-    cout << "DEBUG: inSeq name: " << inSeq->getName() << ", outSeq name: " << outSeq->getName() << endl;
-
     if (inSeq->getName() != outSeq->getName()) {
       // This check is important enough that it can't be an assert.
       stringstream ss;
@@ -204,14 +203,11 @@ void Genome::copyBottomSegments(Genome *dest) const
     }
 
     hal_index_t inSegmentEnd = inSeq->getBottomSegmentArrayIndex() + inSeq->getNumBottomSegments();
-    cout << "DEBUG: inSegmentStart: " << inSeq->getBottomSegmentArrayIndex() << " inSegmentEnd: " << inSegmentEnd << " num bottom segments: " << inSeq->getNumBottomSegments() << endl;
     for (; inBot->getArrayIndex() < inSegmentEnd; inBot->toRight(),
            outBot->toRight())
     {
       hal_index_t outStartPosition = inBot->getStartPosition() - inSeq->getStartPosition() + outSeq->getStartPosition();
 
-      cout << "Decided on outStartPosition " << outStartPosition << " for seg index " << outBot->getArrayIndex() << " (src index " << inBot->getArrayIndex() << ")" << endl;
-
       if (dest->getSequenceBySite(outStartPosition) != outSeq) {
         stringstream ss;
         ss << "When copying bottom segments from " << getName() << " to " << dest->getName() << ": expected destination sequence " << outSeq->getName() << " for segment # " << inBot->getArrayIndex() << " but got " << dest->getSequenceBySite(outStartPosition)->getName();
@@ -222,7 +218,6 @@ void Genome::copyBottomSegments(Genome *dest) const
         hal_size_t outChild = inChildToOutChild[inChild];
         if (outChild != outNc) {
           outBot->setChildIndex(outChild, inBot->getChildIndex(inChild));
-          cout << "genome " << getName() << ": Set child index " << inChild << " to " << inBot->getChildIndex(inChild) << endl;
           outBot->setChildReversed(outChild, inBot->getChildReversed(inChild));
         }
       }
@@ -234,14 +229,17 @@ void Genome::copyBottomSegments(Genome *dest) const
 
 void Genome::copySequence(Genome *dest) const
 {
-  DNAIteratorConstPtr inDna = getDNAIterator();
-  DNAIteratorPtr outDna = dest->getDNAIterator();
+  // copy a block of bases at a time rather than going through the
+  // DNA iterators base by base
+  static const hal_size_t blockSize = 1000000;
   hal_size_t n = getSequenceLength();
   assert(n == dest->getSequenceLength());
-  for (; (hal_size_t)inDna->getArrayIndex() < n; inDna->toRight(), 
-         outDna->toRight())
+  string buffer;
+  for (hal_size_t start = 0; start < n; start += blockSize)
   {
-    outDna->setChar(inDna->getChar());
+    hal_size_t length = min(blockSize, n - start);
+    getSubString(buffer, start, length);
+    dest->setSubString(buffer, start, length);
   }
 }
 
@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include <exception>
+#include "halOrderedWorkQueue.h"
+
+using namespace std;
+using namespace hal;
+
+OrderedWorkQueue::OrderedWorkQueue(const vector<Worker*>& workers,
+                                   hal_size_t window) :
+  _windowSize(window > 0 ? window : 4 * workers.size()),
+  _first(0),
+  _next(0),
+  _end(false),
+  _abort(false)
+{
+  if (workers.empty() == true)
+  {
+    throw hal_exception("OrderedWorkQueue: at least one worker is needed");
+  }
+  pthread_mutex_init(&_mutex, NULL);
+  pthread_cond_init(&_cond, NULL);
+  _threads.resize(workers.size());
+  for (size_t i = 0; i < workers.size(); ++i)
+  {
+    _threads[i]._queue = this;
+    _threads[i]._worker = workers[i];
+    pthread_t pthread;
+    if (pthread_create(&pthread, NULL, threadMain, &_threads[i]) != 0)
+    {
+      stop();
+      throw hal_exception("OrderedWorkQueue: unable to create thread");
+    }
+    _pthreads.push_back(pthread);
+  }
+}
+
+OrderedWorkQueue::~OrderedWorkQueue()
+{
+  stop();
+}
+
+// tell the threads to quit, join them and free what's left
+void OrderedWorkQueue::stop()
+{
+  pthread_mutex_lock(&_mutex);
+  _end = true;
+  _abort = true;
+  pthread_cond_broadcast(&_cond);
+  pthread_mutex_unlock(&_mutex);
+  for (size_t i = 0; i < _pthreads.size(); ++i)
+  {
+    pthread_join(_pthreads[i], NULL);
+  }
+  _pthreads.clear();
+  for (size_t i = 0; i < _window.size(); ++i)
+  {
+    delete _window[i]._work;
+  }
+  _window.clear();
+  pthread_cond_destroy(&_cond);
+  pthread_mutex_destroy(&_mutex);
+}
+
+void* OrderedWorkQueue::threadMain(void* arg)
+{
+  Thread* thread = static_cast<Thread*>(arg);
+  thread->_queue->work(thread->_worker);
+  return NULL;
+}
+
+void OrderedWorkQueue::work(Worker* worker)
+{
+  pthread_mutex_lock(&_mutex);
+  for (;;)
+  {
+    while (_end == false && _abort == false &&
+           _next == _first + _window.size())
+    {
+      pthread_cond_wait(&_cond, &_mutex);
+    }
+    if (_abort == true || _next == _first + _window.size())
+    {
+      break;
+    }
+    // the slot stays in the window until it's done, so it can be found
+    // again by number
+    hal_size_t index = _next++;
+    Work* work = _window[index - _first]._work;
+    pthread_mutex_unlock(&_mutex);
+
+    string error;
+    bool failed = false;
+    try
+    {
+      worker->doWork(work);
+    }
+    catch (exception& e)
+    {
+      error = e.what();
+      failed = true;
+    }
+    catch (...)
+    {
+      error = "OrderedWorkQueue: unknown error in worker thread";
+      failed = true;
+    }
+
+    pthread_mutex_lock(&_mutex);
+    if (failed == true)
+    {
+      if (_abort == false)
+      {
+        _error = error;
+        _abort = true;
+      }
+    }
+    else
+    {
+      _window[index - _first]._done = true;
+    }
+    pthread_cond_broadcast(&_cond);
+  }
+  pthread_mutex_unlock(&_mutex);
+}
+
+void OrderedWorkQueue::push(Work* work)
+{
+  Slot slot;
+  slot._work = work;
+  slot._done = false;
+  pthread_mutex_lock(&_mutex);
+  _window.push_back(slot);
+  pthread_cond_signal(&_cond);
+  pthread_mutex_unlock(&_mutex);
+}
+
+bool OrderedWorkQueue::isFull() const
+{
+  pthread_mutex_lock(&_mutex);
+  bool full = _window.size() >= _windowSize;
+  pthread_mutex_unlock(&_mutex);
+  return full;
+}
+
+bool OrderedWorkQueue::isEmpty() const
+{
+  pthread_mutex_lock(&_mutex);
+  bool empty = _window.empty();
+  pthread_mutex_unlock(&_mutex);
+  return empty;
+}
+
+OrderedWorkQueue::Work* OrderedWorkQueue::pop()
+{
+  pthread_mutex_lock(&_mutex);
+  while (_abort == false && _window.empty() == false &&
+         _window.front()._done == false)
+  {
+    pthread_cond_wait(&_cond, &_mutex);
+  }
+  if (_abort == true)
+  {
+    string error = _error;
+    pthread_mutex_unlock(&_mutex);
+    throw hal_exception(error);
+  }
+  Work* work = NULL;
+  if (_window.empty() == false)
+  {
+    work = _window.front()._work;
+    _window.pop_front();
+    ++_first;
+  }
+  pthread_mutex_unlock(&_mutex);
+  return work;
+}
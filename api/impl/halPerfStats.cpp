@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <pthread.h>
+#include "halPerfStats.h"
+
+using namespace std;
+using namespace hal;
+
+static const char* counterNames[PerfStats::NumCounters] =
+{
+  "sequenceBySiteCalls",
+  "columnToRightCalls",
+  "columnToSiteCalls",
+  "mappedSegments"
+};
+
+static hal_size_t globalCounters[PerfStats::NumCounters] = { 0 };
+
+// the array counters are allocated once and never freed, so that the
+// pointers handed out stay valid through the exit handler
+static pthread_mutex_t globalArrayMutex = PTHREAD_MUTEX_INITIALIZER;
+static map<string, PerfStats::ArrayCounters*>* globalArrays = NULL;
+
+static bool printAtExitSet = false;
+
+static void printGlobal()
+{
+  PerfStats::getGlobal().print(cerr);
+}
+
+PerfStats::PerfStats()
+{
+  memset(_counters, 0, sizeof(_counters));
+}
+
+void PerfStats::print(ostream& os) const
+{
+  if (isEnabled() == false)
+  {
+    os << "perfStats: not counted (build HAL with HAL_PERF_STATS=1)" << endl;
+    return;
+  }
+  os << "perfStats:" << endl;
+  for (int i = 0; i < NumCounters; ++i)
+  {
+    os << "  " << left << setw(24) << counterNames[i] << right
+       << _counters[i] << endl;
+  }
+  os << "  " << left << setw(24) << "array" << right << setw(12)
+     << "pageIns" << setw(16) << "bytesInflated" << setw(18)
+     << "pageMicroseconds" << endl;
+  for (ArrayMap::const_iterator i = _arrays.begin(); i != _arrays.end(); ++i)
+  {
+    os << "  " << left << setw(24) << i->first << right
+       << setw(12) << i->second._pageIns
+       << setw(16) << i->second._bytesInflated
+       << setw(18) << i->second._pageMicroseconds << endl;
+  }
+}
+
+const char* PerfStats::getName(Counter counter)
+{
+  return counterNames[counter];
+}
+
+bool PerfStats::isEnabled()
+{
+#ifdef HAL_PERF_STATS
+  return true;
+#else
+  return false;
+#endif
+}
+
+PerfStats PerfStats::getGlobal()
+{
+  PerfStats stats;
+  for (int i = 0; i < NumCounters; ++i)
+  {
+    stats._counters[i] = __sync_fetch_and_add(&globalCounters[i], 0);
+  }
+  pthread_mutex_lock(&globalArrayMutex);
+  if (globalArrays != NULL)
+  {
+    for (map<string, ArrayCounters*>::iterator i = globalArrays->begin();
+         i != globalArrays->end(); ++i)
+    {
+      ArrayCounters& counters = stats._arrays[i->first];
+      counters._pageIns = __sync_fetch_and_add(&i->second->_pageIns, 0);
+      counters._bytesInflated =
+         __sync_fetch_and_add(&i->second->_bytesInflated, 0);
+      counters._pageMicroseconds =
+         __sync_fetch_and_add(&i->second->_pageMicroseconds, 0);
+    }
+  }
+  pthread_mutex_unlock(&globalArrayMutex);
+  return stats;
+}
+
+void PerfStats::resetGlobal()
+{
+  for (int i = 0; i < NumCounters; ++i)
+  {
+    __sync_fetch_and_and(&globalCounters[i], 0);
+  }
+  pthread_mutex_lock(&globalArrayMutex);
+  if (globalArrays != NULL)
+  {
+    for (map<string, ArrayCounters*>::iterator i = globalArrays->begin();
+         i != globalArrays->end(); ++i)
+    {
+      __sync_fetch_and_and(&i->second->_pageIns, 0);
+      __sync_fetch_and_and(&i->second->_bytesInflated, 0);
+      __sync_fetch_and_and(&i->second->_pageMicroseconds, 0);
+    }
+  }
+  pthread_mutex_unlock(&globalArrayMutex);
+}
+
+void PerfStats::printAtExit()
+{
+  if (__sync_bool_compare_and_swap(&printAtExitSet, false, true) == true)
+  {
+    atexit(printGlobal);
+  }
+}
+
+void PerfStats::add(Counter counter, hal_size_t n)
+{
+  __sync_fetch_and_add(&globalCounters[counter], n);
+}
+
+PerfStats::ArrayCounters* PerfStats::getArrayCounters(const string& arrayName)
+{
+  pthread_mutex_lock(&globalArrayMutex);
+  if (globalArrays == NULL)
+  {
+    globalArrays = new map<string, ArrayCounters*>();
+  }
+  ArrayCounters*& counters = (*globalArrays)[arrayName];
+  if (counters == NULL)
+  {
+    counters = new ArrayCounters();
+    memset(counters, 0, sizeof(ArrayCounters));
+  }
+  ArrayCounters* ret = counters;
+  pthread_mutex_unlock(&globalArrayMutex);
+  return ret;
+}
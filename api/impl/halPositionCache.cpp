@@ -4,80 +4,216 @@
  * Released under the MIT license, see LICENSE.txt
  */
 #include <sstream>
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <sys/mman.h>
 #include "halPositionCache.h"
 #include "hal.h"
 
 using namespace std;
 using namespace hal;
 
+// big enough that the chunk index stays small, small enough that 
+// inserting into the middle of a chunk is a short memmove
+const size_t PositionCache::maxChunkSize = 256;
 
-bool PositionCache::insert(hal_index_t pos)
+const size_t PositionCache::bitsPerWord = 8 * sizeof(unsigned long);
+
+struct IntervalLastLess
+{
+   bool operator()(const PositionCache::Interval& interval, 
+                   hal_index_t pos) const
+   {
+     return interval.first < pos;
+   }
+};
+
+PositionCache::IntervalSet::IntervalSet(const IntervalSet& other)
+{
+  *this = other;
+}
+
+PositionCache::IntervalSet::~IntervalSet()
+{
+  clear();
+}
+
+PositionCache::IntervalSet& 
+PositionCache::IntervalSet::operator=(const IntervalSet& other)
 {
-  IntervalSet::iterator i;
-  if (_prev != _set.end() && _prev->first == pos - 1)
+  if (this != &other)
   {
-    ++_prev;
-    i = _prev;
-    assert (i == _set.lower_bound(pos));
+    clear();
+    _chunks.reserve(other._chunks.size());
+    for (size_t i = 0; i < other._chunks.size(); ++i)
+    {
+      _chunks.push_back(new vector<Interval>());
+      _chunks.back()->reserve(maxChunkSize);
+      *_chunks.back() = *other._chunks[i];
+    }
   }
-  else
+  return *this;
+}
+
+void PositionCache::IntervalSet::clear()
+{
+  for (size_t i = 0; i < _chunks.size(); ++i)
   {
-    i = _set.lower_bound(pos);
+    delete _chunks[i];
   }
-  _prev = i;
+  _chunks.clear();
+}
 
-  IntervalSet::iterator j;
-  if (i != _set.end() && i->second <= pos)
+// find the first interval whose last index is >= pos.  chunk is 
+// _chunkLast.size() if there is none
+void PositionCache::findInterval(hal_index_t pos, size_t& chunk, 
+                                 size_t& index) const
+{
+  chunk = lower_bound(_chunkLast.begin(), _chunkLast.end(), pos) -
+     _chunkLast.begin();
+  index = 0;
+  if (chunk < _chunkLast.size())
   {
-    assert(i->first >= pos);
-    return false;
+    const vector<Interval>& intervals = *_set._chunks[chunk];
+    index = lower_bound(intervals.begin(), intervals.end(), pos,
+                        IntervalLastLess()) - intervals.begin();
+    assert(index < intervals.size());
   }
+}
 
-  //merge to beginning of existing interval
-  if (i != _set.end() && i->second == pos + 1)
+void PositionCache::eraseInterval(size_t chunk, size_t index)
+{
+  vector<Interval>& intervals = *_set._chunks[chunk];
+  intervals.erase(intervals.begin() + index);
+  if (intervals.empty() == true)
   {
-    --i->second;
+    delete _set._chunks[chunk];
+    _set._chunks.erase(_set._chunks.begin() + chunk);
+    _chunkLast.erase(_chunkLast.begin() + chunk);
   }
   else
   {
-    // set hint to position before pos in set.  according to the docs, the
-    // hint works differently in C++11 where it wants the position *after*
-    // so we try to detect the compiler below...
-    j = i;
-#if __cplusplus < 201103L
-    if (j != _set.begin())
+    _chunkLast[chunk] = intervals.back().first;
+  }
+  --_numIntervals;
+}
+
+// insert unit interval pos before the given one (chunk can be one past 
+// the end to append)
+void PositionCache::insertInterval(size_t chunk, size_t index, 
+                                   hal_index_t pos)
+{
+  if (chunk == _set._chunks.size())
+  {
+    if (chunk == 0 || _set._chunks.back()->size() >= maxChunkSize)
     {
-      --j;
+      _set._chunks.push_back(new vector<Interval>());
+      _set._chunks.back()->reserve(maxChunkSize);
+      _chunkLast.push_back(pos);
     }
-#endif
-    // create new unit interval
-    i = _set.insert(j, pair<hal_index_t, hal_index_t>(pos, pos));
-    _prev = i;
-  }
-  assert(i->second <= i->first);
-  // merge abutting left interval
-  if (i != _set.begin())
-  {
-    j = i;
-    --j;
-    if (j->first == i->second - 1)
+    else
     {
-      i->second = j->second;
-      assert(i->second <= i->first);
-      _set.erase(j);
-    }    
+      --chunk;
+    }
+    index = _set._chunks[chunk]->size();
   }
+  vector<Interval>& intervals = *_set._chunks[chunk];
+  intervals.insert(intervals.begin() + index, Interval(pos, pos));
+  _chunkLast[chunk] = intervals.back().first;
+  if (intervals.size() > maxChunkSize)
+  {
+    // split in half
+    size_t half = intervals.size() / 2;
+    vector<Interval>* right = new vector<Interval>();
+    right->reserve(maxChunkSize);
+    right->assign(intervals.begin() + half, intervals.end());
+    intervals.resize(half);
+    _chunkLast[chunk] = intervals.back().first;
+    _set._chunks.insert(_set._chunks.begin() + chunk + 1, right);
+    _chunkLast.insert(_chunkLast.begin() + chunk + 1, right->back().first);
+  }
+  ++_numIntervals;
+}
 
-  // merge abutting right interval
-  j = i;
-  ++j;
-  if ( j != _set.end() && j->second == i->first + 1)
+bool PositionCache::insert(hal_index_t pos)
+{
+  if (_bitmap._on == true)
   {
-     j->second = i->second;
-     assert(j->second <= j->first);
-     _set.erase(i);
+    return insertBit(pos);
   }
 
+  // usual case: extend or add to the right of the last interval
+  if (_chunkLast.empty() == false && pos > _chunkLast.back())
+  {
+    Interval& last = _set._chunks.back()->back();
+    if (last.first == pos - 1)
+    {
+      last.first = pos;
+      _chunkLast.back() = pos;
+    }
+    else
+    {
+      insertInterval(_set._chunks.size(), 0, pos);
+    }
+    ++_size;
+    assert(find(pos) == true);
+    return true;
+  }
+
+  size_t chunk, index;
+  findInterval(pos, chunk, index);
+  Interval* right = NULL;
+  if (chunk < _chunkLast.size())
+  {
+    right = &(*_set._chunks[chunk])[index];
+    if (right->second <= pos)
+    {
+      return false;
+    }
+  }
+
+  // interval to the left of pos (if any)
+  size_t leftChunk = chunk;
+  size_t leftIndex = index;
+  Interval* left = NULL;
+  if (index > 0)
+  {
+    leftIndex = index - 1;
+    left = &(*_set._chunks[leftChunk])[leftIndex];
+  }
+  else if (chunk > 0)
+  {
+    leftChunk = chunk - 1;
+    leftIndex = _set._chunks[leftChunk]->size() - 1;
+    left = &(*_set._chunks[leftChunk])[leftIndex];
+  }
+
+  bool mergeLeft = left != NULL && left->first == pos - 1;
+  bool mergeRight = right != NULL && right->second == pos + 1;
+  if (mergeLeft == true && mergeRight == true)
+  {
+    right->second = left->second;
+    eraseInterval(leftChunk, leftIndex);
+  }
+  else if (mergeRight == true)
+  {
+    right->second = pos;
+  }
+  else if (mergeLeft == true)
+  {
+    left->first = pos;
+    if (leftIndex == _set._chunks[leftChunk]->size() - 1)
+    {
+      _chunkLast[leftChunk] = pos;
+    }
+  }
+  else
+  {
+    insertInterval(chunk, index, pos);
+  }
   ++_size;
   assert(find(pos) == true);
   return true;
@@ -85,27 +221,252 @@ bool PositionCache::insert(hal_index_t pos)
 
 bool PositionCache::find(hal_index_t pos) const
 {
-  IntervalSet::const_iterator i = _set.lower_bound(pos);
-  if (i != _set.end() && i->second <= pos)
+  if (_bitmap._on == true)
   {
-    return true;
+    return findBit(pos);
   }
-  return false;
+  size_t chunk, index;
+  findInterval(pos, chunk, index);
+  return chunk < _chunkLast.size() && 
+     (*_set._chunks[chunk])[index].second <= pos;
 }
 
 void PositionCache::clear()
 {
   _set.clear();
+  _chunkLast.clear();
   _size = 0;
-  _prev = _set.begin();
+  _numIntervals = 0;
+  if (_bitmap._on == true)
+  {
+    // a fresh map is all zeros, and gives back the old one's memory
+    _bitmap.map(_bitmap._length, _bitmap._tempDir);
+  }
+}
+
+void PositionCache::setBitmap(hal_size_t length, const string& tempDir)
+{
+  if (_size > 0)
+  {
+    throw hal_exception("PositionCache: can only switch an empty cache "
+                        "to a bitmap");
+  }
+  clear();
+  _bitmap.map(length, tempDir);
+}
+
+void PositionCache::compactBitmap()
+{
+  if (_bitmap._on == true && _bitmap._full == false && 
+      _size == _bitmap._length)
+  {
+    _bitmap.unmap();
+    _bitmap._on = true;
+    _bitmap._full = true;
+  }
+}
+
+// the set bit is the one that counts if several threads race to insert
+// the same position
+bool PositionCache::insertBit(hal_index_t pos)
+{
+  if (pos < 0 || (hal_size_t)pos >= _bitmap._length)
+  {
+    stringstream ss;
+    ss << "PositionCache: position " << pos << " out of bitmap range [0, "
+       << _bitmap._length << ")";
+    throw hal_exception(ss.str());
+  }
+  if (_bitmap._full == true)
+  {
+    return false;
+  }
+  unsigned long mask = 1UL << (pos % bitsPerWord);
+  unsigned long prev = __sync_fetch_and_or(&_bitmap._words[pos / bitsPerWord],
+                                           mask);
+  if ((prev & mask) != 0)
+  {
+    return false;
+  }
+  __sync_fetch_and_add(&_size, (hal_size_t)1);
+  return true;
+}
+
+// a plain read: a bit being set by another thread at the same time may
+// or may not be seen, same as if it had been set a moment later
+bool PositionCache::findBit(hal_index_t pos) const
+{
+  if (pos < 0 || (hal_size_t)pos >= _bitmap._length)
+  {
+    return false;
+  }
+  if (_bitmap._full == true)
+  {
+    return true;
+  }
+  return ((_bitmap._words[pos / bitsPerWord] >> (pos % bitsPerWord)) & 1UL) 
+     != 0;
+}
+
+hal_size_t PositionCache::getNumBytes() const
+{
+  if (_bitmap._on == true)
+  {
+    return sizeof(PositionCache) + _bitmap._numBytes;
+  }
+  return sizeof(PositionCache) + 
+     _set._chunks.size() * (sizeof(vector<Interval>) + 
+                            maxChunkSize * sizeof(Interval) +
+                            sizeof(vector<Interval>*) + sizeof(hal_index_t));
+}
+
+PositionCache::Bitmap::Bitmap() :
+  _on(false),
+  _full(false),
+  _words(NULL),
+  _numBytes(0),
+  _length(0)
+{
+}
+
+PositionCache::Bitmap::Bitmap(const Bitmap& other) :
+  _on(false),
+  _full(false),
+  _words(NULL),
+  _numBytes(0),
+  _length(0)
+{
+  *this = other;
+}
+
+PositionCache::Bitmap::~Bitmap()
+{
+  unmap();
+}
+
+PositionCache::Bitmap& 
+PositionCache::Bitmap::operator=(const Bitmap& other)
+{
+  if (this != &other)
+  {
+    unmap();
+    if (other._on == true)
+    {
+      if (other._full == true)
+      {
+        _length = other._length;
+        _tempDir = other._tempDir;
+        _on = true;
+        _full = true;
+      }
+      else
+      {
+        map(other._length, other._tempDir);
+        if (_numBytes > 0)
+        {
+          memcpy(_words, other._words, _numBytes);
+        }
+      }
+    }
+  }
+  return *this;
+}
+
+void PositionCache::Bitmap::map(hal_size_t length, const string& tempDir)
+{
+  // tempDir may be our own _tempDir
+  string dir = tempDir;
+  unmap();
+  _on = true;
+  _length = length;
+  _tempDir = dir;
+  _numBytes = (size_t)((length + bitsPerWord - 1) / bitsPerWord) * 
+     sizeof(unsigned long);
+  if (_numBytes == 0)
+  {
+    return;
+  }
+  void* addr = MAP_FAILED;
+  if (dir.empty() == true)
+  {
+    addr = mmap(NULL, _numBytes, PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  }
+  else
+  {
+    string path = dir + "/halPositionCacheXXXXXX";
+    vector<char> buffer(path.begin(), path.end());
+    buffer.push_back('\0');
+    int fd = mkstemp(&buffer[0]);
+    if (fd < 0)
+    {
+      _numBytes = 0;
+      throw hal_exception("error creating temporary file " + path + ": " +
+                          strerror(errno));
+    }
+    // the map keeps the file alive until it's unmapped
+    unlink(&buffer[0]);
+    if (ftruncate(fd, (off_t)_numBytes) == 0)
+    {
+      addr = mmap(NULL, _numBytes, PROT_READ | PROT_WRITE, MAP_SHARED, 
+                  fd, 0);
+    }
+    close(fd);
+  }
+  if (addr == MAP_FAILED)
+  {
+    _numBytes = 0;
+    throw hal_exception(string("error mapping position cache bitmap: ") +
+                        strerror(errno));
+  }
+  _words = (unsigned long*)addr;
+}
+
+void PositionCache::Bitmap::unmap()
+{
+  if (_words != NULL)
+  {
+    munmap(_words, _numBytes);
+  }
+  _words = NULL;
+  _numBytes = 0;
+  _on = false;
+  _full = false;
 }
 
 // for debugging
 bool PositionCache::check() const
 {
+  if (_bitmap._on == true)
+  {
+    if (_bitmap._full == true)
+    {
+      return _size == _bitmap._length;
+    }
+    hal_size_t size = 0;
+    for (size_t i = 0; i < _bitmap._numBytes / sizeof(unsigned long); ++i)
+    {
+      size += __builtin_popcountl(_bitmap._words[i]);
+    }
+    return size == _size && _numIntervals == 0;
+  }
   hal_size_t size = 0;
+  hal_size_t numIntervals = 0;
+  for (size_t c = 0; c < _set._chunks.size(); ++c)
+  {
+    if (_set._chunks[c]->empty() || 
+        _chunkLast[c] != _set._chunks[c]->back().first)
+    {
+      return false;
+    }
+  }
   for (IntervalSet::const_iterator i = _set.begin(); i != _set.end(); ++i)
   {
+    ++numIntervals;
+    if (i->second > i->first)
+    {
+      return false;
+    }
     size += (i->first + 1) - i->second;
     IntervalSet::const_iterator j = i;
     ++j;
@@ -123,5 +484,6 @@ bool PositionCache::check() const
       }
     }
   }
-  return size == _size;
+  return size == _size && numIntervals == _numIntervals &&
+     _chunkLast.size() == _set._chunks.size();
 }
@@ -0,0 +1,566 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include "hal.h"
+#include "halProjectionIndex.h"
+
+using namespace std;
+using namespace hal;
+
+// file layout (native byte order):
+//   magic, number of tables, then for each table its key, the sizes of
+//   its genomes, the number of projections and the projections
+static const char projectionIndexMagic[8] = {'H','A','L','P','I','D','X','1'};
+
+// bytes per projection in the file
+static const size_t projectionBytes = 8 + 8 + 8 + 1;
+
+template <typename T>
+static void writeValue(ostream& os, T value)
+{
+  os.write((const char*)&value, sizeof(T));
+}
+
+template <typename T>
+static T readValue(istream& is)
+{
+  T value = T();
+  is.read((char*)&value, sizeof(T));
+  return value;
+}
+
+static void writeString(ostream& os, const string& s)
+{
+  writeValue<hal_size_t>(os, s.length());
+  os.write(s.data(), s.length());
+}
+
+static string readString(istream& is)
+{
+  hal_size_t length = readValue<hal_size_t>(is);
+  if (!is || length > 1000000)
+  {
+    throw hal_exception("error reading projection index");
+  }
+  string s(length, '\0');
+  if (length > 0)
+  {
+    is.read(&s[0], length);
+  }
+  return s;
+}
+
+struct ProjectionSrcLess
+{
+   bool operator()(const ProjectionIndex::Projection& p1,
+                   const ProjectionIndex::Projection& p2) const
+   {
+     if (p1._srcStart != p2._srcStart)
+     {
+       return p1._srcStart < p2._srcStart;
+     }
+     if (p1._tgtStart != p2._tgtStart)
+     {
+       return p1._tgtStart < p2._tgtStart;
+     }
+     return p1._reversed < p2._reversed;
+   }
+};
+
+// block found while building a table, with the sequences it can't be
+// joined across
+struct ProjectionBlock
+{
+   ProjectionIndex::Projection _projection;
+   const Sequence* _srcSequence;
+   const Sequence* _tgtSequence;
+};
+
+struct ProjectionBlockLess
+{
+   bool operator()(const ProjectionBlock& b1,
+                   const ProjectionBlock& b2) const
+   {
+     return ProjectionSrcLess()(b1._projection, b2._projection);
+   }
+};
+
+bool ProjectionIndex::Key::operator<(const Key& other) const
+{
+  if (_srcName != other._srcName)
+  {
+    return _srcName < other._srcName;
+  }
+  if (_tgtName != other._tgtName)
+  {
+    return _tgtName < other._tgtName;
+  }
+  if (_doDupes != other._doDupes)
+  {
+    return _doDupes < other._doDupes;
+  }
+  return _coalescenceLimit < other._coalescenceLimit;
+}
+
+ProjectionIndex::Table::Table() :
+  _srcLength(0),
+  _srcNumTop(0),
+  _srcNumBottom(0),
+  _tgtLength(0),
+  _tgtNumTop(0),
+  _tgtNumBottom(0),
+  _numProjections(0),
+  _offset(0),
+  _loaded(false)
+{
+}
+
+ProjectionIndex::ProjectionIndex()
+{
+  pthread_mutex_init(&_mutex, NULL);
+}
+
+ProjectionIndex::~ProjectionIndex()
+{
+  clear();
+  pthread_mutex_destroy(&_mutex);
+}
+
+string ProjectionIndex::getDefaultPath(const string& halPath)
+{
+  return halPath + ".pidx";
+}
+
+void ProjectionIndex::clear()
+{
+  for (TableMap::iterator i = _tables.begin(); i != _tables.end(); ++i)
+  {
+    delete i->second;
+  }
+  _tables.clear();
+  if (_file.is_open())
+  {
+    _file.close();
+  }
+  _file.clear();
+  _path.clear();
+}
+
+void ProjectionIndex::open(const string& path)
+{
+  clear();
+  _file.open(path.c_str(), ios::in | ios::binary);
+  if (!_file)
+  {
+    throw hal_exception("error opening projection index " + path);
+  }
+  _path = path;
+  char magic[sizeof(projectionIndexMagic)];
+  _file.read(magic, sizeof(magic));
+  if (!_file || memcmp(magic, projectionIndexMagic, sizeof(magic)) != 0)
+  {
+    throw hal_exception(path + " is not a hal projection index");
+  }
+  hal_size_t numTables = readValue<hal_size_t>(_file);
+  for (hal_size_t i = 0; i < numTables && _file; ++i)
+  {
+    Key key;
+    key._srcName = readString(_file);
+    key._tgtName = readString(_file);
+    key._doDupes = readValue<unsigned char>(_file) != 0;
+    key._coalescenceLimit = readString(_file);
+    Table* table = new Table();
+    table->_srcLength = readValue<hal_size_t>(_file);
+    table->_srcNumTop = readValue<hal_size_t>(_file);
+    table->_srcNumBottom = readValue<hal_size_t>(_file);
+    table->_tgtLength = readValue<hal_size_t>(_file);
+    table->_tgtNumTop = readValue<hal_size_t>(_file);
+    table->_tgtNumBottom = readValue<hal_size_t>(_file);
+    table->_numProjections = readValue<hal_size_t>(_file);
+    table->_offset = _file.tellg();
+    delete _tables[key];
+    _tables[key] = table;
+    _file.seekg(table->_numProjections * projectionBytes, ios::cur);
+  }
+  if (!_file)
+  {
+    throw hal_exception("error reading projection index " + path);
+  }
+}
+
+void ProjectionIndex::write(const string& path)
+{
+  // everything has to be in memory in case we're overwriting the file
+  // we're reading from
+  for (TableMap::iterator i = _tables.begin(); i != _tables.end(); ++i)
+  {
+    load(*i->second);
+  }
+
+  string tempPath = path + ".tmp";
+  ofstream file(tempPath.c_str(), ios::out | ios::binary | ios::trunc);
+  if (!file)
+  {
+    throw hal_exception("error opening " + tempPath + " for writing");
+  }
+  file.write(projectionIndexMagic, sizeof(projectionIndexMagic));
+  writeValue<hal_size_t>(file, _tables.size());
+  for (TableMap::iterator i = _tables.begin(); i != _tables.end(); ++i)
+  {
+    const Key& key = i->first;
+    const Table& table = *i->second;
+    writeString(file, key._srcName);
+    writeString(file, key._tgtName);
+    writeValue<unsigned char>(file, key._doDupes ? 1 : 0);
+    writeString(file, key._coalescenceLimit);
+    writeValue<hal_size_t>(file, table._srcLength);
+    writeValue<hal_size_t>(file, table._srcNumTop);
+    writeValue<hal_size_t>(file, table._srcNumBottom);
+    writeValue<hal_size_t>(file, table._tgtLength);
+    writeValue<hal_size_t>(file, table._tgtNumTop);
+    writeValue<hal_size_t>(file, table._tgtNumBottom);
+    writeValue<hal_size_t>(file, table._projections.size());
+    for (size_t j = 0; j < table._projections.size(); ++j)
+    {
+      const Projection& p = table._projections[j];
+      writeValue<hal_index_t>(file, p._srcStart);
+      writeValue<hal_index_t>(file, p._tgtStart);
+      writeValue<hal_size_t>(file, p._length);
+      writeValue<unsigned char>(file, p._reversed ? 1 : 0);
+    }
+  }
+  file.close();
+  if (!file)
+  {
+    throw hal_exception("error writing " + tempPath);
+  }
+  if (rename(tempPath.c_str(), path.c_str()) != 0)
+  {
+    throw hal_exception("error renaming " + tempPath + " to " + path + ": " +
+                        strerror(errno));
+  }
+}
+
+ProjectionIndex::Key ProjectionIndex::makeKey(const Genome* srcGenome,
+                                              const Genome* tgtGenome,
+                                              bool doDupes,
+                                              const Genome* coalescenceLimit)
+{
+  Key key;
+  key._srcName = srcGenome->getName();
+  key._tgtName = tgtGenome->getName();
+  key._doDupes = doDupes;
+  if (coalescenceLimit != NULL)
+  {
+    set<const Genome*> inputSet;
+    inputSet.insert(srcGenome);
+    inputSet.insert(tgtGenome);
+    if (coalescenceLimit != getLowestCommonAncestor(inputSet))
+    {
+      key._coalescenceLimit = coalescenceLimit->getName();
+    }
+  }
+  return key;
+}
+
+// same walk as BlockLiftover::liftInterval(), one range at a time
+void ProjectionIndex::project(const Genome* srcGenome,
+                              const Genome* tgtGenome,
+                              const vector<pair<hal_index_t, hal_index_t> >&
+                              ranges,
+                              bool doDupes,
+                              const Genome* coalescenceLimit,
+                              vector<Projection>& outProjections)
+{
+  set<const Genome*> inputSet;
+  inputSet.insert(srcGenome);
+  inputSet.insert(tgtGenome);
+  const Genome* mrca = getLowestCommonAncestor(inputSet);
+  if (coalescenceLimit == NULL)
+  {
+    coalescenceLimit = mrca;
+  }
+  inputSet.clear();
+  inputSet.insert(coalescenceLimit);
+  inputSet.insert(tgtGenome);
+  set<const Genome*> downwardPath;
+  getGenomesInSpanningTree(inputSet, downwardPath);
+
+  vector<ProjectionBlock> blocks;
+  SegmentIteratorConstPtr refSeg;
+  hal_index_t lastIndex = 0;
+  if (srcGenome->getNumTopSegments() > 0)
+  {
+    refSeg = srcGenome->getTopSegmentIterator();
+    lastIndex = (hal_index_t)srcGenome->getNumTopSegments();
+  }
+  else if (srcGenome->getNumBottomSegments() > 0)
+  {
+    refSeg = srcGenome->getBottomSegmentIterator();
+    lastIndex = (hal_index_t)srcGenome->getNumBottomSegments();
+  }
+  set<MappedSegmentConstPtr> mappedSegments;
+  for (size_t r = 0; refSeg.get() != NULL && r < ranges.size(); ++r)
+  {
+    hal_index_t start = ranges[r].first;
+    hal_index_t end = ranges[r].second;
+    assert(start <= end && end < (hal_index_t)srcGenome->getSequenceLength());
+    refSeg->toSite(start, false);
+    hal_offset_t startOffset = start - refSeg->getStartPosition();
+    hal_offset_t endOffset = 0;
+    if (end <= refSeg->getEndPosition())
+    {
+      endOffset = refSeg->getEndPosition() - end;
+    }
+    refSeg->slice(startOffset, endOffset);
+    while (refSeg->getArrayIndex() < lastIndex &&
+           refSeg->getStartPosition() <= end)
+    {
+      mappedSegments.clear();
+      refSeg->getMappedSegments(mappedSegments, tgtGenome, &downwardPath,
+                                doDupes, 0, coalescenceLimit, mrca);
+      for (set<MappedSegmentConstPtr>::iterator i = mappedSegments.begin();
+           i != mappedSegments.end(); ++i)
+      {
+        SlicedSegmentConstPtr source = (*i)->getSource();
+        ProjectionBlock block;
+        block._projection._srcStart = min(source->getStartPosition(),
+                                          source->getEndPosition());
+        block._projection._tgtStart = min((*i)->getStartPosition(),
+                                          (*i)->getEndPosition());
+        block._projection._length = (*i)->getLength();
+        block._projection._reversed =
+           source->getReversed() != (*i)->getReversed();
+        block._srcSequence = source->getSequence();
+        block._tgtSequence = (*i)->getSequence();
+        blocks.push_back(block);
+      }
+      refSeg->toRight(end);
+    }
+  }
+
+  // join blocks that continue each other in both genomes.  with
+  // duplications, a block's continuation isn't necessarily the next one
+  // in source order, so the runs that can still be extended are looked
+  // up by (source end, target position to continue from, strand)
+  sort(blocks.begin(), blocks.end(), ProjectionBlockLess());
+  typedef pair<pair<hal_index_t, hal_index_t>, bool> RunEnd;
+  std::map<RunEnd, size_t> openRuns;
+  vector<ProjectionBlock> runs;
+  for (size_t i = 0; i < blocks.size(); ++i)
+  {
+    const Projection& p = blocks[i]._projection;
+    // runs that end before this block can't be extended any more
+    while (openRuns.empty() == false &&
+           openRuns.begin()->first.first.first < p._srcStart)
+    {
+      openRuns.erase(openRuns.begin());
+    }
+    hal_index_t tgtJoin = p._reversed ?
+       p._tgtStart + (hal_index_t)p._length : p._tgtStart;
+    std::map<RunEnd, size_t>::iterator open = openRuns.find(
+      RunEnd(pair<hal_index_t, hal_index_t>(p._srcStart, tgtJoin),
+             p._reversed));
+    size_t r;
+    if (open != openRuns.end() &&
+        runs[open->second]._srcSequence == blocks[i]._srcSequence &&
+        runs[open->second]._tgtSequence == blocks[i]._tgtSequence)
+    {
+      r = open->second;
+      openRuns.erase(open);
+      runs[r]._projection._length += p._length;
+      if (p._reversed == true)
+      {
+        runs[r]._projection._tgtStart = p._tgtStart;
+      }
+    }
+    else
+    {
+      r = runs.size();
+      runs.push_back(blocks[i]);
+    }
+    const Projection& q = runs[r]._projection;
+    hal_index_t tgtNext = q._reversed ?
+       q._tgtStart : q._tgtStart + (hal_index_t)q._length;
+    openRuns[RunEnd(pair<hal_index_t, hal_index_t>(
+                      q._srcStart + (hal_index_t)q._length, tgtNext),
+                    q._reversed)] = r;
+  }
+  vector<ProjectionBlock>().swap(blocks);
+
+  outProjections.reserve(outProjections.size() + runs.size());
+  for (size_t i = 0; i < runs.size(); ++i)
+  {
+    outProjections.push_back(runs[i]._projection);
+  }
+}
+
+void ProjectionIndex::add(const Genome* srcGenome, const Genome* tgtGenome,
+                          bool doDupes, const Genome* coalescenceLimit)
+{
+  Table* table = new Table();
+  try
+  {
+    vector<pair<hal_index_t, hal_index_t> > ranges;
+    if (srcGenome->getSequenceLength() > 0)
+    {
+      ranges.push_back(pair<hal_index_t, hal_index_t>(
+                         0, (hal_index_t)srcGenome->getSequenceLength() - 1));
+    }
+    project(srcGenome, tgtGenome, ranges, doDupes, coalescenceLimit,
+            table->_projections);
+  }
+  catch (...)
+  {
+    delete table;
+    throw;
+  }
+  table->_srcLength = srcGenome->getSequenceLength();
+  table->_srcNumTop = srcGenome->getNumTopSegments();
+  table->_srcNumBottom = srcGenome->getNumBottomSegments();
+  table->_tgtLength = tgtGenome->getSequenceLength();
+  table->_tgtNumTop = tgtGenome->getNumTopSegments();
+  table->_tgtNumBottom = tgtGenome->getNumBottomSegments();
+  table->_numProjections = table->_projections.size();
+  table->_loaded = true;
+  index(table->_projections, table->_maxEnd);
+
+  Key key = makeKey(srcGenome, tgtGenome, doDupes, coalescenceLimit);
+  TableMap::iterator i = _tables.find(key);
+  if (i != _tables.end())
+  {
+    delete i->second;
+    i->second = table;
+  }
+  else
+  {
+    _tables.insert(pair<Key, Table*>(key, table));
+  }
+}
+
+bool ProjectionIndex::hasTable(const Genome* srcGenome,
+                               const Genome* tgtGenome,
+                               bool doDupes,
+                               const Genome* coalescenceLimit) const
+{
+  return _tables.find(makeKey(srcGenome, tgtGenome, doDupes,
+                              coalescenceLimit)) != _tables.end();
+}
+
+const ProjectionIndex::Table*
+ProjectionIndex::getTable(const Genome* srcGenome, const Genome* tgtGenome,
+                          bool doDupes, const Genome* coalescenceLimit) const
+{
+  TableMap::const_iterator i = _tables.find(makeKey(srcGenome, tgtGenome,
+                                                    doDupes,
+                                                    coalescenceLimit));
+  if (i == _tables.end())
+  {
+    throw hal_exception("no projection of " + srcGenome->getName() +
+                        " onto " + tgtGenome->getName() +
+                        " with these options in the index");
+  }
+  Table& table = *i->second;
+  if (table._srcLength != srcGenome->getSequenceLength() ||
+      table._srcNumTop != srcGenome->getNumTopSegments() ||
+      table._srcNumBottom != srcGenome->getNumBottomSegments() ||
+      table._tgtLength != tgtGenome->getSequenceLength() ||
+      table._tgtNumTop != tgtGenome->getNumTopSegments() ||
+      table._tgtNumBottom != tgtGenome->getNumBottomSegments())
+  {
+    throw hal_exception("projection of " + srcGenome->getName() +
+                        " onto " + tgtGenome->getName() +
+                        " in the index doesn't match the alignment "
+                        "(the index is out of date)");
+  }
+  load(table);
+  return &table;
+}
+
+void ProjectionIndex::load(Table& table) const
+{
+  pthread_mutex_lock(&_mutex);
+  if (table._loaded == false)
+  {
+    _file.clear();
+    _file.seekg(table._offset);
+    table._projections.resize(table._numProjections);
+    for (hal_size_t i = 0; i < table._numProjections && _file; ++i)
+    {
+      Projection& p = table._projections[i];
+      p._srcStart = readValue<hal_index_t>(_file);
+      p._tgtStart = readValue<hal_index_t>(_file);
+      p._length = readValue<hal_size_t>(_file);
+      p._reversed = readValue<unsigned char>(_file) != 0;
+    }
+    if (!_file)
+    {
+      table._projections.clear();
+      pthread_mutex_unlock(&_mutex);
+      throw hal_exception("error reading projection index " + _path);
+    }
+    index(table._projections, table._maxEnd);
+    table._loaded = true;
+  }
+  pthread_mutex_unlock(&_mutex);
+}
+
+void ProjectionIndex::index(const vector<Projection>& projections,
+                            vector<hal_index_t>& outMaxEnd)
+{
+  outMaxEnd.resize(projections.size());
+  hal_index_t maxEnd = NULL_INDEX;
+  for (size_t i = 0; i < projections.size(); ++i)
+  {
+    const Projection& p = projections[i];
+    maxEnd = max(maxEnd, p._srcStart + (hal_index_t)p._length - 1);
+    outMaxEnd[i] = maxEnd;
+  }
+}
+
+void ProjectionIndex::clip(const vector<Projection>& projections,
+                           const vector<hal_index_t>& maxEnd,
+                           hal_index_t start, hal_index_t end,
+                           vector<Projection>& outProjections)
+{
+  assert(maxEnd.size() == projections.size());
+  // the first projection that could reach start
+  size_t i = lower_bound(maxEnd.begin(), maxEnd.end(), start) -
+     maxEnd.begin();
+  for (; i < projections.size() && projections[i]._srcStart <= end; ++i)
+  {
+    const Projection& p = projections[i];
+    hal_index_t pEnd = p._srcStart + (hal_index_t)p._length - 1;
+    if (pEnd < start)
+    {
+      continue;
+    }
+    hal_index_t first = max(start, p._srcStart);
+    hal_index_t last = min(end, pEnd);
+    Projection piece;
+    piece._srcStart = first;
+    piece._length = last - first + 1;
+    piece._reversed = p._reversed;
+    piece._tgtStart = p._reversed ? p._tgtStart + (pEnd - last) :
+       p._tgtStart + (first - p._srcStart);
+    outProjections.push_back(piece);
+  }
+}
+
+void ProjectionIndex::map(const Genome* srcGenome, const Genome* tgtGenome,
+                          hal_index_t start, hal_index_t end,
+                          vector<Projection>& outProjections,
+                          bool doDupes,
+                          const Genome* coalescenceLimit) const
+{
+  const Table* table = getTable(srcGenome, tgtGenome, doDupes,
+                                coalescenceLimit);
+  clip(table->_projections, table->_maxEnd, start, end, outProjections);
+}
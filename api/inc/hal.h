@@ -82,6 +82,11 @@
 #include "halDNAIterator.h"
 #include "halValidate.h"
 #include "halColumnIterator.h"
+#include "halColumnBlockIterator.h"
+#include "halAllColumnIterator.h"
+#include "halOrderedWorkQueue.h"
+#include "halProjectionIndex.h"
+#include "halPerfStats.h"
 #include "halGappedTopSegmentIterator.h"
 #include "halGappedBottomSegmentIterator.h"
 #include "halRearrangement.h"
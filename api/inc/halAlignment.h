@@ -10,6 +10,7 @@
 #include <string>
 #include <vector>
 #include "halDefs.h"
+#include "halPerfStats.h"
 
 namespace hal {
 
@@ -136,6 +137,10 @@ public:
    /** Get version used to create the file */
    virtual std::string getVersion() const = 0;
 
+   /** Get the performance counters (see halPerfStats.h).  They are
+    * counted for the whole process, not just this alignment */
+   PerfStats getPerfStats() const;
+
 protected:
    friend class counted_ptr<Alignment>;
    friend class counted_ptr<const Alignment>;
@@ -144,5 +149,10 @@ protected:
 };
 
 inline Alignment::~Alignment() {}
+
+inline PerfStats Alignment::getPerfStats() const
+{
+  return PerfStats::getGlobal();
+}
 }
 #endif
@@ -56,23 +56,72 @@ hdf5AlignmentInstanceReadOnly(const H5::FileCreatPropList& fileCreateProps,
                               const H5::DSetCreatPropList& datasetCreateProps,
                               bool inMemory = false);
 
+/** Get a read-only instance of a memory-mapped Alignment.  These are
+ * uncompressed files made with writeMMapAlignment() that are accessed 
+ * directly through the OS page cache instead of the HDF5 library.  */
+AlignmentConstPtr mmapAlignmentInstanceReadOnly();
+
+/** Write an alignment to a new file in the (read-only) memory-mapped
+ * format.  
+ * @param alignment Alignment to convert (of any type)
+ * @param path Path of file to create (overwritten if exists) */
+void writeMMapAlignment(AlignmentConstPtr alignment, const std::string& path);
+
+/** Check if a file is in the memory-mapped format by looking at 
+ * the first few bytes.
+ * @param path Path of file to check */
+bool isMMapAlignmentFile(const std::string& path);
+
 /** Get an alignment instance from a file by automatically detecting which 
- * implementation to use.  (will currently (and probably forever more) 
- * just return an HDF5 instance since that's all that exists) 
+ * implementation to use.  Memory-mapped files are read-only so an
+ * exception is thrown if one is passed here.
  * @param path Path of file to open 
  * @param options Command line options information */
 AlignmentPtr openHalAlignment(const std::string& path,
                               CLParserConstPtr options); 
 
 /** Get a read-only alignment instance from a file by 
- * automatically detecting which 
- * implementation to use.  (will currently (and probably forever more) 
- * just return an HDF5 instance since that's all that exists) 
+ * automatically detecting which implementation to use: a memory-mapped
+ * instance if the file was made with writeMMapAlignment() and an
+ * HDF5 instance otherwise.
  * @param path Path of file to open 
- * @param options Command line options information */
+ * @param options Command line options information (ignored for
+ * memory-mapped files)*/
 AlignmentConstPtr openHalAlignmentReadOnly(const std::string& path,
                                            CLParserConstPtr options);
 
+/** Check if openHalAlignmentReadOnlyPerThread() can give more than one
+ * thread access to a file.  This is always true for memory-mapped files, 
+ * and true for HDF5 files only if the HDF5 library was built with 
+ * --enable-threadsafe.
+ * @param path Path of file to check */
+bool halAlignmentSupportsThreads(const std::string& path);
+
+/** Open a file for reading from several threads at once.  The API 
+ * objects (alignments, genomes, iterators etc.) are not thread-safe
+ * in general, so each thread must use only the handle it is given and
+ * the iterators it creates from it.  For a memory-mapped file every 
+ * thread gets the same (shared) alignment.  For an HDF5 file each thread
+ * gets a separate handle with its own caches, which requires a 
+ * thread-safe HDF5 library.  Handles are opened one after the other 
+ * by the calling thread.  An exception is thrown if 
+ * halAlignmentSupportsThreads() is false and numThreads > 1
+ * @param path Path of file to open 
+ * @param options Command line options information (applied to each
+ * HDF5 handle)
+ * @param numThreads Number of handles to return */
+std::vector<AlignmentConstPtr> 
+openHalAlignmentReadOnlyPerThread(const std::string& path,
+                                  CLParserConstPtr options,
+                                  hal_size_t numThreads);
+
+/** Open every genome of an alignment, top-down.  Genomes are opened
+ * lazily, and opening them all before starting threads means the
+ * threads never do it on a shared handle (and that they are created
+ * in the same order whether or not threads are used).
+ * @param alignment Alignment whose genomes to open */
+void openAllGenomes(AlignmentConstPtr alignment);
+
 }
 
 #endif
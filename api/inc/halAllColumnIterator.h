@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _HALALLCOLUMNITERATOR_H
+#define _HALALLCOLUMNITERATOR_H
+
+#include <map>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include "halDefs.h"
+#include "halColumnIterator.h"
+
+namespace hal {
+
+/**
+ * Visits every column of an alignment exactly once, without a reference
+ * genome.  The leaf genomes are scanned one after the other with a unique
+ * column iterator, and a column is reported from the first of its bases
+ * to come up.  Every reported base is flagged in a bitmap for its genome
+ * (see PositionCache::setBitmap()), so it is never reported again,
+ * whichever genome it's reached from.  Leaves are scanned in depth-first
+ * order, so each one comes right after its closest relatives and most of
+ * its bases have already been claimed by the time it's scanned.  Columns
+ * with nothing to report (eg only ancestral bases with noAncestors) are
+ * skipped.
+ *
+ * The work can be split between threads by giving each one its own
+ * AllColumnIterator on its own handle to the alignment (see
+ * openHalAlignmentReadOnlyPerThread()) and the same Scan.  Each iterator
+ * scans one slice of every leaf genome, and they all wait for each other
+ * before moving on to the next leaf, so every iterator must either be run
+ * to the end or destroyed.  With one part, the columns are the same
+ * every time.  With several, a base can be reached from two slices at
+ * once (through a paralogy, or if the slices are of different genomes'
+ * copies of a duplication) and its column may be split differently from
+ * run to run, but still no base is reported twice.
+ */
+class AllColumnIterator
+{
+public:
+
+   /** The bitmaps and the genome order of a scan of the alignment,
+    * shared by the iterators that split it up */
+   class Scan
+   {
+   public:
+      /** @param alignment Any handle to the alignment
+       * @param numParts Number of iterators sharing the scan
+       * @param tempDir Directory in which to keep the bitmaps in (unlinked)
+       * temporary files, so they can be paged out, or empty to keep them
+       * in memory */
+      Scan(AlignmentConstPtr alignment, hal_size_t numParts = 1,
+           const std::string& tempDir = "");
+      ~Scan();
+
+      hal_size_t getNumParts() const;
+
+      /** Leaf genomes in the order they are scanned */
+      const std::vector<std::string>& getGenomeNames() const;
+
+      /** Bytes of memory mapped for the bitmaps (a leaf's is freed once
+       * it's been scanned) */
+      hal_size_t getNumBytes() const;
+
+   protected:
+      friend class AllColumnIterator;
+
+      void finishGenome(hal_size_t leaf);
+      void leave();
+      void endGenome();
+
+      // one bitmap per genome, by name
+      std::map<std::string, PositionCache*> _caches;
+      std::vector<std::string> _leafNames;
+      hal_size_t _numParts;
+      // iterators still scanning, and how many of them are done with
+      // the current leaf
+      hal_size_t _numActive;
+      hal_size_t _numFinished;
+      hal_size_t _leaf;
+      mutable pthread_mutex_t _mutex;
+      pthread_cond_t _cond;
+
+   private:
+      Scan(const Scan&);
+      Scan& operator=(const Scan&);
+   };
+
+   /** Create an iterator positioned on the first column of its part of
+    * the scan.  The flags are the same as for
+    * SegmentedSequence::getColumnIterator()
+    * @param alignment Handle to the alignment, used only by this iterator
+    * @param scan State shared by all the parts of the scan
+    * @param part Which slice of each genome to scan, in [0, numParts)
+    * @param noDupes Don't follow paralogy edges
+    * @param noAncestors Don't report ancestral genomes
+    * @param onlyOrthologs Only report orthologs */
+   AllColumnIterator(AlignmentConstPtr alignment, Scan* scan,
+                     hal_size_t part = 0, bool noDupes = false,
+                     bool noAncestors = false, bool onlyOrthologs = false);
+   ~AllColumnIterator();
+
+   /** Move to the next column */
+   void toRight();
+
+   /** True once every column of this part has been visited.  Unlike
+    * ColumnIterator::lastColumn(), there is no current column when this
+    * is true */
+   bool atEnd() const;
+
+   /** Column iterator positioned on the current column.  It's replaced
+    * when the scan moves to the next leaf genome, and can be
+    * defragmented now and then as usual, but shouldn't be moved */
+   ColumnIteratorConstPtr getColumnIterator() const;
+
+   /** Index (in Scan::getGenomeNames()) of the leaf being scanned */
+   hal_size_t getGenomeIndex() const;
+
+protected:
+
+   bool startGenome();
+   void toGenome();
+   void nextGenome();
+   void releaseColumnIterator();
+   bool emptyColumn() const;
+
+   AlignmentConstPtr _alignment;
+   Scan* _scan;
+   hal_size_t _part;
+   bool _noDupes;
+   bool _noAncestors;
+   bool _onlyOrthologs;
+   hal_size_t _leaf;
+   bool _atEnd;
+   // the scan's bitmaps, by this handle's genomes (a 
+   // ColumnIterator::VisitCache)
+   std::map<const Genome*, PositionCache*> _visitCache;
+   ColumnIteratorConstPtr _colIt;
+
+private:
+   AllColumnIterator(const AllColumnIterator&);
+   AllColumnIterator& operator=(const AllColumnIterator&);
+};
+
+inline hal_size_t AllColumnIterator::Scan::getNumParts() const
+{
+  return _numParts;
+}
+
+inline const std::vector<std::string>&
+AllColumnIterator::Scan::getGenomeNames() const
+{
+  return _leafNames;
+}
+
+inline bool AllColumnIterator::atEnd() const
+{
+  return _atEnd;
+}
+
+inline ColumnIteratorConstPtr AllColumnIterator::getColumnIterator() const
+{
+  return _colIt;
+}
+
+inline hal_size_t AllColumnIterator::getGenomeIndex() const
+{
+  return _leaf;
+}
+
+}
+
+#endif
@@ -0,0 +1,191 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _HALCOLUMNBLOCKITERATOR_H
+#define _HALCOLUMNBLOCKITERATOR_H
+
+#include <cassert>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "halDefs.h"
+#include "halColumnIterator.h"
+
+namespace hal {
+
+/**
+ * Iterates over the same columns as a ColumnIterator (without insertions),
+ * but a block at a time rather than a column at a time.  A block is a
+ * run of consecutive columns inside which no row crosses a segment
+ * boundary, so every column in it has the same rows, each one a base
+ * further along its sequence (or back, if the row is reversed).
+ * The bases are returned as a dense row-major (rows x width) matrix,
+ * which is a lot cheaper than rebuilding the column map for every base.
+ */
+class ColumnBlockIterator
+{
+public:
+
+   /** Create an iterator positioned on the first block.  The parameters
+    * are the same as for SegmentedSequence::getColumnIterator()
+    * @param reference Genome or sequence to iterate along
+    * @param targets Genomes to report (all if NULL or empty)
+    * @param position First column (in reference sequence coordinates)
+    * @param lastPosition Last column (end of reference if NULL_INDEX)
+    * @param noDupes Don't follow paralogy edges
+    * @param noAncestors Don't report ancestral genomes
+    * @param unique Don't report a column more than once
+    * @param maxWidth Maximum number of columns in a block */
+   ColumnBlockIterator(const SegmentedSequence* reference,
+                       const std::set<const Genome*>* targets = NULL,
+                       hal_index_t position = 0,
+                       hal_index_t lastPosition = NULL_INDEX,
+                       bool noDupes = false,
+                       bool noAncestors = false,
+                       bool unique = false,
+                       hal_size_t maxWidth = defaultMaxWidth);
+
+   ~ColumnBlockIterator();
+
+   /** Move to the next block */
+   void toRight();
+
+   /** Use this method to bound iteration loops (as with
+    * ColumnIterator::lastColumn()) */
+   bool lastBlock() const;
+
+   /** Get the reference sequence of the block */
+   const Sequence* getReferenceSequence() const;
+
+   /** Get the position of the block's first column in the reference
+    * sequence */
+   hal_index_t getReferenceSequencePosition() const;
+
+   /** Get the number of columns in the block */
+   hal_size_t getWidth() const;
+
+   /** Get the number of rows in the block */
+   hal_size_t getNumRows() const;
+
+   /** Get the sequence of a row */
+   const Sequence* getSequence(hal_size_t row) const;
+
+   /** Get the position of a row's first base (forward genome coordinates) */
+   hal_index_t getStartPosition(hal_size_t row) const;
+
+   /** Check if a row is reversed (ie its bases are the reverse complement
+    * of the positions getStartPosition(), getStartPosition() - 1, ...)*/
+   bool getReversed(hal_size_t row) const;
+
+   /** Get the getWidth() bases of a row */
+   const char* getRow(hal_size_t row) const;
+
+   /** Get all the bases, row by row */
+   const std::string& getBases() const;
+
+   /** Get the column iterator underneath (positioned on the block's
+    * first column) */
+   ColumnIteratorConstPtr getColumnIterator() const;
+
+   static const hal_size_t defaultMaxWidth;
+
+protected:
+
+   void readBlock();
+   hal_size_t getRunLength(const DNAIteratorConstPtr& dnaIt);
+   bool isReported(const Genome* genome) const;
+   void cacheBlock();
+
+protected:
+
+   typedef std::map<const Genome*, TopSegmentIteratorConstPtr> TopMap;
+   typedef std::map<const Genome*, BottomSegmentIteratorConstPtr> BottomMap;
+
+   ColumnIteratorConstPtr _colIt;
+   const Genome* _refGenome;
+   std::set<const Genome*> _targets;
+   std::set<const Genome*> _scope;
+   bool _noAncestors;
+   bool _unique;
+   hal_size_t _maxWidth;
+   hal_index_t _lastIndex;
+   hal_index_t _nextIndex;
+
+   const Sequence* _refSequence;
+   hal_index_t _refPosition;
+   hal_size_t _width;
+   std::vector<const Sequence*> _sequences;
+   std::vector<hal_index_t> _starts;
+   std::vector<bool> _reversed;
+   std::string _bases;
+   std::string _buffer;
+   TopMap _topIts;
+   BottomMap _bottomIts;
+};
+
+inline bool ColumnBlockIterator::lastBlock() const
+{
+  return _nextIndex > _lastIndex;
+}
+
+inline const Sequence* ColumnBlockIterator::getReferenceSequence() const
+{
+  return _refSequence;
+}
+
+inline hal_index_t ColumnBlockIterator::getReferenceSequencePosition() const
+{
+  return _refPosition;
+}
+
+inline hal_size_t ColumnBlockIterator::getWidth() const
+{
+  return _width;
+}
+
+inline hal_size_t ColumnBlockIterator::getNumRows() const
+{
+  return _sequences.size();
+}
+
+inline const Sequence* ColumnBlockIterator::getSequence(hal_size_t row) const
+{
+  assert(row < _sequences.size());
+  return _sequences[row];
+}
+
+inline hal_index_t ColumnBlockIterator::getStartPosition(hal_size_t row) const
+{
+  assert(row < _starts.size());
+  return _starts[row];
+}
+
+inline bool ColumnBlockIterator::getReversed(hal_size_t row) const
+{
+  assert(row < _reversed.size());
+  return _reversed[row];
+}
+
+inline const char* ColumnBlockIterator::getRow(hal_size_t row) const
+{
+  assert(row < _sequences.size());
+  return _bases.data() + row * _width;
+}
+
+inline const std::string& ColumnBlockIterator::getBases() const
+{
+  return _bases;
+}
+
+inline ColumnIteratorConstPtr ColumnBlockIterator::getColumnIterator() const
+{
+  return _colIt;
+}
+
+}
+
+#endif
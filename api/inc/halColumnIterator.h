@@ -109,8 +109,12 @@ public:
     * tree. */
    virtual stTree *getTree() const = 0;
 
-   // temp -- probably want to have a "global column iterator" object
-   // instead
+   // The iterator owns (and deletes) the caches it's given.  In unique
+   // mode, the bases of every genome whose cache is a bitmap (see 
+   // PositionCache::setBitmap()) are claimed as they are reported, not 
+   // just the reference's, so that no base is reported twice, even by
+   // iterators in other threads sharing the bitmaps.  
+   // AllColumnIterator uses this to visit a whole alignment.
    typedef std::map<const Genome*, PositionCache*> VisitCache;
    virtual VisitCache *getVisitCache() const = 0;
    virtual void setVisitCache(VisitCache *visitCache) const = 0;
@@ -68,6 +68,23 @@ public:
    /** Compare (array indexes) of two iterators */
    virtual bool leftOf(DNAIteratorConstPtr& other) const = 0;
 
+   /** Read a string of given length starting at the current position
+    * and moving right (or left if reversed).  This is much faster than
+    * calling getChar() for each base.  The iterator ends up on the 
+    * position following the last character read.
+    * @param outString string to fill (resized to length)
+    * @param length number of characters to read */
+   virtual void readString(std::string& outString, 
+                           hal_size_t length) const = 0;
+
+   /** Write a string of given length starting at the current position
+    * and moving right (or left if reversed).  The iterator ends up on the 
+    * position following the last character written.
+    * @param inString string to write
+    * @param length number of characters to write */
+   virtual void writeString(const std::string& inString,
+                            hal_size_t length) = 0;
+
 protected:
 
    friend class counted_ptr<DNAIterator>;
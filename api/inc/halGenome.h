@@ -151,18 +151,20 @@ public:
    /** Copy top segments from this genome to another (the genomes can be in
     * different alignments)
     * @param dest Genome to be copied to */
-   void copyTopSegments(Genome *dest) const;
+   virtual void copyTopSegments(Genome *dest) const;
 
    /** Copy bottom segments from this genome to another. The genomes
     * must be in different alignments. The child indices do not have
     * to be consistent between the genomes.
     * @param dest Genome to be copied to */
-   void copyBottomSegments(Genome *dest) const;
+   virtual void copyBottomSegments(Genome *dest) const;
 
    /** Copy sequence from this genome to another (the genomes can be
-    * in different alignments).
+    * in different alignments).  Implementations can override this 
+    * and the two methods above with a faster path for destination 
+    * genomes of the same type.
     * @param dest Genome to be copied to */
-   void copySequence(Genome *dest) const;
+   virtual void copySequence(Genome *dest) const;
 
    /** Copy metadata from this genome to another (the genomes can be
     * in different alignments).
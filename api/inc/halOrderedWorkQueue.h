@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _HALORDEREDWORKQUEUE_H
+#define _HALORDEREDWORKQUEUE_H
+
+#include <deque>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include "halDefs.h"
+
+namespace hal {
+
+/**
+ * Runs pieces of work on a pool of threads and hands them back to the
+ * calling thread in the order they were added, so that a tool can, say,
+ * convert slices of a genome in parallel and still write them out in
+ * order.  The caller adds work with push() and takes it back, done, with
+ * pop(), which keeps the amount of finished work waiting to be written
+ * down to the window of the queue:
+ *
+ *    OrderedWorkQueue queue(workers);
+ *    for (each slice)
+ *    {
+ *      queue.push(new SliceWork(slice));
+ *      while (queue.isFull() == true)
+ *      {
+ *        write(queue.pop());
+ *      }
+ *    }
+ *    while (queue.isEmpty() == false)
+ *    {
+ *      write(queue.pop());
+ *    }
+ *
+ * If any work throws, the threads stop taking new work and pop() throws
+ * the error as a hal_exception.
+ */
+class OrderedWorkQueue
+{
+public:
+
+   /** A piece of work: its input and, once it's done, its output */
+   class Work
+   {
+   public:
+      virtual ~Work() {}
+   };
+
+   /** Does the work on one thread.  Each thread has its own worker, so
+    * a worker can keep per-thread state such as a handle to the
+    * alignment (see openHalAlignmentReadOnlyPerThread()) */
+   class Worker
+   {
+   public:
+      virtual ~Worker() {}
+      /** Called on the worker's thread */
+      virtual void doWork(Work* work) = 0;
+   };
+
+   /** Start a thread for each worker.  The workers aren't owned by the
+    * queue and must outlive it
+    * @param workers One worker per thread
+    * @param window Number of pieces of work, done or not, that the
+    * queue holds before isFull() (0 for four per thread) */
+   OrderedWorkQueue(const std::vector<Worker*>& workers,
+                    hal_size_t window = 0);
+
+   /** Stop and join the threads, dropping the work that hasn't been
+    * popped */
+   ~OrderedWorkQueue();
+
+   /** Add work for the threads.  The queue owns it until it's popped */
+   void push(Work* work);
+
+   /** True if the window is full, so the caller should pop() before
+    * pushing more */
+   bool isFull() const;
+
+   /** True if everything pushed has been popped */
+   bool isEmpty() const;
+
+   /** Wait for the oldest work to be done, and return it (the caller
+    * now owns it), or NULL if the queue is empty.  Throws a
+    * hal_exception if any work failed */
+   Work* pop();
+
+protected:
+
+   struct Slot
+   {
+      Work* _work;
+      bool _done;
+   };
+
+   struct Thread
+   {
+      OrderedWorkQueue* _queue;
+      Worker* _worker;
+   };
+
+   static void* threadMain(void* arg);
+   void work(Worker* worker);
+   void stop();
+
+   // work from the oldest not yet popped, numbered _first on
+   std::deque<Slot> _window;
+   hal_size_t _windowSize;
+   hal_size_t _first;
+   // next work for the threads to take
+   hal_size_t _next;
+   bool _end;
+   bool _abort;
+   std::string _error;
+   std::vector<Thread> _threads;
+   std::vector<pthread_t> _pthreads;
+   mutable pthread_mutex_t _mutex;
+   pthread_cond_t _cond;
+
+private:
+   OrderedWorkQueue(const OrderedWorkQueue&);
+   OrderedWorkQueue& operator=(const OrderedWorkQueue&);
+};
+
+}
+
+#endif
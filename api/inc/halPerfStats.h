@@ -0,0 +1,109 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _HALPERFSTATS_H
+#define _HALPERFSTATS_H
+
+#include <iostream>
+#include <map>
+#include <string>
+#include "halDefs.h"
+
+namespace hal {
+
+/**
+ * Counters of the work done in the hot paths of the library (reading
+ * and decompressing array pages, sequence lookups, column iteration,
+ * segment mapping), to see where a slow job spends its time.  They are
+ * only counted if the library is built with HAL_PERF_STATS defined (see
+ * include.mk), and are otherwise always 0.  The counters are global to
+ * the process: they add up all alignments and threads.  Tools print
+ * them to stderr on exit when given --perfStats.
+ */
+class PerfStats
+{
+public:
+
+   enum Counter
+   {
+      SequenceBySiteCalls = 0,
+      ColumnToRightCalls,
+      ColumnToSiteCalls,
+      MappedSegments,
+      NumCounters
+   };
+
+   /** Counters for one kind of array (ex. the DNA arrays of all
+    * genomes) */
+   struct ArrayCounters
+   {
+      /** Pages read from the file (including prefetched ones) */
+      hal_size_t _pageIns;
+      /** Bytes of the pages read, after decompression */
+      hal_size_t _bytesInflated;
+      /** Time spent in HDF5ExternalArray::page() */
+      hal_size_t _pageMicroseconds;
+   };
+   typedef std::map<std::string, ArrayCounters> ArrayMap;
+
+   /** All counters 0 */
+   PerfStats();
+
+   hal_size_t get(Counter counter) const;
+
+   /** Get the array counters, by array name */
+   const ArrayMap& getArrays() const;
+
+   void print(std::ostream& os) const;
+
+   static const char* getName(Counter counter);
+
+   /** Check if the library was built to count */
+   static bool isEnabled();
+
+   /** Get a copy of the counters of the process */
+   static PerfStats getGlobal();
+
+   /** Set the counters of the process to 0 */
+   static void resetGlobal();
+
+   /** Print the counters of the process to stderr when it exits (only
+    * the first call does anything) */
+   static void printAtExit();
+
+   /** Add to a counter of the process (thread-safe) */
+   static void add(Counter counter, hal_size_t n);
+
+   /** Get the counters of an array of the process.  The pointer stays
+    * valid until exit, and adds to its fields must be atomic */
+   static ArrayCounters* getArrayCounters(const std::string& arrayName);
+
+protected:
+
+   hal_size_t _counters[NumCounters];
+   ArrayMap _arrays;
+};
+
+inline hal_size_t PerfStats::get(Counter counter) const
+{
+  return _counters[counter];
+}
+
+inline const PerfStats::ArrayMap& PerfStats::getArrays() const
+{
+  return _arrays;
+}
+
+}
+
+#ifdef HAL_PERF_STATS
+#define HAL_PERF_COUNT(counter, n) \
+   hal::PerfStats::add(hal::PerfStats::counter, n)
+#else
+#define HAL_PERF_COUNT(counter, n)
+#endif
+
+#endif
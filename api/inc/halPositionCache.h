@@ -18,31 +18,185 @@ namespace hal {
 /** keep track of bases by storing 2d intervals 
  * For example, if we want to flag positions in a genome
  * that we have visited, this structure will be fairly 
- * efficient provided positions are clustered into intervals */
+ * efficient provided positions are clustered into intervals.
+ * The intervals are kept sorted in a list of small contiguous chunks
+ * (a two-level B+-tree, essentially) rather than a node-based map, and
+ * positions added to the right of everything else (the usual case 
+ * when scanning a genome) are appended in constant time.  
+ * Alternatively, positions can be kept in a memory-mapped bitmap,
+ * which can be shared between threads (see setBitmap()). */
 class PositionCache
 {
 public:
-   PositionCache() : _size(0), _prev(_set.begin()) {}
-   PositionCache(const PositionCache &positionCache) : _set(*positionCache.getIntervalSet()), _size(positionCache.size()), _prev(_set.begin()) {}
-  // sorted by last index, so each interval is (last, first)
-   typedef std::map<hal_index_t, hal_index_t> IntervalSet;
+
+   // each interval is (last, first), sorted by last index
+   typedef std::pair<hal_index_t, hal_index_t> Interval;
+
+   /** Read-only view of the intervals, in order */
+   class IntervalSet
+   {
+   public:
+      class const_iterator
+      {
+      public:
+         const_iterator() : _chunks(NULL), _chunk(0), _index(0) {}
+         const Interval& operator*() const;
+         const Interval* operator->() const;
+         const_iterator& operator++();
+         const_iterator operator++(int);
+         bool operator==(const const_iterator& other) const;
+         bool operator!=(const const_iterator& other) const;
+      protected:
+         friend class IntervalSet;
+         const std::vector<std::vector<Interval>*>* _chunks;
+         size_t _chunk;
+         size_t _index;
+      };
+
+      IntervalSet() {}
+      IntervalSet(const IntervalSet& other);
+      ~IntervalSet();
+      IntervalSet& operator=(const IntervalSet& other);
+
+      const_iterator begin() const;
+      const_iterator end() const;
+
+   protected:
+      friend class PositionCache;
+      void clear();
+      // by pointer so that adding or removing a chunk doesn't copy the 
+      // ones after it
+      std::vector<std::vector<Interval>*> _chunks;
+   };
+
+   PositionCache() : _size(0), _numIntervals(0) {}
  
    bool insert(hal_index_t pos);
    bool find(hal_index_t pos) const;
    void clear();
    bool check() const;
    hal_size_t size() const { return _size; }
-   hal_size_t numIntervals() const { return _set.size(); }
+   hal_size_t numIntervals() const { return _numIntervals; }
+
+   /** Flag positions [0, length) with one bit each instead of with
+    * intervals.  The cache must be empty.  This takes length / 8 bytes
+    * however scattered the positions are, and insert() and find() can
+    * then be called from several threads at once.  The bits are mapped
+    * from an unlinked temporary file in tempDir, so that the kernel can
+    * page them out, if one is given, or else from anonymous memory.  
+    * Positions outside [0, length) are never found and can't be
+    * inserted. */
+   void setBitmap(hal_size_t length, const std::string& tempDir = "");
+   bool isBitmap() const { return _bitmap._on; }
+
+   /** Free the memory of a bitmap in which every position is set 
+    * (find() still works).  Not thread-safe. */
+   void compactBitmap();
 
+   /** Approximate number of bytes of memory used */
+   hal_size_t getNumBytes() const;
+
+   /** Intervals, if not a bitmap */
    const IntervalSet* getIntervalSet() const { return &_set; }
 
 protected:
 
+   /** Memory-mapped bits, copied (into a new map) with the cache */
+   struct Bitmap
+   {
+      Bitmap();
+      Bitmap(const Bitmap& other);
+      ~Bitmap();
+      Bitmap& operator=(const Bitmap& other);
+      void map(hal_size_t length, const std::string& tempDir);
+      void unmap();
+
+      bool _on;
+      // every position is set, and the bits are unmapped
+      bool _full;
+      unsigned long* _words;
+      size_t _numBytes;
+      hal_size_t _length;
+      std::string _tempDir;
+   };
+
+   void findInterval(hal_index_t pos, size_t& chunk, size_t& index) const;
+   void eraseInterval(size_t chunk, size_t index);
+   void insertInterval(size_t chunk, size_t index, hal_index_t pos);
+   bool insertBit(hal_index_t pos);
+   bool findBit(hal_index_t pos) const;
+
+   static const size_t maxChunkSize;
+   static const size_t bitsPerWord;
+
    IntervalSet _set;
+   // last index of the last interval of each chunk
+   std::vector<hal_index_t> _chunkLast;
    hal_size_t _size;
-   IntervalSet::iterator _prev;
+   hal_size_t _numIntervals;
+   Bitmap _bitmap;
 };
 
+inline const PositionCache::Interval& 
+PositionCache::IntervalSet::const_iterator::operator*() const
+{
+  return (*(*_chunks)[_chunk])[_index];
+}
+
+inline const PositionCache::Interval* 
+PositionCache::IntervalSet::const_iterator::operator->() const
+{
+  return &(*(*_chunks)[_chunk])[_index];
+}
+
+inline PositionCache::IntervalSet::const_iterator& 
+PositionCache::IntervalSet::const_iterator::operator++()
+{
+  if (++_index == (*_chunks)[_chunk]->size())
+  {
+    ++_chunk;
+    _index = 0;
+  }
+  return *this;
+}
+
+inline PositionCache::IntervalSet::const_iterator 
+PositionCache::IntervalSet::const_iterator::operator++(int)
+{
+  const_iterator prev = *this;
+  ++*this;
+  return prev;
+}
+
+inline bool PositionCache::IntervalSet::const_iterator::operator==(
+  const const_iterator& other) const
+{
+  return _chunk == other._chunk && _index == other._index;
+}
+
+inline bool PositionCache::IntervalSet::const_iterator::operator!=(
+  const const_iterator& other) const
+{
+  return !(*this == other);
+}
+
+inline PositionCache::IntervalSet::const_iterator 
+PositionCache::IntervalSet::begin() const
+{
+  const_iterator i;
+  i._chunks = &_chunks;
+  return i;
+}
+
+inline PositionCache::IntervalSet::const_iterator 
+PositionCache::IntervalSet::end() const
+{
+  const_iterator i;
+  i._chunks = &_chunks;
+  i._chunk = _chunks.size();
+  return i;
+}
+
 }
 
 #endif
@@ -0,0 +1,177 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _HALPROJECTIONINDEX_H
+#define _HALPROJECTIONINDEX_H
+
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include "halDefs.h"
+
+namespace hal {
+
+/**
+ * Precomputed projections of whole genomes onto other genomes, kept in
+ * a file next to the alignment (by default, the hal path + ".pidx").
+ * A table for a (source, target) pair holds every aligned block that
+ * Segment::getMappedSegments() finds for the source genome, as sorted
+ * (srcStart, tgtStart, length, strand) intervals, with colinear
+ * neighbours joined.  Mapping a range of the source is then a binary
+ * search rather than a walk up and down the tree.  Tables are built for
+ * given mapping options (following paralogies or not, coalescence
+ * limit) and only answer queries with the same options.  Each one
+ * records the lengths and segment counts of its two genomes, and an
+ * exception is thrown if they don't match the alignment when it's used.
+ * Tables are read from the file the first time they're used.  Queries
+ * can come from several threads.
+ */
+class ProjectionIndex
+{
+public:
+
+   /** Aligned block, in genome coordinates.  Source position
+    * _srcStart + i is aligned to target position _tgtStart + i, or to
+    * _tgtStart + _length - 1 - i if _reversed is set */
+   struct Projection
+   {
+      hal_index_t _srcStart;
+      hal_index_t _tgtStart;
+      hal_size_t _length;
+      bool _reversed;
+   };
+
+   ProjectionIndex();
+   ~ProjectionIndex();
+
+   /** Default location of the index of a hal file */
+   static std::string getDefaultPath(const std::string& halPath);
+
+   /** Read the list of tables in an index file (the tables themselves
+    * are read when first used) */
+   void open(const std::string& path);
+
+   /** Write all tables to a file.  This can be the file the index was
+    * opened from */
+   void write(const std::string& path);
+
+   /** Compute the table for a pair of genomes, replacing any with the
+    * same options
+    * @param srcGenome Genome to map from
+    * @param tgtGenome Genome to map to
+    * @param doDupes Follow paralogy edges
+    * @param coalescenceLimit As for Segment::getMappedSegments() (MRCA
+    * if NULL) */
+   void add(const Genome* srcGenome, const Genome* tgtGenome,
+            bool doDupes = true, const Genome* coalescenceLimit = NULL);
+
+   /** Check if there's a table for a pair of genomes and options */
+   bool hasTable(const Genome* srcGenome, const Genome* tgtGenome,
+                 bool doDupes = true,
+                 const Genome* coalescenceLimit = NULL) const;
+
+   /** Get the number of tables */
+   hal_size_t getNumTables() const;
+
+   /** Project a range of the source genome.  The pieces of the blocks
+    * that overlap it are appended to outProjections, in order of
+    * source position.  An exception is thrown if there's no table.
+    * @param start First position (source genome coordinates)
+    * @param end Last position */
+   void map(const Genome* srcGenome, const Genome* tgtGenome,
+            hal_index_t start, hal_index_t end,
+            std::vector<Projection>& outProjections,
+            bool doDupes = true,
+            const Genome* coalescenceLimit = NULL) const;
+
+   /** Compute the projections of some ranges of the source genome with
+    * Segment::getMappedSegments(), the way the tables are made.  They
+    * are appended to outProjections sorted by source position, with
+    * colinear neighbours joined
+    * @param ranges Sorted, disjoint (first, last) pairs of source genome
+    * positions */
+   static void project(const Genome* srcGenome, const Genome* tgtGenome,
+                       const std::vector<std::pair<hal_index_t,
+                       hal_index_t> >& ranges,
+                       bool doDupes, const Genome* coalescenceLimit,
+                       std::vector<Projection>& outProjections);
+
+   /** Compute the search index of a list of projections sorted by source
+    * position (the last source position of each projection and all those
+    * before it) */
+   static void index(const std::vector<Projection>& projections,
+                     std::vector<hal_index_t>& outMaxEnd);
+
+   /** Append the pieces of the projections that overlap a source range to
+    * outProjections, as map() does
+    * @param projections Sorted by source position
+    * @param maxEnd Their index
+    * @param start First position (source genome coordinates)
+    * @param end Last position */
+   static void clip(const std::vector<Projection>& projections,
+                    const std::vector<hal_index_t>& maxEnd,
+                    hal_index_t start, hal_index_t end,
+                    std::vector<Projection>& outProjections);
+
+protected:
+
+   struct Key
+   {
+      bool operator<(const Key& other) const;
+      std::string _srcName;
+      std::string _tgtName;
+      bool _doDupes;
+      // empty for the MRCA
+      std::string _coalescenceLimit;
+   };
+
+   struct Table
+   {
+      Table();
+      hal_size_t _srcLength;
+      hal_size_t _srcNumTop;
+      hal_size_t _srcNumBottom;
+      hal_size_t _tgtLength;
+      hal_size_t _tgtNumTop;
+      hal_size_t _tgtNumBottom;
+      hal_size_t _numProjections;
+      // where the projections start in the file
+      std::streamoff _offset;
+      bool _loaded;
+      // sorted by source start
+      std::vector<Projection> _projections;
+      // last source position of each projection and all those before it
+      std::vector<hal_index_t> _maxEnd;
+   };
+   typedef std::map<Key, Table*> TableMap;
+
+   static Key makeKey(const Genome* srcGenome, const Genome* tgtGenome,
+                      bool doDupes, const Genome* coalescenceLimit);
+   const Table* getTable(const Genome* srcGenome, const Genome* tgtGenome,
+                         bool doDupes, const Genome* coalescenceLimit) const;
+   void load(Table& table) const;
+   void clear();
+
+   TableMap _tables;
+   std::string _path;
+   mutable std::ifstream _file;
+   mutable pthread_mutex_t _mutex;
+
+private:
+   ProjectionIndex(const ProjectionIndex&);
+   ProjectionIndex& operator=(const ProjectionIndex&);
+};
+
+inline hal_size_t ProjectionIndex::getNumTables() const
+{
+  return _tables.size();
+}
+
+}
+
+#endif
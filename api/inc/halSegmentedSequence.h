@@ -12,6 +12,26 @@
 
 namespace hal {
 
+/** 
+ * Numbers of each kind of base in a stretch of DNA, as filled in by
+ * SegmentedSequence::getBaseCounts().  Upper and lower case bases are
+ * counted together, and lower case (soft-masked) bases are counted
+ * again in _masked.
+ */
+struct BaseCounts
+{
+   BaseCounts() : _a(0), _c(0), _g(0), _t(0), _n(0), _other(0), 
+                  _masked(0) {}
+   hal_size_t getTotal() const { return _a + _c + _g + _t + _n + _other; }
+   hal_size_t _a;
+   hal_size_t _c;
+   hal_size_t _g;
+   hal_size_t _t;
+   hal_size_t _n;
+   hal_size_t _other;
+   hal_size_t _masked;
+};
+
 /** 
  * Interface for a sequence of DNA that is also broken up into 
  * top and bottom segments.  This interface is extended by both
@@ -123,6 +143,14 @@ public:
    virtual void getSubString(std::string& outString, hal_size_t start,
                              hal_size_t length) const = 0;
 
+   /** Count the bases in a substring of the character string underlying
+    * the segmented sequence, without decoding it. 
+    * @param start First position of substring 
+    * @param length Length of substring 
+    * @param counts Counts to add to (not reset first) */
+   virtual void getBaseCounts(hal_size_t start, hal_size_t length,
+                              BaseCounts& counts) const = 0;
+
   /** Set the character string underlying the segmented sequence
     * @param inString input string to copy
     * @param start First position of substring 
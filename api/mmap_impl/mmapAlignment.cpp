@@ -0,0 +1,379 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include <cassert>
+#include <iostream>
+#include <cstdlib>
+#include <deque>
+#include <sstream>
+#include "halCommon.h"
+#include "mmapAlignment.h"
+#include "mmapMetaData.h"
+#include "mmapGenome.h"
+extern "C" {
+#include "sonLibTree.h"
+}
+
+using namespace hal;
+using namespace std;
+
+/** Hold a mutex for the lifetime of the object */
+class MMapScopedLock
+{
+public:
+   MMapScopedLock(pthread_mutex_t* mutex) : _mutex(mutex)
+   {
+     pthread_mutex_lock(_mutex);
+   }
+   ~MMapScopedLock()
+   {
+     pthread_mutex_unlock(_mutex);
+   }
+private:
+   pthread_mutex_t* _mutex;
+};
+
+MMapAlignment::MMapAlignment() :
+  _metaData(NULL),
+  _tree(NULL)
+{
+  pthread_mutex_init(&_mutex, NULL);
+}
+
+MMapAlignment::~MMapAlignment()
+{
+  close();
+  pthread_mutex_destroy(&_mutex);
+}
+
+void MMapAlignment::throwReadOnly(const string& method) const
+{
+  throw hal_exception("MMapAlignment::" + method + ": mmap HAL files are "
+                      "read-only.  Convert to HDF5 (halExtract) to edit");
+}
+
+void MMapAlignment::createNew(const string& alignmentPath)
+{
+  throwReadOnly("createNew");
+}
+
+void MMapAlignment::open(const string& alignmentPath, bool readOnly)
+{
+  if (readOnly == false)
+  {
+    throwReadOnly("open");
+  }
+  open(alignmentPath);
+}
+
+void MMapAlignment::open(const string& alignmentPath) const
+{
+  close();
+  _file.open(alignmentPath);
+  const MMapHeader* header = _file.getHeader();
+  _metaData = new MMapMetaData(&_file, header->_metaOffset,
+                               header->_metaLength);
+  _genomeRecordMap.clear();
+  for (hal_size_t i = 0; i < header->_numGenomes; ++i)
+  {
+    const MMapGenomeRecord* record = _file.getGenomeRecord(i);
+    _genomeRecordMap.insert(pair<string, hal_size_t>(
+                              _file.getString(record->_nameOffset,
+                                              record->_nameLength), i));
+  }
+  loadTree();
+  if (!compatibleWithVersion(getVersion()))
+  {
+    stringstream ss;
+    ss << "HAL API v" << HAL_VERSION << " incompatible with format v"
+       << getVersion() << " HAL file.";
+    close();
+    throw hal_exception(ss.str());
+  }
+}
+
+void MMapAlignment::close()
+{
+  const_cast<const MMapAlignment*>(this)->close();
+}
+
+// nothing is ever written so both closes are the same
+void MMapAlignment::close() const
+{
+  map<string, MMapGenome*>::iterator mapIt;
+  for (mapIt = _openGenomes.begin(); mapIt != _openGenomes.end(); ++mapIt)
+  {
+    delete mapIt->second;
+  }
+  _openGenomes.clear();
+  if (_tree != NULL)
+  {
+    stTree_destruct(_tree);
+    _tree = NULL;
+  }
+  _nodeMap.clear();
+  _genomeRecordMap.clear();
+  delete _metaData;
+  _metaData = NULL;
+  _file.close();
+}
+
+void MMapAlignment::setOptionsFromParser(CLParserConstPtr parser) const
+{
+  // there are no cache or compression options to apply: the OS
+  // page cache does everything.
+  if (parser->hasFlag("perfStats") && parser->getFlag("perfStats"))
+  {
+    PerfStats::printAtExit();
+  }
+}
+
+Genome* MMapAlignment::addLeafGenome(const string& name,
+                                     const string& parentName,
+                                     double branchLength)
+{
+  throwReadOnly("addLeafGenome");
+  return NULL;
+}
+
+Genome* MMapAlignment::addRootGenome(const string& name,
+                                     double branchLength)
+{
+  throwReadOnly("addRootGenome");
+  return NULL;
+}
+
+void MMapAlignment::removeGenome(const string& name)
+{
+  throwReadOnly("removeGenome");
+}
+
+Genome* MMapAlignment::insertGenome(const string& name,
+                                    const string& parentName,
+                                    const string& childName,
+                                    double upperBranchLength)
+{
+  throwReadOnly("insertGenome");
+  return NULL;
+}
+
+const Genome* MMapAlignment::openGenome(const string& name) const
+{
+  MMapScopedLock lock(&_mutex);
+  map<string, MMapGenome*>::iterator mapit = _openGenomes.find(name);
+  if (mapit != _openGenomes.end())
+  {
+    return mapit->second;
+  }
+  MMapGenome* genome = NULL;
+  map<string, hal_size_t>::const_iterator recIt =
+     _genomeRecordMap.find(name);
+  if (recIt != _genomeRecordMap.end())
+  {
+    genome = new MMapGenome(name, const_cast<MMapAlignment*>(this),
+                            _file.getGenomeRecord(recIt->second));
+    _openGenomes.insert(pair<string, MMapGenome*>(name, genome));
+  }
+  return genome;
+}
+
+Genome* MMapAlignment::openGenome(const string& name)
+{
+  const MMapAlignment* constThis = this;
+  return const_cast<Genome*>(constThis->openGenome(name));
+}
+
+void MMapAlignment::closeGenome(const Genome* genome) const
+{
+  MMapScopedLock lock(&_mutex);
+  string name = genome->getName();
+  map<string, MMapGenome*>::iterator mapIt = _openGenomes.find(name);
+  if (mapIt == _openGenomes.end())
+  {
+    throw hal_exception("Attempt to close non-open genome.  "
+                        "Should not even be possible");
+  }
+  delete mapIt->second;
+  _openGenomes.erase(mapIt);
+
+  // reset the parent/child genome caches (which store genome pointers to
+  // the genome we're closing
+  if (name != getRootName())
+  {
+    mapIt = _openGenomes.find(getParentName(name));
+    if (mapIt != _openGenomes.end())
+    {
+      mapIt->second->resetBranchCaches();
+    }
+  }
+  vector<string> childNames = getChildNames(name);
+  for (size_t i = 0; i < childNames.size(); ++i)
+  {
+    mapIt = _openGenomes.find(childNames[i]);
+    if (mapIt != _openGenomes.end())
+    {
+      mapIt->second->resetBranchCaches();
+    }
+  }
+}
+
+string MMapAlignment::getRootName() const
+{
+  if (_tree == NULL)
+  {
+    throw hal_exception("Can't get root name of empty tree");
+  }
+  return stTree_getLabel(_tree);
+}
+
+string MMapAlignment::getParentName(const string& name) const
+{
+  map<string, stTree*>::iterator findIt = _nodeMap.find(name);
+  if (findIt == _nodeMap.end())
+  {
+    throw hal_exception(string("node not found: ") + name);
+  }
+  stTree* node = findIt->second;
+  stTree* parent = stTree_getParent(node);
+  if (parent == NULL)
+  {
+    return "";
+  }
+  return stTree_getLabel(parent);
+}
+
+void MMapAlignment::updateBranchLength(const string& parentName,
+                                       const string& childName,
+                                       double length)
+{
+  throwReadOnly("updateBranchLength");
+}
+
+double MMapAlignment::getBranchLength(const string& parentName,
+                                      const string& childName) const
+{
+  map<string, stTree*>::iterator findIt = _nodeMap.find(childName);
+  if (findIt == _nodeMap.end())
+  {
+    throw hal_exception(string("node ") + childName + " not found");
+  }
+  stTree* node = findIt->second;
+  stTree* parent = stTree_getParent(node);
+  if (parent == NULL || parentName != stTree_getLabel(parent))
+  {
+    throw hal_exception(string("edge ") + parentName + "--" + childName +
+                        " not found");
+  }
+  return stTree_getBranchLength(node);
+}
+
+vector<string> MMapAlignment::getChildNames(const string& name) const
+{
+  map<string, stTree*>::iterator findIt = _nodeMap.find(name);
+  if (findIt == _nodeMap.end())
+  {
+    throw hal_exception(string("node ") + name + " not found");
+  }
+  stTree* node = findIt->second;
+  int32_t numChildren = stTree_getChildNumber(node);
+  vector<string> childNames(numChildren);
+  for (int32_t i = 0; i < numChildren; ++i)
+  {
+    childNames[i] = stTree_getLabel(stTree_getChild(node, i));
+  }
+  return childNames;
+}
+
+vector<string> MMapAlignment::getLeafNamesBelow(const string& name) const
+{
+  vector<string> leaves;
+  vector<string> children;
+  deque<string> bfQueue;
+  bfQueue.push_front(name);
+  while (bfQueue.empty() == false)
+  {
+    string& current = bfQueue.back();
+    children = getChildNames(current);
+    if (children.empty() == true && current != name)
+    {
+      leaves.push_back(current);
+    }
+    for (size_t i = 0; i < children.size(); ++i)
+    {
+      bfQueue.push_front(children[i]);
+    }
+    bfQueue.pop_back();
+  }
+  return leaves;
+}
+
+hal_size_t MMapAlignment::getNumGenomes() const
+{
+  return _nodeMap.size();
+}
+
+MetaData* MMapAlignment::getMetaData()
+{
+  return _metaData;
+}
+
+const MetaData* MMapAlignment::getMetaData() const
+{
+  return _metaData;
+}
+
+string MMapAlignment::getNewickTree() const
+{
+  if (_tree == NULL || _nodeMap.empty() == true)
+  {
+    return "";
+  }
+  char* treeString = stTree_getNewickTreeString(_tree);
+  string returnString(treeString);
+  free(treeString);
+  return returnString;
+}
+
+string MMapAlignment::getVersion() const
+{
+  const MMapHeader* header = _file.getHeader();
+  return _file.getString(header->_versionOffset, header->_versionLength);
+}
+
+static void addNodeToMap(stTree* node, map<string, stTree*>& nodeMap)
+{
+  const char* label = stTree_getLabel(node);
+  assert(label != NULL);
+  string name(label);
+  assert(nodeMap.find(name) == nodeMap.end());
+  nodeMap.insert(pair<string, stTree*>(name, node));
+  int32_t numChildren = stTree_getChildNumber(node);
+  for (int32_t i = 0; i < numChildren; ++i)
+  {
+    addNodeToMap(stTree_getChild(node, i), nodeMap);
+  }
+}
+
+void MMapAlignment::loadTree() const
+{
+  _nodeMap.clear();
+  const MMapHeader* header = _file.getHeader();
+  string treeString = _file.getString(header->_treeOffset,
+                                      header->_treeLength);
+  if (_tree != NULL)
+  {
+    stTree_destruct(_tree);
+  }
+  if (treeString.empty() == true)
+  {
+    _tree = stTree_construct();
+  }
+  else
+  {
+    _tree = stTree_parseNewickString(const_cast<char*>(treeString.c_str()));
+    addNodeToMap(_tree, _nodeMap);
+  }
+}
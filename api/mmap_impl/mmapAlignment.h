@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _MMAPALIGNMENT_H
+#define _MMAPALIGNMENT_H
+
+#include <map>
+#include <pthread.h>
+#include "halAlignment.h"
+#include "halAlignmentInstance.h"
+#include "mmapFile.h"
+
+typedef struct _stTree stTree;
+
+namespace hal {
+
+class MMapGenome;
+class MMapMetaData;
+
+/**
+ * Read-only implementation of hal::Alignment on top of a memory-mapped
+ * file (see mmapFile.h for the format).  Segment and DNA accesses are
+ * pointer dereferences into the mapping, so there is no decompression or
+ * copying and the OS page cache is shared between all processes reading
+ * the same file.  Any attempt to modify the alignment throws an
+ * exception.  Files are created from any other alignment with
+ * writeMMapAlignment().  
+ *
+ * Since nothing is ever written, a single open alignment can be shared
+ * by several threads (each using its own iterators): the only lazily
+ * built state, the table of open genomes, is protected by a mutex.
+ * Genomes must not be closed while other threads are using them.
+ */
+class MMapAlignment : public Alignment
+{
+public:
+
+   ~MMapAlignment();
+
+   void createNew(const std::string& alignmentPath);
+   void open(const std::string& alignmentPath,
+             bool readOnly);
+   void open(const std::string& alignmentPath) const;
+   void close();
+   void close() const;
+   void setOptionsFromParser(CLParserConstPtr parser) const;
+
+   Genome* addLeafGenome(const std::string& name,
+                           const std::string& parentName,
+                           double branchLength);
+
+   Genome* addRootGenome(const std::string& name,
+                           double branchLength);
+
+   void removeGenome(const std::string& name);
+
+   Genome* insertGenome(const std::string& name,
+                        const std::string& parentName,
+                        const std::string& childName,
+                        double upperBranchLength);
+
+   const Genome* openGenome(const std::string& name) const;
+
+   Genome* openGenome(const std::string& name);
+
+   void closeGenome(const Genome* genome) const;
+
+   std::string getRootName() const;
+
+   std::string getParentName(const std::string& name) const;
+
+   void updateBranchLength(const std::string& parentName,
+                           const std::string& childName,
+                           double length);
+
+   double getBranchLength(const std::string& parentName,
+                          const std::string& childName) const;
+
+   std::vector<std::string>
+   getChildNames(const std::string& name) const;
+
+   std::vector<std::string>
+   getLeafNamesBelow(const std::string& name) const;
+
+   hal_size_t getNumGenomes() const;
+
+   MetaData* getMetaData();
+
+   const MetaData* getMetaData() const;
+
+   std::string getNewickTree() const;
+
+   std::string getVersion() const;
+
+   // MMAP SPECIFIC
+   const MMapFile* getFile() const;
+
+protected:
+   // Nobody creates this class except through the interface.
+   friend AlignmentConstPtr mmapAlignmentInstanceReadOnly();
+
+   MMapAlignment();
+
+   void loadTree() const;
+   void throwReadOnly(const std::string& method) const;
+
+protected:
+
+   mutable MMapFile _file;
+   mutable MMapMetaData* _metaData;
+   mutable stTree* _tree;
+   mutable std::map<std::string, stTree*> _nodeMap;
+   mutable std::map<std::string, hal_size_t> _genomeRecordMap;
+   mutable std::map<std::string, MMapGenome*> _openGenomes;
+   mutable pthread_mutex_t _mutex;
+};
+
+inline const MMapFile* MMapAlignment::getFile() const
+{
+  return &_file;
+}
+
+}
+#endif
@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include <string>
+#include <iostream>
+#include "mmapBottomSegment.h"
+#include "mmapTopSegment.h"
+#include "mmapDNAIterator.h"
+
+using namespace std;
+using namespace hal;
+
+MMapBottomSegment::MMapBottomSegment(MMapGenome* genome, hal_index_t index) :
+  _genome(genome),
+  _index(index)
+{
+
+}
+
+MMapBottomSegment::~MMapBottomSegment()
+{
+  
+}
+
+void MMapBottomSegment::setCoordinates(hal_index_t startPos, 
+                                       hal_size_t length)
+{
+  _genome->throwReadOnly("BottomSegment::setCoordinates");
+}
+
+void MMapBottomSegment::setChildIndex(hal_size_t i, hal_index_t childIndex)
+{
+  _genome->throwReadOnly("BottomSegment::setChildIndex");
+}
+
+void MMapBottomSegment::setChildReversed(hal_size_t i, bool isReversed)
+{
+  _genome->throwReadOnly("BottomSegment::setChildReversed");
+}
+
+void MMapBottomSegment::setTopParseIndex(hal_index_t parseIndex)
+{
+  _genome->throwReadOnly("BottomSegment::setTopParseIndex");
+}
+
+hal_offset_t MMapBottomSegment::getTopParseOffset() const
+{
+  assert(_index >= 0);
+  hal_offset_t offset = 0;
+  hal_index_t topIndex = getTopParseIndex();
+  if (topIndex != NULL_INDEX)
+  {
+    hal_index_t topStart = _genome->getTopData(topIndex)->_start;
+    assert(topStart <= getStartPosition());
+    offset = getStartPosition() - topStart;
+  }
+  return offset;
+}
+
+void MMapBottomSegment::getString(string& outString) const
+{
+  MMapDNAIterator di(_genome, getStartPosition());
+  di.readString(outString, getLength()); 
+}
+
+bool MMapBottomSegment::isMissingData(double nThreshold) const
+{
+  if (nThreshold >= 1.0)
+  {
+    return false;
+  }  
+  MMapDNAIterator di(_genome, getStartPosition());
+  size_t length = getLength();
+  size_t maxNs = nThreshold * (double)length;
+  size_t Ns = 0;
+  char c;
+  for (size_t i = 0; i < length; ++i, di.toRight())
+  {
+    c = di.getChar();
+    if (c == 'N' || c == 'n')
+    {
+      ++Ns;
+    }
+    if (Ns > maxNs)
+    {
+      return true;
+    }
+    if ((length - i) < (maxNs - Ns))
+    {
+      break;
+    }
+  }
+  return false;
+}
+
+void MMapBottomSegment::print(std::ostream& os) const
+{
+  os << "MMap Bottom Segment";
+}
@@ -0,0 +1,264 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _MMAPBOTTOMSEGMENT_H
+#define _MMAPBOTTOMSEGMENT_H
+
+#include <cassert>
+#include "halBottomSegment.h"
+#include "halCommon.h"
+#include "mmapGenome.h"
+
+namespace hal {
+
+class MMapBottomSegment : public BottomSegment
+{
+public:
+
+   /** Constructor 
+    * @param genome Genome to which segment belongs
+    * @param index Index of segment in the genome's bottom array */
+   MMapBottomSegment(MMapGenome* genome, hal_index_t index);
+
+   /** Destructor */
+   ~MMapBottomSegment();
+
+   // SEGMENT INTERFACE
+   void setArrayIndex(Genome* genome, hal_index_t arrayIndex);
+   void setArrayIndex(const Genome* genome, hal_index_t arrayIndex) const;
+   const Genome* getGenome() const;
+   Genome* getGenome();
+   const Sequence* getSequence() const;
+   Sequence* getSequence();
+   hal_index_t getStartPosition() const;
+   hal_index_t getEndPosition() const;
+   hal_size_t getLength() const;
+   void getString(std::string& outString) const;
+   void setCoordinates(hal_index_t startPos, hal_size_t length);
+   hal_index_t getArrayIndex() const;
+   bool leftOf(hal_index_t genomePos) const;
+   bool rightOf(hal_index_t genomePos) const;
+   bool overlaps(hal_index_t genomePos) const;
+   bool isFirst() const;
+   bool isLast() const;
+   bool isMissingData(double nThreshold) const;
+   bool isTop() const;
+   hal_size_t getMappedSegments(
+     std::set<MappedSegmentConstPtr>& outSegments,
+     const Genome* tgtGenome,
+     const std::set<const Genome*>* genomesOnPath,
+     bool doDupes,
+     hal_size_t minLength,
+     const Genome *coalescenceLimit,
+     const Genome *mrca) const;
+   void print(std::ostream& os) const;
+
+   // BOTTOM SEGMENT INTERFACE
+   hal_size_t getNumChildren() const;
+   hal_index_t getChildIndex(hal_size_t i) const;
+   hal_index_t getChildIndexG(const Genome* childGenome) const;
+   bool hasChild(hal_size_t child) const;
+   bool hasChildG(const Genome* childGenome) const;
+   void setChildIndex(hal_size_t i, hal_index_t childIndex);
+   bool getChildReversed(hal_size_t i) const;
+   void setChildReversed(hal_size_t child, bool isReversed);
+   hal_index_t getTopParseIndex() const;
+   void setTopParseIndex(hal_index_t parseIndex);
+   hal_offset_t getTopParseOffset() const;
+   bool hasParseUp() const;
+   hal_index_t getLeftChildIndex(hal_size_t i) const;
+   hal_index_t getRightChildIndex(hal_size_t i) const;
+
+private:
+
+   const MMapBottomSegmentData* data() const;
+   const MMapChildData* childData(hal_index_t index, hal_size_t i) const;
+
+   mutable MMapGenome* _genome;
+   mutable hal_index_t _index;
+};
+
+//INLINE members
+inline const MMapBottomSegmentData* MMapBottomSegment::data() const
+{
+  return _genome->getBottomData(_index);
+}
+
+inline const MMapChildData* 
+MMapBottomSegment::childData(hal_index_t index, hal_size_t i) const
+{
+  assert(i < _genome->getNumChildren());
+  return reinterpret_cast<const MMapChildData*>(
+    _genome->getBottomData(index) + 1) + i;
+}
+
+inline void MMapBottomSegment::setArrayIndex(Genome* genome, 
+                                             hal_index_t arrayIndex)
+{
+  _genome = dynamic_cast<MMapGenome*>(genome);
+  assert(_genome != NULL);
+  _index = arrayIndex;
+}
+
+inline void MMapBottomSegment::setArrayIndex(const Genome* genome, 
+                                             hal_index_t arrayIndex) const
+{
+  const MMapGenome* mmGenome = dynamic_cast<const MMapGenome*>(genome);
+  assert(mmGenome != NULL);
+  _genome = const_cast<MMapGenome*>(mmGenome);
+  _index = arrayIndex;
+}
+
+inline hal_index_t MMapBottomSegment::getStartPosition() const
+{
+  assert(_index >= 0);
+  return data()->_start;
+}
+
+inline hal_index_t MMapBottomSegment::getEndPosition() const
+{
+  assert(_index >= 0);
+  return getStartPosition() + (hal_index_t)(getLength() - 1);
+}
+
+inline hal_size_t MMapBottomSegment::getLength() const
+{
+  assert(_index >= 0);
+  return _genome->getBottomData(_index + 1)->_start - data()->_start;
+}
+
+inline const Genome* MMapBottomSegment::getGenome() const
+{                                               
+  return _genome;
+}
+
+inline Genome* MMapBottomSegment::getGenome()
+{
+  return _genome;
+}
+
+inline const Sequence* MMapBottomSegment::getSequence() const
+{
+  return _genome->getSequenceBySite(getStartPosition());
+}
+
+inline Sequence* MMapBottomSegment::getSequence()
+{
+  return _genome->getSequenceBySite(getStartPosition());
+}
+
+inline hal_size_t MMapBottomSegment::getNumChildren() const
+{
+  return _genome->getNumChildren();
+}
+
+inline hal_index_t MMapBottomSegment::getChildIndex(hal_size_t i) const
+{
+  assert(_index >= 0);
+  return childData(_index, i)->_childIndex;
+}
+
+inline 
+hal_index_t MMapBottomSegment::getChildIndexG(const Genome* childGenome) const
+{
+  assert(_index >= 0);
+  return getChildIndex(_genome->getChildIndex(childGenome));
+}
+
+inline bool MMapBottomSegment::hasChild(hal_size_t i) const
+{
+  return getChildIndex(i) != NULL_INDEX;
+}
+
+inline bool MMapBottomSegment::hasChildG(const Genome* childGenome) const
+{
+  return getChildIndexG(childGenome) != NULL_INDEX;
+}
+
+inline bool MMapBottomSegment::getChildReversed(hal_size_t i) const
+{
+  assert(_index >= 0);
+  return childData(_index, i)->_reversed != 0;
+}
+
+inline hal_index_t MMapBottomSegment::getTopParseIndex() const
+{
+  assert(_index >= 0);
+  return data()->_topParseIndex;
+}
+
+inline bool MMapBottomSegment::hasParseUp() const
+{
+  return getTopParseIndex() != NULL_INDEX;
+}
+  
+inline hal_index_t MMapBottomSegment::getArrayIndex() const
+{
+  return _index;
+}
+
+inline bool MMapBottomSegment::leftOf(hal_index_t genomePos) const
+{
+  return getEndPosition() < genomePos;
+}
+
+inline bool MMapBottomSegment::rightOf(hal_index_t genomePos) const
+{
+  return getStartPosition() > genomePos;
+}
+
+inline bool MMapBottomSegment::overlaps(hal_index_t genomePos) const
+{
+  return !leftOf(genomePos) && !rightOf(genomePos);
+}
+
+inline bool MMapBottomSegment::isFirst() const
+{
+  assert(getSequence() != NULL);
+  return _index == 0 || 
+     _index == (hal_index_t)getSequence()->getBottomSegmentArrayIndex();
+}
+
+inline bool MMapBottomSegment::isLast() const
+{
+  assert(getSequence() != NULL);
+  return _index == (hal_index_t)_genome->getNumBottomSegments() || 
+     _index == getSequence()->getBottomSegmentArrayIndex() +
+     (hal_index_t)getSequence()->getNumBottomSegments() - 1;
+}
+
+inline bool MMapBottomSegment::isTop() const
+{
+  return false;
+}
+
+inline hal_size_t MMapBottomSegment::getMappedSegments(
+  std::set<MappedSegmentConstPtr>& outSegments,
+  const Genome* tgtGenome,
+  const std::set<const Genome*>* genomesOnPath,
+  bool doDupes,
+  hal_size_t minLength,
+  const Genome *coalescenceLimit,
+  const Genome *mrca) const
+{
+  throw hal_exception("Internal error.   MMap Segment interface should "
+                      "at some point go through the sliced segment");
+}
+
+inline hal_index_t MMapBottomSegment::getLeftChildIndex(hal_size_t i) const
+{
+  assert(isFirst() == false);
+  return childData(_index - 1, i)->_childIndex;
+}
+
+inline hal_index_t MMapBottomSegment::getRightChildIndex(hal_size_t i) const
+{
+  assert(isLast() == false);
+  return childData(_index + 1, i)->_childIndex;
+}
+
+}
+#endif
@@ -0,0 +1,24 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include "mmapDNAIterator.h"
+
+using namespace std;
+using namespace hal;
+
+MMapDNAIterator::MMapDNAIterator(const MMapGenome* genome, 
+                                 hal_index_t index) :
+  _index(index),
+  _genome(genome),
+  _reversed(false)
+{
+
+}
+
+MMapDNAIterator::~MMapDNAIterator()
+{
+
+}
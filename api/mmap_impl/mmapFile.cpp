@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include <cassert>
+#include <cstring>
+#include <cerrno>
+#include <fstream>
+#include <sstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "halCommon.h"
+#include "mmapFile.h"
+
+using namespace std;
+using namespace hal;
+
+const char MMapFile::Magic[8] = {'H', 'A', 'L', 'M', 'M', 'A', 'P', '\0'};
+const hal_size_t MMapFile::FormatVersion = 1;
+const hal_size_t MMapFile::PageSize = 4096;
+
+MMapFile::MMapFile() :
+  _base(NULL),
+  _size(0)
+{
+
+}
+
+MMapFile::~MMapFile()
+{
+  close();
+}
+
+void MMapFile::open(const string& path)
+{
+  close();
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    throw hal_exception("Unable to open " + path + ": " + strerror(errno));
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (hal_size_t)st.st_size < sizeof(MMapHeader))
+  {
+    ::close(fd);
+    throw hal_exception("Unable to read mmap HAL header from " + path);
+  }
+  void* base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  // the mapping stays valid after the descriptor is closed
+  ::close(fd);
+  if (base == MAP_FAILED)
+  {
+    throw hal_exception("Unable to mmap " + path + ": " + strerror(errno));
+  }
+  _base = static_cast<char*>(base);
+  _size = st.st_size;
+  _path = path;
+
+  const MMapHeader* header = getHeader();
+  if (memcmp(header->_magic, Magic, sizeof(Magic)) != 0)
+  {
+    close();
+    throw hal_exception(path + " is not a mmap HAL file");
+  }
+  if (header->_formatVersion != FormatVersion || header->_fileSize != _size)
+  {
+    stringstream ss;
+    ss << "mmap HAL file " << path << " has format version "
+       << header->_formatVersion << " and size " << header->_fileSize
+       << " but expected version " << FormatVersion << " and size "
+       << _size << ". The file is incompatible or truncated.";
+    close();
+    throw hal_exception(ss.str());
+  }
+}
+
+void MMapFile::close()
+{
+  if (_base != NULL)
+  {
+    munmap(_base, _size);
+    _base = NULL;
+    _size = 0;
+  }
+}
+
+void MMapFile::getMap(hal_size_t offset, hal_size_t length,
+                      map<string, string>& outMap) const
+{
+  outMap.clear();
+  const char* pos = getPointer(offset);
+  const char* end = pos + length;
+  while (pos < end)
+  {
+    string key(pos);
+    pos += key.length() + 1;
+    assert(pos < end);
+    string value(pos);
+    pos += value.length() + 1;
+    outMap.insert(pair<string, string>(key, value));
+  }
+}
+
+bool MMapFile::isMMapFile(const string& path)
+{
+  ifstream file(path.c_str(), ios::binary);
+  char magic[sizeof(Magic)];
+  if (!file.read(magic, sizeof(magic)))
+  {
+    return false;
+  }
+  return memcmp(magic, Magic, sizeof(Magic)) == 0;
+}
+
+string MMapFile::writeMap(const map<string, string>& inMap)
+{
+  string buffer;
+  map<string, string>::const_iterator i;
+  for (i = inMap.begin(); i != inMap.end(); ++i)
+  {
+    buffer.append(i->first);
+    buffer.push_back('\0');
+    buffer.append(i->second);
+    buffer.push_back('\0');
+  }
+  return buffer;
+}
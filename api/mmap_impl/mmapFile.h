@@ -0,0 +1,191 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _MMAPFILE_H
+#define _MMAPFILE_H
+
+#include <string>
+#include <map>
+#include "halDefs.h"
+
+namespace hal {
+
+/**
+ * On-disk layout of a memory-mapped HAL file.  Everything is stored
+ * uncompressed in native byte order, and every array begins on a page
+ * boundary so that it can be addressed directly in the mapping.  The
+ * first page holds the header, which is followed by the genome table
+ * and then the per-genome arrays.  All offsets are in bytes from the
+ * beginning of the file.
+ *
+ * Segment arrays have one extra (sentinel) record at the end whose
+ * start coordinate is the genome length, just like the HDF5 arrays,
+ * so that segment lengths can be computed as the difference between
+ * two consecutive starts.  DNA is packed two bases per byte as in
+ * HDF5DNA.
+ */
+struct MMapHeader
+{
+   char _magic[8];
+   hal_size_t _formatVersion;
+   hal_size_t _numGenomes;
+   hal_size_t _genomeTableOffset;
+   hal_size_t _treeOffset;
+   hal_size_t _treeLength;
+   hal_size_t _metaOffset;
+   hal_size_t _metaLength;
+   hal_size_t _versionOffset;
+   hal_size_t _versionLength;
+   hal_size_t _fileSize;
+};
+
+struct MMapGenomeRecord
+{
+   hal_size_t _nameOffset;
+   hal_size_t _nameLength;
+   hal_size_t _sequenceLength;
+   hal_size_t _numChildren;
+   hal_size_t _numSequences;
+   hal_size_t _sequenceOffset;
+   hal_size_t _numTopSegments;
+   hal_size_t _topOffset;
+   hal_size_t _numBottomSegments;
+   hal_size_t _bottomOffset;
+   hal_size_t _dnaOffset;
+   hal_size_t _dnaLength;
+   hal_size_t _metaOffset;
+   hal_size_t _metaLength;
+};
+
+struct MMapSequenceRecord
+{
+   hal_size_t _nameOffset;
+   hal_size_t _nameLength;
+   hal_size_t _start;
+   hal_size_t _length;
+   hal_size_t _topSegmentArrayIndex;
+   hal_size_t _numTopSegments;
+   hal_size_t _bottomSegmentArrayIndex;
+   hal_size_t _numBottomSegments;
+};
+
+struct MMapTopSegmentData
+{
+   hal_index_t _start;
+   hal_index_t _bottomParseIndex;
+   hal_index_t _nextParalogyIndex;
+   hal_index_t _parentIndex;
+   hal_index_t _parentReversed;
+};
+
+/** Bottom segments are variable length: this header is followed by
+ * one MMapChildData for each child genome */
+struct MMapBottomSegmentData
+{
+   hal_index_t _start;
+   hal_index_t _topParseIndex;
+};
+
+struct MMapChildData
+{
+   hal_index_t _childIndex;
+   hal_index_t _reversed;
+};
+
+/**
+ * Read-only memory mapping of a file in the format described above.
+ */
+class MMapFile
+{
+public:
+
+   MMapFile();
+   ~MMapFile();
+
+   /** Map a file into memory (throws if it isn't in mmap format) */
+   void open(const std::string& path);
+   void close();
+   bool isOpen() const;
+
+   const MMapHeader* getHeader() const;
+   const MMapGenomeRecord* getGenomeRecord(hal_size_t i) const;
+
+   /** Get a pointer into the mapping at the given file offset */
+   const char* getPointer(hal_size_t offset) const;
+
+   std::string getString(hal_size_t offset, hal_size_t length) const;
+
+   /** Read a block written by writeMap() */
+   void getMap(hal_size_t offset, hal_size_t length,
+               std::map<std::string, std::string>& outMap) const;
+
+   /** Quick check of the magic number at the beginning of a file */
+   static bool isMMapFile(const std::string& path);
+
+   /** Encode a string map as a sequence of null-terminated
+    * key, value strings */
+   static std::string writeMap(const std::map<std::string, std::string>&
+                               inMap);
+
+   /** Round an offset up to the next page boundary */
+   static hal_size_t pageAlign(hal_size_t offset);
+
+   static size_t bottomRecordSize(hal_size_t numChildren);
+
+   static const char Magic[8];
+   static const hal_size_t FormatVersion;
+   static const hal_size_t PageSize;
+
+protected:
+
+   std::string _path;
+   char* _base;
+   hal_size_t _size;
+
+private:
+   MMapFile(const MMapFile&);
+   MMapFile& operator=(const MMapFile&);
+};
+
+inline bool MMapFile::isOpen() const
+{
+  return _base != NULL;
+}
+
+inline const MMapHeader* MMapFile::getHeader() const
+{
+  return reinterpret_cast<const MMapHeader*>(_base);
+}
+
+inline const MMapGenomeRecord* MMapFile::getGenomeRecord(hal_size_t i) const
+{
+  return reinterpret_cast<const MMapGenomeRecord*>(
+    _base + getHeader()->_genomeTableOffset) + i;
+}
+
+inline const char* MMapFile::getPointer(hal_size_t offset) const
+{
+  return _base + offset;
+}
+
+inline std::string MMapFile::getString(hal_size_t offset,
+                                       hal_size_t length) const
+{
+  return std::string(_base + offset, length);
+}
+
+inline hal_size_t MMapFile::pageAlign(hal_size_t offset)
+{
+  return ((offset + PageSize - 1) / PageSize) * PageSize;
+}
+
+inline size_t MMapFile::bottomRecordSize(hal_size_t numChildren)
+{
+  return sizeof(MMapBottomSegmentData) + numChildren * sizeof(MMapChildData);
+}
+
+}
+#endif
@@ -0,0 +1,451 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include <cassert>
+#include <iostream>
+#include <sstream>
+#include "halCommon.h"
+#include "halPerfStats.h"
+#include "mmapGenome.h"
+#include "mmapAlignment.h"
+#include "mmapMetaData.h"
+#include "mmapTopSegment.h"
+#include "mmapBottomSegment.h"
+#include "mmapSequence.h"
+#include "mmapSequenceIterator.h"
+#include "mmapDNAIterator.h"
+#include "defaultTopSegmentIterator.h"
+#include "defaultBottomSegmentIterator.h"
+#include "defaultColumnIterator.h"
+#include "defaultRearrangement.h"
+#include "defaultGappedTopSegmentIterator.h"
+#include "defaultGappedBottomSegmentIterator.h"
+
+using namespace hal;
+using namespace std;
+
+MMapGenome::MMapGenome(const string& name,
+                       MMapAlignment* alignment,
+                       const MMapGenomeRecord* record) :
+  _alignment(alignment),
+  _file(alignment->getFile()),
+  _record(record),
+  _name(name),
+  _bottomRecordSize(MMapFile::bottomRecordSize(record->_numChildren)),
+  _parentCache(NULL)
+{
+  _metaData = new MMapMetaData(_file, _record->_metaOffset,
+                               _record->_metaLength);
+  _topArray = reinterpret_cast<const MMapTopSegmentData*>(
+    _file->getPointer(_record->_topOffset));
+  _bottomArray = _file->getPointer(_record->_bottomOffset);
+  _dnaArray = _file->getPointer(_record->_dnaOffset);
+  _childCache.assign(_record->_numChildren, NULL);
+
+  // the sequence table is small so we wrap all of it up front.  the
+  // position map is keyed on end coordinate (as in HDF5Genome)
+  const MMapSequenceRecord* seqRecords =
+     reinterpret_cast<const MMapSequenceRecord*>(
+       _file->getPointer(_record->_sequenceOffset));
+  _sequences.resize(_record->_numSequences);
+  for (hal_size_t i = 0; i < _record->_numSequences; ++i)
+  {
+    const MMapSequenceRecord* seqRecord = seqRecords + i;
+    string seqName = _file->getString(seqRecord->_nameOffset,
+                                      seqRecord->_nameLength);
+    MMapSequence* seq = new MMapSequence(this, seqRecord, i, seqName);
+    _sequences[i] = seq;
+    _sequenceNameMap.insert(pair<string, MMapSequence*>(seqName, seq));
+    if (seqRecord->_length > 0)
+    {
+      _sequencePosMap.insert(pair<hal_size_t, MMapSequence*>(
+                               seqRecord->_start + seqRecord->_length, seq));
+    }
+  }
+}
+
+MMapGenome::~MMapGenome()
+{
+  delete _metaData;
+  for (size_t i = 0; i < _sequences.size(); ++i)
+  {
+    delete _sequences[i];
+  }
+}
+
+void MMapGenome::throwReadOnly(const string& method) const
+{
+  throw hal_exception("Cannot call " + method + " on genome " + _name +
+                      ": mmap HAL files are read-only");
+}
+
+//GENOME INTERFACE
+
+void MMapGenome::setDimensions(
+  const vector<Sequence::Info>& sequenceDimensions,
+  bool storeDNAArrays)
+{
+  throwReadOnly("setDimensions");
+}
+
+void MMapGenome::updateTopDimensions(
+  const vector<Sequence::UpdateInfo>& topDimensions)
+{
+  throwReadOnly("updateTopDimensions");
+}
+
+void MMapGenome::updateBottomDimensions(
+  const vector<Sequence::UpdateInfo>& bottomDimensions)
+{
+  throwReadOnly("updateBottomDimensions");
+}
+
+hal_size_t MMapGenome::getNumSequences() const
+{
+  return _sequences.size();
+}
+
+Sequence* MMapGenome::getSequence(const string& name)
+{
+  map<string, MMapSequence*>::iterator mapIt = _sequenceNameMap.find(name);
+  return mapIt != _sequenceNameMap.end() ? mapIt->second : NULL;
+}
+
+const Sequence* MMapGenome::getSequence(const string& name) const
+{
+  map<string, MMapSequence*>::const_iterator mapIt =
+     _sequenceNameMap.find(name);
+  return mapIt != _sequenceNameMap.end() ? mapIt->second : NULL;
+}
+
+Sequence* MMapGenome::getSequenceBySite(hal_size_t position)
+{
+  const MMapGenome* constThis = this;
+  return const_cast<Sequence*>(constThis->getSequenceBySite(position));
+}
+
+const Sequence* MMapGenome::getSequenceBySite(hal_size_t position) const
+{
+  HAL_PERF_COUNT(SequenceBySiteCalls, 1);
+  map<hal_size_t, MMapSequence*>::const_iterator i;
+  i = _sequencePosMap.upper_bound(position);
+  if (i != _sequencePosMap.end())
+  {
+    if (position >= (hal_size_t)i->second->getStartPosition())
+    {
+      assert(position < i->second->getStartPosition() +
+             i->second->getSequenceLength());
+      return i->second;
+    }
+  }
+  return NULL;
+}
+
+SequenceIteratorPtr MMapGenome::getSequenceIterator(
+  hal_index_t position)
+{
+  assert(position <= (hal_index_t)_sequences.size());
+  MMapSequenceIterator* newIt = new MMapSequenceIterator(this, position);
+  return SequenceIteratorPtr(newIt);
+}
+
+SequenceIteratorConstPtr MMapGenome::getSequenceIterator(
+  hal_index_t position) const
+{
+  assert(position <= (hal_index_t)_sequences.size());
+  // genome effectively gets re-consted when returned in the
+  // const iterator.  just save doubling up code.
+  MMapSequenceIterator* newIt = new MMapSequenceIterator(
+    const_cast<MMapGenome*>(this), position);
+  return SequenceIteratorConstPtr(newIt);
+}
+
+SequenceIteratorConstPtr MMapGenome::getSequenceEndIterator() const
+{
+  return getSequenceIterator(getNumSequences());
+}
+
+MetaData* MMapGenome::getMetaData()
+{
+  return _metaData;
+}
+
+const MetaData* MMapGenome::getMetaData() const
+{
+  return _metaData;
+}
+
+Genome* MMapGenome::getParent()
+{
+  const MMapGenome* constThis = this;
+  return const_cast<Genome*>(constThis->getParent());
+}
+
+// the branch caches are never resized after construction.  several threads
+// may fill the same entry at once, but they will all store the same 
+// pointer (openGenome() is serialized by the alignment)
+const Genome* MMapGenome::getParent() const
+{
+  if (_parentCache == NULL)
+  {
+    string parName = _alignment->getParentName(_name);
+    if (parName.empty() == false)
+    {
+      _parentCache = _alignment->openGenome(parName);
+    }
+  }
+  return _parentCache;
+}
+
+Genome* MMapGenome::getChild(hal_size_t childIdx)
+{
+  const MMapGenome* constThis = this;
+  return const_cast<Genome*>(constThis->getChild(childIdx));
+}
+
+const Genome* MMapGenome::getChild(hal_size_t childIdx) const
+{
+  assert(childIdx < _record->_numChildren);
+  if (_childCache[childIdx] == NULL)
+  {
+    vector<string> childNames = _alignment->getChildNames(_name);
+    assert(childNames.size() > childIdx);
+    _childCache[childIdx] = _alignment->openGenome(childNames.at(childIdx));
+  }
+  return _childCache[childIdx];
+}
+
+hal_size_t MMapGenome::getNumChildren() const
+{
+  return _record->_numChildren;
+}
+
+hal_index_t MMapGenome::getChildIndex(const Genome* child) const
+{
+  string childName = child->getName();
+  vector<string> childNames = _alignment->getChildNames(_name);
+  for (hal_size_t i = 0; i < childNames.size(); ++i)
+  {
+    if (childNames[i] == childName)
+    {
+      return i;
+    }
+  }
+  return NULL_INDEX;
+}
+
+bool MMapGenome::containsDNAArray() const
+{
+  return _record->_dnaLength > 0;
+}
+
+const Alignment* MMapGenome::getAlignment() const
+{
+  return _alignment;
+}
+
+// SEGMENTED SEQUENCE INTERFACE
+
+const string& MMapGenome::getName() const
+{
+  return _name;
+}
+
+hal_size_t MMapGenome::getSequenceLength() const
+{
+  return _record->_sequenceLength;
+}
+
+hal_size_t MMapGenome::getNumTopSegments() const
+{
+  return _record->_numTopSegments;
+}
+
+hal_size_t MMapGenome::getNumBottomSegments() const
+{
+  return _record->_numBottomSegments;
+}
+
+TopSegmentIteratorPtr MMapGenome::getTopSegmentIterator(hal_index_t position)
+{
+  assert(position <= (hal_index_t)getNumTopSegments());
+  MMapTopSegment* newSeg = new MMapTopSegment(this, position);
+  // ownership of newSeg is passed into newIt, whose lifespan is
+  // governed by the returned smart pointer
+  DefaultTopSegmentIterator* newIt = new DefaultTopSegmentIterator(newSeg);
+  return TopSegmentIteratorPtr(newIt);
+}
+
+TopSegmentIteratorConstPtr MMapGenome::getTopSegmentIterator(
+  hal_index_t position) const
+{
+  assert(position <= (hal_index_t)getNumTopSegments());
+  MMapGenome* genome = const_cast<MMapGenome*>(this);
+  MMapTopSegment* newSeg = new MMapTopSegment(genome, position);
+  // ownership of newSeg is passed into newIt, whose lifespan is
+  // governed by the returned smart pointer
+  DefaultTopSegmentIterator* newIt = new DefaultTopSegmentIterator(newSeg);
+  return TopSegmentIteratorConstPtr(newIt);
+}
+
+TopSegmentIteratorConstPtr MMapGenome::getTopSegmentEndIterator() const
+{
+  return getTopSegmentIterator(getNumTopSegments());
+}
+
+BottomSegmentIteratorPtr MMapGenome::getBottomSegmentIterator(
+  hal_index_t position)
+{
+  assert(position <= (hal_index_t)getNumBottomSegments());
+  MMapBottomSegment* newSeg = new MMapBottomSegment(this, position);
+  // ownership of newSeg is passed into newIt, whose lifespan is
+  // governed by the returned smart pointer
+  DefaultBottomSegmentIterator* newIt =
+     new DefaultBottomSegmentIterator(newSeg);
+  return BottomSegmentIteratorPtr(newIt);
+}
+
+BottomSegmentIteratorConstPtr MMapGenome::getBottomSegmentIterator(
+  hal_index_t position) const
+{
+  assert(position <= (hal_index_t)getNumBottomSegments());
+  MMapGenome* genome = const_cast<MMapGenome*>(this);
+  MMapBottomSegment* newSeg = new MMapBottomSegment(genome, position);
+  // ownership of newSeg is passed into newIt, whose lifespan is
+  // governed by the returned smart pointer
+  DefaultBottomSegmentIterator* newIt =
+     new DefaultBottomSegmentIterator(newSeg);
+  return BottomSegmentIteratorConstPtr(newIt);
+}
+
+BottomSegmentIteratorConstPtr MMapGenome::getBottomSegmentEndIterator() const
+{
+  return getBottomSegmentIterator(getNumBottomSegments());
+}
+
+DNAIteratorPtr MMapGenome::getDNAIterator(hal_index_t position)
+{
+  assert(position / 2 <= (hal_index_t)_record->_dnaLength);
+  MMapDNAIterator* newIt = new MMapDNAIterator(this, position);
+  return DNAIteratorPtr(newIt);
+}
+
+DNAIteratorConstPtr MMapGenome::getDNAIterator(hal_index_t position) const
+{
+  assert(position / 2 <= (hal_index_t)_record->_dnaLength);
+  const MMapDNAIterator* newIt = new MMapDNAIterator(this, position);
+  return DNAIteratorConstPtr(newIt);
+}
+
+DNAIteratorConstPtr MMapGenome::getDNAEndIterator() const
+{
+  return getDNAIterator(getSequenceLength());
+}
+
+ColumnIteratorConstPtr MMapGenome::getColumnIterator(
+  const set<const Genome*>* targets, hal_size_t maxInsertLength,
+  hal_index_t position, hal_index_t lastPosition, bool noDupes,
+  bool noAncestors, bool reverseStrand, bool unique, bool onlyOrthologs) const
+{
+  hal_index_t lastIdx = lastPosition;
+  if (lastPosition == NULL_INDEX)
+  {
+    lastIdx = (hal_index_t)(getSequenceLength() - 1);
+  }
+  if (position < 0 ||
+      lastPosition >= (hal_index_t)(getSequenceLength()))
+  {
+    stringstream ss;
+    ss << "MMapGenome::getColumnIterator: input indices "
+       << "(" << position << ", " << lastPosition << ") out of bounds";
+    throw hal_exception(ss.str());
+  }
+  const DefaultColumnIterator* newIt =
+     new DefaultColumnIterator(this, targets, position, lastIdx,
+                               maxInsertLength, noDupes, noAncestors,
+                               reverseStrand, unique, onlyOrthologs);
+  return ColumnIteratorConstPtr(newIt);
+}
+
+void MMapGenome::getString(string& outString) const
+{
+  getSubString(outString, 0, getSequenceLength());
+}
+
+void MMapGenome::setString(const string& inString)
+{
+  throwReadOnly("setString");
+}
+
+void MMapGenome::getSubString(string& outString, hal_size_t start,
+                              hal_size_t length) const
+{
+  MMapDNAIterator dnaIt(this, start);
+  dnaIt.readString(outString, length);
+}
+
+void MMapGenome::getBaseCounts(hal_size_t start, hal_size_t length,
+                               BaseCounts& counts) const
+{
+  if (start + length > getSequenceLength())
+  {
+    throw hal_exception("getBaseCounts: range out of bounds in genome " +
+                        _name);
+  }
+  if (length > 0)
+  {
+    HDF5DNA::countBases(start, length, getDNABytes(start), counts);
+  }
+}
+
+void MMapGenome::setSubString(const string& inString,
+                              hal_size_t start,
+                              hal_size_t length)
+{
+  throwReadOnly("setSubString");
+}
+
+RearrangementPtr MMapGenome::getRearrangement(hal_index_t position,
+                                              hal_size_t gapLengthThreshold,
+                                              double nThreshold,
+                                              bool atomic) const
+{
+  assert(position >= 0 && position < (hal_index_t)getNumTopSegments());
+  TopSegmentIteratorConstPtr top = getTopSegmentIterator(position);
+  DefaultRearrangement* rea = new DefaultRearrangement(this,
+                                                       gapLengthThreshold,
+                                                       nThreshold,
+                                                       atomic);
+  rea->identifyFromLeftBreakpoint(top);
+  return RearrangementPtr(rea);
+}
+
+GappedTopSegmentIteratorConstPtr MMapGenome::getGappedTopSegmentIterator(
+  hal_index_t i, hal_size_t gapThreshold, bool atomic) const
+{
+  TopSegmentIteratorConstPtr top = getTopSegmentIterator(i);
+  DefaultGappedTopSegmentIterator* gt =
+     new DefaultGappedTopSegmentIterator(top, gapThreshold, atomic);
+  return GappedTopSegmentIteratorConstPtr(gt);
+}
+
+GappedBottomSegmentIteratorConstPtr MMapGenome::getGappedBottomSegmentIterator(
+  hal_index_t i, hal_size_t childIdx, hal_size_t gapThreshold,
+  bool atomic) const
+{
+  BottomSegmentIteratorConstPtr bot = getBottomSegmentIterator(i);
+  DefaultGappedBottomSegmentIterator* gb =
+     new DefaultGappedBottomSegmentIterator(bot, childIdx, gapThreshold,
+                                            atomic);
+  return GappedBottomSegmentIteratorConstPtr(gb);
+}
+
+// LOCAL NON-INTERFACE METHODS
+
+void MMapGenome::resetBranchCaches()
+{
+  _parentCache = NULL;
+  _childCache.assign(_record->_numChildren, NULL);
+}
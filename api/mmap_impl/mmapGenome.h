@@ -0,0 +1,215 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _MMAPGENOME_H
+#define _MMAPGENOME_H
+
+#include <cassert>
+#include <map>
+#include <vector>
+#include "halGenome.h"
+#include "mmapFile.h"
+
+namespace hal {
+
+class MMapAlignment;
+class MMapMetaData;
+class MMapSequence;
+
+/**
+ * Memory-mapped (read-only) implementation of hal::Genome
+ */
+class MMapGenome : public Genome
+{
+   friend class MMapTopSegment;
+   friend class MMapBottomSegment;
+   friend class MMapDNAIterator;
+   friend class MMapSequenceIterator;
+public:
+
+   MMapGenome(const std::string& name,
+              MMapAlignment* alignment,
+              const MMapGenomeRecord* record);
+
+   virtual ~MMapGenome();
+
+   // GENOME INTERFACE
+
+   const std::string& getName() const;
+
+   void setDimensions(
+     const std::vector<hal::Sequence::Info>& sequenceDimensions,
+     bool storeDNAArrays);
+
+   void updateTopDimensions(
+     const std::vector<hal::Sequence::UpdateInfo>& sequenceDimensions);
+
+   void updateBottomDimensions(
+     const std::vector<hal::Sequence::UpdateInfo>& sequenceDimensions);
+
+   hal_size_t getNumSequences() const;
+
+   Sequence* getSequence(const std::string& name);
+
+   const Sequence* getSequence(const std::string& name) const;
+
+   Sequence* getSequenceBySite(hal_size_t position);
+   const Sequence* getSequenceBySite(hal_size_t position) const;
+
+   SequenceIteratorPtr getSequenceIterator(
+     hal_index_t position);
+
+   SequenceIteratorConstPtr getSequenceIterator(
+     hal_index_t position) const;
+
+   SequenceIteratorConstPtr getSequenceEndIterator() const;
+
+   MetaData* getMetaData();
+
+   const MetaData* getMetaData() const;
+
+   Genome* getParent();
+
+   const Genome* getParent() const;
+
+   Genome* getChild(hal_size_t childIdx);
+
+   const Genome* getChild(hal_size_t childIdx) const;
+
+   hal_size_t getNumChildren() const;
+
+   hal_index_t getChildIndex(const Genome* child) const;
+
+   bool containsDNAArray() const;
+
+   const Alignment* getAlignment() const;
+
+   // SEGMENTED SEQUENCE INTERFACE
+
+   hal_size_t getSequenceLength() const;
+
+   hal_size_t getNumTopSegments() const;
+
+   hal_size_t getNumBottomSegments() const;
+
+   TopSegmentIteratorPtr getTopSegmentIterator(
+     hal_index_t position);
+
+   TopSegmentIteratorConstPtr getTopSegmentIterator(
+     hal_index_t position) const;
+
+   TopSegmentIteratorConstPtr getTopSegmentEndIterator() const;
+
+   BottomSegmentIteratorPtr getBottomSegmentIterator(
+     hal_index_t position);
+
+   BottomSegmentIteratorConstPtr getBottomSegmentIterator(
+     hal_index_t position) const;
+
+   BottomSegmentIteratorConstPtr getBottomSegmentEndIterator() const;
+
+   DNAIteratorPtr getDNAIterator(hal_index_t position);
+
+   DNAIteratorConstPtr getDNAIterator(hal_index_t position) const;
+
+   DNAIteratorConstPtr getDNAEndIterator() const;
+
+   ColumnIteratorConstPtr getColumnIterator(const std::set<const Genome*>* targets,
+                                            hal_size_t maxInsertLength,
+                                            hal_index_t position,
+                                            hal_index_t lastPosition,
+                                            bool noDupes,
+                                            bool noAncestors,
+                                            bool reverseStrand,
+                                            bool unique,
+                                            bool onlyOrthologs) const;
+
+   void getString(std::string& outString) const;
+
+   void setString(const std::string& inString);
+
+   void getSubString(std::string& outString, hal_size_t start,
+                             hal_size_t length) const;
+
+   void getBaseCounts(hal_size_t start, hal_size_t length,
+                      BaseCounts& counts) const;
+
+   void setSubString(const std::string& intString,
+                             hal_size_t start,
+                             hal_size_t length);
+
+   RearrangementPtr getRearrangement(hal_index_t position,
+                                     hal_size_t gapLengthThreshold,
+                                     double nThreshold,
+                                     bool atomic = false) const;
+
+   GappedTopSegmentIteratorConstPtr getGappedTopSegmentIterator(
+     hal_index_t i, hal_size_t gapThreshold, bool atomic) const;
+
+   GappedBottomSegmentIteratorConstPtr getGappedBottomSegmentIterator(
+     hal_index_t i, hal_size_t childIdx, hal_size_t gapThreshold,
+     bool atomic) const;
+
+   // MMAP SPECIFIC
+   void resetBranchCaches();
+
+protected:
+
+   void throwReadOnly(const std::string& method) const;
+   const MMapTopSegmentData* getTopData(hal_index_t index) const;
+   const MMapBottomSegmentData* getBottomData(hal_index_t index) const;
+   char getDNAByte(hal_index_t index) const;
+   const unsigned char* getDNABytes(hal_index_t index) const;
+
+protected:
+
+   MMapAlignment* _alignment;
+   const MMapFile* _file;
+   const MMapGenomeRecord* _record;
+   std::string _name;
+   MMapMetaData* _metaData;
+   const MMapTopSegmentData* _topArray;
+   const char* _bottomArray;
+   const char* _dnaArray;
+   size_t _bottomRecordSize;
+
+   std::vector<MMapSequence*> _sequences;
+   std::map<std::string, MMapSequence*> _sequenceNameMap;
+   std::map<hal_size_t, MMapSequence*> _sequencePosMap;
+
+   mutable Genome* _parentCache;
+   mutable std::vector<Genome*> _childCache;
+};
+
+inline const MMapTopSegmentData*
+MMapGenome::getTopData(hal_index_t index) const
+{
+  assert(index >= 0 && index <= (hal_index_t)_record->_numTopSegments);
+  return _topArray + index;
+}
+
+inline const MMapBottomSegmentData*
+MMapGenome::getBottomData(hal_index_t index) const
+{
+  assert(index >= 0 && index <= (hal_index_t)_record->_numBottomSegments);
+  return reinterpret_cast<const MMapBottomSegmentData*>(
+    _bottomArray + index * _bottomRecordSize);
+}
+
+inline char MMapGenome::getDNAByte(hal_index_t index) const
+{
+  assert(index >= 0 && index / 2 < (hal_index_t)_record->_dnaLength);
+  return _dnaArray[index / 2];
+}
+
+inline const unsigned char* MMapGenome::getDNABytes(hal_index_t index) const
+{
+  assert(index >= 0 && index / 2 < (hal_index_t)_record->_dnaLength);
+  return reinterpret_cast<const unsigned char*>(_dnaArray) + index / 2;
+}
+
+}
+#endif
@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include <cassert>
+#include "halCommon.h"
+#include "mmapMetaData.h"
+
+using namespace std;
+using namespace hal;
+
+MMapMetaData::MMapMetaData(const MMapFile* file, hal_size_t offset,
+                           hal_size_t length)
+{
+  file->getMap(offset, length, _map);
+}
+
+MMapMetaData::~MMapMetaData()
+{
+
+}
+
+void MMapMetaData::set(const string& key, const string& value)
+{
+  throw hal_exception("Cannot set metadata " + key + ": mmap HAL files "
+                      "are read-only");
+}
+
+const string& MMapMetaData::get(const string& key) const
+{
+  assert (has(key) == true);
+  return _map.find(key)->second;
+}
+
+bool MMapMetaData::has(const string& key) const
+{
+  return _map.find(key) != _map.end();
+}
+
+const map<string, string>& MMapMetaData::getMap() const
+{
+  return _map;
+}
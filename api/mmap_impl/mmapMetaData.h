@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _MMAPMETADATA_H
+#define _MMAPMETADATA_H
+
+#include <map>
+#include <string>
+#include "halMetaData.h"
+#include "mmapFile.h"
+
+namespace hal {
+
+/** 
+ * Read-only string map loaded from a memory-mapped HAL file
+ */
+class MMapMetaData : public MetaData
+{
+public:
+   MMapMetaData(const MMapFile* file, hal_size_t offset, hal_size_t length);
+   virtual ~MMapMetaData();
+   
+   void set(const std::string& key, const std::string& value);
+   const std::string& get(const std::string& key) const;
+   bool has(const std::string& key) const;
+   const std::map<std::string, std::string>& getMap() const;
+
+protected:
+
+   std::map<std::string, std::string> _map;   
+};
+
+}
+#endif
@@ -0,0 +1,260 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include <cassert>
+#include <sstream>
+#include "halCommon.h"
+#include "mmapSequence.h"
+#include "mmapDNAIterator.h"
+#include "defaultColumnIterator.h"
+#include "defaultRearrangement.h"
+#include "defaultGappedTopSegmentIterator.h"
+#include "defaultGappedBottomSegmentIterator.h"
+
+using namespace std;
+using namespace hal;
+
+MMapSequence::MMapSequence(MMapGenome* genome,
+                           const MMapSequenceRecord* record,
+                           hal_index_t index,
+                           const string& name) :
+  _genome(genome),
+  _record(record),
+  _index(index),
+  _name(name)
+{
+
+}
+
+MMapSequence::~MMapSequence()
+{
+
+}
+
+// SEQUENCE INTERFACE
+string MMapSequence::getName() const
+{
+  return _name;
+}
+
+string MMapSequence::getFullName() const
+{
+  assert(_genome != NULL);
+  return _genome->getName() + '.' + getName();
+}
+
+const Genome* MMapSequence::getGenome() const
+{
+  return _genome;
+}
+
+Genome* MMapSequence::getGenome()
+{
+  return _genome;
+}
+
+hal_index_t MMapSequence::getStartPosition() const
+{
+  return _record->_start;
+}
+
+hal_index_t MMapSequence::getEndPosition() const
+{
+  return (hal_index_t)(_record->_start + _record->_length) - 1;
+}
+
+hal_index_t MMapSequence::getArrayIndex() const
+{
+  return _index;
+}
+
+hal_index_t MMapSequence::getTopSegmentArrayIndex() const
+{
+  return (hal_index_t)_record->_topSegmentArrayIndex;
+}
+
+hal_index_t MMapSequence::getBottomSegmentArrayIndex() const
+{
+  return (hal_index_t)_record->_bottomSegmentArrayIndex;
+}
+
+// SEGMENTED SEQUENCE INTERFACE
+
+hal_size_t MMapSequence::getSequenceLength() const
+{
+  return _record->_length;
+}
+
+hal_size_t MMapSequence::getNumTopSegments() const
+{
+  return _record->_numTopSegments;
+}
+
+hal_size_t MMapSequence::getNumBottomSegments() const
+{
+  return _record->_numBottomSegments;
+}
+
+TopSegmentIteratorPtr MMapSequence::getTopSegmentIterator(
+  hal_index_t position)
+{
+  hal_size_t idx = position + getTopSegmentArrayIndex();
+  return _genome->getTopSegmentIterator(idx);
+}
+
+TopSegmentIteratorConstPtr MMapSequence::getTopSegmentIterator(
+  hal_index_t position) const
+{
+  hal_size_t idx = position + getTopSegmentArrayIndex();
+  const MMapGenome* genome = _genome;
+  return genome->getTopSegmentIterator(idx);
+}
+
+TopSegmentIteratorConstPtr MMapSequence::getTopSegmentEndIterator() const
+{
+  return getTopSegmentIterator(getNumTopSegments());
+}
+
+BottomSegmentIteratorPtr MMapSequence::getBottomSegmentIterator(
+  hal_index_t position)
+{
+  hal_size_t idx = position + getBottomSegmentArrayIndex();
+  return _genome->getBottomSegmentIterator(idx);
+}
+
+BottomSegmentIteratorConstPtr MMapSequence::getBottomSegmentIterator(
+  hal_index_t position) const
+{
+  hal_size_t idx = position + getBottomSegmentArrayIndex();
+  const MMapGenome* genome = _genome;
+  return genome->getBottomSegmentIterator(idx);
+}
+
+BottomSegmentIteratorConstPtr MMapSequence::getBottomSegmentEndIterator() const
+{
+  return getBottomSegmentIterator(getNumBottomSegments());
+}
+
+DNAIteratorPtr MMapSequence::getDNAIterator(hal_index_t position)
+{
+  hal_size_t idx = position + getStartPosition();
+  MMapDNAIterator* newIt = new MMapDNAIterator(_genome, idx);
+  return DNAIteratorPtr(newIt);
+}
+
+DNAIteratorConstPtr MMapSequence::getDNAIterator(hal_index_t position) const
+{
+  hal_size_t idx = position + getStartPosition();
+  const MMapDNAIterator* newIt = new MMapDNAIterator(_genome, idx);
+  return DNAIteratorConstPtr(newIt);
+}
+
+DNAIteratorConstPtr MMapSequence::getDNAEndIterator() const
+{
+  return getDNAIterator(getSequenceLength());
+}
+
+ColumnIteratorConstPtr MMapSequence::getColumnIterator(
+  const std::set<const Genome*>* targets, hal_size_t maxInsertLength,
+  hal_index_t position, hal_index_t lastPosition, bool noDupes,
+  bool noAncestors, bool reverseStrand, bool unique, bool onlyOrthologs) const
+{
+  hal_index_t idx = (hal_index_t)(position + getStartPosition());
+  hal_index_t lastIdx;
+  if (lastPosition == NULL_INDEX)
+  {
+    lastIdx = (hal_index_t)(getStartPosition() + getSequenceLength() - 1);
+  }
+  else
+  {
+    lastIdx = (hal_index_t)(lastPosition + getStartPosition());
+  }
+  if (position < 0 ||
+      lastPosition >= (hal_index_t)(getStartPosition() + getSequenceLength()))
+  {
+    stringstream ss;
+    ss << "MMapSequence::getColumnIterators: input indices "
+       << "(" << position << ", " << lastPosition << ") out of bounds";
+    throw hal_exception(ss.str());
+  }
+  const DefaultColumnIterator* newIt =
+     new DefaultColumnIterator(getGenome(), targets, idx, lastIdx,
+                               maxInsertLength, noDupes, noAncestors,
+                               reverseStrand, unique, onlyOrthologs);
+  return ColumnIteratorConstPtr(newIt);
+}
+
+void MMapSequence::getString(std::string& outString) const
+{
+  getSubString(outString, 0, getSequenceLength());
+}
+
+void MMapSequence::setString(const std::string& inString)
+{
+  setSubString(inString, 0, getSequenceLength());
+}
+
+void MMapSequence::getSubString(std::string& outString, hal_size_t start,
+                                hal_size_t length) const
+{
+  hal_size_t idx = start + getStartPosition();
+  MMapDNAIterator dnaIt(_genome, idx);
+  dnaIt.readString(outString, length);
+}
+
+void MMapSequence::getBaseCounts(hal_size_t start, hal_size_t length,
+                                 BaseCounts& counts) const
+{
+  if (start + length > getSequenceLength())
+  {
+    throw hal_exception("getBaseCounts: range out of bounds in sequence " +
+                        getName());
+  }
+  _genome->getBaseCounts(start + getStartPosition(), length, counts);
+}
+
+void MMapSequence::setSubString(const std::string& inString,
+                                hal_size_t start,
+                                hal_size_t length)
+{
+  throw hal_exception("Cannot set DNA of sequence " + getFullName() +
+                      ": mmap HAL files are read-only");
+}
+
+RearrangementPtr MMapSequence::getRearrangement(hal_index_t position,
+                                                hal_size_t gapLengthThreshold,
+                                                double nThreshold,
+                                                bool atomic) const
+{
+  TopSegmentIteratorConstPtr top = getTopSegmentIterator(position);
+  DefaultRearrangement* rea = new DefaultRearrangement(getGenome(),
+                                                       gapLengthThreshold,
+                                                       nThreshold,
+                                                       atomic);
+  rea->identifyFromLeftBreakpoint(top);
+  return RearrangementPtr(rea);
+}
+
+GappedTopSegmentIteratorConstPtr MMapSequence::getGappedTopSegmentIterator(
+  hal_index_t i, hal_size_t gapThreshold, bool atomic) const
+{
+  TopSegmentIteratorConstPtr top = getTopSegmentIterator(i);
+  DefaultGappedTopSegmentIterator* gt =
+     new DefaultGappedTopSegmentIterator(top, gapThreshold, atomic);
+  return GappedTopSegmentIteratorConstPtr(gt);
+}
+
+GappedBottomSegmentIteratorConstPtr
+MMapSequence::getGappedBottomSegmentIterator(
+  hal_index_t i, hal_size_t childIdx, hal_size_t gapThreshold,
+  bool atomic) const
+{
+  BottomSegmentIteratorConstPtr bot = getBottomSegmentIterator(i);
+  DefaultGappedBottomSegmentIterator* gb =
+     new DefaultGappedBottomSegmentIterator(bot, childIdx, gapThreshold,
+                                            atomic);
+  return GappedBottomSegmentIteratorConstPtr(gb);
+}
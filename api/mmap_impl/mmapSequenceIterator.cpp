@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include <cassert>
+#include "mmapSequenceIterator.h"
+#include "mmapSequence.h"
+
+using namespace std;
+using namespace hal;
+
+MMapSequenceIterator::MMapSequenceIterator(MMapGenome* genome, 
+                                           hal_index_t index) :
+  _genome(genome),
+  _index(index)
+{
+  
+}
+
+MMapSequenceIterator::~MMapSequenceIterator()
+{
+
+}
+   
+SequenceIteratorPtr MMapSequenceIterator::copy()
+{
+  MMapSequenceIterator* newIt = new MMapSequenceIterator(_genome, _index);
+  return SequenceIteratorPtr(newIt);
+}
+
+SequenceIteratorConstPtr MMapSequenceIterator::copy() const
+{
+  MMapSequenceIterator* newIt = new MMapSequenceIterator(_genome, _index);
+  return SequenceIteratorConstPtr(newIt);
+}
+
+void MMapSequenceIterator::toNext() const
+{
+  ++_index;
+}
+
+void MMapSequenceIterator::toPrev() const
+{
+  --_index;
+}
+
+Sequence* MMapSequenceIterator::getSequence()
+{
+  assert(_index >= 0 && _index < (hal_index_t)_genome->_sequences.size());
+  return _genome->_sequences[_index];
+}
+
+const Sequence* MMapSequenceIterator::getSequence() const
+{
+  assert(_index >= 0 && _index < (hal_index_t)_genome->_sequences.size());
+  return _genome->_sequences[_index];
+}
+
+bool MMapSequenceIterator::equals(SequenceIteratorConstPtr other) const
+{
+  const MMapSequenceIterator* mmOther = reinterpret_cast<
+     const MMapSequenceIterator*>(other.get());
+  assert(_genome == mmOther->_genome);
+  return _index == mmOther->_index;
+}
@@ -0,0 +1,37 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _MMAPSEQUENCEITERATOR_H
+#define _MMAPSEQUENCEITERATOR_H
+
+#include "halSequenceIterator.h"
+#include "mmapGenome.h"
+
+namespace hal {
+
+class MMapSequenceIterator : public SequenceIterator
+{
+public:
+   
+   MMapSequenceIterator(MMapGenome* genome, hal_index_t index);
+   ~MMapSequenceIterator();
+   
+   // SEQUENCE ITERATOR METHODS
+   SequenceIteratorPtr copy();
+   SequenceIteratorConstPtr copy() const;
+   void toNext() const;
+   void toPrev() const;
+   Sequence* getSequence();
+   const Sequence* getSequence() const;
+   bool equals(SequenceIteratorConstPtr other) const;
+
+protected:
+   MMapGenome* _genome;
+   mutable hal_index_t _index;
+};
+
+}
+#endif
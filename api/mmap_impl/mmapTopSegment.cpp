@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include <string>
+#include <iostream>
+#include "mmapTopSegment.h"
+#include "mmapBottomSegment.h"
+#include "mmapDNAIterator.h"
+
+using namespace std;
+using namespace hal;
+
+MMapTopSegment::MMapTopSegment(MMapGenome* genome, hal_index_t index) :
+  _genome(genome),
+  _index(index)
+{
+  assert(_index >= 0);
+}
+
+MMapTopSegment::~MMapTopSegment()
+{
+  
+}
+
+void MMapTopSegment::setCoordinates(hal_index_t startPos, hal_size_t length)
+{
+  _genome->throwReadOnly("TopSegment::setCoordinates");
+}
+
+void MMapTopSegment::setParentIndex(hal_index_t parentIndex)
+{
+  _genome->throwReadOnly("TopSegment::setParentIndex");
+}
+
+void MMapTopSegment::setParentReversed(bool isReversed)
+{
+  _genome->throwReadOnly("TopSegment::setParentReversed");
+}
+
+void MMapTopSegment::setBottomParseIndex(hal_index_t parseIndex)
+{
+  _genome->throwReadOnly("TopSegment::setBottomParseIndex");
+}
+
+void MMapTopSegment::setNextParalogyIndex(hal_index_t parIdx)
+{
+  _genome->throwReadOnly("TopSegment::setNextParalogyIndex");
+}
+   
+hal_offset_t MMapTopSegment::getBottomParseOffset() const
+{
+  assert(_index >= 0);
+  hal_offset_t offset = 0;
+  hal_index_t bottomIndex = getBottomParseIndex();
+  if (bottomIndex != NULL_INDEX)
+  {
+    hal_index_t bottomStart = _genome->getBottomData(bottomIndex)->_start;
+    assert(bottomStart <= getStartPosition());
+    offset = getStartPosition() - bottomStart;
+  }
+  return offset;
+}
+
+void MMapTopSegment::getString(std::string& outString) const
+{
+  MMapDNAIterator di(_genome, getStartPosition());
+  di.readString(outString, getLength()); 
+}
+
+bool MMapTopSegment::isMissingData(double nThreshold) const
+{
+  if (nThreshold >= 1.0)
+  {
+    return false;
+  }  
+  MMapDNAIterator di(_genome, getStartPosition());
+  size_t length = getLength();
+  size_t maxNs = nThreshold * (double)length;
+  size_t Ns = 0;
+  char c;
+  for (size_t i = 0; i < length; ++i, di.toRight())
+  {
+    c = di.getChar();
+    if (c == 'N' || c == 'n')
+    {
+      ++Ns;
+    }
+    if (Ns > maxNs)
+    {
+      return true;
+    }
+    if ((length - i) < (maxNs - Ns))
+    {
+      break;
+    }
+  }
+  return false;
+}
+
+bool MMapTopSegment::isCanonicalParalog() const
+{
+  bool isCanon = false;
+  if (hasParent())
+  {
+    MMapGenome* parGenome = 
+       const_cast <MMapGenome*>(
+         dynamic_cast<const MMapGenome*>(_genome->getParent()));
+
+    MMapBottomSegment parent(parGenome, getParentIndex());
+    hal_index_t childGenomeIndex = parGenome->getChildIndex(_genome);
+    isCanon = parent.getChildIndex(childGenomeIndex) == _index;
+  }
+  return isCanon;
+}
+
+void MMapTopSegment::print(std::ostream& os) const
+{
+  os << "MMap Top Segment";
+}
@@ -0,0 +1,245 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _MMAPTOPSEGMENT_H
+#define _MMAPTOPSEGMENT_H
+
+#include <cassert>
+#include "halTopSegment.h"
+#include "halCommon.h"
+#include "mmapGenome.h"
+
+namespace hal {
+
+class MMapTopSegment : public TopSegment
+{
+public:
+
+   /** Constructor 
+    * @param genome Genome to which segment belongs
+    * @param index Index of segment in the genome's top array */
+   MMapTopSegment(MMapGenome* genome, hal_index_t index);
+
+   /** Destructor */
+   ~MMapTopSegment();
+
+   // SEGMENT INTERFACE
+   void setArrayIndex(Genome* genome, hal_index_t arrayIndex);
+   void setArrayIndex(const Genome* genome, hal_index_t arrayIndex) const;
+   const Genome* getGenome() const;
+   Genome* getGenome();
+   const Sequence* getSequence() const;
+   Sequence* getSequence();
+   hal_index_t getStartPosition() const;
+   hal_index_t getEndPosition() const;
+   hal_size_t getLength() const;
+   void getString(std::string& outString) const;
+   void setCoordinates(hal_index_t startPos, hal_size_t length);
+   hal_index_t getArrayIndex() const;
+   bool leftOf(hal_index_t genomePos) const;
+   bool rightOf(hal_index_t genomePos) const;
+   bool overlaps(hal_index_t genomePos) const;
+   bool isFirst() const;
+   bool isLast() const;
+   bool isMissingData(double nThreshold) const;
+   bool isTop() const;
+   hal_size_t getMappedSegments(
+     std::set<MappedSegmentConstPtr>& outSegments,
+     const Genome* tgtGenome,
+     const std::set<const Genome*>* genomesOnPath,
+     bool doDupes,
+     hal_size_t minLength,
+     const Genome *coalescenceLimit,
+     const Genome *mrca) const;
+   void print(std::ostream& os) const;
+
+   // TOP SEGMENT INTERFACE
+   hal_index_t getParentIndex() const;
+   bool hasParent() const;
+   void setParentIndex(hal_index_t parIdx);
+   bool getParentReversed() const;
+   void setParentReversed(bool isReversed);
+   hal_index_t getBottomParseIndex() const;
+   void setBottomParseIndex(hal_index_t botParseIdx);
+   hal_offset_t getBottomParseOffset() const;
+   bool hasParseDown() const;
+   hal_index_t getNextParalogyIndex() const;
+   bool hasNextParalogy() const;
+   void setNextParalogyIndex(hal_index_t parIdx);
+   hal_index_t getLeftParentIndex() const;
+   hal_index_t getRightParentIndex() const;
+   bool isCanonicalParalog() const;
+
+private:
+
+   const MMapTopSegmentData* data() const;
+
+   mutable MMapGenome* _genome;
+   mutable hal_index_t _index;
+};
+
+//INLINE members
+inline const MMapTopSegmentData* MMapTopSegment::data() const
+{
+  return _genome->getTopData(_index);
+}
+
+inline void MMapTopSegment::setArrayIndex(Genome* genome, 
+                                          hal_index_t arrayIndex)
+{
+  _genome = dynamic_cast<MMapGenome*>(genome);
+  assert(_genome != NULL);
+  _index = arrayIndex;
+}
+
+inline void MMapTopSegment::setArrayIndex(const Genome* genome, 
+                                          hal_index_t arrayIndex) const
+{
+  const MMapGenome* mmGenome = dynamic_cast<const MMapGenome*>(genome);
+  assert(mmGenome != NULL);
+  _genome = const_cast<MMapGenome*>(mmGenome);
+  _index = arrayIndex;
+}
+
+inline hal_index_t MMapTopSegment::getStartPosition() const
+{
+  return data()->_start;
+}
+
+inline hal_index_t MMapTopSegment::getEndPosition() const
+{
+  return getStartPosition() + (hal_index_t)(getLength() - 1);
+}
+
+inline hal_size_t MMapTopSegment::getLength() const
+{
+  const MMapTopSegmentData* d = data();
+  return (d + 1)->_start - d->_start;
+}
+
+inline const Genome* MMapTopSegment::getGenome() const
+{
+  return _genome;
+}
+
+inline Genome* MMapTopSegment::getGenome()
+{
+  return _genome;
+}
+
+inline const Sequence* MMapTopSegment::getSequence() const
+{
+  return _genome->getSequenceBySite(getStartPosition());
+}
+
+inline Sequence* MMapTopSegment::getSequence()
+{
+  return _genome->getSequenceBySite(getStartPosition());
+}
+
+inline bool MMapTopSegment::hasParseDown() const
+{
+  return getBottomParseIndex() != NULL_INDEX;
+}
+
+inline hal_index_t MMapTopSegment::getNextParalogyIndex() const
+{
+  return data()->_nextParalogyIndex;
+}
+
+inline bool MMapTopSegment::hasNextParalogy() const
+{
+  return getNextParalogyIndex() != NULL_INDEX;
+}
+
+inline hal_index_t MMapTopSegment::getParentIndex() const
+{
+  return data()->_parentIndex;
+}
+
+inline bool MMapTopSegment::hasParent() const
+{
+  return getParentIndex() != NULL_INDEX;
+}
+
+inline bool MMapTopSegment::getParentReversed() const
+{
+  return data()->_parentReversed != 0;
+}
+
+inline hal_index_t MMapTopSegment::getBottomParseIndex() const
+{
+  return data()->_bottomParseIndex;
+}
+
+inline hal_index_t MMapTopSegment::getArrayIndex() const
+{
+  return _index;
+}
+
+inline bool MMapTopSegment::leftOf(hal_index_t genomePos) const
+{
+  return getEndPosition() < genomePos;
+}
+
+inline bool MMapTopSegment::rightOf(hal_index_t genomePos) const
+{
+  return getStartPosition() > genomePos;
+}
+
+inline bool MMapTopSegment::overlaps(hal_index_t genomePos) const
+{
+  return !leftOf(genomePos) && !rightOf(genomePos);
+}
+
+inline bool MMapTopSegment::isFirst() const
+{
+  assert(getSequence() != NULL);
+  return _index == 0 || 
+     _index == (hal_index_t)getSequence()->getTopSegmentArrayIndex();
+}
+
+inline bool MMapTopSegment::isLast() const
+{
+  assert(getSequence() != NULL);
+  return _index == (hal_index_t)_genome->getNumTopSegments() || 
+     _index == getSequence()->getTopSegmentArrayIndex() +
+     (hal_index_t)getSequence()->getNumTopSegments() - 1;
+}
+
+inline bool MMapTopSegment::isTop() const
+{
+  return true;
+}
+
+inline hal_size_t MMapTopSegment::getMappedSegments(
+  std::set<MappedSegmentConstPtr>& outSegments,
+  const Genome* tgtGenome,
+  const std::set<const Genome*>* genomesOnPath,
+  bool doDupes,
+  hal_size_t minLength,
+  const Genome *coalescenceLimit,
+  const Genome *mrca) const
+{
+  throw hal_exception("Internal error.   MMap Segment interface should "
+                      "at some point go through the sliced segment");
+}
+
+inline hal_index_t MMapTopSegment::getLeftParentIndex() const
+{
+  assert(isFirst() == false);
+  return _genome->getTopData(_index - 1)->_parentIndex;
+}
+
+inline hal_index_t MMapTopSegment::getRightParentIndex() const
+{
+  assert(isLast() == false);
+  return _genome->getTopData(_index + 1)->_parentIndex;
+}
+
+}
+
+#endif
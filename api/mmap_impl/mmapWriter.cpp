@@ -0,0 +1,307 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+#include <deque>
+#include <sstream>
+#include "halCommon.h"
+#include "hal.h"
+#include "hdf5DNA.h"
+#include "mmapWriter.h"
+
+using namespace std;
+using namespace hal;
+
+const hal_size_t MMapWriter::BufferBytes = 8388608;
+
+MMapWriter::MMapWriter(const Alignment* alignment) :
+  _alignment(alignment),
+  _offset(0)
+{
+
+}
+
+MMapWriter::~MMapWriter()
+{
+
+}
+
+void MMapWriter::write(const string& path)
+{
+  _path = path;
+  _out.open(path.c_str(), ios::out | ios::binary | ios::trunc);
+  if (!_out)
+  {
+    throw hal_exception("Unable to open " + path + " for writing");
+  }
+  _offset = 0;
+
+  // breadth-first list of genomes, so that ancestors come first
+  vector<string> genomeNames;
+  if (_alignment->getNumGenomes() > 0)
+  {
+    deque<string> bfQueue;
+    bfQueue.push_back(_alignment->getRootName());
+    while (bfQueue.empty() == false)
+    {
+      genomeNames.push_back(bfQueue.front());
+      bfQueue.pop_front();
+      vector<string> children = _alignment->getChildNames(genomeNames.back());
+      bfQueue.insert(bfQueue.end(), children.begin(), children.end());
+    }
+  }
+
+  // reserve the header page and the genome table, which get filled
+  // in at the end once all the offsets are known
+  MMapHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header._magic, MMapFile::Magic, sizeof(header._magic));
+  header._formatVersion = MMapFile::FormatVersion;
+  header._numGenomes = genomeNames.size();
+  vector<MMapGenomeRecord> genomeTable(genomeNames.size());
+  if (genomeTable.empty() == false)
+  {
+    memset(&genomeTable[0], 0, genomeTable.size() * sizeof(MMapGenomeRecord));
+  }
+  vector<char> zeros(MMapFile::PageSize, 0);
+  writeBlock(&zeros[0], zeros.size());
+  header._genomeTableOffset = _offset;
+  for (size_t i = 0; i < genomeTable.size(); ++i)
+  {
+    writeBlock(&genomeTable[i], sizeof(MMapGenomeRecord));
+  }
+
+  stringstream version;
+  version << HAL_VERSION;
+  header._versionOffset = writeString(version.str());
+  header._versionLength = version.str().length();
+  string tree = _alignment->getNewickTree();
+  header._treeOffset = writeString(tree);
+  header._treeLength = tree.length();
+  string meta = MMapFile::writeMap(_alignment->getMetaData()->getMap());
+  header._metaOffset = writeString(meta);
+  header._metaLength = meta.length();
+
+  for (size_t i = 0; i < genomeNames.size(); ++i)
+  {
+    const Genome* genome = _alignment->openGenome(genomeNames[i]);
+    if (genome == NULL)
+    {
+      throw hal_exception("Unable to open genome " + genomeNames[i]);
+    }
+    genomeTable[i]._nameOffset = writeString(genomeNames[i]);
+    genomeTable[i]._nameLength = genomeNames[i].length();
+    writeGenome(genome, genomeTable[i]);
+    _alignment->closeGenome(genome);
+  }
+  alignToPage();
+  header._fileSize = _offset;
+
+  _out.seekp(0);
+  _out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  _out.seekp(header._genomeTableOffset);
+  if (genomeTable.empty() == false)
+  {
+    _out.write(reinterpret_cast<const char*>(&genomeTable[0]),
+               genomeTable.size() * sizeof(MMapGenomeRecord));
+  }
+  checkStream();
+  _out.close();
+}
+
+void MMapWriter::writeGenome(const Genome* genome, MMapGenomeRecord& record)
+{
+  record._sequenceLength = genome->getSequenceLength();
+  record._numChildren = genome->getNumChildren();
+  string meta = MMapFile::writeMap(genome->getMetaData()->getMap());
+  record._metaOffset = writeString(meta);
+  record._metaLength = meta.length();
+  writeSequences(genome, record);
+  writeTopSegments(genome, record);
+  writeBottomSegments(genome, record);
+  writeDNA(genome, record);
+}
+
+void MMapWriter::writeSequences(const Genome* genome, 
+                                MMapGenomeRecord& record)
+{
+  record._numSequences = genome->getNumSequences();
+  alignToPage();
+  record._sequenceOffset = _offset;
+  // the names are pooled right after the table
+  hal_size_t nameOffset = _offset + 
+     record._numSequences * sizeof(MMapSequenceRecord);
+  string names;
+  SequenceIteratorConstPtr seqIt = genome->getSequenceIterator();
+  SequenceIteratorConstPtr seqEndIt = genome->getSequenceEndIterator();
+  for (; seqIt != seqEndIt; seqIt->toNext())
+  {
+    const Sequence* sequence = seqIt->getSequence();
+    MMapSequenceRecord seqRecord;
+    string name = sequence->getName();
+    seqRecord._nameOffset = nameOffset + names.length();
+    seqRecord._nameLength = name.length();
+    seqRecord._start = sequence->getStartPosition();
+    seqRecord._length = sequence->getSequenceLength();
+    seqRecord._topSegmentArrayIndex = sequence->getTopSegmentArrayIndex();
+    seqRecord._numTopSegments = sequence->getNumTopSegments();
+    seqRecord._bottomSegmentArrayIndex = 
+       sequence->getBottomSegmentArrayIndex();
+    seqRecord._numBottomSegments = sequence->getNumBottomSegments();
+    names.append(name);
+    writeBlock(&seqRecord, sizeof(seqRecord));
+  }
+  assert(_offset == nameOffset);
+  writeString(names);
+}
+
+void MMapWriter::writeTopSegments(const Genome* genome, 
+                                  MMapGenomeRecord& record)
+{
+  hal_size_t n = genome->getNumTopSegments();
+  record._numTopSegments = n;
+  alignToPage();
+  record._topOffset = _offset;
+  vector<MMapTopSegmentData> buffer;
+  buffer.reserve(BufferBytes / sizeof(MMapTopSegmentData));
+  if (n > 0)
+  {
+    TopSegmentIteratorConstPtr top = genome->getTopSegmentIterator();
+    for (; (hal_size_t)top->getArrayIndex() < n; top->toRight())
+    {
+      MMapTopSegmentData data;
+      data._start = top->getStartPosition();
+      data._bottomParseIndex = top->getBottomParseIndex();
+      data._nextParalogyIndex = top->getNextParalogyIndex();
+      data._parentIndex = top->getParentIndex();
+      data._parentReversed = top->getParentReversed() ? 1 : 0;
+      buffer.push_back(data);
+      if (buffer.size() == buffer.capacity())
+      {
+        writeBlock(&buffer[0], buffer.size() * sizeof(MMapTopSegmentData));
+        buffer.clear();
+      }
+    }
+  }
+  // sentinel record used to compute the length of the last segment
+  MMapTopSegmentData sentinel;
+  sentinel._start = genome->getSequenceLength();
+  sentinel._bottomParseIndex = NULL_INDEX;
+  sentinel._nextParalogyIndex = NULL_INDEX;
+  sentinel._parentIndex = NULL_INDEX;
+  sentinel._parentReversed = 0;
+  buffer.push_back(sentinel);
+  writeBlock(&buffer[0], buffer.size() * sizeof(MMapTopSegmentData));
+}
+
+void MMapWriter::writeBottomSegments(const Genome* genome, 
+                                     MMapGenomeRecord& record)
+{
+  hal_size_t n = genome->getNumBottomSegments();
+  hal_size_t numChildren = genome->getNumChildren();
+  size_t recordSize = MMapFile::bottomRecordSize(numChildren);
+  record._numBottomSegments = n;
+  alignToPage();
+  record._bottomOffset = _offset;
+  vector<char> buffer;
+  buffer.reserve(BufferBytes + recordSize);
+  vector<char> recordBuffer(recordSize);
+  MMapBottomSegmentData* data = 
+     reinterpret_cast<MMapBottomSegmentData*>(&recordBuffer[0]);
+  MMapChildData* childData = reinterpret_cast<MMapChildData*>(data + 1);
+  if (n > 0)
+  {
+    BottomSegmentIteratorConstPtr bottom = genome->getBottomSegmentIterator();
+    for (; (hal_size_t)bottom->getArrayIndex() < n; bottom->toRight())
+    {
+      data->_start = bottom->getStartPosition();
+      data->_topParseIndex = bottom->getTopParseIndex();
+      for (hal_size_t i = 0; i < numChildren; ++i)
+      {
+        childData[i]._childIndex = bottom->getChildIndex(i);
+        childData[i]._reversed = bottom->getChildReversed(i) ? 1 : 0;
+      }
+      buffer.insert(buffer.end(), recordBuffer.begin(), recordBuffer.end());
+      if (buffer.size() >= BufferBytes)
+      {
+        writeBlock(&buffer[0], buffer.size());
+        buffer.clear();
+      }
+    }
+  }
+  data->_start = genome->getSequenceLength();
+  data->_topParseIndex = NULL_INDEX;
+  for (hal_size_t i = 0; i < numChildren; ++i)
+  {
+    childData[i]._childIndex = NULL_INDEX;
+    childData[i]._reversed = 0;
+  }
+  buffer.insert(buffer.end(), recordBuffer.begin(), recordBuffer.end());
+  writeBlock(&buffer[0], buffer.size());
+}
+
+void MMapWriter::writeDNA(const Genome* genome, MMapGenomeRecord& record)
+{
+  alignToPage();
+  record._dnaOffset = _offset;
+  record._dnaLength = 0;
+  if (genome->containsDNAArray() == false)
+  {
+    return;
+  }
+  hal_size_t length = genome->getSequenceLength();
+  record._dnaLength = (length + 1) / 2;
+  // even number of bases per buffer so that bytes never straddle two
+  // buffers
+  hal_size_t basesPerBuffer = 2 * BufferBytes;
+  vector<unsigned char> buffer;
+  string dna;
+  for (hal_size_t start = 0; start < length; start += basesPerBuffer)
+  {
+    hal_size_t bufLength = min(basesPerBuffer, length - start);
+    genome->getSubString(dna, start, bufLength);
+    buffer.assign((bufLength + 1) / 2, 0U);
+    for (hal_size_t i = 0; i < bufLength; ++i)
+    {
+      HDF5DNA::pack(dna[i], i, buffer[i / 2]);
+    }
+    writeBlock(&buffer[0], buffer.size());
+  }
+}
+
+hal_size_t MMapWriter::writeBlock(const void* data, hal_size_t length)
+{
+  hal_size_t offset = _offset;
+  _out.write(static_cast<const char*>(data), length);
+  checkStream();
+  _offset += length;
+  return offset;
+}
+
+hal_size_t MMapWriter::writeString(const string& data)
+{
+  return writeBlock(data.c_str(), data.length());
+}
+
+void MMapWriter::alignToPage()
+{
+  hal_size_t padding = MMapFile::pageAlign(_offset) - _offset;
+  if (padding > 0)
+  {
+    vector<char> zeros(padding, 0);
+    writeBlock(&zeros[0], padding);
+  }
+}
+
+void MMapWriter::checkStream()
+{
+  if (!_out)
+  {
+    throw hal_exception("Error writing mmap HAL file " + _path);
+  }
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _MMAPWRITER_H
+#define _MMAPWRITER_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include "halAlignment.h"
+#include "mmapFile.h"
+
+namespace hal {
+
+/**
+ * Writes any alignment out in the memory-mapped format described in
+ * mmapFile.h.  Genomes are written one at a time, and each array is 
+ * streamed through a fixed-size buffer so memory use does not depend 
+ * on the size of the alignment.
+ */
+class MMapWriter
+{
+public:
+
+   MMapWriter(const Alignment* alignment);
+   ~MMapWriter();
+
+   void write(const std::string& path);
+
+protected:
+
+   void writeGenome(const Genome* genome, MMapGenomeRecord& record);
+   void writeSequences(const Genome* genome, MMapGenomeRecord& record);
+   void writeTopSegments(const Genome* genome, MMapGenomeRecord& record);
+   void writeBottomSegments(const Genome* genome, MMapGenomeRecord& record);
+   void writeDNA(const Genome* genome, MMapGenomeRecord& record);
+
+   /** Write a block of data at the current position
+    * @return file offset of the block */
+   hal_size_t writeBlock(const void* data, hal_size_t length);
+   hal_size_t writeString(const std::string& data);
+   /** Pad the file with zeros up to the next page boundary */
+   void alignToPage();
+   void checkStream();
+
+   const Alignment* _alignment;
+   std::string _path;
+   std::ofstream _out;
+   hal_size_t _offset;
+
+   static const hal_size_t BufferBytes;
+};
+
+}
+#endif
@@ -20,6 +20,8 @@ int halRunAllTests(void) {
   CuSuiteAddSuite(suite, halRearrangementTestSuite());
   CuSuiteAddSuite(suite, halMappedSegmentTestSuite());
   CuSuiteAddSuite(suite, halValidateTestSuite());
+  CuSuiteAddSuite(suite, halMMapTestSuite());
+  CuSuiteAddSuite(suite, halThreadTestSuite());
   CuSuiteRun(suite);
   CuSuiteSummary(suite, output);
   CuSuiteDetails(suite, output);
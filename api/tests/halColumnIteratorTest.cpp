@@ -9,12 +9,20 @@
 #include <cassert>
 #include <cmath>
 #include <ctime>
+#include <sstream>
+#include <deque>
+#include <algorithm>
+#include <set>
+#include <pthread.h>
 #include "halColumnIteratorTest.h"
 #include "halRandomData.h"
 #include "halBottomSegmentTest.h"
 #include "halTopSegmentTest.h"
 #include "hal.h"
 
+extern "C" {
+#include "commonC.h"
+}
 
 using namespace std;
 using namespace hal;
@@ -1042,6 +1050,428 @@ void ColumnIteratorPositionCacheTest::checkCallBack(AlignmentConstPtr alignment)
     truth.clear();
     cache.clear();
   }
+
+  // mostly left-to-right with gaps, plus the odd position filled in
+  // behind, which is how the column iterator fills its visit cache
+  hal_index_t pos = 0;
+  for (size_t j = 0; j < entries * 10; ++j)
+  {
+    hal_index_t val = pos;
+    if (rand() % 20 == 0)
+    {
+      val = (hal_index_t)rand() % (pos + 1);
+    }
+    else
+    {
+      pos += 1 + (rand() % 3 == 0 ? rand() % 10 : 0);
+    }
+    bool r = truth.insert(val).second;
+    bool r2 = cache.insert(val);
+    CuAssertTrue(_testCase, r == r2);
+  }
+  CuAssertTrue(_testCase, truth.size() == cache.size());
+  CuAssertTrue(_testCase, cache.check());
+  const PositionCache::IntervalSet* intervals = cache.getIntervalSet();
+  set<hal_index_t>::const_iterator t = truth.begin();
+  for (PositionCache::IntervalSet::const_iterator k = intervals->begin();
+       k != intervals->end(); ++k)
+  {
+    for (hal_index_t val = k->second; val <= k->first; ++val, ++t)
+    {
+      CuAssertTrue(_testCase, t != truth.end() && *t == val);
+    }
+  }
+  CuAssertTrue(_testCase, t == truth.end());
+
+  // fill in more positions behind the scan position as it moves on,
+  // then check a copy finds the same ones
+  for (size_t j = 0; j < entries * 10; ++j)
+  {
+    hal_index_t val = pos;
+    if (rand() % 20 == 0)
+    {
+      val = (hal_index_t)rand() % (pos + 1);
+    }
+    else
+    {
+      pos += 1 + (rand() % 3 == 0 ? rand() % 10 : 0);
+    }
+    bool r = truth.insert(val).second;
+    bool r2 = cache.insert(val);
+    CuAssertTrue(_testCase, r == r2);
+  }
+  CuAssertTrue(_testCase, truth.size() == cache.size());
+  CuAssertTrue(_testCase, cache.check());
+  PositionCache copy(cache);
+  for (hal_index_t val = 0; val <= pos + 1; ++val)
+  {
+    bool r = truth.find(val) != truth.end();
+    CuAssertTrue(_testCase, r == cache.find(val));
+    CuAssertTrue(_testCase, r == copy.find(val));
+  }
+  CuAssertTrue(_testCase, copy.check());
+
+  // same positions in a bitmap
+  PositionCache bitmap;
+  bitmap.setBitmap(pos + 1);
+  CuAssertTrue(_testCase, bitmap.isBitmap() == true);
+  for (set<hal_index_t>::iterator i = truth.begin(); i != truth.end(); ++i)
+  {
+    CuAssertTrue(_testCase, bitmap.insert(*i) == true);
+    CuAssertTrue(_testCase, bitmap.insert(*i) == false);
+  }
+  CuAssertTrue(_testCase, truth.size() == bitmap.size());
+  CuAssertTrue(_testCase, bitmap.check());
+  PositionCache bitmapCopy(bitmap);
+  for (hal_index_t val = -1; val <= pos + 1; ++val)
+  {
+    bool r = truth.find(val) != truth.end();
+    CuAssertTrue(_testCase, r == bitmap.find(val));
+    CuAssertTrue(_testCase, r == bitmapCopy.find(val));
+  }
+  try
+  {
+    bitmap.insert(pos + 1);
+    CuAssertTrue(_testCase, false);
+  }
+  catch (hal_exception&)
+  {
+  }
+  for (hal_index_t val = 0; val <= pos; ++val)
+  {
+    bitmapCopy.insert(val);
+  }
+  bitmapCopy.compactBitmap();
+  CuAssertTrue(_testCase, bitmapCopy.check());
+  CuAssertTrue(_testCase, bitmapCopy.find(pos) == true);
+  CuAssertTrue(_testCase, bitmapCopy.find(pos + 1) == false);
+  CuAssertTrue(_testCase, bitmapCopy.insert(0) == false);
+  CuAssertTrue(_testCase, bitmap.find(pos) == (truth.count(pos) > 0));
+}
+
+void ColumnIteratorBlockTest::createCallBack(AlignmentPtr alignment)
+{
+  createRandomAlignment(alignment, 
+                        0.75, 
+                        0.1,
+                        5,
+                        10,
+                        1000,
+                        5,
+                        10);
+}
+
+// every column of every block must be the column the column iterator 
+// gives at the same point
+void ColumnIteratorBlockTest::checkGenome(const Genome* genome, 
+                                          bool noAncestors, bool unique)
+{
+  vector<vector<string> > columns;
+  ColumnIteratorConstPtr colIt = genome->getColumnIterator(NULL, 0, 0,
+                                                           NULL_INDEX,
+                                                           false,
+                                                           noAncestors,
+                                                           false,
+                                                           unique);
+  while (true)
+  {
+    vector<string> column;
+    const ColumnIterator::ColumnMap* cmap = colIt->getColumnMap();
+    for (ColumnIterator::ColumnMap::const_iterator i = cmap->begin();
+         i != cmap->end(); ++i)
+    {
+      for (size_t j = 0; j < i->second->size(); ++j)
+      {
+        DNAIteratorConstPtr dnaIt = i->second->at(j);
+        stringstream ss;
+        ss << i->first->getFullName() << " " << dnaIt->getArrayIndex()
+           << " " << dnaIt->getReversed() << " " << dnaIt->getChar();
+        column.push_back(ss.str());
+      }
+    }
+    sort(column.begin(), column.end());
+    columns.push_back(column);
+    if (colIt->lastColumn() == true)
+    {
+      break;
+    }
+    colIt->toRight();
+  }
+
+  size_t count = 0;
+  size_t numBlocks = 0;
+  ColumnBlockIterator blockIt(genome, NULL, 0, NULL_INDEX, false,
+                              noAncestors, unique, 50);
+  while (true)
+  {
+    ++numBlocks;
+    CuAssertTrue(_testCase, blockIt.getWidth() > 0 && 
+                 blockIt.getWidth() <= 50);
+    for (hal_size_t col = 0; col < blockIt.getWidth(); ++col, ++count)
+    {
+      vector<string> column;
+      for (hal_size_t row = 0; row < blockIt.getNumRows(); ++row)
+      {
+        bool reversed = blockIt.getReversed(row);
+        hal_index_t pos = blockIt.getStartPosition(row) + 
+           (reversed ? -(hal_index_t)col : (hal_index_t)col);
+        stringstream ss;
+        ss << blockIt.getSequence(row)->getFullName() << " " << pos
+           << " " << reversed << " " << blockIt.getRow(row)[col];
+        column.push_back(ss.str());
+      }
+      sort(column.begin(), column.end());
+      CuAssertTrue(_testCase, count < columns.size());
+      CuAssertTrue(_testCase, column == columns[count]);
+    }
+    if (blockIt.lastBlock() == true)
+    {
+      break;
+    }
+    blockIt.toRight();
+  }
+  CuAssertTrue(_testCase, count == columns.size());
+  CuAssertTrue(_testCase, numBlocks <= columns.size());
+}
+
+void ColumnIteratorBlockTest::checkCallBack(AlignmentConstPtr alignment)
+{
+  deque<string> bfQueue;
+  bfQueue.push_back(alignment->getRootName());
+  while (bfQueue.empty() == false)
+  {
+    const Genome* genome = alignment->openGenome(bfQueue.front());
+    vector<string> children = alignment->getChildNames(bfQueue.front());
+    bfQueue.insert(bfQueue.end(), children.begin(), children.end());
+    bfQueue.pop_front();
+    if (genome->getSequenceLength() > 0)
+    {
+      checkGenome(genome, false, false);
+      checkGenome(genome, false, true);
+      if (genome->getNumChildren() == 0)
+      {
+        checkGenome(genome, true, true);
+      }
+    }
+  }
+}
+
+void ColumnIteratorAllColumnsTest::createCallBack(AlignmentPtr alignment)
+{
+  createRandomAlignment(alignment, 
+                        0.75, 
+                        0.1,
+                        5,
+                        10,
+                        1000,
+                        5,
+                        10);
+}
+
+struct AllColumnsScanData
+{
+   AlignmentConstPtr _alignment;
+   AllColumnIterator::Scan* _scan;
+   hal_size_t _part;
+   bool _noAncestors;
+   // every base reported by this part, by genome name since the handles
+   // don't share genomes
+   vector<pair<string, hal_index_t> > _bases;
+   bool _ok;
+};
+
+// one part of a scan.  CuAssert isn't thread-safe, so the checks are 
+// left to the caller
+static void* allColumnsScanMain(void* arg)
+{
+  AllColumnsScanData* data = static_cast<AllColumnsScanData*>(arg);
+  try
+  {
+    AllColumnIterator allIt(data->_alignment, data->_scan, data->_part,
+                            false, data->_noAncestors);
+    for (; allIt.atEnd() == false; allIt.toRight())
+    {
+      ColumnIteratorConstPtr colIt = allIt.getColumnIterator();
+      const ColumnIterator::ColumnMap* colMap = colIt->getColumnMap();
+      bool empty = true;
+      for (ColumnIterator::ColumnMap::const_iterator i = colMap->begin();
+           i != colMap->end(); ++i)
+      {
+        for (ColumnIterator::DNASet::const_iterator j = i->second->begin();
+             j != i->second->end(); ++j)
+        {
+          const Genome* genome = (*j)->getGenome();
+          if (data->_noAncestors == true && genome->getNumChildren() > 0)
+          {
+            data->_ok = false;
+          }
+          data->_bases.push_back(make_pair(genome->getName(), 
+                                           (*j)->getArrayIndex()));
+          empty = false;
+        }
+      }
+      if (empty == true)
+      {
+        data->_ok = false;
+      }
+    }
+  }
+  catch (...)
+  {
+    data->_ok = false;
+  }
+  return NULL;
+}
+
+// every leaf base is reported exactly once, and no other base more 
+// than once, by one part per handle (each in its own thread if there
+// are several)
+void ColumnIteratorAllColumnsTest::checkScan(
+  const vector<AlignmentConstPtr>& alignments, bool noAncestors)
+{
+  AlignmentConstPtr alignment = alignments[0];
+  hal_size_t numParts = alignments.size();
+  AllColumnIterator::Scan scan(alignment, numParts);
+  vector<AllColumnsScanData> data(numParts);
+  vector<pthread_t> threads(numParts);
+  for (hal_size_t i = 0; i < numParts; ++i)
+  {
+    data[i]._alignment = alignments[i];
+    data[i]._scan = &scan;
+    data[i]._part = i;
+    data[i]._noAncestors = noAncestors;
+    data[i]._ok = true;
+    if (numParts == 1)
+    {
+      allColumnsScanMain(&data[i]);
+    }
+    else
+    {
+      CuAssertTrue(_testCase, pthread_create(&threads[i], NULL, 
+                                             allColumnsScanMain,
+                                             &data[i]) == 0);
+    }
+  }
+  set<pair<string, hal_index_t> > seen;
+  hal_size_t numLeafBases = 0;
+  for (hal_size_t i = 0; i < numParts; ++i)
+  {
+    if (numParts > 1)
+    {
+      pthread_join(threads[i], NULL);
+    }
+    CuAssertTrue(_testCase, data[i]._ok == true);
+    for (size_t j = 0; j < data[i]._bases.size(); ++j)
+    {
+      CuAssertTrue(_testCase, seen.insert(data[i]._bases[j]).second);
+      if (alignment->getChildNames(data[i]._bases[j].first).empty())
+      {
+        ++numLeafBases;
+      }
+    }
+  }
+
+  // getLeafNamesBelow() leaves out the genome itself, so a tree that 
+  // is just a root (which random alignments can be) has no leaves 
+  // below it, but the scan counts the root as a leaf
+  const vector<string>& leafNames = scan.getGenomeNames();
+  vector<string> expectedLeaves = 
+     alignment->getLeafNamesBelow(alignment->getRootName());
+  if (expectedLeaves.empty() == true)
+  {
+    expectedLeaves.push_back(alignment->getRootName());
+  }
+  CuAssertTrue(_testCase, leafNames.size() == expectedLeaves.size());
+  hal_size_t totalLeafBases = 0;
+  for (size_t i = 0; i < leafNames.size(); ++i)
+  {
+    totalLeafBases += 
+       alignment->openGenome(leafNames[i])->getSequenceLength();
+  }
+  CuAssertTrue(_testCase, numLeafBases == totalLeafBases);
+}
+
+void ColumnIteratorAllColumnsTest::checkCallBack(AlignmentConstPtr alignment)
+{
+  vector<AlignmentConstPtr> alignments(1, alignment);
+  checkScan(alignments, false);
+  checkScan(alignments, true);
+
+  // parts racing each other for the bases of the same columns
+  char* mmPath = getTempFile();
+  writeMMapAlignment(alignment, mmPath);
+  alignments = openHalAlignmentReadOnlyPerThread(mmPath, CLParserPtr(), 4);
+  CuAssertTrue(_testCase, alignments.size() == 4);
+  for (size_t i = 0; i < 5; ++i)
+  {
+    checkScan(alignments, i % 2 == 1);
+  }
+  alignments[0]->close();
+  alignments.clear();
+  removeTempFile(mmPath);
+}
+
+void ColumnIteratorPerfStatsTest::createCallBack(AlignmentPtr alignment)
+{
+  createRandomAlignment(alignment, 
+                        0.75, 
+                        0.1,
+                        3,
+                        10,
+                        100,
+                        2,
+                        5);
+}
+
+// the counters only move if the library is built with HAL_PERF_STATS
+void ColumnIteratorPerfStatsTest::checkCallBack(AlignmentConstPtr alignment)
+{
+  // scan the first genome (breadth first) that has any bases; random
+  // alignments can have empty ones
+  const Genome* genome = NULL;
+  deque<string> bfQueue;
+  bfQueue.push_back(alignment->getRootName());
+  while (genome == NULL && bfQueue.empty() == false)
+  {
+    const Genome* candidate = alignment->openGenome(bfQueue.front());
+    vector<string> children = alignment->getChildNames(bfQueue.front());
+    bfQueue.insert(bfQueue.end(), children.begin(), children.end());
+    bfQueue.pop_front();
+    if (candidate->getSequenceLength() > 0)
+    {
+      genome = candidate;
+    }
+  }
+  if (genome == NULL)
+  {
+    return;
+  }
+  PerfStats::resetGlobal();
+  ColumnIteratorConstPtr colIt = genome->getColumnIterator();
+  hal_size_t numMoves = 0;
+  for (; colIt->lastColumn() == false; colIt->toRight())
+  {
+    ++numMoves;
+  }
+  PerfStats stats = alignment->getPerfStats();
+  if (PerfStats::isEnabled() == true)
+  {
+    CuAssertTrue(_testCase, 
+                 stats.get(PerfStats::ColumnToRightCalls) >= numMoves);
+    CuAssertTrue(_testCase, stats.get(PerfStats::ColumnToSiteCalls) > 0);
+    CuAssertTrue(_testCase, stats.get(PerfStats::SequenceBySiteCalls) > 0);
+  }
+  else
+  {
+    for (int i = 0; i < PerfStats::NumCounters; ++i)
+    {
+      CuAssertTrue(_testCase, stats.get((PerfStats::Counter)i) == 0);
+    }
+    CuAssertTrue(_testCase, stats.getArrays().empty());
+  }
+  PerfStats::resetGlobal();
+  CuAssertTrue(_testCase, PerfStats::getGlobal().get(
+                 PerfStats::ColumnToRightCalls) == 0);
 }
 
 void halColumnIteratorBaseTest(CuTest *testCase)
@@ -1148,6 +1578,45 @@ void halColumnIteratorPositionCacheTest(CuTest *testCase)
   } 
 }
 
+void halColumnIteratorBlockTest(CuTest *testCase)
+{
+  try 
+  {
+    ColumnIteratorBlockTest tester;
+    tester.check(testCase);
+  }
+  catch (...) 
+  {
+    CuAssertTrue(testCase, false);
+  } 
+}
+
+void halColumnIteratorAllColumnsTest(CuTest *testCase)
+{
+  try 
+  {
+    ColumnIteratorAllColumnsTest tester;
+    tester.check(testCase);
+  }
+  catch (...) 
+  {
+    CuAssertTrue(testCase, false);
+  } 
+}
+
+void halColumnIteratorPerfStatsTest(CuTest *testCase)
+{
+  try 
+  {
+    ColumnIteratorPerfStatsTest tester;
+    tester.check(testCase);
+  }
+  catch (...) 
+  {
+    CuAssertTrue(testCase, false);
+  } 
+}
+
 CuSuite* halColumnIteratorTestSuite(void) 
 {
   CuSuite* suite = CuSuiteNew();
@@ -1159,6 +1628,9 @@ CuSuite* halColumnIteratorTestSuite(void)
   SUITE_ADD_TEST(suite, halColumnIteratorMultiGapTest);
   SUITE_ADD_TEST(suite, halColumnIteratorMultiGapInvTest);
   SUITE_ADD_TEST(suite, halColumnIteratorPositionCacheTest);
+  SUITE_ADD_TEST(suite, halColumnIteratorBlockTest);
+  SUITE_ADD_TEST(suite, halColumnIteratorAllColumnsTest);
+  SUITE_ADD_TEST(suite, halColumnIteratorPerfStatsTest);
   return suite;
 }
 
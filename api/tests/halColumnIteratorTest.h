@@ -63,4 +63,26 @@ struct ColumnIteratorPositionCacheTest : public AlignmentTest
    void checkCallBack(hal::AlignmentConstPtr alignment);
 };
 
+struct ColumnIteratorBlockTest : public AlignmentTest
+{
+   void createCallBack(hal::AlignmentPtr alignment);
+   void checkCallBack(hal::AlignmentConstPtr alignment);
+   void checkGenome(const hal::Genome* genome, bool noAncestors, 
+                    bool unique);
+};
+
+struct ColumnIteratorAllColumnsTest : public AlignmentTest
+{
+   void createCallBack(hal::AlignmentPtr alignment);
+   void checkCallBack(hal::AlignmentConstPtr alignment);
+   void checkScan(const std::vector<hal::AlignmentConstPtr>& alignments,
+                  bool noAncestors);
+};
+
+struct ColumnIteratorPerfStatsTest : public AlignmentTest
+{
+   void createCallBack(hal::AlignmentPtr alignment);
+   void checkCallBack(hal::AlignmentConstPtr alignment);
+};
+
 #endif
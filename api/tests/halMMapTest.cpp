@@ -0,0 +1,192 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include <string>
+#include <iostream>
+#include <deque>
+#include "halAlignmentTest.h"
+#include "halMMapTest.h"
+#include "halRandomData.h"
+
+extern "C" {
+#include "commonC.h"
+}
+
+using namespace std;
+using namespace hal;
+
+void MMapConvertTest::createCallBack(AlignmentPtr alignment)
+{
+  createRandomAlignment(alignment, 
+                        0.75, 
+                        0.1,
+                        5,
+                        10,
+                        1000,
+                        5,
+                        10);
+  alignment->getMetaData()->set("meta", "data");
+}
+
+void MMapConvertTest::checkCallBack(AlignmentConstPtr alignment)
+{
+  char* mmPath = getTempFile();
+  writeMMapAlignment(alignment, mmPath);
+  CuAssertTrue(_testCase, isMMapAlignmentFile(mmPath) == true);
+  CuAssertTrue(_testCase, isMMapAlignmentFile(_checkPath) == false);
+
+  AlignmentConstPtr mmAlignment = openHalAlignmentReadOnly(mmPath,
+                                                           CLParserPtr());
+  CuAssertTrue(_testCase, mmAlignment->getNewickTree() == 
+               alignment->getNewickTree());
+  CuAssertTrue(_testCase, mmAlignment->getNumGenomes() == 
+               alignment->getNumGenomes());
+  CuAssertTrue(_testCase, mmAlignment->getMetaData()->getMap() == 
+               alignment->getMetaData()->getMap());
+
+  deque<string> bfQueue;
+  bfQueue.push_back(alignment->getRootName());
+  while (bfQueue.empty() == false)
+  {
+    string name = bfQueue.front();
+    bfQueue.pop_front();
+    const Genome* genome = alignment->openGenome(name);
+    const Genome* mmGenome = mmAlignment->openGenome(name);
+    CuAssertTrue(_testCase, mmGenome != NULL);
+    checkGenome(genome, mmGenome);
+    vector<string> children = alignment->getChildNames(name);
+    CuAssertTrue(_testCase, mmAlignment->getChildNames(name) == children);
+    bfQueue.insert(bfQueue.end(), children.begin(), children.end());
+  }
+  validateAlignment(mmAlignment);
+
+  bool threw = false;
+  try
+  {
+    openHalAlignment(mmPath, CLParserPtr());
+  }
+  catch (hal_exception&)
+  {
+    threw = true;
+  }
+  CuAssertTrue(_testCase, threw == true);
+
+  mmAlignment->close();
+  removeTempFile(mmPath);
+}
+
+void MMapConvertTest::checkGenome(const Genome* genome, 
+                                  const Genome* mmGenome)
+{
+  CuAssertTrue(_testCase, genome->getSequenceLength() == 
+               mmGenome->getSequenceLength());
+  CuAssertTrue(_testCase, genome->getNumChildren() == 
+               mmGenome->getNumChildren());
+  CuAssertTrue(_testCase, genome->getNumSequences() == 
+               mmGenome->getNumSequences());
+  CuAssertTrue(_testCase, genome->getNumTopSegments() == 
+               mmGenome->getNumTopSegments());
+  CuAssertTrue(_testCase, genome->getNumBottomSegments() == 
+               mmGenome->getNumBottomSegments());
+  CuAssertTrue(_testCase, genome->getMetaData()->getMap() == 
+               mmGenome->getMetaData()->getMap());
+
+  string dna, mmDna;
+  genome->getString(dna);
+  mmGenome->getString(mmDna);
+  CuAssertTrue(_testCase, dna == mmDna);
+
+  SequenceIteratorConstPtr seqIt = genome->getSequenceIterator();
+  SequenceIteratorConstPtr seqEndIt = genome->getSequenceEndIterator();
+  SequenceIteratorConstPtr mmSeqIt = mmGenome->getSequenceIterator();
+  for (; seqIt != seqEndIt; seqIt->toNext(), mmSeqIt->toNext())
+  {
+    const Sequence* seq = seqIt->getSequence();
+    const Sequence* mmSeq = mmSeqIt->getSequence();
+    CuAssertTrue(_testCase, seq->getName() == mmSeq->getName());
+    CuAssertTrue(_testCase, mmGenome->getSequence(seq->getName()) == mmSeq);
+    CuAssertTrue(_testCase, seq->getStartPosition() == 
+                 mmSeq->getStartPosition());
+    CuAssertTrue(_testCase, seq->getSequenceLength() == 
+                 mmSeq->getSequenceLength());
+    CuAssertTrue(_testCase, seq->getTopSegmentArrayIndex() == 
+                 mmSeq->getTopSegmentArrayIndex());
+    CuAssertTrue(_testCase, seq->getNumTopSegments() == 
+                 mmSeq->getNumTopSegments());
+    CuAssertTrue(_testCase, seq->getBottomSegmentArrayIndex() == 
+                 mmSeq->getBottomSegmentArrayIndex());
+    CuAssertTrue(_testCase, seq->getNumBottomSegments() == 
+                 mmSeq->getNumBottomSegments());
+    if (seq->getSequenceLength() > 0)
+    {
+      CuAssertTrue(_testCase, mmGenome->getSequenceBySite(
+                     mmSeq->getEndPosition()) == mmSeq);
+    }
+  }
+
+  TopSegmentIteratorConstPtr top = genome->getTopSegmentIterator();
+  TopSegmentIteratorConstPtr mmTop = mmGenome->getTopSegmentIterator();
+  hal_size_t numTop = genome->getNumTopSegments();
+  for (; (hal_size_t)top->getArrayIndex() < numTop; top->toRight(),
+         mmTop->toRight())
+  {
+    CuAssertTrue(_testCase, top->getStartPosition() == 
+                 mmTop->getStartPosition());
+    CuAssertTrue(_testCase, top->getLength() == mmTop->getLength());
+    CuAssertTrue(_testCase, top->getParentIndex() == 
+                 mmTop->getParentIndex());
+    CuAssertTrue(_testCase, top->getParentReversed() == 
+                 mmTop->getParentReversed());
+    CuAssertTrue(_testCase, top->getBottomParseIndex() == 
+                 mmTop->getBottomParseIndex());
+    CuAssertTrue(_testCase, top->getNextParalogyIndex() == 
+                 mmTop->getNextParalogyIndex());
+  }
+
+  BottomSegmentIteratorConstPtr bot = genome->getBottomSegmentIterator();
+  BottomSegmentIteratorConstPtr mmBot = mmGenome->getBottomSegmentIterator();
+  hal_size_t numBot = genome->getNumBottomSegments();
+  for (; (hal_size_t)bot->getArrayIndex() < numBot; bot->toRight(),
+         mmBot->toRight())
+  {
+    CuAssertTrue(_testCase, bot->getStartPosition() == 
+                 mmBot->getStartPosition());
+    CuAssertTrue(_testCase, bot->getLength() == mmBot->getLength());
+    CuAssertTrue(_testCase, bot->getTopParseIndex() == 
+                 mmBot->getTopParseIndex());
+    for (hal_size_t i = 0; i < genome->getNumChildren(); ++i)
+    {
+      CuAssertTrue(_testCase, bot->getChildIndex(i) == 
+                   mmBot->getChildIndex(i));
+      CuAssertTrue(_testCase, bot->getChildReversed(i) == 
+                   mmBot->getChildReversed(i));
+    }
+  }
+}
+
+void halMMapConvertTest(CuTest *testCase)
+{
+  try
+  {
+    MMapConvertTest tester;
+    tester.check(testCase);
+  }
+  catch (hal_exception& e)
+  {
+    cerr << e.what() << endl;
+    CuAssertTrue(testCase, false);
+  }
+  catch (...) 
+  {
+    CuAssertTrue(testCase, false);
+  }
+}
+
+CuSuite* halMMapTestSuite(void) 
+{
+  CuSuite* suite = CuSuiteNew();
+  SUITE_ADD_TEST(suite, halMMapConvertTest);
+  return suite;
+}
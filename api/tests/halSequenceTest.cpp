@@ -6,6 +6,7 @@
 #include <string>
 #include <iostream>
 #include <sstream>
+#include <cstdlib>
 #include "halGenomeTest.h"
 #include "halAlignmentTest.h"
 #include "halSequenceTest.h"
@@ -160,7 +161,24 @@ void SequenceIteratorTest::checkCallBack(AlignmentConstPtr alignment)
                    sqBottomSegment->getArrayIndex());
       bsIt->toRight();
     }
+
+    // sequence0 is empty and must never be found by position
+    if (seq->getSequenceLength() > 0)
+    {
+      hal_index_t start = seq->getStartPosition();
+      hal_index_t end = seq->getEndPosition();
+      CuAssertTrue(_testCase, ancGenome->getSequenceBySite(start)->getName()
+                   == seq->getName());
+      CuAssertTrue(_testCase,
+                   ancGenome->getSequenceBySite((start + end) / 2)->getName()
+                   == seq->getName());
+      CuAssertTrue(_testCase, ancGenome->getSequenceBySite(end)->getName()
+                   == seq->getName());
+    }
+    CuAssertTrue(_testCase, ancGenome->getSequence(seq->getName()) == seq);
   }
+  CuAssertTrue(_testCase, ancGenome->getSequenceBySite(
+                 ancGenome->getSequenceLength()) == NULL);
 }
 
 void SequenceUpdateTest::createCallBack(AlignmentPtr alignment)
@@ -270,6 +288,134 @@ void SequenceUpdateTest::checkCallBack(AlignmentConstPtr alignment)
 }
 
 
+// sequence lengths are odd and even so that strings start and end on
+// both halves of a packed DNA byte
+string SequenceStringTest::makeString(hal_size_t length, unsigned int seed)
+{
+  static const char bases[] = "acgtnACGTN";
+  srand(seed);
+  string dna(length, 'a');
+  for (hal_size_t i = 0; i < length; ++i)
+  {
+    dna[i] = bases[rand() % 10];
+  }
+  return dna;
+}
+
+static bool checkBaseCounts(const string& dna, const BaseCounts& counts)
+{
+  BaseCounts truth;
+  for (size_t i = 0; i < dna.length(); ++i)
+  {
+    switch (tolower(dna[i]))
+    {
+    case 'a' : ++truth._a; break;
+    case 'c' : ++truth._c; break;
+    case 'g' : ++truth._g; break;
+    case 't' : ++truth._t; break;
+    case 'n' : ++truth._n; break;
+    default : ++truth._other; break;
+    }
+    if (islower(dna[i]))
+    {
+      ++truth._masked;
+    }
+  }
+  return counts._a == truth._a && counts._c == truth._c && 
+     counts._g == truth._g && counts._t == truth._t && 
+     counts._n == truth._n && counts._other == truth._other &&
+     counts._masked == truth._masked;
+}
+
+void SequenceStringTest::createCallBack(AlignmentPtr alignment)
+{
+  Genome* ancGenome = alignment->addRootGenome("AncGenome", 0);
+  
+  size_t numSequences = 10;
+  vector<Sequence::Info> seqVec;
+  for (size_t i = 0; i < numSequences; ++i)
+  {
+    stringstream ss;
+    ss << "sequence" << i;
+    seqVec.push_back(Sequence::Info(ss.str(), 1 + i * 37, 0, 0));
+  }
+  ancGenome->setDimensions(seqVec);
+
+  bool threw = false;
+  try
+  {
+    ancGenome->setSubString("acgtacgtqacgt", 0, 13);
+  }
+  catch (hal_exception&)
+  {
+    threw = true;
+  }
+  CuAssertTrue(_testCase, threw == true);
+  
+  for (size_t i = 0; i < numSequences; ++i)
+  {
+    Sequence* sequence = ancGenome->getSequence(seqVec[i]._name);
+    string dna = makeString(sequence->getSequenceLength(), i);
+    if (i % 2 == 0)
+    {
+      sequence->setString(dna);
+    }
+    else
+    {
+      // write the reverse complement backwards from the last base
+      DNAIteratorPtr dnaIt = sequence->getDNAIterator(
+        sequence->getSequenceLength() - 1);
+      dnaIt->toReverse();
+      reverseComplement(dna);
+      dnaIt->writeString(dna, dna.length());
+    }
+  }
+}
+
+void SequenceStringTest::checkCallBack(AlignmentConstPtr alignment)
+{
+  const Genome* ancGenome = alignment->openGenome("AncGenome");
+  SequenceIteratorConstPtr seqIt = ancGenome->getSequenceIterator();
+  SequenceIteratorConstPtr endIt = ancGenome->getSequenceEndIterator();
+  string genomeString;
+  for (; seqIt != endIt; seqIt->toNext())
+  {
+    const Sequence* sequence = seqIt->getSequence();
+    hal_size_t len = sequence->getSequenceLength();
+    string dna = makeString(len, sequence->getArrayIndex());
+    string buffer;
+    sequence->getString(buffer);
+    CuAssertTrue(_testCase, buffer == dna);
+    genomeString += dna;
+
+    for (hal_size_t start = 0; start < len; start += 7)
+    {
+      hal_size_t subLen = min(len - start, (hal_size_t)start * 3 + 1);
+      sequence->getSubString(buffer, start, subLen);
+      CuAssertTrue(_testCase, buffer == dna.substr(start, subLen));
+      BaseCounts counts;
+      sequence->getBaseCounts(start, subLen, counts);
+      CuAssertTrue(_testCase, checkBaseCounts(buffer, counts));
+
+      DNAIteratorConstPtr dnaIt = sequence->getDNAIterator(
+        start + subLen - 1);
+      dnaIt->toReverse();
+      dnaIt->readString(buffer, subLen);
+      reverseComplement(buffer);
+      CuAssertTrue(_testCase, buffer == dna.substr(start, subLen));
+      CuAssertTrue(_testCase, dnaIt->getArrayIndex() == 
+                   sequence->getStartPosition() + (hal_index_t)start - 1);
+    }
+  }
+  string buffer;
+  ancGenome->getString(buffer);
+  CuAssertTrue(_testCase, buffer == genomeString);
+  BaseCounts counts;
+  ancGenome->getBaseCounts(0, genomeString.length(), counts);
+  CuAssertTrue(_testCase, checkBaseCounts(genomeString, counts));
+  CuAssertTrue(_testCase, counts.getTotal() == genomeString.length());
+}
+
 void halSequenceCreateTest(CuTest *testCase)
 {
   try
@@ -310,12 +456,26 @@ void halSequenceUpdateTest(CuTest *testCase)
 }
 
 
+void halSequenceStringTest(CuTest *testCase)
+{
+  try
+  {
+    SequenceStringTest tester;
+    tester.check(testCase);
+  }
+  catch (...) 
+  {
+    CuAssertTrue(testCase, false);
+  }
+}
+
 CuSuite* halSequenceTestSuite(void) 
 {
   CuSuite* suite = CuSuiteNew();
   SUITE_ADD_TEST(suite, halSequenceCreateTest);
   SUITE_ADD_TEST(suite, halSequenceIteratorTest);
   SUITE_ADD_TEST(suite, halSequenceUpdateTest);
+  SUITE_ADD_TEST(suite, halSequenceStringTest);
   return suite;
 }
 
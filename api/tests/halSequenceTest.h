@@ -31,4 +31,11 @@ struct SequenceUpdateTest : public AlignmentTest
    void checkCallBack(hal::AlignmentConstPtr alignment);
 };
 
+struct SequenceStringTest : public AlignmentTest
+{
+   void createCallBack(hal::AlignmentPtr alignment);
+   void checkCallBack(hal::AlignmentConstPtr alignment);
+   std::string makeString(hal_size_t length, unsigned int seed);
+};
+
 #endif
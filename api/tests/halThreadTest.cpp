@@ -0,0 +1,295 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include <string>
+#include <iostream>
+#include <deque>
+#include <pthread.h>
+#include <unistd.h>
+#include "halAlignmentTest.h"
+#include "halThreadTest.h"
+#include "halRandomData.h"
+
+extern "C" {
+#include "commonC.h"
+}
+
+using namespace std;
+using namespace hal;
+
+static const hal_size_t numThreads = 8;
+static const hal_size_t numPasses = 4;
+
+struct ThreadSharedReadData
+{
+   AlignmentConstPtr _alignment;
+   hal_size_t _checksum;
+   bool _ok;
+};
+
+// every thread makes and drops lots of copies of its (possibly shared) 
+// alignment pointer along the way, to exercise the reference counts
+static void* threadSharedReadMain(void* arg)
+{
+  ThreadSharedReadData* data = static_cast<ThreadSharedReadData*>(arg);
+  try
+  {
+    for (hal_size_t i = 0; i < numPasses; ++i)
+    {
+      AlignmentConstPtr alignment = data->_alignment;
+      hal_size_t sum = ThreadSharedReadTest::checksum(alignment);
+      if (i > 0 && sum != data->_checksum)
+      {
+        data->_ok = false;
+      }
+      data->_checksum = sum;
+    }
+  }
+  catch (...)
+  {
+    data->_ok = false;
+  }
+  return NULL;
+}
+
+void ThreadSharedReadTest::createCallBack(AlignmentPtr alignment)
+{
+  createRandomAlignment(alignment, 
+                        0.75, 
+                        0.1,
+                        5,
+                        10,
+                        1000,
+                        5,
+                        10);
+}
+
+// touch the dna, segments, parent links and columns of every genome
+hal_size_t ThreadSharedReadTest::checksum(AlignmentConstPtr alignment)
+{
+  hal_size_t sum = 0;
+  deque<string> bfQueue;
+  bfQueue.push_back(alignment->getRootName());
+  while (bfQueue.empty() == false)
+  {
+    const Genome* genome = alignment->openGenome(bfQueue.front());
+    vector<string> children = alignment->getChildNames(bfQueue.front());
+    bfQueue.insert(bfQueue.end(), children.begin(), children.end());
+    bfQueue.pop_front();
+
+    string dna;
+    genome->getString(dna);
+    for (size_t i = 0; i < dna.length(); ++i)
+    {
+      sum = sum * 31 + dna[i];
+    }
+
+    TopSegmentIteratorConstPtr top = genome->getTopSegmentIterator();
+    BottomSegmentIteratorConstPtr parBot;
+    if (genome->getParent() != NULL)
+    {
+      parBot = genome->getParent()->getBottomSegmentIterator();
+    }
+    hal_size_t numTop = genome->getNumTopSegments();
+    for (; (hal_size_t)top->getArrayIndex() < numTop; top->toRight())
+    {
+      sum += top->getStartPosition() + top->getLength();
+      if (top->hasParent() == true)
+      {
+        parBot->toParent(top);
+        sum += parBot->getArrayIndex();
+      }
+    }
+
+    if (genome->getSequenceLength() > 0)
+    {
+      ColumnIteratorConstPtr colIt = genome->getColumnIterator();
+      while (true)
+      {
+        sum += colIt->getColumnMap()->size();
+        if (colIt->lastColumn() == true)
+        {
+          break;
+        }
+        colIt->toRight();
+      }
+    }
+  }
+  return sum;
+}
+
+void ThreadSharedReadTest::checkCallBack(AlignmentConstPtr alignment)
+{
+  hal_size_t expected = checksum(alignment);
+
+  char* mmPath = getTempFile();
+  writeMMapAlignment(alignment, mmPath);
+  CuAssertTrue(_testCase, halAlignmentSupportsThreads(mmPath) == true);
+  vector<AlignmentConstPtr> alignments = 
+     openHalAlignmentReadOnlyPerThread(mmPath, CLParserPtr(), numThreads);
+  CuAssertTrue(_testCase, alignments.size() == numThreads);
+
+  vector<ThreadSharedReadData> data(numThreads);
+  vector<pthread_t> threads(numThreads);
+  for (hal_size_t i = 0; i < numThreads; ++i)
+  {
+    data[i]._alignment = alignments[i];
+    data[i]._checksum = 0;
+    data[i]._ok = true;
+    CuAssertTrue(_testCase, pthread_create(&threads[i], NULL, 
+                                           threadSharedReadMain, 
+                                           &data[i]) == 0);
+  }
+  for (hal_size_t i = 0; i < numThreads; ++i)
+  {
+    pthread_join(threads[i], NULL);
+    CuAssertTrue(_testCase, data[i]._ok == true);
+    CuAssertTrue(_testCase, data[i]._checksum == expected);
+    data[i]._alignment = AlignmentConstPtr();
+  }
+
+  // all copies made by the threads must have been released
+  for (hal_size_t i = 1; i < numThreads; ++i)
+  {
+    alignments[i] = AlignmentConstPtr();
+  }
+  CuAssertTrue(_testCase, alignments[0].unique() == true);
+  alignments[0]->close();
+  removeTempFile(mmPath);
+
+  // hdf5 handles can only be shared with a thread-safe library
+  if (halAlignmentSupportsThreads(_checkPath) == false)
+  {
+    bool threw = false;
+    try
+    {
+      openHalAlignmentReadOnlyPerThread(_checkPath, CLParserPtr(), 
+                                        numThreads);
+    }
+    catch (hal_exception&)
+    {
+      threw = true;
+    }
+    CuAssertTrue(_testCase, threw == true);
+  }
+}
+
+void halThreadSharedReadTest(CuTest *testCase)
+{
+  try
+  {
+    ThreadSharedReadTest tester;
+    tester.check(testCase);
+  }
+  catch (...) 
+  {
+    CuAssertTrue(testCase, false);
+  }
+}
+
+struct SquareWork : public OrderedWorkQueue::Work
+{
+   hal_size_t _in;
+   hal_size_t _out;
+};
+
+// squares numbers, slowly and unevenly so that they finish out of
+// order, and fails on _failOn
+struct SquareWorker : public OrderedWorkQueue::Worker
+{
+   void doWork(OrderedWorkQueue::Work* work)
+   {
+     SquareWork* square = dynamic_cast<SquareWork*>(work);
+     if (square->_in == _failOn)
+     {
+       throw hal_exception("square failed");
+     }
+     usleep((square->_in * 7919) % 13 * 100);
+     square->_out = square->_in * square->_in;
+   }
+   hal_size_t _failOn;
+};
+
+// run numbers through the queue as a tool would, and check that they
+// come back in order, or that the queue throws when one fails
+static bool squareAll(hal_size_t numWork, hal_size_t failOn, 
+                      vector<hal_size_t>& squares)
+{
+  vector<SquareWorker> workers(numThreads);
+  vector<OrderedWorkQueue::Worker*> workerPtrs;
+  for (size_t i = 0; i < workers.size(); ++i)
+  {
+    workers[i]._failOn = failOn;
+    workerPtrs.push_back(&workers[i]);
+  }
+  squares.clear();
+  try
+  {
+    OrderedWorkQueue queue(workerPtrs, 5);
+    for (hal_size_t i = 0; i < numWork; ++i)
+    {
+      SquareWork* work = new SquareWork();
+      work->_in = i;
+      queue.push(work);
+      while (queue.isFull() == true)
+      {
+        SquareWork* done = dynamic_cast<SquareWork*>(queue.pop());
+        squares.push_back(done->_out);
+        delete done;
+      }
+    }
+    while (queue.isEmpty() == false)
+    {
+      SquareWork* done = dynamic_cast<SquareWork*>(queue.pop());
+      squares.push_back(done->_out);
+      delete done;
+    }
+    if (queue.pop() != NULL)
+    {
+      return false;
+    }
+  }
+  catch (hal_exception&)
+  {
+    return false;
+  }
+  return true;
+}
+
+void halOrderedWorkQueueTest(CuTest *testCase)
+{
+  try
+  {
+    vector<hal_size_t> squares;
+    hal_size_t numWork = 200;
+    CuAssertTrue(testCase, squareAll(numWork, numWork, squares) == true);
+    CuAssertTrue(testCase, squares.size() == numWork);
+    for (hal_size_t i = 0; i < squares.size(); ++i)
+    {
+      CuAssertTrue(testCase, squares[i] == i * i);
+    }
+
+    // the work before the failure may or may not have been popped, but
+    // never anything after it
+    CuAssertTrue(testCase, squareAll(numWork, 57, squares) == false);
+    CuAssertTrue(testCase, squares.size() <= 57);
+    for (hal_size_t i = 0; i < squares.size(); ++i)
+    {
+      CuAssertTrue(testCase, squares[i] == i * i);
+    }
+  }
+  catch (...) 
+  {
+    CuAssertTrue(testCase, false);
+  }
+}
+
+CuSuite* halThreadTestSuite(void) 
+{
+  CuSuite* suite = CuSuiteNew();
+  SUITE_ADD_TEST(suite, halThreadSharedReadTest);
+  SUITE_ADD_TEST(suite, halOrderedWorkQueueTest);
+  return suite;
+}
@@ -0,0 +1,22 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _HALTHREADTEST_H
+#define _HALTHREADTEST_H
+
+#include <vector>
+#include "halAlignmentTest.h"
+#include "hal.h"
+#include "allTests.h"
+
+struct ThreadSharedReadTest : public AlignmentTest
+{
+   void createCallBack(hal::AlignmentPtr alignment);
+   void checkCallBack(hal::AlignmentConstPtr alignment);
+   static hal_size_t checksum(hal::AlignmentConstPtr alignment);
+};
+
+#endif
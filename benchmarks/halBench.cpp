@@ -0,0 +1,622 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <new>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include "hal.h"
+#include "halRandomData.h"
+#include "halBlockLiftover.h"
+#include "halMafExport.h"
+#include "halBlockViz.h"
+
+using namespace std;
+using namespace hal;
+
+// Times the API's hot paths on an alignment made by createRandomAlignment()
+// with one of halRandGen's presets (or on a given file), and prints the
+// results as JSON or CSV, one record per benchmark, so runs can be compared
+// by script.  Throughput is operations per second of wall time, where an
+// operation is whatever the benchmark counts (segments, bases, columns,
+// queries...).  Allocations are calls to operator new made during the
+// benchmark (C allocations, as in the blockViz API, aren't counted).  Peak
+// RSS is the process's high water mark at the end of the benchmark, so it
+// only ever grows from one benchmark to the next.
+
+// operator delete can't throw (dynamic exception specifications are gone
+// from C++17, which newer compilers default to)
+#if __cplusplus >= 201103L
+#define BENCH_NOEXCEPT noexcept
+#else
+#define BENCH_NOEXCEPT throw()
+#endif
+
+static hal_size_t numAllocations = 0;
+static hal_size_t numAllocatedBytes = 0;
+
+void* operator new(size_t size)
+{
+  __sync_fetch_and_add(&numAllocations, 1);
+  __sync_fetch_and_add(&numAllocatedBytes, size);
+  void* p = malloc(size == 0 ? 1 : size);
+  if (p == NULL)
+  {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void* operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+void operator delete(void* p) BENCH_NOEXCEPT
+{
+  free(p);
+}
+
+void operator delete[](void* p) BENCH_NOEXCEPT
+{
+  free(p);
+}
+
+// same as halRandGen's
+struct Preset
+{
+   const char* _name;
+   double _meanDegree;
+   double _maxBranchLength;
+   hal_size_t _maxGenomes;
+   hal_size_t _minSegmentLength;
+   hal_size_t _maxSegmentLength;
+   hal_size_t _minSegments;
+   hal_size_t _maxSegments;
+};
+
+static const Preset presets[] = {
+  {"small", 0.75, 0.1, 5, 10, 1000, 5, 10},
+  {"medium", 1.25, 0.7, 20, 2, 50, 1000, 50000},
+  {"big", 2, 0.7, 50, 2, 500, 100, 5000},
+  {"large", 2, 1, 100, 2, 10, 10000, 500000}
+};
+
+struct BenchOptions
+{
+   string _preset;
+   int _seed;
+   string _halPath;
+   bool _mmap;
+   string _format;
+   string _only;
+   hal_size_t _maxBases;
+   hal_size_t _maxQueries;
+};
+
+struct BenchContext
+{
+   BenchOptions _options;
+   string _path;
+   AlignmentConstPtr _alignment;
+   // the first two leaves (or a leaf and the root)
+   const Genome* _refGenome;
+   const Genome* _otherGenome;
+};
+
+struct BenchResult
+{
+   string _name;
+   hal_size_t _operations;
+   double _seconds;
+   hal_size_t _allocations;
+   hal_size_t _allocatedBytes;
+   long _peakRSSKb;
+};
+
+static double wallTime()
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static long peakRSSKb()
+{
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+  return usage.ru_maxrss / 1024;
+#else
+  return usage.ru_maxrss;
+#endif
+}
+
+static hal_size_t randomPosition(hal_size_t length)
+{
+  return ((hal_size_t)rand() * RAND_MAX + rand()) % length;
+}
+
+// walk the top segments of every genome
+static hal_size_t benchSegmentScan(BenchContext& ctx, hal_size_t& checksum)
+{
+  hal_size_t numSegments = 0;
+  vector<string> names(1, ctx._alignment->getRootName());
+  for (size_t i = 0; i < names.size() &&
+          numSegments < ctx._options._maxBases; ++i)
+  {
+    vector<string> children = ctx._alignment->getChildNames(names[i]);
+    names.insert(names.end(), children.begin(), children.end());
+    const Genome* genome = ctx._alignment->openGenome(names[i]);
+    if (genome->getNumTopSegments() == 0)
+    {
+      continue;
+    }
+    TopSegmentIteratorConstPtr top = genome->getTopSegmentIterator();
+    TopSegmentIteratorConstPtr end = genome->getTopSegmentEndIterator();
+    for (; top->equals(end) == false &&
+            numSegments < ctx._options._maxBases; top->toRight())
+    {
+      checksum += top->getLength() + top->getTopSegment()->getParentIndex();
+      ++numSegments;
+    }
+  }
+  return numSegments;
+}
+
+// jump to random positions of the reference
+static hal_size_t benchSegmentRandom(BenchContext& ctx, hal_size_t& checksum)
+{
+  const Genome* genome = ctx._refGenome;
+  if (genome->getNumTopSegments() == 0)
+  {
+    return 0;
+  }
+  TopSegmentIteratorConstPtr top = genome->getTopSegmentIterator();
+  hal_size_t length = genome->getSequenceLength();
+  for (hal_size_t i = 0; i < ctx._options._maxQueries; ++i)
+  {
+    top->toSite(randomPosition(length));
+    checksum += top->getArrayIndex();
+  }
+  return ctx._options._maxQueries;
+}
+
+// read the reference's DNA in chunks
+static hal_size_t benchDNADecode(BenchContext& ctx, hal_size_t& checksum)
+{
+  const Genome* genome = ctx._refGenome;
+  hal_size_t length = min(genome->getSequenceLength(),
+                          ctx._options._maxBases);
+  const hal_size_t chunkLength = 100000;
+  string buffer;
+  for (hal_size_t start = 0; start < length; start += chunkLength)
+  {
+    genome->getSubString(buffer, start, min(chunkLength, length - start));
+    checksum += buffer[0];
+  }
+  return length;
+}
+
+// iterate over the columns of the reference
+static hal_size_t benchColumnIteration(BenchContext& ctx,
+                                       hal_size_t& checksum)
+{
+  const Genome* genome = ctx._refGenome;
+  hal_size_t length = min(genome->getSequenceLength(),
+                          ctx._options._maxBases);
+  if (length == 0)
+  {
+    return 0;
+  }
+  ColumnIteratorConstPtr colIt = genome->getColumnIterator(
+    NULL, 0, 0, length - 1);
+  hal_size_t numColumns = 0;
+  while (true)
+  {
+    checksum += colIt->getColumnMap()->size();
+    ++numColumns;
+    if (colIt->lastColumn() == true)
+    {
+      break;
+    }
+    colIt->toRight();
+    if (numColumns % 1000 == 0)
+    {
+      colIt->defragment();
+    }
+  }
+  return numColumns;
+}
+
+// map the reference's segments to the other genome
+static hal_size_t benchMappedSegments(BenchContext& ctx, hal_size_t& checksum)
+{
+  const Genome* genome = ctx._refGenome;
+  hal_size_t numSegments = 0;
+  if (genome->getNumTopSegments() == 0)
+  {
+    return 0;
+  }
+  TopSegmentIteratorConstPtr top = genome->getTopSegmentIterator();
+  TopSegmentIteratorConstPtr end = genome->getTopSegmentEndIterator();
+  set<MappedSegmentConstPtr> mappedSegments;
+  for (; top->equals(end) == false &&
+          numSegments < ctx._options._maxQueries; top->toRight())
+  {
+    mappedSegments.clear();
+    top->getMappedSegments(mappedSegments, ctx._otherGenome);
+    checksum += mappedSegments.size();
+    ++numSegments;
+  }
+  return numSegments;
+}
+
+// lift random intervals of the reference to the other genome
+static hal_size_t benchLiftover(BenchContext& ctx, hal_size_t& checksum)
+{
+  const Genome* genome = ctx._refGenome;
+  stringstream inBed;
+  hal_size_t numLines = 0;
+  for (; numLines < ctx._options._maxQueries / 10; ++numLines)
+  {
+    const Sequence* sequence = genome->getSequenceBySite(
+      randomPosition(genome->getSequenceLength()));
+    hal_size_t length = sequence->getSequenceLength();
+    hal_size_t start = randomPosition(length);
+    hal_size_t end = min(length, start + 1 + rand() % 1000);
+    inBed << sequence->getName() << '\t' << start << '\t' << end << '\n';
+  }
+  stringstream outBed;
+  BlockLiftover liftover;
+  liftover.convert(ctx._alignment, genome, &inBed, ctx._otherGenome,
+                   &outBed, 3, 3);
+  checksum += outBed.str().length();
+  return numLines;
+}
+
+// export the start of the reference as MAF
+static hal_size_t benchMafExport(BenchContext& ctx, hal_size_t& checksum)
+{
+  const Genome* genome = ctx._refGenome;
+  hal_size_t length = min(genome->getSequenceLength(),
+                          ctx._options._maxBases);
+  stringstream maf;
+  MafExport mafExport;
+  mafExport.convertSegmentedSequence(maf, ctx._alignment, genome, 0, length,
+                                     set<const Genome*>());
+  checksum += maf.str().length();
+  return length;
+}
+
+// query windows along the reference's first sequence through the C API,
+// the way the browser does
+static hal_size_t benchBlockViz(BenchContext& ctx, hal_size_t& checksum)
+{
+  const Sequence* sequence = ctx._refGenome->getSequenceIterator()->
+     getSequence();
+  hal_size_t length = sequence->getSequenceLength();
+  const hal_size_t windowLength = 10000;
+  vector<char> path(ctx._path.begin(), ctx._path.end());
+  path.push_back('\0');
+  vector<char> qSpecies(ctx._otherGenome->getName().begin(),
+                        ctx._otherGenome->getName().end());
+  qSpecies.push_back('\0');
+  vector<char> tSpecies(ctx._refGenome->getName().begin(),
+                        ctx._refGenome->getName().end());
+  tSpecies.push_back('\0');
+  vector<char> tChrom(sequence->getName().begin(),
+                      sequence->getName().end());
+  tChrom.push_back('\0');
+
+  char* error = NULL;
+  int handle = halOpen(&path[0], &error);
+  if (handle < 0)
+  {
+    string message = error != NULL ? error : "error opening " + ctx._path;
+    free(error);
+    throw hal_exception(message);
+  }
+  hal_size_t numQueries = 0;
+  for (hal_size_t start = 0; start < length &&
+          numQueries < ctx._options._maxQueries / 100; start += windowLength)
+  {
+    hal_block_results_t* results = halGetBlocksInTargetRange(
+      handle, &qSpecies[0], &tSpecies[0], &tChrom[0], start,
+      min(start + windowLength, length), 0, HAL_NO_SEQUENCE,
+      HAL_QUERY_DUPS, 1, NULL, &error);
+    if (results == NULL)
+    {
+      string message = error != NULL ? error : "blockViz query failed";
+      free(error);
+      halClose(handle, NULL);
+      throw hal_exception(message);
+    }
+    for (hal_block_t* block = results->mappedBlocks; block != NULL;
+         block = block->next)
+    {
+      ++checksum;
+    }
+    halFreeBlockResults(results);
+    ++numQueries;
+  }
+  halClose(handle, NULL);
+  return numQueries;
+}
+
+typedef hal_size_t (*BenchFunction)(BenchContext&, hal_size_t&);
+
+struct Benchmark
+{
+   const char* _name;
+   BenchFunction _function;
+};
+
+static const Benchmark benchmarks[] = {
+  {"segmentScan", benchSegmentScan},
+  {"segmentRandom", benchSegmentRandom},
+  {"dnaDecode", benchDNADecode},
+  {"columnIteration", benchColumnIteration},
+  {"mappedSegments", benchMappedSegments},
+  {"liftover", benchLiftover},
+  {"mafExport", benchMafExport},
+  {"blockViz", benchBlockViz}
+};
+
+static BenchResult runBenchmark(const Benchmark& benchmark, BenchContext& ctx,
+                                hal_size_t& checksum)
+{
+  srand(ctx._options._seed);
+  BenchResult result;
+  result._name = benchmark._name;
+  hal_size_t allocations = numAllocations;
+  hal_size_t allocatedBytes = numAllocatedBytes;
+  double start = wallTime();
+  result._operations = benchmark._function(ctx, checksum);
+  result._seconds = wallTime() - start;
+  result._allocations = numAllocations - allocations;
+  result._allocatedBytes = numAllocatedBytes - allocatedBytes;
+  result._peakRSSKb = peakRSSKb();
+  return result;
+}
+
+static void printResults(ostream& os, const BenchContext& ctx,
+                         const vector<BenchResult>& results)
+{
+  const BenchOptions& options = ctx._options;
+  if (options._format == "csv")
+  {
+    os << "preset,seed,benchmark,operations,seconds,throughput,"
+       << "allocations,allocatedBytes,peakRSSKb\n";
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+      const BenchResult& r = results[i];
+      os << options._preset << ',' << options._seed << ',' << r._name << ','
+         << r._operations << ',' << r._seconds << ','
+         << (r._seconds > 0 ? r._operations / r._seconds : 0) << ','
+         << r._allocations << ',' << r._allocatedBytes << ','
+         << r._peakRSSKb << '\n';
+    }
+  }
+  else
+  {
+    os << "{\n  \"preset\": \"" << options._preset << "\",\n"
+       << "  \"seed\": " << options._seed << ",\n"
+       << "  \"mmap\": " << (options._mmap ? "true" : "false") << ",\n"
+       << "  \"genomes\": " << ctx._alignment->getNumGenomes() << ",\n"
+       << "  \"refGenome\": \"" << ctx._refGenome->getName() << "\",\n"
+       << "  \"refLength\": " << ctx._refGenome->getSequenceLength() << ",\n"
+       << "  \"results\": [";
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+      const BenchResult& r = results[i];
+      os << (i > 0 ? "," : "") << "\n    {\"benchmark\": \"" << r._name
+         << "\", \"operations\": " << r._operations
+         << ", \"seconds\": " << r._seconds
+         << ", \"throughput\": "
+         << (r._seconds > 0 ? r._operations / r._seconds : 0)
+         << ", \"allocations\": " << r._allocations
+         << ", \"allocatedBytes\": " << r._allocatedBytes
+         << ", \"peakRSSKb\": " << r._peakRSSKb << "}";
+    }
+    os << "\n  ]\n}\n";
+  }
+}
+
+static void printUsage()
+{
+  cerr << "usage: halBench [options]\n"
+       << "Time the API's hot paths on a random alignment\n"
+       << "[options]:\n"
+       << "--preset <small, medium, big, large> [small]\n"
+       << "--seed <int> [0]\n"
+       << "--halFile <path>: benchmark this file instead of making one\n"
+       << "--mmap: convert the alignment to a memory-mapped file first\n"
+       << "--format <json, csv> [json]\n"
+       << "--only <name>: run only this benchmark (segmentScan, "
+       << "segmentRandom, dnaDecode, columnIteration, mappedSegments, "
+       << "liftover, mafExport, blockViz)\n"
+       << "--maxBases <int>: bases or segments per scan [10000000]\n"
+       << "--maxQueries <int>: random queries per benchmark [100000]\n";
+}
+
+static bool parseOptions(int argc, char** argv, BenchOptions& options)
+{
+  options._preset = "small";
+  options._seed = 0;
+  options._mmap = false;
+  options._format = "json";
+  options._maxBases = 10000000;
+  options._maxQueries = 100000;
+  for (int i = 1; i < argc; ++i)
+  {
+    string arg = argv[i];
+    if (arg == "--mmap")
+    {
+      options._mmap = true;
+      continue;
+    }
+    if (i + 1 >= argc)
+    {
+      return false;
+    }
+    string val = argv[++i];
+    if (arg == "--preset")
+    {
+      options._preset = val;
+    }
+    else if (arg == "--seed")
+    {
+      options._seed = atoi(val.c_str());
+    }
+    else if (arg == "--halFile")
+    {
+      options._halPath = val;
+    }
+    else if (arg == "--format")
+    {
+      options._format = val;
+    }
+    else if (arg == "--only")
+    {
+      options._only = val;
+    }
+    else if (arg == "--maxBases")
+    {
+      options._maxBases = strtoul(val.c_str(), NULL, 10);
+    }
+    else if (arg == "--maxQueries")
+    {
+      options._maxQueries = strtoul(val.c_str(), NULL, 10);
+    }
+    else
+    {
+      return false;
+    }
+  }
+  return options._format == "json" || options._format == "csv";
+}
+
+static string makeTempPath(const string& suffix)
+{
+  const char* tempDir = getenv("TMPDIR");
+  string path = string(tempDir != NULL ? tempDir : "/tmp") +
+     "/halBenchXXXXXX";
+  vector<char> buffer(path.begin(), path.end());
+  buffer.push_back('\0');
+  int fd = mkstemp(&buffer[0]);
+  if (fd < 0)
+  {
+    throw hal_exception("error creating temporary file " + path);
+  }
+  close(fd);
+  unlink(&buffer[0]);
+  return string(&buffer[0]) + suffix;
+}
+
+int main(int argc, char** argv)
+{
+  BenchContext ctx;
+  if (parseOptions(argc, argv, ctx._options) == false)
+  {
+    printUsage();
+    return 1;
+  }
+  BenchOptions& options = ctx._options;
+  vector<string> tempPaths;
+  int ret = 0;
+  try
+  {
+    ctx._path = options._halPath;
+    if (ctx._path.empty() == true)
+    {
+      const Preset* preset = NULL;
+      for (size_t i = 0; i < sizeof(presets) / sizeof(presets[0]); ++i)
+      {
+        if (options._preset == presets[i]._name)
+        {
+          preset = &presets[i];
+        }
+      }
+      if (preset == NULL)
+      {
+        throw hal_exception("unknown preset " + options._preset);
+      }
+      ctx._path = makeTempPath(".hal");
+      tempPaths.push_back(ctx._path);
+      AlignmentPtr alignment = hdf5AlignmentInstance();
+      alignment->createNew(ctx._path);
+      createRandomAlignment(alignment, preset->_meanDegree,
+                            preset->_maxBranchLength, preset->_maxGenomes,
+                            preset->_minSegmentLength,
+                            preset->_maxSegmentLength,
+                            preset->_minSegments, preset->_maxSegments,
+                            options._seed);
+      alignment->close();
+    }
+    else
+    {
+      options._preset = "file";
+    }
+    if (options._mmap == true)
+    {
+      string mmapPath = makeTempPath(".mmap.hal");
+      tempPaths.push_back(mmapPath);
+      writeMMapAlignment(openHalAlignmentReadOnly(ctx._path, CLParserPtr()),
+                         mmapPath);
+      ctx._path = mmapPath;
+    }
+
+    ctx._alignment = openHalAlignmentReadOnly(ctx._path, CLParserPtr());
+    vector<string> leaves = ctx._alignment->getLeafNamesBelow(
+      ctx._alignment->getRootName());
+    if (leaves.empty() == true)
+    {
+      throw hal_exception("alignment has no leaves");
+    }
+    ctx._refGenome = ctx._alignment->openGenome(leaves[0]);
+    ctx._otherGenome = ctx._alignment->openGenome(
+      leaves.size() > 1 ? leaves[1] : ctx._alignment->getRootName());
+    if (ctx._refGenome->getSequenceLength() == 0)
+    {
+      throw hal_exception("reference genome " + leaves[0] + " is empty");
+    }
+
+    vector<BenchResult> results;
+    hal_size_t checksum = 0;
+    for (size_t i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); ++i)
+    {
+      if (options._only.empty() || options._only == benchmarks[i]._name)
+      {
+        results.push_back(runBenchmark(benchmarks[i], ctx, checksum));
+      }
+    }
+    if (results.empty() == true)
+    {
+      throw hal_exception("unknown benchmark " + options._only);
+    }
+    printResults(cout, ctx, results);
+    // so that the work can't be optimized away
+    cerr << "checksum " << checksum << endl;
+    ctx._alignment = AlignmentConstPtr();
+  }
+  catch (exception& e)
+  {
+    cerr << "Exception caught: " << e.what() << endl;
+    ret = 1;
+  }
+  for (size_t i = 0; i < tempPaths.size(); ++i)
+  {
+    remove(tempPaths[i].c_str());
+  }
+  return ret;
+}
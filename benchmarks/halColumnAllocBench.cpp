@@ -0,0 +1,126 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include "hal.h"
+
+using namespace std;
+using namespace hal;
+
+// count heap allocations made while iterating columns, to see how much
+// the column iterator allocates for each column it visits.  built by
+// make in this directory; run it on the same alignment before and after
+// changing the iterator.
+
+// operator delete can't throw (dynamic exception specifications are gone
+// from C++17, which newer compilers default to)
+#if __cplusplus >= 201103L
+#define BENCH_NOEXCEPT noexcept
+#else
+#define BENCH_NOEXCEPT throw()
+#endif
+
+static size_t allocCount = 0;
+
+void* operator new(size_t size)
+{
+  ++allocCount;
+  void* p = malloc(size > 0 ? size : 1);
+  if (p == NULL)
+  {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void* p) BENCH_NOEXCEPT
+{
+  free(p);
+}
+
+void* operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+void operator delete[](void* p) BENCH_NOEXCEPT
+{
+  operator delete(p);
+}
+
+// visit numColumns columns with toRight()
+static double scanColumns(const Genome* genome, hal_size_t numColumns)
+{
+  ColumnIteratorConstPtr colIt = genome->getColumnIterator();
+  size_t before = allocCount;
+  hal_size_t count = 0;
+  for (; count < numColumns && colIt->lastColumn() == false; ++count)
+  {
+    colIt->toRight();
+  }
+  return count > 0 ? (double)(allocCount - before) / count : 0.;
+}
+
+// visit numColumns columns, jumping with toSite() every jump columns
+// (which resets the links the way a liftover or browser query would)
+static double jumpColumns(const Genome* genome, hal_size_t numColumns,
+                          hal_size_t jump)
+{
+  ColumnIteratorConstPtr colIt = genome->getColumnIterator();
+  hal_index_t last = (hal_index_t)genome->getSequenceLength() - 1;
+  size_t before = allocCount;
+  hal_size_t count = 0;
+  for (hal_index_t pos = 0; count < numColumns && pos <= last;
+       pos += (hal_index_t)jump)
+  {
+    colIt->toSite(pos, last);
+    for (hal_size_t i = 1; i < jump && count < numColumns &&
+            colIt->lastColumn() == false; ++i, ++count)
+    {
+      colIt->toRight();
+    }
+    ++count;
+  }
+  return count > 0 ? (double)(allocCount - before) / count : 0.;
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 3 || argc > 5)
+  {
+    cerr << "usage : halColumnAllocBench <halFile> <refGenome> "
+         << "[numColumns (default 100000)] [jump (default 100)]" << endl;
+    return 1;
+  }
+  string halPath = argv[1];
+  string refName = argv[2];
+  hal_size_t numColumns = argc > 3 ? strtoul(argv[3], NULL, 10) : 100000;
+  hal_size_t jump = argc > 4 ? strtoul(argv[4], NULL, 10) : 100;
+  try
+  {
+    AlignmentConstPtr alignment = openHalAlignmentReadOnly(halPath,
+                                                           CLParserPtr());
+    const Genome* genome = alignment->openGenome(refName);
+    if (genome == NULL || genome->getSequenceLength() == 0 || jump == 0)
+    {
+      throw hal_exception("reference genome " + refName +
+                          " not found or empty (or jump is 0)");
+    }
+    cout << "genomes: " << alignment->getNumGenomes() << "\n"
+         << "allocations / column (toRight): "
+         << scanColumns(genome, numColumns) << "\n"
+         << "allocations / column (toSite every " << jump << "): "
+         << jumpColumns(genome, numColumns, jump) << endl;
+  }
+  catch (exception& e)
+  {
+    cerr << "Exception caught: " << e.what() << endl;
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,82 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include <cstdlib>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <sys/resource.h>
+#include "hal.h"
+#include "halMafExport.h"
+
+using namespace std;
+using namespace hal;
+
+// peak memory of hal2maf --global with and without --maxMemory.  the peak
+// can only go up within a process, so run once per setting and compare
+// the numbers, eg
+//   halMafExportRSSBench in.hal 0
+//   halMafExportRSSBench in.hal 1000000000 1500
+// the second form exits with status 2 if the peak resident set is over
+// 1500 MB, so it can be used as a regression test on a known alignment.
+// built by make in this directory
+
+// peak resident set size in megabytes
+static double peakRSS()
+{
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+  {
+    return 0.;
+  }
+  // kilobytes on linux
+  return usage.ru_maxrss / 1024.;
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 2 || argc > 4)
+  {
+    cerr << "usage : halMafExportRSSBench <halFile> "
+         << "[maxMemory in bytes (default 0 = no limit)] "
+         << "[maximum peak RSS in MB]" << endl;
+    return 1;
+  }
+  string halPath = argv[1];
+  hal_size_t maxMemory = argc > 2 ? strtoull(argv[2], NULL, 10) : 0;
+  double maxRSS = argc > 3 ? strtod(argv[3], NULL) : 0.;
+  double rss = 0.;
+  try
+  {
+    AlignmentConstPtr alignment = openHalAlignmentReadOnly(halPath,
+                                                           CLParserPtr());
+    double openRSS = peakRSS();
+    ofstream mafStream("/dev/null");
+    MafExport mafExport;
+    mafExport.setMaxMemory(maxMemory);
+    clock_t start = clock();
+    mafExport.convertEntireAlignment(mafStream, alignment);
+    double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    rss = peakRSS();
+    cout << "genomes: " << alignment->getNumGenomes() << "\n"
+         << "maxMemory: " << maxMemory << "\n"
+         << "peak RSS after open (MB): " << openRSS << "\n"
+         << "peak RSS (MB): " << rss << "\n"
+         << "cpu seconds: " << seconds << endl;
+  }
+  catch (exception& e)
+  {
+    cerr << "Exception caught: " << e.what() << endl;
+    return 1;
+  }
+  if (maxRSS > 0. && rss > maxRSS)
+  {
+    cerr << "peak RSS " << rss << " MB is over the limit of " << maxRSS
+         << " MB" << endl;
+    return 2;
+  }
+  return 0;
+}
@@ -0,0 +1,193 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <map>
+#include <vector>
+#include "halPositionCache.h"
+
+using namespace std;
+using namespace hal;
+
+// compare PositionCache with the std::map version it replaced, on the
+// insertion patterns the column iterator and friends produce.  built by make
+// in this directory
+
+/** The old map-based cache (minus the debugging), as a baseline */
+class MapPositionCache
+{
+public:
+   MapPositionCache() : _size(0), _prev(_set.end()) {}
+   bool insert(hal_index_t pos);
+   bool find(hal_index_t pos) const;
+   hal_size_t size() const { return _size; }
+   hal_size_t numIntervals() const { return _set.size(); }
+protected:
+   typedef map<hal_index_t, hal_index_t> IntervalSet;
+   IntervalSet _set;
+   hal_size_t _size;
+   IntervalSet::iterator _prev;
+};
+
+bool MapPositionCache::insert(hal_index_t pos)
+{
+  IntervalSet::iterator i;
+  if (_prev != _set.end() && _prev->first == pos - 1)
+  {
+    ++_prev;
+    i = _prev;
+  }
+  else
+  {
+    i = _set.lower_bound(pos);
+  }
+  _prev = i;
+  IntervalSet::iterator j;
+  if (i != _set.end() && i->second <= pos)
+  {
+    return false;
+  }
+  if (i != _set.end() && i->second == pos + 1)
+  {
+    --i->second;
+  }
+  else
+  {
+    j = i;
+    if (j != _set.begin())
+    {
+      --j;
+    }
+    i = _set.insert(j, pair<hal_index_t, hal_index_t>(pos, pos));
+    _prev = i;
+  }
+  if (i != _set.begin())
+  {
+    j = i;
+    --j;
+    if (j->first == i->second - 1)
+    {
+      i->second = j->second;
+      _set.erase(j);
+    }    
+  }
+  j = i;
+  ++j;
+  if ( j != _set.end() && j->second == i->first + 1)
+  {
+     j->second = i->second;
+     _set.erase(i);
+  }
+  ++_size;
+  return true;
+}
+
+bool MapPositionCache::find(hal_index_t pos) const
+{
+  IntervalSet::const_iterator i = _set.lower_bound(pos);
+  return i != _set.end() && i->second <= pos;
+}
+
+// positions to insert, then positions to look up
+struct Pattern
+{
+   const char* _name;
+   vector<hal_index_t> _inserts;
+   vector<hal_index_t> _finds;
+};
+
+static void makePatterns(hal_size_t n, vector<Pattern>& patterns)
+{
+  patterns.resize(4);
+  patterns[0]._name = "contiguous scan";
+  patterns[1]._name = "scan with gaps";
+  patterns[2]._name = "scan with 5% backfill";
+  patterns[3]._name = "random";
+  hal_index_t gapPos = 0;
+  hal_index_t backPos = 0;
+  for (hal_size_t i = 0; i < n; ++i)
+  {
+    patterns[0]._inserts.push_back((hal_index_t)i);
+    gapPos += 1 + (rand() % 4 == 0 ? rand() % 10 : 0);
+    patterns[1]._inserts.push_back(gapPos);
+    if (rand() % 20 == 0)
+    {
+      patterns[2]._inserts.push_back((hal_index_t)rand() % (backPos + 1));
+    }
+    else
+    {
+      backPos += 1 + (rand() % 4 == 0 ? rand() % 10 : 0);
+      patterns[2]._inserts.push_back(backPos);
+    }
+    patterns[3]._inserts.push_back((hal_index_t)rand() % (hal_index_t)(4 * n));
+  }
+  for (size_t p = 0; p < patterns.size(); ++p)
+  {
+    for (hal_size_t i = 0; i < n; ++i)
+    {
+      patterns[p]._finds.push_back((hal_index_t)rand() % (hal_index_t)(4 * n));
+    }
+  }
+}
+
+template <typename Cache>
+static void runPattern(const Pattern& pattern, double& insertSecs, 
+                       double& findSecs, hal_size_t& numIntervals,
+                       hal_size_t& checksum)
+{
+  Cache cache;
+  clock_t start = clock();
+  for (size_t i = 0; i < pattern._inserts.size(); ++i)
+  {
+    cache.insert(pattern._inserts[i]);
+  }
+  clock_t mid = clock();
+  hal_size_t found = 0;
+  for (size_t i = 0; i < pattern._finds.size(); ++i)
+  {
+    found += cache.find(pattern._finds[i]) ? 1 : 0;
+  }
+  clock_t end = clock();
+  insertSecs = (double)(mid - start) / CLOCKS_PER_SEC;
+  findSecs = (double)(end - mid) / CLOCKS_PER_SEC;
+  numIntervals = cache.numIntervals();
+  checksum = cache.size() + found;
+}
+
+int main(int argc, char** argv)
+{
+  if (argc > 2)
+  {
+    cerr << "usage : halPositionCacheBench [numPositions (default 10000000)]"
+         << endl;
+    return 1;
+  }
+  hal_size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000000;
+  srand(42);
+  vector<Pattern> patterns;
+  makePatterns(n, patterns);
+  cout << "pattern\tintervals\tmap insert(s)\tcache insert(s)"
+       << "\tmap find(s)\tcache find(s)\n";
+  for (size_t p = 0; p < patterns.size(); ++p)
+  {
+    double mapInsert, mapFind, cacheInsert, cacheFind;
+    hal_size_t mapIntervals, cacheIntervals, mapSum, cacheSum;
+    runPattern<MapPositionCache>(patterns[p], mapInsert, mapFind,
+                                 mapIntervals, mapSum);
+    runPattern<PositionCache>(patterns[p], cacheInsert, cacheFind,
+                              cacheIntervals, cacheSum);
+    if (mapIntervals != cacheIntervals || mapSum != cacheSum)
+    {
+      cerr << "caches disagree on " << patterns[p]._name << endl;
+      return 1;
+    }
+    cout << patterns[p]._name << "\t" << cacheIntervals << "\t" 
+         << mapInsert << "\t" << cacheInsert << "\t"
+         << mapFind << "\t" << cacheFind << "\n";
+  }
+  return 0;
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+#include <cstdlib>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include "hal.h"
+
+using namespace std;
+using namespace hal;
+
+// time Genome::getSequenceBySite() on a genome, both walking along it 
+// (as the DNA and segment iterators do) and jumping around at random.
+// most useful on a genome with lots of scaffolds.  built by make in
+// this directory
+
+static double timeLookups(const Genome* genome, hal_size_t numLookups,
+                          bool random, hal_size_t& checksum)
+{
+  hal_size_t length = genome->getSequenceLength();
+  hal_size_t step = max((hal_size_t)1, length / numLookups);
+  clock_t start = clock();
+  for (hal_size_t i = 0; i < numLookups; ++i)
+  {
+    hal_size_t pos = random ? 
+       ((hal_size_t)rand() * RAND_MAX + rand()) % length : 
+       (i * step) % length;
+    checksum += genome->getSequenceBySite(pos)->getArrayIndex();
+  }
+  return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+int main(int argc, char** argv)
+{
+  if (argc < 3 || argc > 4)
+  {
+    cerr << "usage : halSequenceBySiteBench <halFile> <genome> "
+         << "[numLookups (default 10000000)]" << endl;
+    return 1;
+  }
+  string halPath = argv[1];
+  string genomeName = argv[2];
+  hal_size_t numLookups = argc > 3 ? strtoul(argv[3], NULL, 10) : 10000000;
+  try
+  {
+    AlignmentConstPtr alignment = openHalAlignmentReadOnly(halPath,
+                                                           CLParserPtr());
+    const Genome* genome = alignment->openGenome(genomeName);
+    if (genome == NULL || genome->getSequenceLength() == 0)
+    {
+      throw hal_exception("genome " + genomeName + " not found or empty");
+    }
+    srand(42);
+    hal_size_t checksum = 0;
+    clock_t start = clock();
+    genome->getSequenceBySite(0);
+    double loadTime = (double)(clock() - start) / CLOCKS_PER_SEC;
+    double scanTime = timeLookups(genome, numLookups, false, checksum);
+    double randomTime = timeLookups(genome, numLookups, true, checksum);
+    cout << "sequences: " << genome->getNumSequences() << "\n"
+         << "first lookup (s): " << loadTime << "\n"
+         << numLookups << " lookups left to right (s): " << scanTime << "\n"
+         << numLookups << " random lookups (s): " << randomTime << "\n"
+         << "(checksum " << checksum << ")" << endl;
+  }
+  catch (exception& e)
+  {
+    cerr << "Exception caught: " << e.what() << endl;
+    return 1;
+  }
+  return 0;
+}
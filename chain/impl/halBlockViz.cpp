@@ -14,15 +14,16 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <pthread.h>
 #include "hal.h"
 #include "halChain.h"
 #include "halBlockViz.h"
 #include "halBlockMapper.h"
+#include "halBlockVizCache.h"
 #include "halLodManager.h"
 #include "halMafExport.h"
 
 #ifdef ENABLE_UDC
-#include <pthread.h>
 static pthread_mutex_t HAL_MUTEX;
 #define HAL_LOCK pthread_mutex_lock(&HAL_MUTEX);
 #define HAL_UNLOCK pthread_mutex_unlock(&HAL_MUTEX);
@@ -36,6 +37,66 @@ using namespace hal;
 
 typedef map<int, pair<string, LodManagerPtr> > HandleMap;
 static HandleMap handleMap;
+static BlockVizCache blockCache;
+
+/** How a handle was opened, along with the extra read handles (one
+ * per worker thread) used by halGetBlocksInTargetRangeBatch.  They
+ * are opened the first time they are needed and kept until halClose */
+struct HandleWorkers
+{
+   bool _isLod;
+   vector<LodManagerPtr> _lodManagers;
+};
+typedef map<int, HandleWorkers> WorkerMap;
+static WorkerMap workerMap;
+
+/** A block query resolved against a given set of read handles: the
+ * level of detail that was picked, the genomes, and the target range */
+struct BlockQuery
+{
+   AlignmentConstPtr _alignment;
+   AlignmentConstPtr _seqAlignment;
+   const Genome* _qGenome;
+   const Sequence* _tSequence;
+   hal_index_t _absStart;
+   hal_index_t _absEnd;
+   hal_int_t _tStart;
+   hal_int_t _tEnd;
+   bool _tReversed;
+   bool _getSequenceString;
+   hal_dup_type_t _dupMode;
+   bool _doAdjes;
+   const char* _coalescenceLimitName;
+   BlockVizCache::Key _key;
+};
+
+/** Work shared by the threads of a halGetBlocksInTargetRangeBatch call.
+ * The queries left in _todo are handed out in order under the mutex */
+struct BlockBatch
+{
+   int _halHandle;
+   char** _qSpecies;
+   char* _tSpecies;
+   char* _tChrom;
+   hal_int_t _tStart;
+   hal_int_t _tEnd;
+   hal_int_t _tReversed;
+   hal_seqmode_type_t _seqMode;
+   hal_dup_type_t _dupMode;
+   int _mapBackAdjacencies;
+   const char* _coalescenceLimitName;
+   std::vector<size_t> _todo;
+   size_t _next;
+   hal_block_results_t** _results;
+   std::string _error;
+   pthread_mutex_t _mutex;
+};
+
+struct BlockBatchThread
+{
+   BlockBatch* _batch;
+   LodManagerPtr _lodManager;
+};
 
 static int halOpenLodOrHal(char* inputPath, bool isLod, char **errStr);
 static void checkHandle(int handle);
@@ -47,8 +108,21 @@ static AlignmentConstPtr getExistingAlignment(int handle,
                                               hal_size_t queryLength,
                                               bool needSequence);
 static bool isAlignmentLod0(int handle, hal_size_t queryLength);
+static LodManagerPtr getLodManager(int handle);
+static void resolveBlockQuery(int halHandle, LodManager& lodManager,
+                              char* qSpecies, char* tSpecies, char* tChrom,
+                              hal_int_t tStart, hal_int_t tEnd,
+                              hal_int_t tReversed,
+                              hal_seqmode_type_t seqMode,
+                              hal_dup_type_t dupMode,
+                              int mapBackAdjacencies,
+                              const char *coalescenceLimitName,
+                              BlockQuery& query);
+static void* blockBatchWorker(void* arg);
 static char* copyCString(const string& inString);
 
+static hal_block_results_t* readBlocks(const BlockQuery& query);
+
 static hal_block_results_t* readBlocks(AlignmentConstPtr seqAlignment,
                                        const Sequence* tSequence,
                                        hal_index_t absStart, 
@@ -123,6 +197,7 @@ int halOpenLodOrHal(char* inputPath, bool isLod, char **errStr)
       handleMap.insert(pair<int, pair<string, LodManagerPtr> >(
                          handle, pair<string, LodManagerPtr>(
                            inputPath, lodManager)));
+      workerMap[handle]._isLod = isLod;
     }
   }
   catch(exception& e)
@@ -165,6 +240,8 @@ extern "C" int halClose(int handle, char **errStr)
       throw hal_exception(ss.str());
     }
     handleMap.erase(mapIt);
+    workerMap.erase(handle);
+    blockCache.erase(handle);
   }
   catch(exception& e)
   {
@@ -250,83 +327,193 @@ struct hal_block_results_t *halGetBlocksInTargetRange(int halHandle,
   hal_block_results_t* results = NULL;
   try
   {
-    hal_int_t rangeLength = tEnd - tStart;
-    if (rangeLength < 0)
+    BlockQuery query;
+    resolveBlockQuery(halHandle, *getLodManager(halHandle), qSpecies,
+                      tSpecies, tChrom, tStart, tEnd, tReversed, seqMode,
+                      dupMode, mapBackAdjacencies, coalescenceLimitName,
+                      query);
+    if (blockCache.getMaxBytes() > 0)
     {
-      stringstream ss;
-      ss << "Invalid query range [" << tStart << "," << tEnd << ").";
-      throw hal_exception(ss.str());
+      results = blockCache.find(query._key, query._tStart, query._tEnd);
     }
-    if (tReversed != 0 && mapBackAdjacencies != 0)
+    if (results == NULL)
     {
-      throw hal_exception("tReversed can only be set when"
-                          "mapBackAdjacencies is 0");
+      results = readBlocks(query);
+      if (blockCache.getMaxBytes() > 0)
+      {
+        blockCache.insert(query._key, query._tStart, query._tEnd, results);
+      }
     }
-    if (tReversed != 0 && dupMode == HAL_QUERY_AND_TARGET_DUPS)
+  }
+  catch(exception& e)
+  {
+    if (errStr == NULL)
     {
-      throw hal_exception("tReversed cannot be set in conjunction with"
-                          " dupMode=HAL_QUERY_AND_TARGET_DUPS");
+      throw hal_exception(e.what());
     }
-    bool getSequenceString;
-    switch (seqMode) 
+    stringstream ss;
+    ss << "Exception caught: " << e.what() << endl;
+    *errStr = stString_copy(ss.str().c_str());
+    results = NULL;
+  }
+  catch(...)
+  {
+    stringstream ss;
+    ss << "Error in hal block query";
+    if (errStr == NULL)
     {
-    case HAL_NO_SEQUENCE: getSequenceString = false; break;
-    case HAL_FORCE_LOD0_SEQUENCE: getSequenceString = true; break;           
-    case HAL_LOD0_SEQUENCE: default:
-      getSequenceString = isAlignmentLod0(halHandle, hal_size_t(rangeLength)); 
+      throw hal_exception(ss.str());
     }
-      
-    AlignmentConstPtr alignment = getExistingAlignment(
-      halHandle, hal_size_t(rangeLength), getSequenceString);
-    checkGenomes(halHandle, alignment, qSpecies, tSpecies, tChrom);
+    *errStr = stString_copy(ss.str().c_str());
+    results = NULL;
+  }
+  HAL_UNLOCK
+  return results;
+}
 
-    const Genome* qGenome = alignment->openGenome(qSpecies);
-    const Genome* tGenome = alignment->openGenome(tSpecies);
-    const Sequence* tSequence = tGenome->getSequence(tChrom);
+extern "C"
+int halGetBlocksInTargetRangeBatch(int halHandle,
+                                   int numQueries,
+                                   char** qSpecies,
+                                   char* tSpecies,
+                                   char* tChrom,
+                                   hal_int_t tStart, 
+                                   hal_int_t tEnd,
+                                   hal_int_t tReversed,
+                                   hal_seqmode_type_t seqMode,
+                                   hal_dup_type_t dupMode,
+                                   int mapBackAdjacencies,
+                                   const char *coalescenceLimitName,
+                                   int numThreads,
+                                   struct hal_block_results_t** results,
+                                   char **errStr)
+{
+  HAL_LOCK
+  int ret = 0;
+  try
+  {
+    if (numQueries < 0 || 
+        (numQueries > 0 && (qSpecies == NULL || results == NULL)))
+    {
+      throw hal_exception("Invalid query species list");
+    }
+    for (int i = 0; i < numQueries; ++i)
+    {
+      results[i] = NULL;
+    }
+    BlockBatch batch;
+    batch._halHandle = halHandle;
+    batch._qSpecies = qSpecies;
+    batch._tSpecies = tSpecies;
+    batch._tChrom = tChrom;
+    batch._tStart = tStart;
+    batch._tEnd = tEnd;
+    batch._tReversed = tReversed;
+    batch._seqMode = seqMode;
+    batch._dupMode = dupMode;
+    batch._mapBackAdjacencies = mapBackAdjacencies;
+    batch._coalescenceLimitName = coalescenceLimitName;
+    batch._next = 0;
+    batch._results = results;
+
+    // check all the queries (and the cache) in this thread before
+    // starting any others
+    LodManagerPtr lodManager = getLodManager(halHandle);
+    vector<BlockQuery> queries(numQueries);
+    for (int i = 0; i < numQueries; ++i)
+    {
+      resolveBlockQuery(halHandle, *lodManager, qSpecies[i], tSpecies, 
+                        tChrom, tStart, tEnd, tReversed, seqMode, dupMode,
+                        mapBackAdjacencies, coalescenceLimitName, 
+                        queries[i]);
+      if (blockCache.getMaxBytes() > 0)
+      {
+        results[i] = blockCache.find(queries[i]._key, queries[i]._tStart,
+                                     queries[i]._tEnd);
+      }
+      if (results[i] == NULL)
+      {
+        batch._todo.push_back(i);
+      }
+    }
 
-    hal_index_t myEnd = tEnd > 0 ? tEnd : tSequence->getSequenceLength();
-    hal_index_t absStart = tSequence->getStartPosition() + tStart;
-    hal_index_t absEnd = tSequence->getStartPosition() + myEnd - 1;
-    if (absStart > absEnd)
+    size_t numWorkers = min((size_t)max(numThreads, 1), batch._todo.size());
+    const string& path = handleMap.find(halHandle)->second.first;
+    if (numWorkers > 1 && halAlignmentSupportsThreads(path) == false)
     {
-      throw hal_exception("Invalid range");
+      numWorkers = 1;
     }
-    if (absEnd > tSequence->getEndPosition())
+    if (numWorkers <= 1)
     {
-      throw hal_exception("Target end position outside of target sequence");
+      for (size_t j = 0; j < batch._todo.size(); ++j)
+      {
+        results[batch._todo[j]] = readBlocks(queries[batch._todo[j]]);
+      }
     }
-    // We now know the query length so we can do a proper lod query
-    if (tEnd == 0)
+    else
     {
-      alignment = getExistingAlignment(halHandle, absEnd - absStart, 
-                                       false);
-      checkGenomes(halHandle, alignment, qSpecies, tSpecies, tChrom);
-      qGenome = alignment->openGenome(qSpecies);
-      tGenome = alignment->openGenome(tSpecies);
-      tSequence = tGenome->getSequence(tSequence->getName());
+      // each thread reads through its own handles on the file(s)
+      HandleWorkers& workers = workerMap[halHandle];
+      while (workers._lodManagers.size() < numWorkers)
+      {
+        LodManagerPtr threadLodManager(new LodManager());
+        if (workers._isLod == true)
+        {
+          threadLodManager->loadLODFile(path);
+        }
+        else
+        {
+          threadLodManager->loadSingeHALFile(path);
+        }
+        workers._lodManagers.push_back(threadLodManager);
+      }
+
+      pthread_mutex_init(&batch._mutex, NULL);
+      vector<BlockBatchThread> args(numWorkers);
+      vector<pthread_t> threads;
+      for (size_t i = 0; i < numWorkers; ++i)
+      {
+        args[i]._batch = &batch;
+        args[i]._lodManager = workers._lodManagers[i];
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, blockBatchWorker, &args[i]) != 0)
+        {
+          pthread_mutex_lock(&batch._mutex);
+          batch._error = "unable to create thread";
+          batch._next = batch._todo.size();
+          pthread_mutex_unlock(&batch._mutex);
+          break;
+        }
+        threads.push_back(thread);
+      }
+      for (size_t i = 0; i < threads.size(); ++i)
+      {
+        pthread_join(threads[i], NULL);
+      }
+      pthread_mutex_destroy(&batch._mutex);
+      if (batch._error.empty() == false)
+      {
+        throw hal_exception(batch._error);
+      }
     }
 
-    AlignmentConstPtr seqAlignment;
-    if (getSequenceString == true)
+    if (blockCache.getMaxBytes() > 0)
     {
-      // note: this separate pointer no longer necessary since we will
-      // not get sequence unless alignment has sequence.  don't bother
-      // getting rid of it since it allows us to easily revert back to 
-      // the previous functionaly of allowing lod-blocks to acces lod-0
-      // sequence
-      seqAlignment = getExistingAlignment(halHandle, absEnd - absStart, 
-                                          true);
+      for (size_t j = 0; j < batch._todo.size(); ++j)
+      {
+        const BlockQuery& query = queries[batch._todo[j]];
+        blockCache.insert(query._key, query._tStart, query._tEnd,
+                          results[batch._todo[j]]);
+      }
     }
-
-    results = readBlocks(seqAlignment, tSequence, absStart, absEnd, 
-                         tReversed != 0,
-                         qGenome,
-                         getSequenceString, dupMode != HAL_NO_DUPS, 
-                         dupMode == HAL_QUERY_AND_TARGET_DUPS,
-                         mapBackAdjacencies != 0, coalescenceLimitName);
   }
   catch(exception& e)
   {
+    for (int i = 0; results != NULL && i < numQueries; ++i)
+    {
+      halFreeBlockResults(results[i]);
+      results[i] = NULL;
+    }
     if (errStr == NULL)
     {
       throw hal_exception(e.what());
@@ -334,10 +521,15 @@ struct hal_block_results_t *halGetBlocksInTargetRange(int halHandle,
     stringstream ss;
     ss << "Exception caught: " << e.what() << endl;
     *errStr = stString_copy(ss.str().c_str());
-    results = NULL;
+    ret = -1;
   }
   catch(...)
   {
+    for (int i = 0; results != NULL && i < numQueries; ++i)
+    {
+      halFreeBlockResults(results[i]);
+      results[i] = NULL;
+    }
     stringstream ss;
     ss << "Error in hal block query";
     if (errStr == NULL)
@@ -345,10 +537,10 @@ struct hal_block_results_t *halGetBlocksInTargetRange(int halHandle,
       throw hal_exception(ss.str());
     }
     *errStr = stString_copy(ss.str().c_str());
-    results = NULL;
+    ret = -1;
   }
   HAL_UNLOCK
-  return results;
+  return ret;
 }
 
 extern "C"
@@ -836,6 +1028,35 @@ extern "C" char *halGetDna(int halHandle,
   return dna;
 }
 
+extern "C" int halSetBlockCacheSize(hal_int_t maxBytes, char **errStr)
+{
+  HAL_LOCK
+  int ret = 0;
+  try
+  {
+    if (maxBytes < 0)
+    {
+      stringstream ss;
+      ss << "Invalid block cache size " << maxBytes;
+      throw hal_exception(ss.str());
+    }
+    blockCache.setMaxBytes((size_t)maxBytes);
+  }
+  catch(exception& e)
+  {
+    if (errStr == NULL)
+    {
+      throw hal_exception(e.what());
+    }
+    stringstream ss;
+    ss << "Exception caught: " << e.what() << endl;
+    *errStr = stString_copy(ss.str().c_str());
+    ret = -1;
+  }
+  HAL_UNLOCK
+  return ret;
+}
+
 extern "C" hal_int_t halGetMaxLODQueryLength(int halHandle, char **errStr)
 {
   HAL_LOCK
@@ -942,6 +1163,173 @@ bool isAlignmentLod0(int handle, hal_size_t queryLength)
   return mapIt->second.second->isLod0(queryLength);
 }
 
+LodManagerPtr getLodManager(int handle)
+{
+  checkHandle(handle);
+  return handleMap.find(handle)->second.second;
+}
+
+void resolveBlockQuery(int halHandle, LodManager& lodManager,
+                       char* qSpecies, char* tSpecies, char* tChrom,
+                       hal_int_t tStart, hal_int_t tEnd, hal_int_t tReversed,
+                       hal_seqmode_type_t seqMode, hal_dup_type_t dupMode,
+                       int mapBackAdjacencies,
+                       const char *coalescenceLimitName,
+                       BlockQuery& query)
+{
+  hal_int_t rangeLength = tEnd - tStart;
+  if (rangeLength < 0)
+  {
+    stringstream ss;
+    ss << "Invalid query range [" << tStart << "," << tEnd << ").";
+    throw hal_exception(ss.str());
+  }
+  if (tReversed != 0 && mapBackAdjacencies != 0)
+  {
+    throw hal_exception("tReversed can only be set when"
+                        "mapBackAdjacencies is 0");
+  }
+  if (tReversed != 0 && dupMode == HAL_QUERY_AND_TARGET_DUPS)
+  {
+    throw hal_exception("tReversed cannot be set in conjunction with"
+                        " dupMode=HAL_QUERY_AND_TARGET_DUPS");
+  }
+  bool getSequenceString;
+  switch (seqMode) 
+  {
+  case HAL_NO_SEQUENCE: getSequenceString = false; break;
+  case HAL_FORCE_LOD0_SEQUENCE: getSequenceString = true; break;           
+  case HAL_LOD0_SEQUENCE: default:
+    getSequenceString = lodManager.isLod0(hal_size_t(rangeLength)); 
+  }
+    
+  AlignmentConstPtr alignment = lodManager.getAlignment(
+    hal_size_t(rangeLength), getSequenceString);
+  checkGenomes(halHandle, alignment, qSpecies, tSpecies, tChrom);
+
+  const Genome* qGenome = alignment->openGenome(qSpecies);
+  const Genome* tGenome = alignment->openGenome(tSpecies);
+  const Sequence* tSequence = tGenome->getSequence(tChrom);
+
+  hal_index_t myEnd = tEnd > 0 ? tEnd : tSequence->getSequenceLength();
+  hal_index_t absStart = tSequence->getStartPosition() + tStart;
+  hal_index_t absEnd = tSequence->getStartPosition() + myEnd - 1;
+  if (absStart > absEnd)
+  {
+    throw hal_exception("Invalid range");
+  }
+  if (absEnd > tSequence->getEndPosition())
+  {
+    throw hal_exception("Target end position outside of target sequence");
+  }
+  // We now know the query length so we can do a proper lod query
+  if (tEnd == 0)
+  {
+    alignment = lodManager.getAlignment(absEnd - absStart, false);
+    checkGenomes(halHandle, alignment, qSpecies, tSpecies, tChrom);
+    qGenome = alignment->openGenome(qSpecies);
+    tGenome = alignment->openGenome(tSpecies);
+    tSequence = tGenome->getSequence(tSequence->getName());
+  }
+
+  AlignmentConstPtr seqAlignment;
+  if (getSequenceString == true)
+  {
+    // note: this separate pointer no longer necessary since we will
+    // not get sequence unless alignment has sequence.  don't bother
+    // getting rid of it since it allows us to easily revert back to 
+    // the previous functionaly of allowing lod-blocks to acces lod-0
+    // sequence
+    seqAlignment = lodManager.getAlignment(absEnd - absStart, true);
+  }
+
+  query._alignment = alignment;
+  query._seqAlignment = seqAlignment;
+  query._qGenome = qGenome;
+  query._tSequence = tSequence;
+  query._absStart = absStart;
+  query._absEnd = absEnd;
+  query._tStart = absStart - tSequence->getStartPosition();
+  query._tEnd = absEnd + 1 - tSequence->getStartPosition();
+  query._tReversed = tReversed != 0;
+  query._getSequenceString = getSequenceString;
+  query._dupMode = dupMode;
+  query._doAdjes = mapBackAdjacencies != 0;
+  query._coalescenceLimitName = coalescenceLimitName;
+
+  query._key._handle = halHandle;
+  query._key._alignment = alignment.get();
+  query._key._seqAlignment = seqAlignment.get();
+  query._key._qSpecies = qSpecies;
+  query._key._tSpecies = tSpecies;
+  query._key._tChrom = tSequence->getName();
+  query._key._tReversed = query._tReversed;
+  query._key._getSequence = getSequenceString;
+  query._key._dupMode = dupMode;
+  query._key._doAdjes = query._doAdjes;
+  query._key._hasCoalescenceLimit = coalescenceLimitName != NULL;
+  query._key._coalescenceLimit = coalescenceLimitName != NULL ? 
+     coalescenceLimitName : "";
+}
+
+hal_block_results_t* readBlocks(const BlockQuery& query)
+{
+  return readBlocks(query._seqAlignment, query._tSequence, query._absStart,
+                    query._absEnd, query._tReversed, query._qGenome,
+                    query._getSequenceString, query._dupMode != HAL_NO_DUPS,
+                    query._dupMode == HAL_QUERY_AND_TARGET_DUPS,
+                    query._doAdjes, query._coalescenceLimitName);
+}
+
+void* blockBatchWorker(void* arg)
+{
+  BlockBatchThread* thread = static_cast<BlockBatchThread*>(arg);
+  BlockBatch* batch = thread->_batch;
+  for (;;)
+  {
+    pthread_mutex_lock(&batch->_mutex);
+    if (batch->_next >= batch->_todo.size())
+    {
+      pthread_mutex_unlock(&batch->_mutex);
+      break;
+    }
+    size_t i = batch->_todo[batch->_next++];
+    pthread_mutex_unlock(&batch->_mutex);
+
+    string error;
+    try
+    {
+      BlockQuery query;
+      resolveBlockQuery(batch->_halHandle, *thread->_lodManager,
+                        batch->_qSpecies[i], batch->_tSpecies, 
+                        batch->_tChrom, batch->_tStart, batch->_tEnd,
+                        batch->_tReversed, batch->_seqMode, batch->_dupMode,
+                        batch->_mapBackAdjacencies,
+                        batch->_coalescenceLimitName, query);
+      batch->_results[i] = readBlocks(query);
+    }
+    catch (exception& e)
+    {
+      error = e.what();
+    }
+    catch (...)
+    {
+      error = "Error in hal block query";
+    }
+    if (error.empty() == false)
+    {
+      pthread_mutex_lock(&batch->_mutex);
+      if (batch->_error.empty() == true)
+      {
+        batch->_error = error;
+      }
+      batch->_next = batch->_todo.size();
+      pthread_mutex_unlock(&batch->_mutex);
+    }
+  }
+  return NULL;
+}
+
 char* copyCString(const string& inString)
 {
   char* outString = (char*)malloc(inString.length() + 1);
@@ -0,0 +1,380 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include <cassert>
+#include <algorithm>
+#include <stdlib.h>
+#include <string.h>
+#include "halBlockVizCache.h"
+
+using namespace std;
+using namespace hal;
+
+static char* copyCString(const char* inString)
+{
+  if (inString == NULL)
+  {
+    return NULL;
+  }
+  char* outString = (char*)malloc(strlen(inString) + 1);
+  strcpy(outString, inString);
+  return outString;
+}
+
+static char* copyCSubString(const char* inString, hal_int_t start,
+                            hal_int_t length)
+{
+  if (inString == NULL)
+  {
+    return NULL;
+  }
+  assert(start >= 0 && start + length <= (hal_int_t)strlen(inString));
+  char* outString = (char*)malloc(length + 1);
+  memcpy(outString, inString + start, length);
+  outString[length] = '\0';
+  return outString;
+}
+
+static size_t cStringBytes(const char* inString)
+{
+  return inString == NULL ? 0 : strlen(inString) + 1;
+}
+
+BlockVizCache::Key::Key() :
+  _handle(-1),
+  _alignment(NULL),
+  _seqAlignment(NULL),
+  _tReversed(false),
+  _getSequence(false),
+  _dupMode(HAL_NO_DUPS),
+  _doAdjes(false),
+  _hasCoalescenceLimit(false)
+{
+}
+
+bool BlockVizCache::Key::operator<(const Key& other) const
+{
+  if (_handle != other._handle)
+  {
+    return _handle < other._handle;
+  }
+  if (_alignment != other._alignment)
+  {
+    return _alignment < other._alignment;
+  }
+  if (_seqAlignment != other._seqAlignment)
+  {
+    return _seqAlignment < other._seqAlignment;
+  }
+  if (_qSpecies != other._qSpecies)
+  {
+    return _qSpecies < other._qSpecies;
+  }
+  if (_tSpecies != other._tSpecies)
+  {
+    return _tSpecies < other._tSpecies;
+  }
+  if (_tChrom != other._tChrom)
+  {
+    return _tChrom < other._tChrom;
+  }
+  if (_tReversed != other._tReversed)
+  {
+    return _tReversed < other._tReversed;
+  }
+  if (_getSequence != other._getSequence)
+  {
+    return _getSequence < other._getSequence;
+  }
+  if (_dupMode != other._dupMode)
+  {
+    return _dupMode < other._dupMode;
+  }
+  if (_doAdjes != other._doAdjes)
+  {
+    return _doAdjes < other._doAdjes;
+  }
+  if (_hasCoalescenceLimit != other._hasCoalescenceLimit)
+  {
+    return _hasCoalescenceLimit < other._hasCoalescenceLimit;
+  }
+  return _coalescenceLimit < other._coalescenceLimit;
+}
+
+BlockVizCache::BlockVizCache() :
+  _maxBytes(0),
+  _numBytes(0)
+{
+}
+
+BlockVizCache::~BlockVizCache()
+{
+  clear();
+}
+
+void BlockVizCache::setMaxBytes(size_t maxBytes)
+{
+  _maxBytes = maxBytes;
+  evict(_maxBytes);
+}
+
+hal_block_results_t* BlockVizCache::find(const Key& key, hal_int_t tStart,
+                                         hal_int_t tEnd)
+{
+  pair<EntryMap::iterator, EntryMap::iterator> range =
+     _entryMap.equal_range(key);
+  EntryMap::iterator best = _entryMap.end();
+  for (EntryMap::iterator mapIt = range.first; mapIt != range.second;
+       ++mapIt)
+  {
+    const Entry& entry = *mapIt->second;
+    if (entry._tStart == tStart && entry._tEnd == tEnd)
+    {
+      best = mapIt;
+      break;
+    }
+    if (entry._tStart <= tStart && entry._tEnd >= tEnd &&
+        canClip(key) == true &&
+        (best == _entryMap.end() ||
+         entry._numBytes < best->second->_numBytes))
+    {
+      best = mapIt;
+    }
+  }
+  if (best == _entryMap.end())
+  {
+    return NULL;
+  }
+  _entries.splice(_entries.begin(), _entries, best->second);
+  const Entry& entry = *best->second;
+  if (entry._tStart == tStart && entry._tEnd == tEnd)
+  {
+    return copyResults(entry._results);
+  }
+  return copyResults(entry._results, tStart, tEnd);
+}
+
+void BlockVizCache::insert(const Key& key, hal_int_t tStart, hal_int_t tEnd,
+                           const hal_block_results_t* results)
+{
+  assert(results != NULL && tStart < tEnd);
+  size_t numBytes = getNumBytes(results) + sizeof(Entry) +
+     key._qSpecies.length() + key._tSpecies.length() +
+     key._tChrom.length() + key._coalescenceLimit.length();
+  if (numBytes > _maxBytes)
+  {
+    return;
+  }
+  pair<EntryMap::iterator, EntryMap::iterator> range =
+     _entryMap.equal_range(key);
+  for (EntryMap::iterator mapIt = range.first; mapIt != range.second;
+       ++mapIt)
+  {
+    if (mapIt->second->_tStart == tStart && mapIt->second->_tEnd == tEnd)
+    {
+      _entries.splice(_entries.begin(), _entries, mapIt->second);
+      return;
+    }
+  }
+  evict(_maxBytes - numBytes);
+
+  Entry entry;
+  entry._key = key;
+  entry._tStart = tStart;
+  entry._tEnd = tEnd;
+  entry._results = copyResults(results);
+  entry._numBytes = numBytes;
+  _entries.push_front(entry);
+  _entryMap.insert(pair<Key, EntryList::iterator>(key, _entries.begin()));
+  _numBytes += numBytes;
+}
+
+void BlockVizCache::erase(int handle)
+{
+  EntryMap::iterator mapIt = _entryMap.begin();
+  while (mapIt != _entryMap.end())
+  {
+    EntryMap::iterator next = mapIt;
+    ++next;
+    if (mapIt->first._handle == handle)
+    {
+      eraseEntry(mapIt);
+    }
+    mapIt = next;
+  }
+}
+
+void BlockVizCache::clear()
+{
+  for (EntryList::iterator i = _entries.begin(); i != _entries.end(); ++i)
+  {
+    halFreeBlockResults(i->_results);
+  }
+  _entries.clear();
+  _entryMap.clear();
+  _numBytes = 0;
+}
+
+void BlockVizCache::evict(size_t maxBytes)
+{
+  while (_numBytes > maxBytes)
+  {
+    assert(_entries.empty() == false);
+    EntryList::iterator last = _entries.end();
+    --last;
+    pair<EntryMap::iterator, EntryMap::iterator> range =
+       _entryMap.equal_range(last->_key);
+    EntryMap::iterator mapIt = range.first;
+    while (mapIt->second != last)
+    {
+      ++mapIt;
+      assert(mapIt != range.second);
+    }
+    eraseEntry(mapIt);
+  }
+}
+
+void BlockVizCache::eraseEntry(EntryMap::iterator mapIt)
+{
+  EntryList::iterator entryIt = mapIt->second;
+  assert(_numBytes >= entryIt->_numBytes);
+  _numBytes -= entryIt->_numBytes;
+  halFreeBlockResults(entryIt->_results);
+  _entries.erase(entryIt);
+  _entryMap.erase(mapIt);
+}
+
+// adjacent blocks (mapBackAdjacencies) and the target duplication list
+// depend on the window, not just on the bases inside it, so they can't
+// be recovered by clipping a bigger window.  reversed queries are only
+// used for liftover, which doesn't pan around, so don't bother.
+bool BlockVizCache::canClip(const Key& key)
+{
+  return key._doAdjes == false && key._tReversed == false &&
+     key._dupMode != HAL_QUERY_AND_TARGET_DUPS;
+}
+
+hal_block_results_t* BlockVizCache::copyResults(
+  const hal_block_results_t* results, hal_int_t tStart, hal_int_t tEnd)
+{
+  hal_block_results_t* outResults =
+     (hal_block_results_t*)calloc(1, sizeof(hal_block_results_t));
+
+  hal_block_t* prev = NULL;
+  for (const hal_block_t* block = results->mappedBlocks; block != NULL;
+       block = block->next)
+  {
+    hal_int_t left = 0;
+    hal_int_t right = 0;
+    if (tEnd > 0)
+    {
+      if (block->tStart + block->size <= tStart || block->tStart >= tEnd)
+      {
+        continue;
+      }
+      left = max((hal_int_t)0, tStart - block->tStart);
+      right = max((hal_int_t)0, block->tStart + block->size - tEnd);
+    }
+    hal_block_t* cur = (hal_block_t*)calloc(1, sizeof(hal_block_t));
+    cur->qChrom = copyCString(block->qChrom);
+    cur->tStart = block->tStart + left;
+    cur->size = block->size - left - right;
+    // the query runs backwards along the target on the - strand
+    cur->qStart = block->qStart + (block->strand == '-' ? right : left);
+    cur->strand = block->strand;
+    // both strings are in target order
+    cur->qSequence = copyCSubString(block->qSequence, left, cur->size);
+    cur->tSequence = copyCSubString(block->tSequence, left, cur->size);
+    if (prev == NULL)
+    {
+      outResults->mappedBlocks = cur;
+    }
+    else
+    {
+      prev->next = cur;
+    }
+    prev = cur;
+  }
+
+  hal_target_dupe_list_t* prevDupe = NULL;
+  for (const hal_target_dupe_list_t* dupe = results->targetDupeBlocks;
+       dupe != NULL; dupe = dupe->next)
+  {
+    hal_target_dupe_list_t* cur = NULL;
+    hal_target_range_t* prevRange = NULL;
+    for (const hal_target_range_t* range = dupe->tRange; range != NULL;
+         range = range->next)
+    {
+      hal_int_t start = range->tStart;
+      hal_int_t end = range->tStart + range->size;
+      if (tEnd > 0)
+      {
+        start = max(start, tStart);
+        end = min(end, tEnd);
+        if (start >= end)
+        {
+          continue;
+        }
+      }
+      if (cur == NULL)
+      {
+        cur = (hal_target_dupe_list_t*)calloc(1,
+                                              sizeof(hal_target_dupe_list_t));
+        cur->id = dupe->id;
+        cur->qChrom = copyCString(dupe->qChrom);
+      }
+      hal_target_range_t* curRange =
+         (hal_target_range_t*)calloc(1, sizeof(hal_target_range_t));
+      curRange->tStart = start;
+      curRange->size = end - start;
+      if (prevRange == NULL)
+      {
+        cur->tRange = curRange;
+      }
+      else
+      {
+        prevRange->next = curRange;
+      }
+      prevRange = curRange;
+    }
+    if (cur == NULL)
+    {
+      continue;
+    }
+    if (prevDupe == NULL)
+    {
+      outResults->targetDupeBlocks = cur;
+    }
+    else
+    {
+      prevDupe->next = cur;
+    }
+    prevDupe = cur;
+  }
+  return outResults;
+}
+
+size_t BlockVizCache::getNumBytes(const hal_block_results_t* results)
+{
+  size_t numBytes = sizeof(hal_block_results_t);
+  for (const hal_block_t* block = results->mappedBlocks; block != NULL;
+       block = block->next)
+  {
+    numBytes += sizeof(hal_block_t) + cStringBytes(block->qChrom) +
+       cStringBytes(block->qSequence) + cStringBytes(block->tSequence);
+  }
+  for (const hal_target_dupe_list_t* dupe = results->targetDupeBlocks;
+       dupe != NULL; dupe = dupe->next)
+  {
+    numBytes += sizeof(hal_target_dupe_list_t) + cStringBytes(dupe->qChrom);
+    for (const hal_target_range_t* range = dupe->tRange; range != NULL;
+         range = range->next)
+    {
+      numBytes += sizeof(hal_target_range_t);
+    }
+  }
+  return numBytes;
+}
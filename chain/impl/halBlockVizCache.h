@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _HALBLOCKVIZCACHE_H
+#define _HALBLOCKVIZCACHE_H
+
+#include <list>
+#include <map>
+#include <string>
+#include "hal.h"
+#include "halBlockViz.h"
+
+namespace hal {
+
+/**
+ * Keeps copies of recent halGetBlocksInTargetRange() results so that
+ * a browser panning back and forth over the same region doesn't have
+ * to re-map it every time.  A query for a window that lies inside a
+ * cached window can be answered by clipping the cached blocks, as
+ * long as the query doesn't ask for anything (adjacencies, target
+ * duplications) that depends on where the window ends.  The clipped
+ * blocks hold the same aligned bases as a fresh query would, but blocks
+ * that were merged in the bigger window stay merged.  Entries are
+ * evicted in least-recently-used order once they take up more than
+ * the maximum number of bytes.  Results are always copied in and out
+ * of the cache, so the caller owns (and frees) what it gets back.
+ */
+class BlockVizCache
+{
+public:
+
+   /** Everything but the target range that the blocks depend on */
+   struct Key
+   {
+      Key();
+      bool operator<(const Key& other) const;
+      int _handle;
+      const Alignment* _alignment;
+      const Alignment* _seqAlignment;
+      std::string _qSpecies;
+      std::string _tSpecies;
+      std::string _tChrom;
+      bool _tReversed;
+      bool _getSequence;
+      hal_dup_type_t _dupMode;
+      bool _doAdjes;
+      bool _hasCoalescenceLimit;
+      std::string _coalescenceLimit;
+   };
+
+   BlockVizCache();
+   ~BlockVizCache();
+
+   /** Set the maximum size of the cache (0 turns it off), evicting
+    * entries if necessary */
+   void setMaxBytes(size_t maxBytes);
+   size_t getMaxBytes() const;
+   size_t getNumBytes() const;
+   size_t getNumEntries() const;
+
+   /** Look up the blocks for a range of the target sequence
+    * @param key Query parameters
+    * @param tStart First position of range (in target sequence)
+    * @param tEnd Last position + 1 of range
+    * @return new copy of the results or NULL if not cached */
+   hal_block_results_t* find(const Key& key, hal_int_t tStart,
+                             hal_int_t tEnd);
+
+   /** Add a copy of the blocks for a range of the target sequence
+    * (does nothing if they don't fit in the cache)
+    * @param key Query parameters
+    * @param tStart First position of range (in target sequence)
+    * @param tEnd Last position + 1 of range
+    * @param results Results to copy */
+   void insert(const Key& key, hal_int_t tStart, hal_int_t tEnd,
+               const hal_block_results_t* results);
+
+   /** Remove all entries for a given handle */
+   void erase(int handle);
+
+   /** Remove all entries */
+   void clear();
+
+   /** Copy a results structure, keeping only what overlaps
+    * [tStart, tEnd) of the target (everything if tEnd is 0) */
+   static hal_block_results_t* copyResults(const hal_block_results_t* results,
+                                           hal_int_t tStart = 0,
+                                           hal_int_t tEnd = 0);
+
+   /** Number of bytes of memory used by a results structure */
+   static size_t getNumBytes(const hal_block_results_t* results);
+
+protected:
+
+   struct Entry
+   {
+      Key _key;
+      hal_int_t _tStart;
+      hal_int_t _tEnd;
+      hal_block_results_t* _results;
+      size_t _numBytes;
+   };
+   typedef std::list<Entry> EntryList;
+   typedef std::multimap<Key, EntryList::iterator> EntryMap;
+
+   void evict(size_t maxBytes);
+   void eraseEntry(EntryMap::iterator mapIt);
+   static bool canClip(const Key& key);
+
+   // most recently used entry at the front
+   EntryList _entries;
+   EntryMap _entryMap;
+   size_t _maxBytes;
+   size_t _numBytes;
+};
+
+inline size_t BlockVizCache::getMaxBytes() const
+{
+  return _maxBytes;
+}
+
+inline size_t BlockVizCache::getNumBytes() const
+{
+  return _numBytes;
+}
+
+inline size_t BlockVizCache::getNumEntries() const
+{
+  return _entries.size();
+}
+
+}
+
+#endif
@@ -230,6 +230,41 @@ struct hal_block_results_t *halGetBlocksInTargetRange(int halHandle,
                                                       const char *coalescenceLimitName,
                                                       char **errStr);
 
+/** Same as halGetBlocksInTargetRange, but for several query species at
+ * once (for example all the snake tracks of a browser view).  The 
+ * queries can be computed at the same time in separate threads, which
+ * each read the file through their own handles (opened on first use 
+ * and kept until halClose).  This needs an HDF5 library built with
+ * --enable-threadsafe; otherwise the queries are computed one after
+ * the other as if numThreads was 1.
+ *
+ * @param halHandle handle for the HAL alignment obtained from halOpen
+ * @param numQueries number of query species
+ * @param qSpecies array of numQueries query species names
+ * @param numThreads maximum number of threads to use
+ * @param results array of numQueries pointers that is filled with the 
+ * results for each query species, in the same order as qSpecies.  Each
+ * must be freed by halFreeBlockResults().
+ * (see halGetBlocksInTargetRange for the other parameters)
+ * @return 0: success -1: failure (in which case all the results are 
+ * set to NULL)
+ */
+int halGetBlocksInTargetRangeBatch(int halHandle,
+                                   int numQueries,
+                                   char** qSpecies,
+                                   char* tSpecies,
+                                   char* tChrom,
+                                   hal_int_t tStart, 
+                                   hal_int_t tEnd,
+                                   hal_int_t tReversed,
+                                   hal_seqmode_type_t seqMode,
+                                   hal_dup_type_t dupMode,
+                                   int mapBackAdjacencies,
+                                   const char *coalescenceLimitName,
+                                   int numThreads,
+                                   struct hal_block_results_t** results,
+                                   char **errStr);
+
 /*
  * Create linked list of block structures.  Blocks returned will be all
  * aligned blocks in the query sequence that align to the given range
@@ -339,6 +374,22 @@ char *halGetDna(int halHandle,
                 hal_int_t start, hal_int_t end,
                 char **errStr);
 
+/** Set the amount of memory used to keep the results of recent calls to
+ * halGetBlocksInTargetRange (and halGetBlocksInTargetRange_filterByChrom)
+ * so that requests for the same window, or for a window inside a
+ * previous one, don't have to be recomputed. Windows inside a cached
+ * window are only served from the cache when mapBackAdjacencies is 0, 
+ * tReversed is 0 and dupMode is not HAL_QUERY_AND_TARGET_DUPS.  They
+ * contain the same aligned bases as a fresh query, but blocks that
+ * were merged in the larger window stay merged.  The least recently
+ * used results are dropped first once the limit is reached.
+ * @param maxBytes maximum size of the cache in bytes (0, the default,
+ * turns the cache off and frees its contents)
+ * @param errStr pointer to a string that contains an error message on
+ * failure. If NULL, throws an exception on failure instead.
+ * @return 0: success -1: failure */
+int halSetBlockCacheSize(hal_int_t maxBytes, char **errStr);
+
 /** Get the maximum query size supported by the lod.txt file.  Queries > than
  * this length will return an error. 
  * @param  halHandle handle for the HAL LOD.txt obtained from halOpenLOD 
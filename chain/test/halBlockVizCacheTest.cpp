@@ -0,0 +1,171 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "halChainTests.h"
+#include "halBlockVizCache.h"
+
+using namespace std;
+using namespace hal;
+
+static char* makeCString(const char* inString)
+{
+  char* outString = (char*)malloc(strlen(inString) + 1);
+  strcpy(outString, inString);
+  return outString;
+}
+
+// two blocks: target [10, 20) -> query [100, 110) on the + strand
+// and target [20, 30) -> query [200, 210) on the - strand
+static hal_block_results_t* makeResults()
+{
+  hal_block_results_t* results =
+     (hal_block_results_t*)calloc(1, sizeof(hal_block_results_t));
+  hal_block_t* first = (hal_block_t*)calloc(1, sizeof(hal_block_t));
+  first->qChrom = makeCString("chr1");
+  first->tStart = 10;
+  first->qStart = 100;
+  first->size = 10;
+  first->strand = '+';
+  first->tSequence = makeCString("ACGTACGTAC");
+  first->qSequence = makeCString("ACGTACGTAA");
+  hal_block_t* second = (hal_block_t*)calloc(1, sizeof(hal_block_t));
+  second->qChrom = makeCString("chr2");
+  second->tStart = 20;
+  second->qStart = 200;
+  second->size = 10;
+  second->strand = '-';
+  second->tSequence = makeCString("GGGGGCCCCC");
+  second->qSequence = makeCString("GGGGGCCCCA");
+  first->next = second;
+  results->mappedBlocks = first;
+  return results;
+}
+
+static BlockVizCache::Key makeKey(int handle, bool doAdjes)
+{
+  BlockVizCache::Key key;
+  key._handle = handle;
+  key._qSpecies = "query";
+  key._tSpecies = "target";
+  key._tChrom = "chrT";
+  key._doAdjes = doAdjes;
+  return key;
+}
+
+void halBlockVizCacheClipTest(CuTest* testCase)
+{
+  hal_block_results_t* results = makeResults();
+
+  hal_block_results_t* copy = BlockVizCache::copyResults(results);
+  CuAssertTrue(testCase, copy->mappedBlocks != results->mappedBlocks);
+  CuAssertIntEquals(testCase, 10, copy->mappedBlocks->tStart);
+  CuAssertIntEquals(testCase, 200, copy->mappedBlocks->next->qStart);
+  CuAssertStrEquals(testCase, "GGGGGCCCCA",
+                    copy->mappedBlocks->next->qSequence);
+  CuAssertTrue(testCase, copy->mappedBlocks->next->next == NULL);
+  halFreeBlockResults(copy);
+
+  // [12, 25) cuts 2 bases off the left of the first block and 5 off the
+  // right of the second, which is the start of its query range
+  hal_block_results_t* clip = BlockVizCache::copyResults(results, 12, 25);
+  hal_block_t* block = clip->mappedBlocks;
+  CuAssertTrue(testCase, block != NULL);
+  CuAssertIntEquals(testCase, 12, block->tStart);
+  CuAssertIntEquals(testCase, 102, block->qStart);
+  CuAssertIntEquals(testCase, 8, block->size);
+  CuAssertStrEquals(testCase, "chr1", block->qChrom);
+  CuAssertStrEquals(testCase, "GTACGTAC", block->tSequence);
+  CuAssertStrEquals(testCase, "GTACGTAA", block->qSequence);
+  block = block->next;
+  CuAssertTrue(testCase, block != NULL);
+  CuAssertIntEquals(testCase, 20, block->tStart);
+  CuAssertIntEquals(testCase, 205, block->qStart);
+  CuAssertIntEquals(testCase, 5, block->size);
+  CuAssertTrue(testCase, block->strand == '-');
+  CuAssertStrEquals(testCase, "GGGGG", block->tSequence);
+  CuAssertTrue(testCase, block->next == NULL);
+  halFreeBlockResults(clip);
+
+  // a window that misses the first block entirely
+  clip = BlockVizCache::copyResults(results, 22, 23);
+  CuAssertTrue(testCase, clip->mappedBlocks != NULL);
+  CuAssertIntEquals(testCase, 22, clip->mappedBlocks->tStart);
+  CuAssertIntEquals(testCase, 207, clip->mappedBlocks->qStart);
+  CuAssertIntEquals(testCase, 1, clip->mappedBlocks->size);
+  CuAssertTrue(testCase, clip->mappedBlocks->next == NULL);
+  halFreeBlockResults(clip);
+
+  halFreeBlockResults(results);
+}
+
+void halBlockVizCacheLookupTest(CuTest* testCase)
+{
+  hal_block_results_t* results = makeResults();
+  BlockVizCache cache;
+
+  // off by default
+  cache.insert(makeKey(0, false), 10, 30, results);
+  CuAssertIntEquals(testCase, 0, cache.getNumEntries());
+  CuAssertTrue(testCase, cache.find(makeKey(0, false), 10, 30) == NULL);
+
+  // room for exactly two entries (all the keys are the same size)
+  cache.setMaxBytes(1000000);
+  cache.insert(makeKey(0, false), 10, 30, results);
+  CuAssertIntEquals(testCase, 1, cache.getNumEntries());
+  size_t entryBytes = cache.getNumBytes();
+  CuAssertTrue(testCase, entryBytes > BlockVizCache::getNumBytes(results));
+  cache.setMaxBytes(2 * entryBytes);
+  cache.insert(makeKey(0, true), 10, 30, results);
+  CuAssertIntEquals(testCase, 2, cache.getNumEntries());
+
+  hal_block_results_t* found = cache.find(makeKey(0, false), 10, 30);
+  CuAssertTrue(testCase, found != NULL);
+  CuAssertIntEquals(testCase, 20, found->mappedBlocks->next->tStart);
+  halFreeBlockResults(found);
+
+  // windows inside a cached window are clipped, unless the blocks
+  // depend on the window
+  found = cache.find(makeKey(0, false), 15, 25);
+  CuAssertTrue(testCase, found != NULL);
+  CuAssertIntEquals(testCase, 15, found->mappedBlocks->tStart);
+  CuAssertIntEquals(testCase, 5, found->mappedBlocks->size);
+  halFreeBlockResults(found);
+  CuAssertTrue(testCase, cache.find(makeKey(0, true), 15, 25) == NULL);
+  CuAssertTrue(testCase, cache.find(makeKey(0, false), 5, 25) == NULL);
+  CuAssertTrue(testCase, cache.find(makeKey(1, false), 10, 30) == NULL);
+
+  // the (0, true) entry is now the least recently used one
+  cache.insert(makeKey(1, false), 10, 30, results);
+  CuAssertIntEquals(testCase, 2, cache.getNumEntries());
+  CuAssertTrue(testCase, cache.find(makeKey(0, true), 10, 30) == NULL);
+  found = cache.find(makeKey(0, false), 10, 30);
+  CuAssertTrue(testCase, found != NULL);
+  halFreeBlockResults(found);
+  CuAssertTrue(testCase, cache.getNumBytes() <= cache.getMaxBytes());
+
+  cache.erase(0);
+  CuAssertIntEquals(testCase, 1, cache.getNumEntries());
+  CuAssertTrue(testCase, cache.find(makeKey(0, false), 10, 30) == NULL);
+  found = cache.find(makeKey(1, false), 10, 30);
+  CuAssertTrue(testCase, found != NULL);
+  halFreeBlockResults(found);
+
+  cache.setMaxBytes(0);
+  CuAssertIntEquals(testCase, 0, cache.getNumEntries());
+  CuAssertIntEquals(testCase, 0, cache.getNumBytes());
+
+  halFreeBlockResults(results);
+}
+
+CuSuite* halBlockVizCacheTestSuite(void)
+{
+  CuSuite* suite = CuSuiteNew();
+  SUITE_ADD_TEST(suite, halBlockVizCacheClipTest);
+  SUITE_ADD_TEST(suite, halBlockVizCacheLookupTest);
+  return suite;
+}
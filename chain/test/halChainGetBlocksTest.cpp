@@ -434,6 +434,76 @@ void ChainGetBlocksSimpleLiftoverTest::checkCallBack(
   CuAssertTrue(_testCase, queSeg->getLength() == 10);    
 }
 
+static bool sameBlocks(const hal_block_t* b1, const hal_block_t* b2)
+{
+  for (; b1 != NULL && b2 != NULL; b1 = b1->next, b2 = b2->next)
+  {
+    if (strcmp(b1->qChrom, b2->qChrom) != 0 || b1->tStart != b2->tStart ||
+        b1->qStart != b2->qStart || b1->size != b2->size ||
+        b1->strand != b2->strand || 
+        strcmp(b1->qSequence, b2->qSequence) != 0 ||
+        strcmp(b1->tSequence, b2->tSequence) != 0)
+    {
+      return false;
+    }
+  }
+  return b1 == NULL && b2 == NULL;
+}
+
+void ChainGetBlocksBatchTest::checkCallBack(AlignmentConstPtr alignment)
+{
+  // the blockViz API can only open hdf5 files
+  char* errStr = NULL;
+  int handle = halOpen(const_cast<char*>(_checkPath), &errStr);
+  if (handle == -1)
+  {
+    free(errStr);
+    return;
+  }
+  // (the root can't be the target of a self-alignment query, it has no
+  // top segments to look for paralogies with)
+  char* qSpecies[] = {(char*)"parent", (char*)"child2", (char*)"child1"};
+  hal_block_results_t* batchResults[3];
+  for (int numThreads = 1; numThreads <= 3; numThreads += 2)
+  {
+    int ret = halGetBlocksInTargetRangeBatch(handle, 3, qSpecies, 
+                                             (char*)"child1",
+                                             (char*)"Sequence", 2, 9, 0,
+                                             HAL_FORCE_LOD0_SEQUENCE,
+                                             HAL_QUERY_DUPS, 0, NULL,
+                                             numThreads, batchResults,
+                                             NULL);
+    CuAssertTrue(_testCase, ret == 0);
+    for (int i = 0; i < 3; ++i)
+    {
+      hal_block_results_t* results = 
+         halGetBlocksInTargetRange(handle, qSpecies[i], (char*)"child1",
+                                   (char*)"Sequence", 2, 9, 0,
+                                   HAL_FORCE_LOD0_SEQUENCE, HAL_QUERY_DUPS,
+                                   0, NULL, NULL);
+      CuAssertTrue(_testCase, results != NULL && 
+                   results->mappedBlocks != NULL);
+      CuAssertTrue(_testCase, batchResults[i] != NULL);
+      CuAssertTrue(_testCase, sameBlocks(results->mappedBlocks,
+                                         batchResults[i]->mappedBlocks));
+      halFreeBlockResults(results);
+      halFreeBlockResults(batchResults[i]);
+    }
+  }
+
+  // one bad query fails the whole batch
+  qSpecies[1] = (char*)"notAGenome";
+  int ret = halGetBlocksInTargetRangeBatch(handle, 3, qSpecies,
+                                           (char*)"child1",
+                                           (char*)"Sequence", 2, 9, 0,
+                                           HAL_NO_SEQUENCE, HAL_NO_DUPS, 0,
+                                           NULL, 3, batchResults, &errStr);
+  CuAssertTrue(_testCase, ret == -1);
+  CuAssertTrue(_testCase, batchResults[0] == NULL);
+  free(errStr);
+  halClose(handle, NULL);
+}
+
 void halChainGetBlocksSimpleTest(CuTest *testCase)
 {
   try 
@@ -538,6 +608,18 @@ void halChainGetBlocksSimpleLiftoverTest(CuTest *testCase)
   } 
 }
 
+void halChainGetBlocksBatchTest(CuTest *testCase)
+{
+  try 
+  {
+    ChainGetBlocksBatchTest tester;
+    tester.check(testCase);
+  }
+   catch (...) 
+  {
+    CuAssertTrue(testCase, false);
+  } 
+}
 
 CuSuite *halChainGetBlocksTestSuite(void)
 {
@@ -550,6 +632,7 @@ CuSuite *halChainGetBlocksTestSuite(void)
   SUITE_ADD_TEST(suite, halChainGetBlocksInversionOffsetQRefTest);
   SUITE_ADD_TEST(suite, halChainGetBlocksInversionOffsetQSisTest);
   SUITE_ADD_TEST(suite, halChainGetBlocksSimpleLiftoverTest);
+  SUITE_ADD_TEST(suite, halChainGetBlocksBatchTest);
   return suite;
 }
 
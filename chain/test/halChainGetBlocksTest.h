@@ -55,6 +55,11 @@ struct ChainGetBlocksSimpleLiftoverTest : public ChainGetBlocksSimpleTest
    void checkCallBack(hal::AlignmentConstPtr alignment);
 };
 
+struct ChainGetBlocksBatchTest : public ChainGetBlocksSimpleTest
+{
+   void checkCallBack(hal::AlignmentConstPtr alignment);
+};
+
 
 
 #endif
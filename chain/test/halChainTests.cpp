@@ -10,6 +10,7 @@ int halChainRunAllTests(void) {
   CuString *output = CuStringNew();
   CuSuite* suite = CuSuiteNew();
   CuSuiteAddSuite(suite, halChainGetBlocksTestSuite());
+  CuSuiteAddSuite(suite, halBlockVizCacheTestSuite());
   CuSuiteRun(suite);
   CuSuiteSummary(suite, output);
   CuSuiteDetails(suite, output);
@@ -14,5 +14,6 @@ extern "C" {
 }
 
 CuSuite *halChainGetBlocksTestSuite();
+CuSuite *halBlockVizCacheTestSuite();
 
 #endif
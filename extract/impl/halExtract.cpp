@@ -116,61 +116,33 @@ void getDimensions(AlignmentConstPtr outAlignment, const Genome* genome,
 
 void copyGenome(const Genome* inGenome, Genome* outGenome)
 {
-  DNAIteratorConstPtr inDna = inGenome->getDNAIterator();
-  DNAIteratorPtr outDna = outGenome->getDNAIterator();
-  hal_size_t n = inGenome->getSequenceLength();
-  assert(n == outGenome->getSequenceLength());
-  for (; (hal_size_t)inDna->getArrayIndex() < n; inDna->toRight(), 
-          outDna->toRight())
-  {
-    outDna->setChar(inDna->getChar());
-  }
+  // the Genome::copy* methods move whole blocks of raw data when both
+  // genomes are hdf5 and have the same layout (which is always the case
+  // here unless the input is in another format)
+  inGenome->copySequence(outGenome);
 
-  TopSegmentIteratorConstPtr inTop = inGenome->getTopSegmentIterator();
-  TopSegmentIteratorPtr outTop = outGenome->getTopSegmentIterator();
-  n = outGenome->getNumTopSegments();
-  assert(n == 0 || n == inGenome->getNumTopSegments());
-  for (; (hal_size_t)inTop->getArrayIndex() < n; inTop->toRight(),
-          outTop->toRight())
-  {
-    outTop->setCoordinates(inTop->getStartPosition(), inTop->getLength());
-    outTop->setParentIndex(inTop->getParentIndex());
-    outTop->setParentReversed(inTop->getParentReversed());
-    outTop->setBottomParseIndex(inTop->getBottomParseIndex());
-    outTop->setNextParalogyIndex(inTop->getNextParalogyIndex());
-  }
+  assert(outGenome->getNumTopSegments() == 0 || 
+         outGenome->getNumTopSegments() == inGenome->getNumTopSegments());
+  inGenome->copyTopSegments(outGenome);
 
-  BottomSegmentIteratorConstPtr inBot = inGenome->getBottomSegmentIterator();
-  BottomSegmentIteratorPtr outBot = outGenome->getBottomSegmentIterator();
-  n = outGenome->getNumBottomSegments();
+  hal_size_t n = outGenome->getNumBottomSegments();
   assert(n == 0 || n == inGenome->getNumBottomSegments());
-  hal_size_t nc = inGenome->getNumChildren();
-  assert(nc == outGenome->getNumChildren());
-  for (; (hal_size_t)inBot->getArrayIndex() < n; inBot->toRight(),
-          outBot->toRight())
+  assert(n == 0 || inGenome->getNumChildren() == outGenome->getNumChildren());
+  if (n > 0)
   {
-    outBot->setCoordinates(inBot->getStartPosition(), inBot->getLength());
-    for (hal_size_t child = 0; child < nc; ++child)
-    {
-      outBot->setChildIndex(child, inBot->getChildIndex(child));
-      outBot->setChildReversed(child, inBot->getChildReversed(child));
-    }
-    if (outGenome->getAlignment()->getRootName() == outGenome->getName())
-    {
-      outBot->setTopParseIndex(NULL_INDEX);
-    }
-    else
+    inGenome->copyBottomSegments(outGenome);
+    if (outGenome->getAlignment()->getRootName() == outGenome->getName() &&
+        inGenome->getParent() != NULL)
     {
-      outBot->setTopParseIndex(inBot->getTopParseIndex());
+      BottomSegmentIteratorPtr outBot = outGenome->getBottomSegmentIterator();
+      for (; (hal_size_t)outBot->getArrayIndex() < n; outBot->toRight())
+      {
+        outBot->setTopParseIndex(NULL_INDEX);
+      }
     }
   }
 
-  const map<string, string>& meta = inGenome->getMetaData()->getMap();
-  map<string, string>::const_iterator i = meta.begin();
-  for (; i != meta.end(); ++i)
-  {
-    outGenome->getMetaData()->set(i->first, i->second);
-  }
+  inGenome->copyMetadata(outGenome);
 }
 
 static void extractTree(const AlignmentConstPtr inAlignment,
@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include "hal.h"
+
+using namespace std;
+using namespace hal;
+
+static CLParserPtr initParser()
+{
+  CLParserPtr optionsParser = hdf5CLParserInstance(false);
+  optionsParser->addArgument("inHalPath", "input hal file");
+  optionsParser->addArgument("outMMapPath", "output memory-mapped hal file");
+  optionsParser->setDescription("Convert a hal file into the read-only "
+                                "memory-mapped format.  The output can be "
+                                "given to any hal tool that does not modify "
+                                "its input.  Use halExtract to convert back "
+                                "to HDF5.");
+  return optionsParser;
+}
+
+int main(int argc, char** argv)
+{
+  CLParserPtr optionsParser = initParser();
+
+  string inHalPath;
+  string outMMapPath;
+  try
+  {
+    optionsParser->parseOptions(argc, argv);
+    inHalPath = optionsParser->getArgument<string>("inHalPath");
+    outMMapPath = optionsParser->getArgument<string>("outMMapPath");
+  }
+  catch(exception& e)
+  {
+    cerr << e.what() << endl;
+    optionsParser->printUsage(cerr);
+    exit(1);
+  }
+
+  try
+  {
+    AlignmentConstPtr inAlignment = openHalAlignmentReadOnly(inHalPath, 
+                                                             optionsParser);
+    if (inAlignment->getNumGenomes() == 0)
+    {
+      throw hal_exception("input hal alignmenet is empty");
+    }
+    writeMMapAlignment(inAlignment, outMMapPath);
+  }
+  catch(hal_exception& e)
+  {
+    cerr << "hal exception caught: " << e.what() << endl;
+    return 1;
+  }
+  catch(exception& e)
+  {
+    cerr << "Exception caught: " << e.what() << endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -14,8 +14,23 @@ dataSetsPath=/Users/hickey/Documents/Devel/genomes/datasets
 cflags += -I${sonLibPath} -fPIC
 cppflags += -I${sonLibPath} -fPIC
 
-basicLibs = ${sonLibPath}/sonLib.a ${sonLibPath}/cuTest.a
-basicLibsDependencies = ${basicLibs}
+# the hdf5 array prefetcher uses a pthread and decompresses with zlib
+cppflags += -pthread
+
+# packed DNA strings are decoded and encoded 32 bases at a time with SSSE3
+# instructions when the compiler targets them (ex. uncomment the following)
+#cppflags += -mssse3
+
+# count pages read, sequence lookups, column moves and mapped segments for
+# the --perfStats option of the tools (make HAL_PERF_STATS=1).  off by
+# default because the counters are atomic adds in hot loops
+ifdef HAL_PERF_STATS
+	cppflags += -DHAL_PERF_STATS
+endif
+
+basicLibsDependencies = ${sonLibPath}/sonLib.a ${sonLibPath}/cuTest.a
+# system libraries are linked but can't be prerequisites
+basicLibs = ${basicLibsDependencies} -lz -lpthread
 
 # hdf5 compilation is done through its wrappers.
 # we can speficy our own (sonlib) compilers with these variables:
@@ -5,6 +5,7 @@
  */
 
 #include <deque>
+#include <algorithm>
 #include <cassert>
 #include "halBlockLiftover.h"
 #include "halBlockMapper.h"
@@ -12,7 +13,10 @@
 using namespace std;
 using namespace hal;
 
-BlockLiftover::BlockLiftover() : Liftover()
+BlockLiftover::BlockLiftover() : Liftover(),
+                                 _projectionIndex(NULL),
+                                 _useIndex(false),
+                                 _inBatch(false)
 {
 
 }
@@ -22,6 +26,11 @@ BlockLiftover::~BlockLiftover()
 
 }
 
+void BlockLiftover::setProjectionIndex(const ProjectionIndex* projectionIndex)
+{
+  _projectionIndex = projectionIndex;
+}
+
 void BlockLiftover::visitBegin()
 {
   if (_srcGenome->getNumTopSegments() > 0)
@@ -47,10 +56,92 @@ void BlockLiftover::visitBegin()
   inputSet.insert(_coalescenceLimit);
   inputSet.insert(_tgtGenome);
   getGenomesInSpanningTree(inputSet, _downwardPath);
+
+  _useIndex = _projectionIndex != NULL &&
+     _projectionIndex->hasTable(_srcGenome, _tgtGenome, _traverseDupes,
+                                _coalescenceLimit);
+  endBatch();
+}
+
+// map the regions covered by the batch's intervals in one sweep over
+// the source genome, so that overlapping or nearby intervals don't each
+// walk the tree
+void BlockLiftover::beginBatch()
+{
+  if (_useIndex == true)
+  {
+    return;
+  }
+  vector<pair<hal_index_t, hal_index_t> > ranges;
+  for (size_t i = 0; i < _batch.size(); ++i)
+  {
+    const BedLine& bedLine = _batch[i];
+    const Sequence* sequence = _srcGenome->getSequence(bedLine._chrName);
+    if (sequence == NULL || bedLine._start < 0 ||
+        bedLine._end > (hal_index_t)sequence->getSequenceLength())
+    {
+      // skipped with a warning later on
+      continue;
+    }
+    hal_index_t offset = sequence->getStartPosition();
+    if (_inBedVersion > 9)
+    {
+      for (size_t j = 0; j < bedLine._blocks.size(); ++j)
+      {
+        const BedBlock& block = bedLine._blocks[j];
+        hal_index_t start = bedLine._start + block._start;
+        hal_index_t end = min(start + (hal_index_t)block._length,
+                              (hal_index_t)sequence->getSequenceLength());
+        if (end > start)
+        {
+          ranges.push_back(pair<hal_index_t, hal_index_t>(
+                             offset + start, offset + end - 1));
+        }
+      }
+    }
+    else if (bedLine._end > bedLine._start)
+    {
+      ranges.push_back(pair<hal_index_t, hal_index_t>(
+                         offset + bedLine._start, offset + bedLine._end - 1));
+    }
+  }
+  sort(ranges.begin(), ranges.end());
+  size_t numMerged = 0;
+  for (size_t i = 0; i < ranges.size(); ++i)
+  {
+    if (numMerged > 0 && ranges[i].first <= ranges[numMerged - 1].second + 1)
+    {
+      ranges[numMerged - 1].second = max(ranges[numMerged - 1].second,
+                                         ranges[i].second);
+    }
+    else
+    {
+      ranges[numMerged++] = ranges[i];
+    }
+  }
+  ranges.resize(numMerged);
+
+  _batchProjections.clear();
+  ProjectionIndex::project(_srcGenome, _tgtGenome, ranges, _traverseDupes,
+                           _coalescenceLimit, _batchProjections);
+  ProjectionIndex::index(_batchProjections, _batchMaxEnd);
+  _inBatch = true;
+}
+
+void BlockLiftover::endBatch()
+{
+  _inBatch = false;
+  vector<ProjectionIndex::Projection>().swap(_batchProjections);
+  vector<hal_index_t>().swap(_batchMaxEnd);
 }
 
 void BlockLiftover::liftInterval(BedList& mappedBedLines)
 {
+  if (_useIndex == true || _inBatch == true)
+  {
+    liftProjections(mappedBedLines);
+    return;
+  }
   _mappedSegments.clear();
   hal_index_t globalStart = _bedLine._start + _srcSequence->getStartPosition();
   hal_index_t globalEnd = _bedLine._end - 1 + _srcSequence->getStartPosition();
@@ -136,6 +227,57 @@ void BlockLiftover::liftInterval(BedList& mappedBedLines)
   }
 }
 
+// each projection (from the index or the batch) that overlaps the
+// interval is a mapped block
+void BlockLiftover::liftProjections(BedList& mappedBedLines)
+{
+  hal_index_t globalStart = _bedLine._start + _srcSequence->getStartPosition();
+  hal_index_t globalEnd = _bedLine._end - 1 + _srcSequence->getStartPosition();
+  bool flip = _bedLine._strand == '-';
+
+  _projections.clear();
+  if (_useIndex == true)
+  {
+    _projectionIndex->map(_srcGenome, _tgtGenome, globalStart, globalEnd,
+                          _projections, _traverseDupes, _coalescenceLimit);
+  }
+  else
+  {
+    ProjectionIndex::clip(_batchProjections, _batchMaxEnd, globalStart,
+                          globalEnd, _projections);
+  }
+
+  for (size_t i = 0; i < _projections.size(); ++i)
+  {
+    const ProjectionIndex::Projection& p = _projections[i];
+    const Sequence* seq = _tgtGenome->getSequenceBySite(p._tgtStart);
+    assert(seq != NULL);
+    hal_index_t seqStart = seq->getStartPosition();
+    mappedBedLines.push_back(_bedLine);
+    BedLine& outBedLine = mappedBedLines.back();
+    outBedLine._blocks.clear();
+    outBedLine._chrName = seq->getName();
+    outBedLine._start = p._tgtStart - seqStart;
+    outBedLine._end = outBedLine._start + (hal_index_t)p._length;
+    outBedLine._strand = p._reversed != flip ? '-' : '+';
+    outBedLine._srcStart = p._srcStart;
+    outBedLine._srcStrand = flip ? '-' : '+';
+
+    if (_bedLine._strand == '.')
+    {
+      outBedLine._strand = '.';
+      outBedLine._srcStrand = '.';
+    }
+
+    assert(outBedLine._start < outBedLine._end);
+
+    if (_outPSL == true)
+    {
+      readPSLInfo(p, seq, outBedLine);
+    }
+  }
+}
+
 void BlockLiftover::readPSLInfo(vector<MappedSegmentConstPtr>& fragments, 
                                 BedLine& outBedLine)
 {
@@ -198,3 +340,61 @@ void BlockLiftover::readPSLInfo(vector<MappedSegmentConstPtr>& fragments,
     }
   }
 }
+
+void BlockLiftover::readPSLInfo(const ProjectionIndex::Projection& projection,
+                                const Sequence* tSequence,
+                                BedLine& outBedLine)
+{
+  outBedLine._psl.resize(1);
+  PSLInfo& psl = outBedLine._psl[0];
+  psl._matches = 0;
+  psl._misMatches = 0;
+  psl._repMatches = 0;
+  psl._nCount = 0;
+  psl._qNumInsert = 0;
+  psl._qBaseInsert = 0;
+  psl._tNumInsert = 0;
+  psl._tBaseInsert = 0;
+  psl._qSeqName = _srcSequence->getName();
+  psl._qSeqSize = _srcSequence->getSequenceLength();
+  psl._qStrand = _bedLine._strand == '-' ? '-' : '+';
+  assert(outBedLine._srcStart >= _srcSequence->getStartPosition());
+  psl._qChromOffset = _srcSequence->getStartPosition();
+  psl._qEnd = outBedLine._srcStart + 
+     (outBedLine._end - outBedLine._start);
+  psl._tSeqSize = tSequence->getSequenceLength();
+  psl._qBlockStarts.clear();
+
+  // flipping both strings wouldn't change the counts, so only the
+  // target is flipped, if it's on the other strand
+  _srcGenome->getSubString(_srcBuf, projection._srcStart,
+                           projection._length);
+  _tgtGenome->getSubString(_tgtBuf, projection._tgtStart,
+                           projection._length);
+  if (projection._reversed == true)
+  {
+    reverseComplement(_tgtBuf);
+  }
+  for (size_t j = 0; j < _srcBuf.length(); ++j)
+  {
+    if (_srcBuf[j] == _tgtBuf[j])
+    {
+      if (!isMasked(_srcBuf[j]) && !isMasked(_tgtBuf[j]))
+      {
+        ++psl._matches;
+      }
+      else
+      {
+        ++psl._repMatches;
+      }
+    }
+    else if (isMissingData(_tgtBuf[j]))
+    {
+      ++psl._nCount;
+    }
+    else
+    {
+      ++psl._misMatches;
+    }
+  }
+}
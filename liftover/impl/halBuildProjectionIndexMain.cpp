@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2013 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <fstream>
+#include "hal.h"
+
+using namespace std;
+using namespace hal;
+
+static CLParserPtr initParser()
+{
+  CLParserPtr optionsParser = hdf5CLParserInstance();
+  optionsParser->addArgument("halFile", "input hal file");
+  optionsParser->addArgument("tgtGenome", "target genome name");
+  optionsParser->addOption("srcGenomes", "comma-separated (no spaces) list "
+                           "of genomes to map from (default: all leaves "
+                           "other than the target)", "");
+  optionsParser->addOption("outFile", "path of the index (default: "
+                           "<halFile>.pidx)", "");
+  optionsParser->addOptionFlag("append", "add the tables to the existing "
+                               "index, replacing any made with the same "
+                               "options", false);
+  optionsParser->addOptionFlag("noDupes", "do not map between duplications in"
+                               " graph.", false);
+  optionsParser->addOption("coalescenceLimit", "coalescence limit genome:"
+                           " the genome at or above the MRCA of source"
+                           " and target at which we stop looking for"
+                           " homologies (default: MRCA)",
+                           "");
+  optionsParser->setDescription("Precompute the projections of genomes onto "
+                                "a target genome, for halLiftover "
+                                "--projectionIndex.  The index has to be "
+                                "rebuilt if the alignment changes.");
+  return optionsParser;
+}
+
+int main(int argc, char** argv)
+{
+  CLParserPtr optionsParser = initParser();
+
+  string halPath;
+  string tgtGenomeName;
+  string srcGenomeNames;
+  string outPath;
+  string coalescenceLimitName;
+  bool append;
+  bool noDupes;
+  try
+  {
+    optionsParser->parseOptions(argc, argv);
+    halPath = optionsParser->getArgument<string>("halFile");
+    tgtGenomeName = optionsParser->getArgument<string>("tgtGenome");
+    srcGenomeNames = optionsParser->getOption<string>("srcGenomes");
+    outPath = optionsParser->getOption<string>("outFile");
+    coalescenceLimitName = optionsParser->getOption<string>("coalescenceLimit");
+    append = optionsParser->getFlag("append");
+    noDupes = optionsParser->getFlag("noDupes");
+  }
+  catch(exception& e)
+  {
+    cerr << e.what() << endl;
+    optionsParser->printUsage(cerr);
+    exit(1);
+  }
+
+  try
+  {
+    AlignmentConstPtr alignment = openHalAlignmentReadOnly(halPath,
+                                                           optionsParser);
+    if (alignment->getNumGenomes() == 0)
+    {
+      throw hal_exception("hal alignment is empty");
+    }
+
+    const Genome* tgtGenome = alignment->openGenome(tgtGenomeName);
+    if (tgtGenome == NULL)
+    {
+      throw hal_exception(string("tgtGenome, ") + tgtGenomeName +
+                          ", not found in alignment");
+    }
+
+    const Genome *coalescenceLimit = NULL;
+    if (coalescenceLimitName != "")
+    {
+      coalescenceLimit = alignment->openGenome(coalescenceLimitName);
+      if (coalescenceLimit == NULL)
+      {
+        throw hal_exception("coalescence limit genome "
+                            + coalescenceLimitName
+                            + " not found in alignment");
+      }
+    }
+
+    vector<string> srcNames;
+    if (srcGenomeNames != "")
+    {
+      srcNames = chopString(srcGenomeNames, ",");
+    }
+    else
+    {
+      vector<string> leafNames = alignment->getLeafNamesBelow(
+        alignment->getRootName());
+      for (size_t i = 0; i < leafNames.size(); ++i)
+      {
+        if (leafNames[i] != tgtGenomeName)
+        {
+          srcNames.push_back(leafNames[i]);
+        }
+      }
+    }
+
+    if (outPath == "")
+    {
+      outPath = ProjectionIndex::getDefaultPath(halPath);
+    }
+
+    ProjectionIndex projectionIndex;
+    if (append == true)
+    {
+      projectionIndex.open(outPath);
+    }
+    for (size_t i = 0; i < srcNames.size(); ++i)
+    {
+      const Genome* srcGenome = alignment->openGenome(srcNames[i]);
+      if (srcGenome == NULL)
+      {
+        throw hal_exception(string("srcGenome, ") + srcNames[i] +
+                            ", not found in alignment");
+      }
+      projectionIndex.add(srcGenome, tgtGenome, !noDupes, coalescenceLimit);
+      if (srcGenome != tgtGenome && srcGenome != coalescenceLimit)
+      {
+        alignment->closeGenome(srcGenome);
+      }
+    }
+    projectionIndex.write(outPath);
+  }
+  catch(hal_exception& e)
+  {
+    cerr << "hal exception caught: " << e.what() << endl;
+    return 1;
+  }
+  catch(exception& e)
+  {
+    cerr << "Exception caught: " << e.what() << endl;
+    return 1;
+  }
+
+  return 0;
+}
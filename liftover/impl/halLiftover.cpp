@@ -14,7 +14,8 @@ using namespace hal;
 Liftover::Liftover() : _outBedStream(NULL),                       
                        _inBedVersion(-1), _outBedVersion(-1),
                        _outPSL(false), _outPSLWithName(false),
-                       _srcGenome(NULL), _tgtGenome(NULL)
+                       _srcGenome(NULL), _tgtGenome(NULL),
+                       _batchSize(0)
 {
 
 }
@@ -51,6 +52,7 @@ void Liftover::convert(AlignmentConstPtr alignment,
   _inLocale = inLocale;
   _missedSet.clear();
   _tgtSet.clear();
+  _batch.clear();
   assert(_srcGenome && inBedStream && tgtGenome && outBedStream);
 
   _tgtSet.insert(tgtGenome);
@@ -87,11 +89,32 @@ void Liftover::convert(AlignmentConstPtr alignment,
   scan(inBedStream, _inBedVersion, inLocale);
 }
 
+void Liftover::setBatchSize(hal_size_t batchSize)
+{
+  _batchSize = batchSize;
+}
+
 void Liftover::visitBegin()
 {
 }
 
 void Liftover::visitLine()
+{
+  if (_batchSize == 0)
+  {
+    liftLine();
+  }
+  else
+  {
+    _batch.push_back(_bedLine);
+    if (_batch.size() >= _batchSize)
+    {
+      flushBatch();
+    }
+  }
+}
+
+void Liftover::liftLine()
 {
   _outBedLines.clear();
   _srcSequence = _srcGenome->getSequence(_bedLine._chrName);
@@ -149,6 +172,30 @@ void Liftover::visitLine()
 }
 
 void Liftover::visitEOF()
+{
+  flushBatch();
+}
+
+void Liftover::flushBatch()
+{
+  if (_batch.empty() == false)
+  {
+    beginBatch();
+    for (size_t i = 0; i < _batch.size(); ++i)
+    {
+      _bedLine = _batch[i];
+      liftLine();
+    }
+    endBatch();
+    _batch.clear();
+  }
+}
+
+void Liftover::beginBatch()
+{
+}
+
+void Liftover::endBatch()
 {
 }
 
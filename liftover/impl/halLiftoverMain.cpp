@@ -9,6 +9,7 @@
 #include <fstream>
 #include "halColumnLiftover.h"
 #include "halBlockLiftover.h"
+#include "halThreadedLiftover.h"
 #include "halTabFacet.h"
 
 using namespace std;
@@ -56,6 +57,23 @@ static CLParserPtr initParser()
                                " column entries to contain spaces.  if this"
                                " flag is not set, both spaces and tabs are"
                                " used to separate input columns.", false);
+  optionsParser->addOption("projectionIndex", "projection index made by "
+                           "halBuildProjectionIndex.  it's used if it has a "
+                           "table for the source and target genomes with "
+                           "the same --noDupes and --coalescenceLimit "
+                           "options", "");
+  optionsParser->addOption("batchSize", "number of input lines to map "
+                           "together.  the regions they cover are mapped in "
+                           "one pass over the source genome, which is much "
+                           "faster for large or unsorted inputs with many "
+                           "overlapping or nearby intervals.  0 maps lines "
+                           "one at a time", 0);
+  optionsParser->addOption("numThreads", "number of threads.  the input "
+                           "is lifted in chunks of lines (or batches, with "
+                           "--batchSize) on separate handles to the "
+                           "alignment, and written in input order.  an "
+                           "hdf5 alignment needs a thread-safe hdf5 library",
+                           1);
   optionsParser->setDescription("Map BED genome interval coordinates between "
                                 "two genomes.");
   return optionsParser;
@@ -71,6 +89,9 @@ int main(int argc, char** argv)
   string tgtGenomeName;
   string tgtBedPath;
   string coalescenceLimitName;
+  string projectionIndexPath;
+  int batchSize;
+  int numThreads;
   bool noDupes;
   bool append;
   int inBedVersion;
@@ -88,6 +109,17 @@ int main(int argc, char** argv)
     tgtGenomeName = optionsParser->getArgument<string>("tgtGenome");
     tgtBedPath =  optionsParser->getArgument<string>("tgtBed");
     coalescenceLimitName = optionsParser->getOption<string>("coalescenceLimit");
+    projectionIndexPath = optionsParser->getOption<string>("projectionIndex");
+    batchSize = optionsParser->getOption<int>("batchSize");
+    if (batchSize < 0)
+    {
+      throw hal_exception("--batchSize must be >= 0");
+    }
+    numThreads = optionsParser->getOption<int>("numThreads");
+    if (numThreads < 1)
+    {
+      throw hal_exception("--numThreads must be at least 1");
+    }
     noDupes = optionsParser->getFlag("noDupes");
     append = optionsParser->getFlag("append");
     inBedVersion = optionsParser->getOption<int>("inBedVersion");
@@ -186,10 +218,39 @@ int main(int argc, char** argv)
       assert(std::isspace(' ', *inLocale) == false);
     }
     
-    BlockLiftover liftover;
-    liftover.convert(alignment, srcGenome, srcBedPtr, tgtGenome, tgtBedPtr,
-                     inBedVersion, outBedVersion, keepExtra, !noDupes,
-                     outPSL, outPSLWithName, inLocale, coalescenceLimit);
+    ProjectionIndex projectionIndex;
+    if (projectionIndexPath != "")
+    {
+      projectionIndex.open(projectionIndexPath);
+    }
+    if (numThreads == 1)
+    {
+      BlockLiftover liftover;
+      if (projectionIndexPath != "")
+      {
+        liftover.setProjectionIndex(&projectionIndex);
+      }
+      liftover.setBatchSize(batchSize);
+      liftover.convert(alignment, srcGenome, srcBedPtr, tgtGenome, tgtBedPtr,
+                       inBedVersion, outBedVersion, keepExtra, !noDupes,
+                       outPSL, outPSLWithName, inLocale, coalescenceLimit);
+    }
+    else
+    {
+      ThreadedLiftover liftover;
+      if (projectionIndexPath != "")
+      {
+        liftover.setProjectionIndex(&projectionIndex);
+      }
+      liftover.setBatchSize(batchSize);
+      liftover.convert(openHalAlignmentReadOnlyPerThread(halPath,
+                                                         optionsParser,
+                                                         numThreads),
+                       srcGenomeName, srcBedPtr, tgtGenomeName, tgtBedPtr,
+                       inBedVersion, outBedVersion, keepExtra, !noDupes,
+                       outPSL, outPSLWithName, inLocale,
+                       coalescenceLimitName);
+    }
     
     delete inLocale;
 
@@ -0,0 +1,363 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#include <sstream>
+#include <deque>
+#include <algorithm>
+#include <pthread.h>
+#include "halThreadedLiftover.h"
+#include "halBlockLiftover.h"
+
+using namespace std;
+using namespace hal;
+
+// a chunk of input lines, and what they lift to
+struct LiftoverJob
+{
+   string _input;
+   string _output;
+   string _error;
+   bool _done;
+};
+
+// everything the workers share.  jobs are numbered in input order, and
+// the window holds those from _first on that haven't been written yet
+struct LiftoverJobs
+{
+   pthread_mutex_t _mutex;
+   // signalled when a job is added or the input ends
+   pthread_cond_t _jobAdded;
+   // signalled when a job is done
+   pthread_cond_t _jobDone;
+   deque<LiftoverJob*> _window;
+   hal_size_t _first;
+   hal_size_t _next;
+   bool _end;
+
+   // the options, for every worker
+   string _srcGenomeName;
+   string _tgtGenomeName;
+   string _coalescenceLimitName;
+   const ProjectionIndex* _projectionIndex;
+   hal_size_t _batchSize;
+   int _inBedVersion;
+   int _outBedVersion;
+   bool _addExtraColumns;
+   bool _traverseDupes;
+   bool _outPSL;
+   bool _outPSLWithName;
+   const locale* _inLocale;
+};
+
+struct LiftoverThread
+{
+   LiftoverJobs* _jobs;
+   AlignmentConstPtr _alignment;
+};
+
+static const Genome* openThreadGenome(AlignmentConstPtr alignment,
+                                      const string& name)
+{
+  const Genome* genome = alignment->openGenome(name);
+  if (genome == NULL)
+  {
+    throw hal_exception("genome " + name + " not found in alignment");
+  }
+  return genome;
+}
+
+// lift jobs until the input ends.  an error in a job is kept in the job,
+// for the writer to throw when it gets to it
+static void liftJobs(LiftoverThread* thread)
+{
+  LiftoverJobs* jobs = thread->_jobs;
+  AlignmentConstPtr alignment = thread->_alignment;
+  BlockLiftover liftover;
+  liftover.setProjectionIndex(jobs->_projectionIndex);
+  liftover.setBatchSize(jobs->_batchSize);
+  const Genome* srcGenome = NULL;
+  const Genome* tgtGenome = NULL;
+  const Genome* coalescenceLimit = NULL;
+  // the jobs must all be marked done even if this fails
+  string error;
+  try
+  {
+    srcGenome = openThreadGenome(alignment, jobs->_srcGenomeName);
+    tgtGenome = openThreadGenome(alignment, jobs->_tgtGenomeName);
+    if (jobs->_coalescenceLimitName != "")
+    {
+      coalescenceLimit = openThreadGenome(alignment,
+                                          jobs->_coalescenceLimitName);
+    }
+  }
+  catch (exception& e)
+  {
+    error = e.what();
+  }
+
+  pthread_mutex_lock(&jobs->_mutex);
+  while (true)
+  {
+    while (jobs->_next == jobs->_first + jobs->_window.size() &&
+           jobs->_end == false)
+    {
+      pthread_cond_wait(&jobs->_jobAdded, &jobs->_mutex);
+    }
+    if (jobs->_next == jobs->_first + jobs->_window.size())
+    {
+      break;
+    }
+    LiftoverJob* job = jobs->_window[jobs->_next - jobs->_first];
+    ++jobs->_next;
+    pthread_mutex_unlock(&jobs->_mutex);
+
+    try
+    {
+      if (error.empty() == false)
+      {
+        throw hal_exception(error);
+      }
+      istringstream inBed(job->_input);
+      ostringstream outBed;
+      liftover.convert(alignment, srcGenome, &inBed, tgtGenome, &outBed,
+                       jobs->_inBedVersion, jobs->_outBedVersion,
+                       jobs->_addExtraColumns, jobs->_traverseDupes,
+                       jobs->_outPSL, jobs->_outPSLWithName,
+                       jobs->_inLocale, coalescenceLimit);
+      job->_output = outBed.str();
+    }
+    catch (exception& e)
+    {
+      job->_error = e.what();
+    }
+    catch (...)
+    {
+      job->_error = "unknown error in liftover thread";
+    }
+    job->_input.clear();
+
+    pthread_mutex_lock(&jobs->_mutex);
+    job->_done = true;
+    pthread_cond_broadcast(&jobs->_jobDone);
+  }
+  pthread_mutex_unlock(&jobs->_mutex);
+}
+
+static void *liftoverWorker(void *arg)
+{
+  liftJobs(static_cast<LiftoverThread *>(arg));
+  return NULL;
+}
+
+// write out the finished jobs at the front of the window.  if wait is
+// set, wait for the first one to finish.  called with the mutex held
+static void writeJobs(LiftoverJobs* jobs, ostream* outBed, bool wait)
+{
+  while (jobs->_window.empty() == false &&
+         (jobs->_window.front()->_done == true || wait == true))
+  {
+    LiftoverJob* job = jobs->_window.front();
+    while (job->_done == false)
+    {
+      pthread_cond_wait(&jobs->_jobDone, &jobs->_mutex);
+    }
+    if (job->_error.empty() == false)
+    {
+      throw hal_exception(job->_error);
+    }
+    *outBed << job->_output;
+    delete job;
+    jobs->_window.pop_front();
+    ++jobs->_first;
+    wait = false;
+  }
+}
+
+ThreadedLiftover::ThreadedLiftover() : _projectionIndex(NULL),
+                                       _batchSize(0),
+                                       _linesPerJob(10000)
+{
+
+}
+
+ThreadedLiftover::~ThreadedLiftover()
+{
+
+}
+
+void ThreadedLiftover::setProjectionIndex(
+  const ProjectionIndex* projectionIndex)
+{
+  _projectionIndex = projectionIndex;
+}
+
+void ThreadedLiftover::setBatchSize(hal_size_t batchSize)
+{
+  _batchSize = batchSize;
+}
+
+void ThreadedLiftover::setLinesPerJob(hal_size_t linesPerJob)
+{
+  _linesPerJob = max(linesPerJob, (hal_size_t)1);
+}
+
+void ThreadedLiftover::convert(const vector<AlignmentConstPtr>& alignments,
+                               const string& srcGenomeName,
+                               istream* inputFile,
+                               const string& tgtGenomeName,
+                               ostream* outputFile,
+                               int inBedVersion,
+                               int outBedVersion,
+                               bool addExtraColumns,
+                               bool traverseDupes,
+                               bool outPSL,
+                               bool outPSLWithName,
+                               const locale* inLocale,
+                               const string& coalescenceLimitName)
+{
+  hal_size_t numThreads = alignments.size();
+  if (numThreads == 0)
+  {
+    throw hal_exception("ThreadedLiftover: no alignment handles given");
+  }
+  LiftoverJobs jobs;
+  jobs._srcGenomeName = srcGenomeName;
+  jobs._tgtGenomeName = tgtGenomeName;
+  jobs._coalescenceLimitName = coalescenceLimitName;
+  jobs._projectionIndex = _projectionIndex;
+  jobs._batchSize = _batchSize;
+  jobs._inBedVersion = inBedVersion;
+  jobs._outBedVersion = outBedVersion;
+  jobs._addExtraColumns = addExtraColumns;
+  jobs._traverseDupes = traverseDupes;
+  jobs._outPSL = outPSL;
+  jobs._outPSLWithName = outPSLWithName;
+  jobs._inLocale = inLocale;
+
+  string line;
+  // the workers have to agree on the input bed version, so it's detected
+  // here from the first line, as in Liftover::convert()
+  string firstLines;
+  if (jobs._inBedVersion <= 0)
+  {
+    while (firstLines.empty() == true && getline(*inputFile, line))
+    {
+      if (line.find_first_not_of(" \t\r") != string::npos)
+      {
+        stringstream firstLineStream(line);
+        jobs._inBedVersion = BedScanner::getBedVersion(&firstLineStream,
+                                                       jobs._inLocale);
+        size_t numCols = BedScanner::getNumColumns(line, jobs._inLocale);
+        if ((int)numCols > jobs._inBedVersion)
+        {
+          cerr << "Warning: auto-detecting input BED version "
+               << jobs._inBedVersion << " even though " << numCols
+               << " columns present" << endl;
+        }
+        firstLines = line + "\n";
+      }
+    }
+    if (firstLines.empty() == true)
+    {
+      return;
+    }
+  }
+  if (jobs._outBedVersion <= 0)
+  {
+    jobs._outBedVersion = jobs._inBedVersion;
+  }
+
+  pthread_mutex_init(&jobs._mutex, NULL);
+  pthread_cond_init(&jobs._jobAdded, NULL);
+  pthread_cond_init(&jobs._jobDone, NULL);
+  jobs._first = 0;
+  jobs._next = 0;
+  jobs._end = false;
+
+  string error;
+  vector<LiftoverThread> threads(numThreads);
+  vector<pthread_t> pthreads;
+  for (hal_size_t i = 0; i < numThreads; ++i)
+  {
+    threads[i]._jobs = &jobs;
+    threads[i]._alignment = alignments[i];
+    pthread_t pthread;
+    if (pthread_create(&pthread, NULL, liftoverWorker, &threads[i]) != 0)
+    {
+      error = "ThreadedLiftover: unable to create thread";
+      break;
+    }
+    pthreads.push_back(pthread);
+  }
+
+  hal_size_t jobSize = _batchSize > 0 ? _batchSize : _linesPerJob;
+  hal_size_t maxWindow = 4 * numThreads;
+  pthread_mutex_lock(&jobs._mutex);
+  try
+  {
+    if (error.empty() == false)
+    {
+      throw hal_exception(error);
+    }
+    bool eof = false;
+    while (eof == false)
+    {
+      LiftoverJob* job = new LiftoverJob();
+      job->_done = false;
+      job->_input.swap(firstLines);
+      hal_size_t numLines = job->_input.empty() ? 0 : 1;
+      // read without the lock
+      pthread_mutex_unlock(&jobs._mutex);
+      for (; numLines < jobSize && getline(*inputFile, line); ++numLines)
+      {
+        job->_input += line;
+        job->_input += '\n';
+      }
+      eof = numLines < jobSize;
+      pthread_mutex_lock(&jobs._mutex);
+      jobs._window.push_back(job);
+      pthread_cond_signal(&jobs._jobAdded);
+      writeJobs(&jobs, outputFile, jobs._window.size() >= maxWindow);
+    }
+    jobs._end = true;
+    pthread_cond_broadcast(&jobs._jobAdded);
+    while (jobs._window.empty() == false)
+    {
+      writeJobs(&jobs, outputFile, true);
+    }
+  }
+  catch (exception& e)
+  {
+    error = e.what();
+    // drop the jobs nobody has started, and let the others finish
+    while (jobs._window.size() > jobs._next - jobs._first)
+    {
+      delete jobs._window.back();
+      jobs._window.pop_back();
+    }
+    jobs._end = true;
+    pthread_cond_broadcast(&jobs._jobAdded);
+  }
+  pthread_mutex_unlock(&jobs._mutex);
+
+  for (size_t i = 0; i < pthreads.size(); ++i)
+  {
+    pthread_join(pthreads[i], NULL);
+  }
+  for (size_t i = 0; i < jobs._window.size(); ++i)
+  {
+    delete jobs._window[i];
+  }
+  jobs._window.clear();
+  pthread_cond_destroy(&jobs._jobDone);
+  pthread_cond_destroy(&jobs._jobAdded);
+  pthread_mutex_destroy(&jobs._mutex);
+
+  if (error.empty() == false)
+  {
+    throw hal_exception(error);
+  }
+}
@@ -21,15 +21,27 @@ public:
    
    BlockLiftover();
    virtual ~BlockLiftover();
+
+   /** Use precomputed projections where the index has a table for the
+    * source and target genomes and the mapping options (see
+    * ProjectionIndex).  The output is the same, except that blocks
+    * aligned through duplications may be split up differently.  The
+    * index isn't owned by the liftover */
+   void setProjectionIndex(const ProjectionIndex* projectionIndex);
                    
 protected:
 
    void liftInterval(BedList& mappedBedLines);
+   void liftProjections(BedList& mappedBedLines);
    void visitBegin();
+   void beginBatch();
+   void endBatch();
 
    void cleanTargetParalogies();
    void readPSLInfo(std::vector<MappedSegmentConstPtr>& fragments, 
                     BedLine& outBedLine);
+   void readPSLInfo(const ProjectionIndex::Projection& projection,
+                    const Sequence* tgtSequence, BedLine& outBedLine);
 
    
 protected: 
@@ -39,6 +51,16 @@ protected:
    hal_index_t _lastIndex;
    std::set<const Genome*> _downwardPath;
    const Genome *_mrca;
+   const ProjectionIndex* _projectionIndex;
+   bool _useIndex;
+   std::vector<ProjectionIndex::Projection> _projections;
+   // everything the lines of the current batch map to, when it's not
+   // in the index
+   bool _inBatch;
+   std::vector<ProjectionIndex::Projection> _batchProjections;
+   std::vector<hal_index_t> _batchMaxEnd;
+   std::string _srcBuf;
+   std::string _tgtBuf;
 };
 
 }
@@ -36,6 +36,11 @@ public:
                 bool outPSLWithName = false,
                 const std::locale* inLocale = NULL,
                 const Genome *coalescenceLimit = NULL);
+
+   /** Read the input this many lines at a time, so that they can be
+    * mapped together (see beginBatch()).  The output is still in input
+    * order.  0 (the default) maps each line as soon as it's read */
+   void setBatchSize(hal_size_t batchSize);
                    
 protected:
 
@@ -44,6 +49,11 @@ protected:
    virtual void visitBegin();
    virtual void visitLine();
    virtual void visitEOF();
+   virtual void liftLine();
+   virtual void flushBatch();
+   /** Called before the lines in _batch are lifted one by one */
+   virtual void beginBatch();
+   virtual void endBatch();
    virtual void writeLineResults();
    virtual void assignBlocksToIntervals();
    virtual bool compatible(const BedLine& tgtBed, const BedLine& newBlock);
@@ -77,6 +87,9 @@ protected:
 
    ColumnIteratorConstPtr _colIt;
    std::set<std::string> _missedSet;
+
+   hal_size_t _batchSize;
+   std::vector<BedLine> _batch;
 };
 
 }
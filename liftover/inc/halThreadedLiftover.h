@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2012 by Glenn Hickey (hickey@soe.ucsc.edu)
+ *
+ * Released under the MIT license, see LICENSE.txt
+ */
+
+#ifndef _HALTHREADEDLIFTOVER_H
+#define _HALTHREADEDLIFTOVER_H
+
+#include <vector>
+#include <string>
+#include <iostream>
+#include <locale>
+#include "hal.h"
+
+namespace hal {
+
+/** Lifts BED input with BlockLiftover on several threads.  The input is
+ * read in chunks of lines (or batches, see setBatchSize()), each chunk
+ * is lifted by a thread with its own handle to the alignment, and the
+ * results are written in input order.  The output is the same as
+ * lifting all the input with one BlockLiftover */
+class ThreadedLiftover
+{
+public:
+
+   ThreadedLiftover();
+   ~ThreadedLiftover();
+
+   /** See BlockLiftover::setProjectionIndex().  The index is shared
+    * by the threads */
+   void setProjectionIndex(const ProjectionIndex* projectionIndex);
+
+   /** See Liftover::setBatchSize().  A thread lifts a batch at a time */
+   void setBatchSize(hal_size_t batchSize);
+
+   /** Number of lines a thread lifts at a time when not batching.
+    * The default is 10000 */
+   void setLinesPerJob(hal_size_t linesPerJob);
+
+   /** Lift the input as Liftover::convert() does, on one thread for
+    * each alignment handle (see openHalAlignmentReadOnlyPerThread()).
+    * The genomes are given by name so that each thread can open them
+    * in its own handle.  An error in any thread stops the liftover and
+    * is thrown here, as a hal_exception, once the threads are done */
+   void convert(const std::vector<AlignmentConstPtr>& alignments,
+                const std::string& srcGenomeName,
+                std::istream* inputFile,
+                const std::string& tgtGenomeName,
+                std::ostream* outputFile,
+                int inBedVersion = -1,
+                int outBedVersion = -1,
+                bool addExtraColumns = false,
+                bool traverseDupes = true,
+                bool outPSL = false,
+                bool outPSLWithName = false,
+                const std::locale* inLocale = NULL,
+                const std::string& coalescenceLimitName = "");
+
+protected:
+
+   const ProjectionIndex* _projectionIndex;
+   hal_size_t _batchSize;
+   hal_size_t _linesPerJob;
+};
+
+}
+#endif
@@ -4,10 +4,16 @@
  * Released under the MIT license, see LICENSE.txt
  */
 #include <cstdio>
+#include <algorithm>
 #include "hal.h"
 #include "halBlockLiftover.h"
+#include "halThreadedLiftover.h"
 #include "halLiftoverTests.h"
 
+extern "C" {
+#include "commonC.h"
+}
+
 using namespace std;
 using namespace hal;
 
@@ -418,6 +424,169 @@ void WiggleLiftoverTest::checkCallBack(AlignmentConstPtr alignment)
   testMultiBranchLifts(alignment);
 }
 
+void ProjectionIndexLiftoverTest::createCallBack(AlignmentPtr alignment)
+{
+  setupSharedAlignment(alignment);
+}
+
+// lift every base of every genome, on both strands, to every other genome
+// with and without the index, and in batches.  single bases can't be
+// merged differently so the output should be exactly the same
+void ProjectionIndexLiftoverTest::checkCallBack(AlignmentConstPtr alignment)
+{
+  const char* names[] = {"root", "child1", "leaf1", "leaf2", "leaf3"};
+  size_t numNames = sizeof(names) / sizeof(names[0]);
+  char* indexPath = getTempFile();
+  ProjectionIndex buildIndex;
+  for (size_t i = 0; i < numNames; ++i)
+  {
+    for (size_t j = 0; j < numNames; ++j)
+    {
+      if (i != j)
+      {
+        buildIndex.add(alignment->openGenome(names[i]),
+                       alignment->openGenome(names[j]));
+      }
+    }
+  }
+  buildIndex.write(indexPath);
+  ProjectionIndex projectionIndex;
+  projectionIndex.open(indexPath);
+  CuAssertTrue(_testCase, projectionIndex.getNumTables() ==
+               numNames * (numNames - 1));
+
+  for (size_t i = 0; i < numNames; ++i)
+  {
+    const Genome* srcGenome = alignment->openGenome(names[i]);
+    stringstream bed;
+    for (hal_size_t pos = 0; pos < srcGenome->getSequenceLength(); ++pos)
+    {
+      bed << "Sequence\t" << pos << "\t" << pos + 1 << "\tb" << pos
+          << "\t0\t+\n";
+      bed << "Sequence\t" << pos << "\t" << pos + 1 << "\tb" << pos
+          << "\t0\t-\n";
+    }
+    for (size_t j = 0; j < numNames; ++j)
+    {
+      if (i == j)
+      {
+        continue;
+      }
+      const Genome* tgtGenome = alignment->openGenome(names[j]);
+      CuAssertTrue(_testCase, projectionIndex.hasTable(srcGenome,
+                                                       tgtGenome));
+      CuAssertTrue(_testCase, !projectionIndex.hasTable(srcGenome,
+                                                        tgtGenome, false));
+      stringstream inBed1(bed.str());
+      stringstream outBed1;
+      BlockLiftover liftover;
+      liftover.convert(alignment, srcGenome, &inBed1, tgtGenome, &outBed1);
+
+      stringstream inBed2(bed.str());
+      stringstream outBed2;
+      BlockLiftover indexLiftover;
+      indexLiftover.setProjectionIndex(&projectionIndex);
+      indexLiftover.convert(alignment, srcGenome, &inBed2, tgtGenome,
+                            &outBed2);
+
+      stringstream inBed3(bed.str());
+      stringstream outBed3;
+      BlockLiftover batchLiftover;
+      batchLiftover.setBatchSize(7);
+      batchLiftover.convert(alignment, srcGenome, &inBed3, tgtGenome,
+                            &outBed3);
+
+      vector<string> lines1 = chopString(outBed1.str(), "\n");
+      vector<string> lines2 = chopString(outBed2.str(), "\n");
+      vector<string> lines3 = chopString(outBed3.str(), "\n");
+      sort(lines1.begin(), lines1.end());
+      sort(lines2.begin(), lines2.end());
+      sort(lines3.begin(), lines3.end());
+      CuAssertTrue(_testCase, lines1.empty() == false);
+      CuAssertTrue(_testCase, lines1 == lines2);
+      CuAssertTrue(_testCase, lines1 == lines3);
+    }
+  }
+  removeTempFile(indexPath);
+}
+
+void ThreadedLiftoverTest::createCallBack(AlignmentPtr alignment)
+{
+  setupSharedAlignment(alignment);
+}
+
+// lifting on three threads, in small jobs so that each thread gets
+// several, must write exactly what one liftover writes
+void ThreadedLiftoverTest::checkCallBack(AlignmentConstPtr alignment)
+{
+  const char* names[] = {"root", "child1", "leaf1", "leaf2", "leaf3"};
+  size_t numNames = sizeof(names) / sizeof(names[0]);
+  char* mmPath = getTempFile();
+  writeMMapAlignment(alignment, mmPath);
+  vector<AlignmentConstPtr> alignments = 
+     openHalAlignmentReadOnlyPerThread(mmPath, CLParserPtr(), 3);
+
+  for (size_t i = 0; i < numNames; ++i)
+  {
+    const Genome* srcGenome = alignments[0]->openGenome(names[i]);
+    stringstream bed;
+    for (hal_size_t pos = 0; pos < srcGenome->getSequenceLength(); ++pos)
+    {
+      hal_size_t length = 1 + pos % 11;
+      length = min(length, srcGenome->getSequenceLength() - pos);
+      bed << "Sequence\t" << pos << "\t" << pos + length << "\tb" << pos
+          << "\t0\t" << (pos % 2 == 0 ? "+" : "-") << "\n";
+    }
+    for (size_t j = 0; j < numNames; ++j)
+    {
+      if (i == j)
+      {
+        continue;
+      }
+      const Genome* tgtGenome = alignments[0]->openGenome(names[j]);
+      for (hal_size_t batchSize = 0; batchSize <= 5; batchSize += 5)
+      {
+        stringstream inBed1(bed.str());
+        stringstream outBed1;
+        BlockLiftover liftover;
+        liftover.setBatchSize(batchSize);
+        liftover.convert(alignments[0], srcGenome, &inBed1, tgtGenome,
+                         &outBed1);
+
+        stringstream inBed2(bed.str());
+        stringstream outBed2;
+        ThreadedLiftover threadedLiftover;
+        threadedLiftover.setBatchSize(batchSize);
+        threadedLiftover.setLinesPerJob(7);
+        threadedLiftover.convert(alignments, names[i], &inBed2, names[j],
+                                 &outBed2);
+
+        CuAssertTrue(_testCase, outBed1.str().empty() == false);
+        CuAssertTrue(_testCase, outBed2.str() == outBed1.str());
+      }
+    }
+  }
+
+  // an error in the threads comes back as an exception
+  bool thrown = false;
+  try
+  {
+    stringstream inBed("Sequence\t0\t10\n");
+    stringstream outBed;
+    ThreadedLiftover threadedLiftover;
+    threadedLiftover.convert(alignments, "root", &inBed, "noSuchGenome",
+                             &outBed);
+  }
+  catch (hal_exception& e)
+  {
+    thrown = true;
+  }
+  CuAssertTrue(_testCase, thrown == true);
+
+  alignments.clear();
+  removeTempFile(mmPath);
+}
+
 void halBedLiftoverTest(CuTest *testCase)
 {
   try
@@ -444,11 +613,39 @@ void halWiggleLiftoverTest(CuTest *testCase)
   }
 }
 
+void halProjectionIndexLiftoverTest(CuTest *testCase)
+{
+  try
+  {
+    ProjectionIndexLiftoverTest tester;
+    tester.check(testCase);
+  }
+  catch (...)
+  {
+    CuAssertTrue(testCase, false);
+  }
+}
+
+void halThreadedLiftoverTest(CuTest *testCase)
+{
+  try
+  {
+    ThreadedLiftoverTest tester;
+    tester.check(testCase);
+  }
+  catch (...)
+  {
+    CuAssertTrue(testCase, false);
+  }
+}
+
 CuSuite* halLiftoverTestSuite(void)
 {
   CuSuite* suite = CuSuiteNew();
   SUITE_ADD_TEST(suite, halBedLiftoverTest);
   SUITE_ADD_TEST(suite, halWiggleLiftoverTest);
+  SUITE_ADD_TEST(suite, halProjectionIndexLiftoverTest);
+  SUITE_ADD_TEST(suite, halThreadedLiftoverTest);
   return suite;
 }
 
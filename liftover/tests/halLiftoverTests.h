@@ -29,6 +29,18 @@ struct WiggleLiftoverTest : public AlignmentTest
    void testMultiBranchLifts(hal::AlignmentConstPtr alignment);
 };
 
+struct ProjectionIndexLiftoverTest : public AlignmentTest
+{
+   void createCallBack(hal::AlignmentPtr alignment);
+   void checkCallBack(hal::AlignmentConstPtr alignment);
+};
+
+struct ThreadedLiftoverTest : public AlignmentTest
+{
+   void createCallBack(hal::AlignmentPtr alignment);
+   void checkCallBack(hal::AlignmentConstPtr alignment);
+};
+
 CuSuite *halLiftoverTestSuite();
 
 #endif
@@ -85,6 +85,32 @@ static CLParserPtr initParser()
                                false);
   optionsParser->addOptionFlag("onlyOrthologs", "make only orthologs to the "
                                "reference appear in the MAF blocks", false);
+  optionsParser->addOption("numThreads",
+                           "number of threads to convert the reference with. "
+                           "Each thread converts one slice of the reference "
+                           "at a time (see --sliceLength).  The HAL file must "
+                           "be memory-mapped (see halMMapConvert) or HDF5 "
+                           "must be thread-safe",
+                           1);
+  optionsParser->addOption("sliceLength",
+                           "convert the reference in independent slices of "
+                           "this length.  Blocks are broken at slice "
+                           "boundaries, otherwise the output is the same as "
+                           "without slicing.  For a given slice length, the "
+                           "output does not depend on --numThreads.  "
+                           "If 0, there is no slicing unless --numThreads > 1"
+                           ", in which case it is set to 1000000",
+                           0);
+  optionsParser->addOption("maxMemory",
+                           "with --global, rough limit (in bytes) on the "
+                           "memory used to keep track of visited columns "
+                           "and to build blocks.  Visited bases are kept "
+                           "in temporary files (in $TMPDIR) that can be "
+                           "paged out and blocks are cut short when over "
+                           "the limit.  "
+                           "HDF5 caches are not included.  If 0, there is "
+                           "no limit",
+                           0);
 
   optionsParser->setDescription("Convert hal database to maf.");
   return optionsParser;
@@ -112,6 +138,9 @@ int main(int argc, char** argv)
   bool printTree;
   bool onlyOrthologs;
   hal_index_t maxBlockLen;
+  hal_size_t numThreads;
+  hal_size_t sliceLength;
+  hal_size_t maxMemory;
   try
   {
     optionsParser->parseOptions(argc, argv);
@@ -134,12 +163,28 @@ int main(int argc, char** argv)
     printTree = optionsParser->getFlag("printTree");
     maxBlockLen = optionsParser->getOption<hal_index_t>("maxBlockLen");
     onlyOrthologs = optionsParser->getFlag("onlyOrthologs");
+    numThreads = optionsParser->getOption<hal_size_t>("numThreads");
+    sliceLength = optionsParser->getOption<hal_size_t>("sliceLength");
+    maxMemory = optionsParser->getOption<hal_size_t>("maxMemory");
 
     if (rootGenomeName != "\"\"" && targetGenomes != "\"\"")
     {
       throw hal_exception("--rootGenome and --targetGenomes options are "
                           "mutually exclusive");
     }
+    if (numThreads == 0)
+    {
+      throw hal_exception("--numThreads must be at least 1");
+    }
+    if (global == true && (numThreads > 1 || sliceLength > 0))
+    {
+      throw hal_exception("--numThreads and --sliceLength cannot be used "
+                          "with --global");
+    }
+    if (global == false && maxMemory > 0)
+    {
+      throw hal_exception("--maxMemory can only be used with --global");
+    }
   }
   catch(exception& e)
   {
@@ -149,8 +194,9 @@ int main(int argc, char** argv)
   }
   try
   {
-    AlignmentConstPtr alignment = openHalAlignmentReadOnly(halPath, 
-                                                           optionsParser);
+    vector<AlignmentConstPtr> threadAlignments = 
+       openHalAlignmentReadOnlyPerThread(halPath, optionsParser, numThreads);
+    AlignmentConstPtr alignment = threadAlignments[0];
     if (alignment->getNumGenomes() == 0)
     {
       throw hal_exception("hal alignmenet is empty");
@@ -251,6 +297,10 @@ int main(int argc, char** argv)
     mafExport.setMaxBlockLength(maxBlockLen);
     mafExport.setPrintTree(printTree);
     mafExport.setOnlyOrthologs(onlyOrthologs);
+    mafExport.setNumThreads(numThreads);
+    mafExport.setSliceLength(sliceLength);
+    mafExport.setThreadAlignments(threadAlignments);
+    mafExport.setMaxMemory(maxMemory);
 
     ifstream refTargetsStream;
     if (refTargetsPath != "\"\"")
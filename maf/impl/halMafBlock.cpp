@@ -7,6 +7,7 @@
 #include <cstdlib>
 #include <iostream>
 #include <limits>
+#include <algorithm>
 #include "halMafBlock.h"
 
 using namespace std;
@@ -335,6 +336,7 @@ void MafBlock::initBlock(ColumnIteratorConstPtr col, bool fullNames, bool printT
     stTree_destruct(_tree);
   }
   resetEntries();
+  _genomeRanks.clear();
   _fullNames = fullNames;
   _printTree = printTree;
   const ColumnMap* colMap = col->getColumnMap();
@@ -456,6 +458,20 @@ void MafBlock::appendColumn(ColumnIteratorConstPtr col)
   }
 }
 
+hal_size_t MafBlock::getNumBytes() const
+{
+  hal_size_t numBytes = 0;
+  for (Entries::const_iterator e = _entries.begin(); e != _entries.end(); ++e)
+  {
+    numBytes += sizeof(MafBlockEntry) + sizeof(MafBlockString) + 
+       e->second->_name.capacity() + e->second->_sequence->_cap;
+  }
+  for (size_t i = 0; i < _stringBuffers.size(); ++i)
+  {
+    numBytes += sizeof(MafBlockString) + _stringBuffers[i]->_cap;
+  }
+  return numBytes;
+}
 
 // Q: When can we append a column? 
 // A: When for every sequence already in the column, the new column
@@ -601,17 +617,67 @@ ostream& MafBlock::printBlock(ostream& os) const
     os << *ref->second;
   }
 
+  // the other rows by genome in tree order, then as they are in the 
+  // block (by sequence).  the entries are sorted by genome address, 
+  // which isn't the same from one alignment handle to the next
+  vector<pair<size_t, Entries::const_iterator> > rows;
+  rows.reserve(_entries.size());
   for (Entries::const_iterator e = _entries.begin();
        e != _entries.end(); ++e)
   {
     if (e->second->_start != NULL_INDEX && e != ref)
     {
-      os << *e->second;
+      rows.push_back(pair<size_t, Entries::const_iterator>(
+                       getGenomeRank(e->first->getGenome()), e));
     }
   }
+  stable_sort(rows.begin(), rows.end(), RowRankLess());
+  for (size_t i = 0; i < rows.size(); ++i)
+  {
+    os << *rows[i].second->second;
+  }
   return os;
 }
 
+// rank of a genome in the order the rows are printed in: the reference
+// genome, its ancestors up to the root, and then the other genomes
+// breadth-first from the root.  this is the order in which a single
+// alignment handle usually opens (and so allocates) them.  worked out
+// once per block, as the reference (and alignment) can change between 
+// blocks
+size_t MafBlock::getGenomeRank(const Genome* genome) const
+{
+  map<const Genome*, size_t>::const_iterator i = _genomeRanks.find(genome);
+  if (i != _genomeRanks.end())
+  {
+    return i->second;
+  }
+  if (_genomeRanks.empty() == true)
+  {
+    const Genome* root = _reference->first->getGenome();
+    _genomeRanks.insert(pair<const Genome*, size_t>(root, 0));
+    while (root->getParent() != NULL)
+    {
+      root = root->getParent();
+      _genomeRanks.insert(pair<const Genome*, size_t>(root, 
+                                                      _genomeRanks.size()));
+    }
+    deque<const Genome*> bfQueue(1, root);
+    while (bfQueue.empty() == false)
+    {
+      const Genome* next = bfQueue.front();
+      bfQueue.pop_front();
+      _genomeRanks.insert(pair<const Genome*, size_t>(next, 
+                                                      _genomeRanks.size()));
+      for (hal_size_t child = 0; child < next->getNumChildren(); ++child)
+      {
+        bfQueue.push_back(next->getChild(child));
+      }
+    }
+  }
+  return _genomeRanks[genome];
+}
+
 ostream& hal::operator<<(ostream& os, const MafBlock& mafBlock)
 {
   if (mafBlock._printTree) {
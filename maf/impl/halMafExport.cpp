@@ -6,12 +6,20 @@
 
 #include <deque>
 #include <cassert>
+#include <cstdlib>
+#include <sstream>
+#include <algorithm>
+#include <pthread.h>
 #include "halMafExport.h"
 
 using namespace std;
 using namespace hal;
 
-MafExport::MafExport() : _maxRefGap(0), _noDupes(false), _printTree(false)
+const hal_size_t MafExport::defaultSliceLength = 1000000;
+
+MafExport::MafExport() : _maxRefGap(0), _noDupes(false), _printTree(false),
+                         _maxBlockLength(MafBlock::defaultMaxLength),
+                         _numThreads(1), _sliceLength(0), _maxMemory(0)
 {
 
 }
@@ -53,6 +61,7 @@ void MafExport::setAppend(bool append)
 
 void MafExport::setMaxBlockLength(hal_index_t maxLength)
 {
+  _maxBlockLength = maxLength;
   _mafBlock.setMaxLength(maxLength);
 }
 
@@ -66,6 +75,26 @@ void MafExport::setOnlyOrthologs(bool onlyOrthologs)
   _onlyOrthologs = onlyOrthologs;
 }
 
+void MafExport::setNumThreads(hal_size_t numThreads)
+{
+  _numThreads = max(numThreads, (hal_size_t)1);
+}
+
+void MafExport::setSliceLength(hal_size_t sliceLength)
+{
+  _sliceLength = sliceLength;
+}
+
+void MafExport::setThreadAlignments(const vector<AlignmentConstPtr>& alignments)
+{
+  _threadAlignments = alignments;
+}
+
+void MafExport::setMaxMemory(hal_size_t maxMemory)
+{
+  _maxMemory = maxMemory;
+}
+
 void MafExport::writeHeader()
 {
   assert(_mafStream != NULL);
@@ -106,6 +135,75 @@ void MafExport::convertSegmentedSequence(ostream& mafStream,
     writeHeader();
   }
 
+  hal_size_t sliceLength = _sliceLength;
+  if (sliceLength == 0 && _numThreads > 1)
+  {
+    sliceLength = defaultSliceLength;
+  }
+  if (sliceLength == 0)
+  {
+    convertRange(mafStream, _mafBlock, seq, startPosition, lastPosition,
+                 targets, startPosition);
+    mafStream.flush();
+  }
+  else
+  {
+    convertSlices(mafStream, seq, startPosition, lastPosition, targets,
+                  sliceLength);
+  }
+}
+
+/** Offset of a reference sequence (or genome) in genome coordinates */
+static hal_index_t getRefOffset(const SegmentedSequence* seq)
+{
+  const Sequence* sequence = dynamic_cast<const Sequence*>(seq);
+  return sequence != NULL ? sequence->getStartPosition() : 0;
+}
+
+/** Check if any reference position in a column lies in [first, last] 
+ * (genome coordinates).  The column map is sorted by genome and then by
+ * sequence, so the only entries to look at are those from the sequence
+ * containing first up to the one containing last (just the one entry 
+ * when converting a single sequence) */
+static bool hasRefPositionIn(ColumnIteratorConstPtr colIt, hal_index_t first,
+                             hal_index_t last)
+{
+  const Genome* refGenome = colIt->getReferenceGenome();
+  const ColumnIterator::ColumnMap* cmap = colIt->getColumnMap();
+  const Sequence* firstSequence = refGenome->getSequenceBySite(first);
+  assert(firstSequence != NULL);
+  for (ColumnIterator::ColumnMap::const_iterator i = 
+          cmap->lower_bound(firstSequence);
+       i != cmap->end() && i->first->getGenome() == refGenome &&
+          i->first->getStartPosition() <= last; ++i)
+  {
+    const ColumnIterator::DNASet* dnaSet = i->second;
+    for (size_t j = 0; j < dnaSet->size(); ++j)
+    {
+      hal_index_t pos = dnaSet->at(j)->getArrayIndex();
+      if (pos >= first && pos <= last)
+      {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// Write the blocks for [startPosition, lastPosition] of seq.  If this is
+// a slice of a bigger range that starts at rangeStart, columns that 
+// contain reference positions in [rangeStart, startPosition) were 
+// already visited by the iterators of the earlier slices and are skipped,
+// just as the visit cache would skip them in a single pass.  (With 
+// --unique, isCanonicalOnRef() already takes care of this)
+void MafExport::convertRange(ostream& mafStream,
+                             MafBlock& mafBlock,
+                             const SegmentedSequence* seq,
+                             hal_index_t startPosition,
+                             hal_index_t lastPosition,
+                             const set<const Genome*>& targets,
+                             hal_index_t rangeStart) const
+{
   ColumnIteratorConstPtr colIt = seq->getColumnIterator(&targets,
                                                         _maxRefGap, 
                                                         startPosition,
@@ -116,27 +214,34 @@ void MafExport::convertSegmentedSequence(ostream& mafStream,
                                                         true,  // unique
                                                         _onlyOrthologs);
 
+  bool checkVisited = _unique == false && rangeStart < startPosition;
+  hal_index_t visitedFirst = getRefOffset(seq) + rangeStart;
+  hal_index_t visitedLast = getRefOffset(seq) + startPosition - 1;
 
   hal_size_t appendCount = 0;
-  if (_unique == false || colIt->isCanonicalOnRef() == true)
+  if ((_unique == false || colIt->isCanonicalOnRef() == true) &&
+      (checkVisited == false || 
+       hasRefPositionIn(colIt, visitedFirst, visitedLast) == false))
   {
-    _mafBlock.initBlock(colIt, _ucscNames, _printTree);
-    assert(_mafBlock.canAppendColumn(colIt) == true);
-    _mafBlock.appendColumn(colIt);
+    mafBlock.initBlock(colIt, _ucscNames, _printTree);
+    assert(mafBlock.canAppendColumn(colIt) == true);
+    mafBlock.appendColumn(colIt);
     ++appendCount;
   }
   size_t numBlocks = 0;
   while (colIt->lastColumn() == false)
   {
     colIt->toRight();
-    if (_unique == false || colIt->isCanonicalOnRef() == true)
+    if ((_unique == false || colIt->isCanonicalOnRef() == true) &&
+        (checkVisited == false || 
+         hasRefPositionIn(colIt, visitedFirst, visitedLast) == false))
     {
       if (appendCount == 0)
       {
-        _mafBlock.initBlock(colIt, _ucscNames, _printTree);
-        assert(_mafBlock.canAppendColumn(colIt) == true);
+        mafBlock.initBlock(colIt, _ucscNames, _printTree);
+        assert(mafBlock.canAppendColumn(colIt) == true);
       }
-      if (_mafBlock.canAppendColumn(colIt) == false)
+      if (mafBlock.canAppendColumn(colIt) == false)
       {
         // erase empty entries from the column.  helps when there are 
         // millions of sequences (ie from fastas with lots of scaffolds)
@@ -146,12 +251,12 @@ void MafExport::convertSegmentedSequence(ostream& mafStream,
         }
         if (appendCount > 0)
         {
-          mafStream << _mafBlock << '\n';
+          mafStream << mafBlock << '\n';
         }
-        _mafBlock.initBlock(colIt, _ucscNames, _printTree);
-        assert(_mafBlock.canAppendColumn(colIt) == true);
+        mafBlock.initBlock(colIt, _ucscNames, _printTree);
+        assert(mafBlock.canAppendColumn(colIt) == true);
       }
-      _mafBlock.appendColumn(colIt);
+      mafBlock.appendColumn(colIt);
       ++appendCount;
     }
   }
@@ -160,7 +265,253 @@ void MafExport::convertSegmentedSequence(ostream& mafStream,
   // so we do following check
   if (appendCount > 0)
   {
-    mafStream << _mafBlock << endl;
+    mafStream << mafBlock << '\n';
+  }
+}
+
+/** Open every genome, top-down, so that they are created in the same 
+ * order whether or not threads are used (MAF rows are sorted by 
+ * genome pointer) */
+static void openAllGenomes(AlignmentConstPtr alignment)
+{
+  deque<string> bfQueue;
+  bfQueue.push_back(alignment->getRootName());
+  while (bfQueue.empty() == false)
+  {
+    string name = bfQueue.front();
+    bfQueue.pop_front();
+    alignment->openGenome(name);
+    vector<string> childNames = alignment->getChildNames(name);
+    bfQueue.insert(bfQueue.end(), childNames.begin(), childNames.end());
+  }
+}
+
+/** Find the counterpart of a genome or sequence in another handle
+ * to the same alignment */
+static const SegmentedSequence* 
+findSegmentedSequence(AlignmentConstPtr alignment, 
+                      const SegmentedSequence* seq)
+{
+  const Sequence* sequence = dynamic_cast<const Sequence*>(seq);
+  const Genome* genome = sequence != NULL ? sequence->getGenome() :
+     dynamic_cast<const Genome*>(seq);
+  assert(genome != NULL);
+  const Genome* threadGenome = alignment->openGenome(genome->getName());
+  if (threadGenome == NULL || sequence == NULL)
+  {
+    return threadGenome;
+  }
+  return threadGenome->getSequence(sequence->getName());
+}
+
+/** Slices shared by the worker threads.  Slices are handed out in
+ * order, and the calling thread writes their output in the same order.
+ * Workers stop taking new slices when they get _window slices ahead of
+ * the writer so that the output doesn't pile up in memory */
+struct MafSliceQueue
+{
+   const MafExport* _mafExport;
+   vector<const SegmentedSequence*> _seqs;
+   vector<set<const Genome*> > _targets;
+   hal_index_t _rangeStart;
+   vector<pair<hal_index_t, hal_index_t> > _slices;
+   vector<string*> _output;
+   size_t _nextSlice;
+   size_t _nextWrite;
+   size_t _window;
+   bool _abort;
+   string _error;
+   pthread_mutex_t _mutex;
+   pthread_cond_t _cond;
+};
+
+struct MafSliceThread
+{
+   MafSliceQueue* _queue;
+   size_t _index;
+};
+
+void* MafExport::sliceWorker(void* arg)
+{
+  MafSliceThread* thread = static_cast<MafSliceThread*>(arg);
+  MafSliceQueue* queue = thread->_queue;
+  const SegmentedSequence* seq = queue->_seqs[thread->_index];
+  const set<const Genome*>& targets = queue->_targets[thread->_index];
+  for (;;)
+  {
+    pthread_mutex_lock(&queue->_mutex);
+    while (queue->_abort == false && 
+           queue->_nextSlice < queue->_slices.size() &&
+           queue->_nextSlice >= queue->_nextWrite + queue->_window)
+    {
+      pthread_cond_wait(&queue->_cond, &queue->_mutex);
+    }
+    if (queue->_abort == true || queue->_nextSlice >= queue->_slices.size())
+    {
+      pthread_mutex_unlock(&queue->_mutex);
+      break;
+    }
+    size_t i = queue->_nextSlice++;
+    pthread_mutex_unlock(&queue->_mutex);
+
+    string* output = NULL;
+    string error;
+    try
+    {
+      ostringstream sliceStream;
+      MafBlock mafBlock(queue->_mafExport->_maxBlockLength);
+      queue->_mafExport->convertRange(sliceStream, mafBlock, seq,
+                                      queue->_slices[i].first,
+                                      queue->_slices[i].second,
+                                      targets, queue->_rangeStart);
+      output = new string(sliceStream.str());
+    }
+    catch (exception& e)
+    {
+      error = e.what();
+    }
+
+    pthread_mutex_lock(&queue->_mutex);
+    if (output != NULL)
+    {
+      queue->_output[i] = output;
+    }
+    else
+    {
+      queue->_error = error;
+      queue->_abort = true;
+    }
+    pthread_cond_broadcast(&queue->_cond);
+    pthread_mutex_unlock(&queue->_mutex);
+  }
+  return NULL;
+}
+
+void MafExport::convertSlices(ostream& mafStream,
+                              const SegmentedSequence* seq,
+                              hal_index_t startPosition,
+                              hal_index_t lastPosition,
+                              const set<const Genome*>& targets,
+                              hal_size_t sliceLength)
+{
+  vector<pair<hal_index_t, hal_index_t> > slices;
+  for (hal_index_t first = startPosition; first <= lastPosition; 
+       first += (hal_index_t)sliceLength)
+  {
+    hal_index_t last = min(first + (hal_index_t)sliceLength - 1, 
+                           lastPosition);
+    slices.push_back(pair<hal_index_t, hal_index_t>(first, last));
+  }
+  
+  if (_numThreads <= 1)
+  {
+    openAllGenomes(_alignment);
+    for (size_t i = 0; i < slices.size(); ++i)
+    {
+      MafBlock mafBlock(_maxBlockLength);
+      convertRange(mafStream, mafBlock, seq, slices[i].first, 
+                   slices[i].second, targets, startPosition);
+    }
+    mafStream.flush();
+    return;
+  }
+
+  if (_threadAlignments.size() < _numThreads)
+  {
+    throw hal_exception("MafExport: an alignment handle is needed for each "
+                        "thread (see setThreadAlignments())");
+  }
+  MafSliceQueue queue;
+  queue._mafExport = this;
+  queue._rangeStart = startPosition;
+  queue._slices = slices;
+  queue._output.assign(slices.size(), NULL);
+  queue._nextSlice = 0;
+  queue._nextWrite = 0;
+  queue._window = 4 * _numThreads;
+  queue._abort = false;
+  for (size_t i = 0; i < _numThreads; ++i)
+  {
+    AlignmentConstPtr alignment = _threadAlignments[i];
+    openAllGenomes(alignment);
+    const SegmentedSequence* threadSeq = findSegmentedSequence(alignment, 
+                                                               seq);
+    if (threadSeq == NULL)
+    {
+      throw hal_exception("MafExport: reference not found in thread "
+                          "alignment handle");
+    }
+    queue._seqs.push_back(threadSeq);
+    set<const Genome*> threadTargets;
+    for (set<const Genome*>::const_iterator j = targets.begin();
+         j != targets.end(); ++j)
+    {
+      threadTargets.insert(alignment->openGenome((*j)->getName()));
+    }
+    queue._targets.push_back(threadTargets);
+  }
+  pthread_mutex_init(&queue._mutex, NULL);
+  pthread_cond_init(&queue._cond, NULL);
+
+  vector<MafSliceThread> args(_numThreads);
+  vector<pthread_t> threads;
+  for (size_t i = 0; i < _numThreads; ++i)
+  {
+    args[i]._queue = &queue;
+    args[i]._index = i;
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, sliceWorker, &args[i]) != 0)
+    {
+      pthread_mutex_lock(&queue._mutex);
+      queue._error = "MafExport: unable to create thread";
+      queue._abort = true;
+      pthread_mutex_unlock(&queue._mutex);
+      break;
+    }
+    threads.push_back(thread);
+  }
+
+  // write the slices in order as they are finished
+  for (size_t i = 0; i < slices.size(); ++i)
+  {
+    pthread_mutex_lock(&queue._mutex);
+    while (queue._abort == false && queue._output[i] == NULL)
+    {
+      pthread_cond_wait(&queue._cond, &queue._mutex);
+    }
+    if (queue._abort == true)
+    {
+      pthread_mutex_unlock(&queue._mutex);
+      break;
+    }
+    string* output = queue._output[i];
+    queue._output[i] = NULL;
+    ++queue._nextWrite;
+    pthread_cond_broadcast(&queue._cond);
+    pthread_mutex_unlock(&queue._mutex);
+
+    mafStream << *output;
+    delete output;
+  }
+  mafStream.flush();
+
+  pthread_mutex_lock(&queue._mutex);
+  queue._abort = true;
+  pthread_cond_broadcast(&queue._cond);
+  pthread_mutex_unlock(&queue._mutex);
+  for (size_t i = 0; i < threads.size(); ++i)
+  {
+    pthread_join(threads[i], NULL);
+  }
+  for (size_t i = 0; i < queue._output.size(); ++i)
+  {
+    delete queue._output[i];
+  }
+  pthread_cond_destroy(&queue._cond);
+  pthread_mutex_destroy(&queue._mutex);
+  if (queue._error.empty() == false)
+  {
+    throw hal_exception(queue._error);
   }
 }
 
@@ -175,71 +526,47 @@ void MafExport::convertEntireAlignment(ostream& mafStream,
 
     writeHeader();
 
-    // Load in all leaves from alignment
-    vector<string> leafNames = alignment->getLeafNamesBelow(alignment->getRootName());
-    vector<const Genome *> leafGenomes;
-    for (hal_size_t i = 0; i < leafNames.size(); i++) {
-        const Genome *genome = alignment->openGenome(leafNames[i]);
-        assert(genome != NULL);
-        leafGenomes.push_back(genome);
+    // with a memory cap, keep the visited bases in temporary files so 
+    // that they can be paged out
+    string tempDir;
+    if (_maxMemory > 0)
+    {
+        const char* tmp = getenv("TMPDIR");
+        tempDir = tmp != NULL && *tmp != '\0' ? tmp : "/tmp";
     }
-    ColumnIterator::VisitCache visitCache;
-    // Go through all the genomes one by one, and spit out any columns
+    // Go through all the leaves one by one, and spit out any columns
     // they participate in that we haven't seen.
-    for (hal_size_t i = 0; i < leafGenomes.size(); i++) {
-        const Genome *genome = leafGenomes[i];
-        ColumnIteratorConstPtr colIt = genome->getColumnIterator(NULL,
-                                                                 0,
-                                                                 0,
-                                                                 NULL_INDEX,
-                                                                 _noDupes,
-                                                                 _noAncestors,
-                                                                 false, // reverseStrand
-                                                                 true,  // unique
-                                                                 _onlyOrthologs);
-        colIt->setVisitCache(&visitCache);
-        // So that we don't accidentally visit the first column if it's
-        // already been visited.
-        colIt->toSite(0, genome->getSequenceLength() - 1);
-        for (;;) {
-            if (appendCount == 0) {
-              _mafBlock.initBlock(colIt, _ucscNames, _printTree);
-                assert(_mafBlock.canAppendColumn(colIt) == true);
-            }
-            if (_mafBlock.canAppendColumn(colIt) == false)
+    AllColumnIterator::Scan scan(alignment, 1, tempDir);
+    AllColumnIterator allIt(alignment, &scan, 0, _noDupes, _noAncestors,
+                            _onlyOrthologs);
+    for (; allIt.atEnd() == false; allIt.toRight()) {
+        ColumnIteratorConstPtr colIt = allIt.getColumnIterator();
+        if (appendCount == 0) {
+            _mafBlock.initBlock(colIt, _ucscNames, _printTree);
+            assert(_mafBlock.canAppendColumn(colIt) == true);
+        }
+        // with a memory cap, don't let a block grow past its share 
+        // (checking only every so often since it's not free)
+        bool blockFull = _maxMemory > 0 && appendCount % 1024 == 0 &&
+           _mafBlock.getNumBytes() > _maxMemory / 2;
+        if (blockFull == true || 
+            _mafBlock.canAppendColumn(colIt) == false)
+        {
+            // erase empty entries from the column.  helps when there are 
+            // millions of sequences (ie from fastas with lots of scaffolds)
+            if (numBlocks++ % 1000 == 0)
             {
-                // erase empty entries from the column.  helps when there are 
-                // millions of sequences (ie from fastas with lots of scaffolds)
-                if (numBlocks++ % 1000 == 0)
-                {
-                    colIt->defragment();
-                }
-                if (appendCount > 0)
-                {
-                    mafStream << _mafBlock << '\n';
-                }
-                _mafBlock.initBlock(colIt, _ucscNames, _printTree);
-                assert(_mafBlock.canAppendColumn(colIt) == true);
+                colIt->defragment();
             }
-            _mafBlock.appendColumn(colIt);
-            appendCount++;
-
-            if (colIt->lastColumn()) {
-                // Have to break here because otherwise
-                // colIt->toRight() will crash.
-                break;
+            if (appendCount > 0)
+            {
+                mafStream << _mafBlock << '\n';
             }
-            colIt->toRight();
-        }
-        // Copy over the updated visit cache information. This is a
-        // deep copy, so it's slow, but necessary to preserve the
-        // column iterator ownership of the visit cache
-        visitCache.clear();
-        ColumnIterator::VisitCache *newVisitCache = colIt->getVisitCache();
-        for(ColumnIterator::VisitCache::iterator it = newVisitCache->begin();
-            it != newVisitCache->end(); it++) {
-            visitCache[it->first] = new PositionCache(*it->second);
+            _mafBlock.initBlock(colIt, _ucscNames, _printTree);
+            assert(_mafBlock.canAppendColumn(colIt) == true);
         }
+        _mafBlock.appendColumn(colIt);
+        appendCount++;
     }
 
     // if nothing was ever added (seems to happen in corner case where
@@ -67,6 +67,10 @@ public:
    void appendColumn(ColumnIteratorConstPtr col);
    bool canAppendColumn(hal::ColumnIteratorConstPtr col);
    void setMaxLength(hal_index_t maxLen);
+
+   /** Approximate number of bytes of memory used by the block's 
+    * entries (including spare string buffers) */
+   hal_size_t getNumBytes() const;
    
 protected:
    
@@ -82,9 +86,15 @@ protected:
 
    std::ostream& printBlock(std::ostream& os) const;
    std::ostream& printBlockWithTree(std::ostream& os) const;
+   size_t getGenomeRank(const Genome* genome) const;
 
    typedef std::multimap<const Sequence*, MafBlockEntry*, 
                          ColumnIterator::SequenceLess> Entries;
+   struct RowRankLess { 
+     bool operator()(const std::pair<size_t, Entries::const_iterator>& r1,
+                     const std::pair<size_t, Entries::const_iterator>& r2) 
+       const { return r1.first < r2.first; }
+   };
    Entries _entries;
    Entries::const_iterator _reference;
    std::vector<MafBlockString*> _stringBuffers;
@@ -93,6 +103,8 @@ protected:
    bool _fullNames;
    bool _printTree;
    stTree *_tree;
+   // print order of the genomes (of the handle the block is built with)
+   mutable std::map<const Genome*, size_t> _genomeRanks;
 
    typedef hal::ColumnIterator::ColumnMap ColumnMap;
    typedef hal::ColumnIterator::DNASet DNASet;
@@ -46,11 +46,46 @@ public:
    void setMaxBlockLength(hal_index_t maxLength);
    void setPrintTree(bool printTree);
    void setOnlyOrthologs(bool onlyOrthologs);
+   void setNumThreads(hal_size_t numThreads);
+   void setSliceLength(hal_size_t sliceLength);
+
+   /** Alignment handles for the worker threads, as returned by
+    * openHalAlignmentReadOnlyPerThread().  Needed when numThreads > 1.
+    * The reference and targets passed to convertSegmentedSequence() are
+    * looked up by name in each of them. */
+   void setThreadAlignments(const std::vector<AlignmentConstPtr>& alignments);
+
+   /** Rough cap on the memory used by convertEntireAlignment() to 
+    * remember visited columns and build blocks (0 means no limit). 
+    * The visited bases (a bit each) are kept in temporary files that 
+    * can be paged out, and the current block is written out early
+    * (even though it could be extended) once it takes up half the cap. */
+   void setMaxMemory(hal_size_t maxMemory);
+
+   /** Slice length used when numThreads > 1 and no slice length is set */
+   static const hal_size_t defaultSliceLength;
 
 protected:
 
    void writeHeader();
 
+   void convertRange(std::ostream& mafStream,
+                     MafBlock& mafBlock,
+                     const SegmentedSequence* seq,
+                     hal_index_t startPosition,
+                     hal_index_t lastPosition,
+                     const std::set<const Genome*>& targets,
+                     hal_index_t rangeStart) const;
+
+   void convertSlices(std::ostream& mafStream,
+                      const SegmentedSequence* seq,
+                      hal_index_t startPosition,
+                      hal_index_t lastPosition,
+                      const std::set<const Genome*>& targets,
+                      hal_size_t sliceLength);
+
+   static void* sliceWorker(void* arg);
+
 protected:
 
    AlignmentConstPtr _alignment;
@@ -64,6 +99,11 @@ protected:
    bool _append;
    bool _printTree;
    bool _onlyOrthologs;
+   hal_index_t _maxBlockLength;
+   hal_size_t _numThreads;
+   hal_size_t _sliceLength;
+   std::vector<AlignmentConstPtr> _threadAlignments;
+   hal_size_t _maxMemory;
 };
 
 }
@@ -4,14 +4,98 @@
  * Released under the MIT license, see LICENSE.txt
  */
 
-#include "halMafTests.h"
+#include <sstream>
+#include "halMafExportTest.h"
 #include "halMafExport.h"
+#include "halRandomData.h"
+
+extern "C" {
+#include "commonC.h"
+}
 
 using namespace std;
 using namespace hal;
 
+static const hal_size_t numThreads = 4;
+static const hal_size_t sliceLength = 100;
+
+void MafExportThreadTest::createCallBack(AlignmentPtr alignment)
+{
+  createRandomAlignment(alignment, 
+                        0.75, 
+                        0.1,
+                        5,
+                        10,
+                        1000,
+                        5,
+                        10);
+}
+
+static string exportMaf(const vector<AlignmentConstPtr>& alignments,
+                        hal_size_t threads, bool unique)
+{
+  AlignmentConstPtr alignment = alignments[0];
+  const Genome* ref = alignment->openGenome(alignment->getRootName());
+  stringstream mafStream;
+  MafExport mafExport;
+  mafExport.setMaxRefGap(0);
+  mafExport.setNoDupes(false);
+  mafExport.setNoAncestors(false);
+  mafExport.setUcscNames(true);
+  mafExport.setUnique(unique);
+  mafExport.setAppend(false);
+  mafExport.setPrintTree(false);
+  mafExport.setOnlyOrthologs(false);
+  mafExport.setNumThreads(threads);
+  mafExport.setSliceLength(sliceLength);
+  mafExport.setThreadAlignments(alignments);
+  mafExport.convertSegmentedSequence(mafStream, alignment, ref, 0, 0,
+                                     set<const Genome*>());
+  return mafStream.str();
+}
+
+// the threaded output must match the serial output for the same slices
+void MafExportThreadTest::checkCallBack(AlignmentConstPtr alignment)
+{
+  const Genome* root = alignment->openGenome(alignment->getRootName());
+  if (root->getSequenceLength() == 0)
+  {
+    return;
+  }
+  char* mmPath = getTempFile();
+  writeMMapAlignment(alignment, mmPath);
+  vector<AlignmentConstPtr> alignments = 
+     openHalAlignmentReadOnlyPerThread(mmPath, CLParserPtr(), numThreads);
+  
+  for (size_t i = 0; i < 2; ++i)
+  {
+    bool unique = i == 1;
+    string serial = exportMaf(alignments, 1, unique);
+    string threaded = exportMaf(alignments, numThreads, unique);
+    CuAssertTrue(_testCase, serial.empty() == false);
+    CuAssertTrue(_testCase, threaded == serial);
+  }
+
+  alignments.clear();
+  removeTempFile(mmPath);
+}
+
+void halMafExportThreadTest(CuTest *testCase)
+{
+  try
+  {
+    MafExportThreadTest tester;
+    tester.check(testCase);
+  }
+  catch (...) 
+  {
+    CuAssertTrue(testCase, false);
+  }
+}
+
 CuSuite *halMafExportTestSuite(void)
 {
   CuSuite* suite = CuSuiteNew();
+  SUITE_ADD_TEST(suite, halMafExportThreadTest);
   return suite;
 }
@@ -3,6 +3,8 @@
 #include "hal.h"
 #include "sonLibTree.h"
 #include "string.h"
+#include <deque>
+#include <pthread.h>
 #include "halBedScanner.h"
 #include "ancestorsMLBed.h"
 extern "C" {
@@ -35,6 +37,15 @@ static CLParserPtr initParser()
                                " probabilities for reference in wig"
                                " format", false);
   optionsParser->addOptionFlag("printWrites", "print base changes", false);
+  optionsParser->addOption("cacheSize", "number of site estimates to keep, "
+                           "by tree and leaf bases.  sites that match one "
+                           "aren't estimated again.  0 disables the cache",
+                           100000);
+  optionsParser->addOption("numThreads", "number of threads.  the ranges "
+                           "are estimated in slices on separate handles to "
+                           "the alignment, and the changes are made in "
+                           "order by the main thread.  an hdf5 alignment "
+                           "needs a thread-safe hdf5 library", 1);
   return optionsParser;
 }
 
@@ -401,39 +412,236 @@ void walkFelsenstein(TreeModel *mod, stTree *tree, char assignment, double thres
   }
 }
 
-void writeNucleotides(stTree *tree, AlignmentPtr alignment,
-                      Genome *target, hal_index_t targetPos, bool writeHal = false,
-                      bool printWrites = false)
+// An ancestral base estimated for a site: the base (on the strand of
+// the reference) of one internal node of the site's tree
+struct SiteCall {
+  const Genome *genome;
+  hal_index_t pos;
+  bool reversed;
+  char dna;
+};
+
+// Estimates for the internal nodes of a site tree, in preorder
+struct CachedSite {
+  vector<char> dna;
+  vector<double> post;
+};
+
+// Estimates of the sites seen so far, by tree topology (phast IDs of
+// the nodes) and leaf bases.  The estimate of a site only depends on
+// those, so sites in conserved regions are mostly found here.  It's
+// emptied when it gets to maxSize sites.
+class PosteriorCache {
+public:
+  PosteriorCache(size_t maxSize) : _maxSize(maxSize) {}
+  const CachedSite *find(const string &key) const {
+    map<string, CachedSite>::const_iterator i = _sites.find(key);
+    return i == _sites.end() ? NULL : &i->second;
+  }
+  void insert(const string &key, const CachedSite &site) {
+    if (_sites.size() >= _maxSize) {
+      _sites.clear();
+    }
+    _sites.insert(pair<string, CachedSite>(key, site));
+  }
+private:
+  map<string, CachedSite> _sites;
+  size_t _maxSize;
+};
+
+// Key of a site tree for the PosteriorCache
+void getTreeKey(stTree *tree, string &key)
 {
   felsensteinData *data = (felsensteinData *) stTree_getClientData(tree);
+  char buf[32];
+  sprintf(buf, "%d", data->phastId);
+  key += buf;
   if (stTree_getChildNumber(tree) == 0) {
+    key += ':';
+    key += (char)toupper(data->dna);
     return;
   }
-  Genome *genome = alignment->openGenome(stTree_getLabel(tree));
-  assert(genome != NULL);
-  DNAIteratorPtr dnaIt = genome->getDNAIterator(data->pos);
-  if (data->reversed) {
-    dnaIt->toReverse();
+  key += '(';
+  for (int64_t i = 0; i < stTree_getChildNumber(tree); i++) {
+    getTreeKey(stTree_getChild(tree, i), key);
   }
-  char dna = toupper(dnaIt->getChar());
-  if (data->dna != dna) {
-    if (printWrites) {
-      cout << genome->getName() << "\t" << data->pos << "\t" << string(1, dna) << "\t" << string(1, data->dna) << endl;
-    }
-    if (writeHal) {
-      dnaIt->setChar(data->dna);
-    }
+  key += ')';
+}
+
+// Get the estimates of the internal nodes of a site tree, in preorder
+void getEstimates(stTree *tree, CachedSite &site)
+{
+  if (stTree_getChildNumber(tree) == 0) {
+    return;
+  }
+  felsensteinData *data = (felsensteinData *) stTree_getClientData(tree);
+  site.dna.push_back(data->dna);
+  site.post.push_back(data->post);
+  for (int64_t i = 0; i < stTree_getChildNumber(tree); i++) {
+    getEstimates(stTree_getChild(tree, i), site);
+  }
+}
+
+// Set the estimates of the internal nodes of a site tree from those
+// of a site with the same key
+void setEstimates(stTree *tree, const CachedSite &site, size_t &index)
+{
+  if (stTree_getChildNumber(tree) == 0) {
+    return;
   }
-  if (writePosts && genome == target && data->pos == targetPos) {
+  felsensteinData *data = (felsensteinData *) stTree_getClientData(tree);
+  data->dna = site.dna[index];
+  data->post = site.post[index];
+  ++index;
+  for (int64_t i = 0; i < stTree_getChildNumber(tree); i++) {
+    setEstimates(stTree_getChild(tree, i), site, index);
+  }
+}
+
+// List the bases estimated for the internal nodes of a site tree, and
+// get the posterior of the target position
+void collectCalls(stTree *tree, AlignmentConstPtr alignment,
+                  const Genome *target, hal_index_t targetPos,
+                  vector<SiteCall> &calls, double &targetPost)
+{
+  felsensteinData *data = (felsensteinData *) stTree_getClientData(tree);
+  if (stTree_getChildNumber(tree) == 0) {
+    return;
+  }
+  const Genome *genome = alignment->openGenome(stTree_getLabel(tree));
+  assert(genome != NULL);
+  SiteCall call;
+  call.genome = genome;
+  call.pos = data->pos;
+  call.reversed = data->reversed;
+  call.dna = data->dna;
+  calls.push_back(call);
+  if (genome == target && data->pos == targetPos) {
     // correct genome and correct position
-    outValue = data->post;
+    targetPost = data->post;
   }
   for (int64_t i = 0; i < stTree_getChildNumber(tree); i++) {
     stTree *childNode = stTree_getChild(tree, i);
-    writeNucleotides(childNode, alignment, target, targetPos, writeHal, printWrites);
+    collectCalls(childNode, alignment, target, targetPos, calls, targetPost);
   }
 }
 
+// Apply the estimated bases to the alignment: print those that differ
+// from the alignment if printWrites is set, and write them if writeHal
+// is set.  Bases are read a window at a time and written in contiguous
+// runs with setSubString() when there are enough of them (and when
+// flush() is called) rather than one DNAIterator per base.  Calls can
+// come from other handles to the alignment (genomes are matched by
+// name).
+class NucleotideWriter {
+public:
+  NucleotideWriter(AlignmentPtr alignment, bool writeHal, bool printWrites) :
+    _alignment(alignment), _writeHal(writeHal), _printWrites(printWrites),
+    _numPending(0) {}
+  ~NucleotideWriter() {
+    for (map<string, GenomeBuffer *>::iterator i = _buffers.begin();
+         i != _buffers.end(); ++i) {
+      delete i->second;
+    }
+  }
+  void apply(const SiteCall *begin, const SiteCall *end) {
+    for (const SiteCall *call = begin; call != end; ++call) {
+      GenomeBuffer *buffer = getBuffer(call->genome);
+      char dna = toupper(getChar(buffer, call->pos));
+      if (call->reversed) {
+        dna = reverseComplement(dna);
+      }
+      if (call->dna != dna) {
+        if (_printWrites) {
+          cout << buffer->genome->getName() << "\t" << call->pos << "\t"
+               << string(1, dna) << "\t" << string(1, call->dna) << endl;
+        }
+        if (_writeHal) {
+          setChar(buffer, call->pos, call->reversed ?
+                  reverseComplement(call->dna) : call->dna);
+        }
+      }
+    }
+  }
+  void flush() {
+    for (map<string, GenomeBuffer *>::iterator i = _buffers.begin();
+         i != _buffers.end(); ++i) {
+      GenomeBuffer *buffer = i->second;
+      map<hal_index_t, char>::iterator j = buffer->pending.begin();
+      while (j != buffer->pending.end()) {
+        hal_index_t start = j->first;
+        string run;
+        for (; j != buffer->pending.end() &&
+               j->first == start + (hal_index_t)run.length(); ++j) {
+          run += j->second;
+        }
+        buffer->genome->setSubString(run, start, run.length());
+      }
+      buffer->pending.clear();
+    }
+    _numPending = 0;
+  }
+private:
+  // bases read from the alignment at a time
+  static const hal_size_t windowLength = 4096;
+  // bases written to the alignment at a time
+  static const size_t maxPending = 1000000;
+  struct GenomeBuffer {
+    Genome *genome;
+    hal_index_t windowStart;
+    string window;
+    // forward-strand bases not written yet
+    map<hal_index_t, char> pending;
+  };
+  GenomeBuffer *getBuffer(const Genome *genome) {
+    map<const Genome *, GenomeBuffer *>::iterator i = _byGenome.find(genome);
+    if (i != _byGenome.end()) {
+      return i->second;
+    }
+    GenomeBuffer *&buffer = _buffers[genome->getName()];
+    if (buffer == NULL) {
+      buffer = new GenomeBuffer();
+      buffer->genome = _alignment->openGenome(genome->getName());
+      buffer->windowStart = 0;
+    }
+    _byGenome.insert(pair<const Genome *, GenomeBuffer *>(genome, buffer));
+    return buffer;
+  }
+  char getChar(GenomeBuffer *buffer, hal_index_t pos) {
+    map<hal_index_t, char>::iterator i = buffer->pending.find(pos);
+    if (i != buffer->pending.end()) {
+      return i->second;
+    }
+    if (pos < buffer->windowStart ||
+        pos >= buffer->windowStart + (hal_index_t)buffer->window.length()) {
+      // sites are visited in both directions through inversions
+      hal_size_t length = buffer->genome->getSequenceLength();
+      hal_size_t start = pos > (hal_index_t)windowLength / 2 ?
+        pos - windowLength / 2 : 0;
+      buffer->windowStart = start;
+      hal_size_t windowEnd = min(start + (hal_size_t)windowLength, length);
+      buffer->genome->getSubString(buffer->window, start, windowEnd - start);
+    }
+    return buffer->window[pos - buffer->windowStart];
+  }
+  void setChar(GenomeBuffer *buffer, hal_index_t pos, char dna) {
+    buffer->pending[pos] = dna;
+    if (pos >= buffer->windowStart &&
+        pos < buffer->windowStart + (hal_index_t)buffer->window.length()) {
+      buffer->window[pos - buffer->windowStart] = dna;
+    }
+    if (++_numPending >= maxPending) {
+      flush();
+    }
+  }
+  AlignmentPtr _alignment;
+  bool _writeHal;
+  bool _printWrites;
+  map<string, GenomeBuffer *> _buffers;
+  map<const Genome *, GenomeBuffer *> _byGenome;
+  size_t _numPending;
+};
+
 // TODO: just free the tree here as well, it'd be cleaner
 void freeClientData(stTree *tree)
 {
@@ -451,39 +659,38 @@ void freeClientData(stTree *tree)
   free(data);
 }
 
-void reEstimate(TreeModel *mod, AlignmentPtr alignment, Genome *genome, hal_index_t startPos, hal_index_t endPos, map<string, int> &nameToId, double threshold, bool writeHal, bool printWrites)
+// Estimate the ancestral bases of the tree of a site.  Returns false
+// (and no calls) if there is no tree, i.e. the site is inserted in the
+// root genome relative to its children.
+bool estimateSite(TreeModel *mod, AlignmentConstPtr alignment, const Genome *genome, hal_index_t pos, map<string, int> &nameToId, double threshold, PosteriorCache *cache, vector<SiteCall> &calls, double &targetPost)
 {
-  stTree *tree = NULL;
-  bool firstRun = true;
-  for (hal_index_t pos = startPos; pos < endPos; pos++) {
-    outValue = 0.0;
-    if (writePosts && firstRun) {
-      const Sequence *seq = genome->getSequenceBySite(pos);
-      // position + 1 because wigs are 1-based.
-      cout << "fixedStep chrom=" << seq->getName() << 
-        " start=" << pos - seq->getStartPosition() + 1 << " step=1" << endl;
-      firstRun = false;
-    }
-    tree = stTree_construct();
-    // Find root of tree
-    rootInfo *rootInfo = findRoot(genome, pos);
-    const Genome *root = rootInfo->rootGenome;
-    hal_index_t rootPos = rootInfo->pos;
-    bool rootReversed = rootInfo->reversed;
-    buildTree(alignment, root, rootPos, tree, rootReversed, &nameToId);
-    pruneTree(tree);
-    if (stTree_getChildNumber(tree) == 0) {
-      // No reason to build a tree, there's an insertion in the root
-      // node relative to its children.
-      freeClientData(tree);
-      stTree_destruct(tree);
-      if (writePosts) {
-        // need to keep the wig in order
-        outValue = 0.0;
-        cout << outValue << endl;
-      }
-      continue;
-    }
+  targetPost = 0.0;
+  stTree *tree = stTree_construct();
+  // Find root of tree
+  rootInfo *rootInfo = findRoot(genome, pos);
+  const Genome *root = rootInfo->rootGenome;
+  hal_index_t rootPos = rootInfo->pos;
+  bool rootReversed = rootInfo->reversed;
+  free(rootInfo);
+  buildTree(alignment, root, rootPos, tree, rootReversed, &nameToId);
+  pruneTree(tree);
+  if (stTree_getChildNumber(tree) == 0) {
+    // No reason to build a tree, there's an insertion in the root
+    // node relative to its children.
+    freeClientData(tree);
+    stTree_destruct(tree);
+    return false;
+  }
+  string key;
+  const CachedSite *cachedSite = NULL;
+  if (cache != NULL) {
+    getTreeKey(tree, key);
+    cachedSite = cache->find(key);
+  }
+  if (cachedSite != NULL) {
+    size_t index = 0;
+    setEstimates(tree, *cachedSite, index);
+  } else {
     doFelsenstein(tree, mod);
     // Find assignment for root node that maximizes P(leaves)
     felsensteinData *rootData = (felsensteinData *) stTree_getClientData(tree);
@@ -510,15 +717,256 @@ void reEstimate(TreeModel *mod, AlignmentPtr alignment, Genome *genome, hal_inde
       assignment = indexToChar(maxDna);
     }
     walkFelsenstein(mod, tree, assignment, threshold);
-    writeNucleotides(tree, alignment, genome, pos, writeHal, printWrites);
-    freeClientData(tree);
-    stTree_destruct(tree);
+    if (cache != NULL) {
+      CachedSite site;
+      getEstimates(tree, site);
+      cache->insert(key, site);
+    }
+  }
+  collectCalls(tree, alignment, genome, pos, calls, targetPost);
+  freeClientData(tree);
+  stTree_destruct(tree);
+  return true;
+}
+
+void reEstimate(TreeModel *mod, AlignmentConstPtr alignment, const Genome *genome, hal_index_t startPos, hal_index_t endPos, map<string, int> &nameToId, double threshold, PosteriorCache *cache, NucleotideWriter &writer)
+{
+  vector<SiteCall> calls;
+  for (hal_index_t pos = startPos; pos < endPos; pos++) {
+    if (writePosts && pos == startPos) {
+      const Sequence *seq = genome->getSequenceBySite(pos);
+      // position + 1 because wigs are 1-based.
+      cout << "fixedStep chrom=" << seq->getName() << 
+        " start=" << pos - seq->getStartPosition() + 1 << " step=1" << endl;
+    }
+    calls.clear();
+    estimateSite(mod, alignment, genome, pos, nameToId, threshold, cache,
+                 calls, outValue);
+    if (!calls.empty()) {
+      writer.apply(&calls[0], &calls[0] + calls.size());
+    }
     if (writePosts) {
+      // need to keep the wig in order
       cout << outValue << endl;
     }
   }
 }
 
+// Slices of the ranges shared by the worker threads.  Slices are
+// handed out in order, and the main thread applies their estimates in
+// the same order.  Workers stop taking new slices when they get
+// _window slices ahead of it so that the estimates don't pile up in
+// memory.
+struct SliceResult {
+  vector<SiteCall> calls;
+  // end of the calls of each position in calls
+  vector<size_t> callEnds;
+  vector<double> posts;
+};
+
+// positions estimated at a time by a thread
+static const hal_index_t sliceLength = 10000;
+
+struct SliceQueue {
+  TreeModel *mod;
+  map<string, int> *nameToId;
+  double threshold;
+  size_t cacheSize;
+  // (first, end) genome positions of the slices, and whether each
+  // starts a range
+  vector<pair<hal_index_t, hal_index_t> > slices;
+  vector<bool> rangeStarts;
+  vector<SliceResult *> results;
+  size_t nextSlice;
+  size_t nextApply;
+  size_t window;
+  bool abort;
+  string error;
+  pthread_mutex_t mutex;
+  pthread_cond_t cond;
+};
+
+struct SliceThread {
+  SliceQueue *queue;
+  AlignmentConstPtr alignment;
+  const Genome *genome;
+};
+
+static void *sliceWorker(void *arg)
+{
+  SliceThread *thread = static_cast<SliceThread *>(arg);
+  SliceQueue *queue = thread->queue;
+  PosteriorCache cache(queue->cacheSize);
+  for (;;) {
+    pthread_mutex_lock(&queue->mutex);
+    while (!queue->abort && queue->nextSlice < queue->slices.size() &&
+           queue->nextSlice >= queue->nextApply + queue->window) {
+      pthread_cond_wait(&queue->cond, &queue->mutex);
+    }
+    if (queue->abort || queue->nextSlice >= queue->slices.size()) {
+      pthread_mutex_unlock(&queue->mutex);
+      break;
+    }
+    size_t i = queue->nextSlice++;
+    pthread_mutex_unlock(&queue->mutex);
+
+    SliceResult *result = new SliceResult();
+    string error;
+    try {
+      for (hal_index_t pos = queue->slices[i].first;
+           pos < queue->slices[i].second; pos++) {
+        double post = 0.0;
+        estimateSite(queue->mod, thread->alignment, thread->genome, pos,
+                     *queue->nameToId, queue->threshold,
+                     queue->cacheSize > 0 ? &cache : NULL,
+                     result->calls, post);
+        result->callEnds.push_back(result->calls.size());
+        result->posts.push_back(post);
+      }
+    } catch (exception &e) {
+      error = e.what();
+      delete result;
+      result = NULL;
+    }
+
+    pthread_mutex_lock(&queue->mutex);
+    if (result != NULL) {
+      queue->results[i] = result;
+    } else {
+      queue->error = error;
+      queue->abort = true;
+    }
+    pthread_cond_broadcast(&queue->cond);
+    pthread_mutex_unlock(&queue->mutex);
+  }
+  return NULL;
+}
+
+// Open every genome, so that the threads never do it on a shared
+// alignment
+static void openAllGenomes(AlignmentConstPtr alignment)
+{
+  deque<string> bfQueue;
+  bfQueue.push_back(alignment->getRootName());
+  while (!bfQueue.empty()) {
+    string name = bfQueue.front();
+    bfQueue.pop_front();
+    alignment->openGenome(name);
+    vector<string> childNames = alignment->getChildNames(name);
+    bfQueue.insert(bfQueue.end(), childNames.begin(), childNames.end());
+  }
+}
+
+// Estimate the ranges in slices on worker threads, each with its own
+// handle to the alignment and posterior cache, and apply the estimates
+// in order on this thread.
+void reEstimateWithThreads(TreeModel *mod, const vector<AlignmentConstPtr> &alignments, const string &genomeName, const vector<pair<hal_index_t, hal_index_t> > &ranges, map<string, int> &nameToId, double threshold, size_t cacheSize, NucleotideWriter &writer)
+{
+  size_t numThreads = alignments.size();
+  SliceQueue queue;
+  queue.mod = mod;
+  queue.nameToId = &nameToId;
+  queue.threshold = threshold;
+  queue.cacheSize = cacheSize;
+  for (size_t i = 0; i < ranges.size(); ++i) {
+    for (hal_index_t first = ranges[i].first; first < ranges[i].second;
+         first += sliceLength) {
+      hal_index_t end = min(first + sliceLength, ranges[i].second);
+      queue.slices.push_back(pair<hal_index_t, hal_index_t>(first, end));
+      queue.rangeStarts.push_back(first == ranges[i].first);
+    }
+  }
+  queue.results.assign(queue.slices.size(), NULL);
+  queue.nextSlice = 0;
+  queue.nextApply = 0;
+  queue.window = 4 * numThreads;
+  queue.abort = false;
+
+  vector<SliceThread> args(numThreads);
+  for (size_t i = 0; i < numThreads; ++i) {
+    openAllGenomes(alignments[i]);
+    args[i].queue = &queue;
+    args[i].alignment = alignments[i];
+    args[i].genome = alignments[i]->openGenome(genomeName);
+  }
+  pthread_mutex_init(&queue.mutex, NULL);
+  pthread_cond_init(&queue.cond, NULL);
+
+  vector<pthread_t> threads;
+  for (size_t i = 0; i < numThreads; ++i) {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, sliceWorker, &args[i]) != 0) {
+      pthread_mutex_lock(&queue.mutex);
+      queue.error = "ancestorsML: unable to create thread";
+      queue.abort = true;
+      pthread_mutex_unlock(&queue.mutex);
+      break;
+    }
+    threads.push_back(thread);
+  }
+
+  // apply the estimates of the slices in order as they are finished
+  try {
+    for (size_t i = 0; i < queue.slices.size(); ++i) {
+      pthread_mutex_lock(&queue.mutex);
+      while (!queue.abort && queue.results[i] == NULL) {
+        pthread_cond_wait(&queue.cond, &queue.mutex);
+      }
+      if (queue.abort) {
+        pthread_mutex_unlock(&queue.mutex);
+        break;
+      }
+      SliceResult *result = queue.results[i];
+      queue.results[i] = NULL;
+      ++queue.nextApply;
+      pthread_cond_broadcast(&queue.cond);
+      pthread_mutex_unlock(&queue.mutex);
+
+      hal_index_t first = queue.slices[i].first;
+      if (writePosts && queue.rangeStarts[i]) {
+        const Sequence *seq = args[0].genome->getSequenceBySite(first);
+        // position + 1 because wigs are 1-based.
+        cout << "fixedStep chrom=" << seq->getName() << 
+          " start=" << first - seq->getStartPosition() + 1 << " step=1" 
+             << endl;
+      }
+      size_t callStart = 0;
+      for (size_t j = 0; j < result->posts.size(); ++j) {
+        if (result->callEnds[j] > callStart) {
+          writer.apply(&result->calls[callStart], 
+                       &result->calls[0] + result->callEnds[j]);
+        }
+        callStart = result->callEnds[j];
+        if (writePosts) {
+          cout << result->posts[j] << endl;
+        }
+      }
+      delete result;
+    }
+  } catch (exception &e) {
+    pthread_mutex_lock(&queue.mutex);
+    queue.error = e.what();
+    queue.abort = true;
+    pthread_mutex_unlock(&queue.mutex);
+  }
+
+  pthread_mutex_lock(&queue.mutex);
+  queue.abort = true;
+  pthread_cond_broadcast(&queue.cond);
+  pthread_mutex_unlock(&queue.mutex);
+  for (size_t i = 0; i < threads.size(); ++i) {
+    pthread_join(threads[i], NULL);
+  }
+  for (size_t i = 0; i < queue.results.size(); ++i) {
+    delete queue.results[i];
+  }
+  pthread_cond_destroy(&queue.cond);
+  pthread_mutex_destroy(&queue.mutex);
+  if (!queue.error.empty()) {
+    throw hal_exception(queue.error);
+  }
+}
+
 int main(int argc, char *argv[])
 {
   string halPath, genomeName, modPath, sequenceName, bedPath;
@@ -527,6 +975,8 @@ int main(int argc, char *argv[])
   hal_index_t startPos = 0;
   hal_index_t endPos = -1;
   double threshold = 0.0;
+  int cacheSize = 0;
+  int numThreads = 1;
   try {
     optParser->parseOptions(argc, argv);
     halPath = optParser->getArgument<string>("halFile");
@@ -540,6 +990,14 @@ int main(int argc, char *argv[])
     bedPath = optParser->getOption<string>("bed");
     writePosts = optParser->getFlag("outputPosts");
     printWrites = optParser->getFlag("printWrites");
+    cacheSize = optParser->getOption<int>("cacheSize");
+    if (cacheSize < 0) {
+      throw hal_exception("--cacheSize must be >= 0");
+    }
+    numThreads = optParser->getOption<int>("numThreads");
+    if (numThreads < 1) {
+      throw hal_exception("--numThreads must be at least 1");
+    }
   } catch (exception &e) {
     optParser->printUsage(cerr);
     return 1;
@@ -568,33 +1026,51 @@ int main(int argc, char *argv[])
     throw hal_exception("Genome " + genomeName + " is a leaf genome.");
   }
   
+  // (first, end) genome positions to estimate
+  vector<pair<hal_index_t, hal_index_t> > ranges;
   if (bedPath != "") {
-    AncestorsMLBed bedScanner(mod, alignment, genome, nameToId, threshold,
-                              writeHal, printWrites);
+    AncestorsMLBed bedScanner(genome, ranges);
     bedScanner.scan(bedPath, -1);
-    return 0;
-  }
-
-  if (sequenceName != "") {
-    Sequence *sequence = genome->getSequence(sequenceName);
-    if (sequence == NULL) {
-      throw hal_exception("Sequence name not found!");
-    }
-    startPos += sequence->getStartPosition();
-    if (endPos == -1) {
-      endPos = sequence->getEndPosition();
-    } else {
-      endPos += sequence->getStartPosition();
-      if (endPos > sequence->getEndPosition()) {
+  } else {
+    if (sequenceName != "") {
+      Sequence *sequence = genome->getSequence(sequenceName);
+      if (sequence == NULL) {
+        throw hal_exception("Sequence name not found!");
+      }
+      startPos += sequence->getStartPosition();
+      if (endPos == -1) {
         endPos = sequence->getEndPosition();
+      } else {
+        endPos += sequence->getStartPosition();
+        if (endPos > sequence->getEndPosition()) {
+          endPos = sequence->getEndPosition();
+        }
       }
     }
+
+    if (endPos == -1 || endPos > genome->getSequenceLength()) {
+      endPos = genome->getSequenceLength();
+    }
+    ranges.push_back(pair<hal_index_t, hal_index_t>(startPos, endPos));
   }
 
-  if (endPos == -1 || endPos > genome->getSequenceLength()) {
-    endPos = genome->getSequenceLength();
+  NucleotideWriter writer(alignment, writeHal, printWrites);
+  if (numThreads > 1) {
+    vector<AlignmentConstPtr> alignments =
+      openHalAlignmentReadOnlyPerThread(halPath, optParser, numThreads);
+    reEstimateWithThreads(mod, alignments, genomeName, ranges, nameToId,
+                          threshold, cacheSize, writer);
+    for (size_t i = 0; i < alignments.size(); ++i) {
+      alignments[i]->close();
+    }
+  } else {
+    PosteriorCache cache(cacheSize);
+    for (size_t i = 0; i < ranges.size(); ++i) {
+      reEstimate(mod, alignment, genome, ranges[i].first, ranges[i].second,
+                 nameToId, threshold, cacheSize > 0 ? &cache : NULL, writer);
+    }
   }
-  reEstimate(mod, alignment, genome, startPos, endPos, nameToId, threshold, writeHal, printWrites);
+  writer.flush();
   alignment->close();
 //  tm_free(mod);
   return 0;
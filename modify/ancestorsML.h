@@ -41,6 +41,4 @@ void removeAndPrune(stTree *tree);
 void buildTree(hal::AlignmentConstPtr alignment, const hal::Genome *genome,
                hal_index_t pos, stTree *tree, bool reversed, std::map<std::string, int> *nameToId = NULL);
 
-void reEstimate(TreeModel *mod, hal::AlignmentPtr alignment, hal::Genome *genome, hal_index_t startPos, hal_index_t endPos, std::map<std::string, int> &nameToId, double threshold, bool writeHal, bool printWrites);
-
 #endif
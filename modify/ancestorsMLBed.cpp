@@ -3,10 +3,6 @@
 #include <fstream>
 #include <iostream>
 #include "hal.h"
-extern "C" {
-#include "tree_model.h"
-}
-#include "ancestorsML.h"
 #include "ancestorsMLBed.h"
 
 using namespace hal;
@@ -25,7 +21,7 @@ void AncestorsMLBed::visitLine()
   startPos += sequence->getStartPosition();
   endPos += sequence->getStartPosition();
 
-  reEstimate(_mod, _alignment, _genome, startPos, endPos, _nameToId, _threshold, _writeHal, _printWrites);
+  _ranges.push_back(pair<hal_index_t, hal_index_t>(startPos, endPos));
 }
 
 #endif
@@ -1,17 +1,11 @@
 #include "halBedScanner.h"
-extern "C" {
-#include "tree_model.h"
-}
+// Collects the (first, end) genome positions of the lines of a bed
+// file on a genome, to be estimated by ancestorsML
 class AncestorsMLBed : public hal::BedScanner
 {
 public:
-AncestorsMLBed(TreeModel *mod, hal::AlignmentPtr alignment, hal::Genome *genome, std::map<std::string, int> &nameToId, double threshold, bool writeHal, bool printWrites) : _mod(mod), _alignment(alignment), _genome(genome), _nameToId(nameToId), _threshold(threshold), _writeHal(writeHal), _printWrites(printWrites) {};
+AncestorsMLBed(hal::Genome *genome, std::vector<std::pair<hal_index_t, hal_index_t> > &ranges) : _genome(genome), _ranges(ranges) {};
   void visitLine();
-  TreeModel *_mod;
-  hal::AlignmentPtr _alignment;
   hal::Genome *_genome;
-  std::map<std::string, int> &_nameToId;
-  double _threshold;
-  bool _writeHal;
-  bool _printWrites;
+  std::vector<std::pair<hal_index_t, hal_index_t> > &_ranges;
 };
@@ -1,6 +1,9 @@
 #!/usr/bin/env python
 """Runs ancestorsML on all unique columns that contain at least one
 ancestor.
+
+On a single machine, running ancestorsML --numThreads on the genome
+(with --bed for the regions) does the same without jobTree.
 """
 import math
 from argparse import ArgumentParser
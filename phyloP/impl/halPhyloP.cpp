@@ -5,14 +5,21 @@
  * Released under the MIT license, see LICENSE.txt
  */
 
+#include <algorithm>
 #include "halPhyloP.h"
 
 using namespace std;
 using namespace hal;
 
+const hal_size_t PhyloP::DefaultCacheSize = 1048576;
+
+// species per word of a packed column (3 bits each)
+static const hal_size_t basesPerKeyWord = 21;
+
 PhyloP::PhyloP() : _mod(NULL), _softMaskDups(false), _maskAllDups(false),
                    _seqnameHash(NULL), _colfitdata(NULL), _mode(CONACC),
-                   _msa(NULL)
+                   _msa(NULL), _cacheSize(DefaultCacheSize),
+                   _cacheKeyWords(0), _cacheHits(0), _cacheMisses(0)
 {
   
 }
@@ -37,6 +44,9 @@ void PhyloP::clear()
     hsh_free(_seqnameHash);
   }
   _targetSet.clear();
+  _cacheKeys.clear();
+  _cacheValues.clear();
+  _cacheUsed.clear();
 
   // need to free _mod?
 
@@ -166,6 +176,31 @@ void PhyloP::init(AlignmentConstPtr alignment, const string& modFilePath,
     _colfitdata = col_init_fit_data(_mod, _msa, ALL, _mode, FALSE);
   }
   _colfitdata->tupleidx = 0;
+  resetCache();
+}
+
+void PhyloP::setCacheSize(hal_size_t numPatterns)
+{
+  _cacheSize = 0;
+  if (numPatterns > 0)
+  {
+    for (_cacheSize = 1; _cacheSize < numPatterns; _cacheSize *= 2);
+  }
+  if (_msa != NULL)
+  {
+    resetCache();
+  }
+}
+
+void PhyloP::resetCache()
+{
+  _cacheKeyWords = (_msa->nseqs + basesPerKeyWord - 1) / basesPerKeyWord;
+  _key.assign(_cacheKeyWords, 0);
+  _cacheKeys.assign(_cacheSize * _cacheKeyWords, 0);
+  _cacheValues.assign(_cacheSize, 0.);
+  _cacheUsed.assign(_cacheSize, false);
+  _cacheHits = 0;
+  _cacheMisses = 0;
 }
 
 /** Given a Sequence (chromosome) and a (sequence-relative) coordinate
@@ -200,7 +235,8 @@ void PhyloP::init(AlignmentConstPtr alignment, const string& modFilePath,
 void PhyloP::processSequence(const Sequence* sequence,
                              hal_index_t start,
                              hal_size_t length,
-                             hal_size_t step)
+                             hal_size_t step,
+                             bool printHeader)
 {
   hal_size_t seqLen = sequence->getSequenceLength();
   if (seqLen == 0)
@@ -241,15 +277,18 @@ void PhyloP::processSequence(const Sequence* sequence,
                                  last - 1);
 
   // note wig coordinates are 1-based for some reason so we shift to right
-  *_outStream << "fixedStep chrom=" << sequenceName << " start=" << start + 1
-              << " step=" << step << "\n";
+  if (printHeader == true)
+  {
+    *_outStream << "fixedStep chrom=" << sequenceName << " start=" 
+                << start + 1 << " step=" << step << "\n";
+  }
   
   /** Since the column iterator stores coordinates in Genome coordinates
    * internally, we have to switch back to genome coordinates.  */
   // convert to genome coordinates
   pos += sequence->getStartPosition();
   last += sequence->getStartPosition();
-  while (pos <= last)
+  while (pos < last)
   {
     /** ColumnIterator::ColumnMap maps a Sequence to a list of bases
      * the bases in the map form the alignment column.  Some sequences
@@ -284,7 +323,7 @@ void PhyloP::processSequence(const Sequence* sequence,
         colIt->defragment();
       }
     }
-    else
+    else if (pos < last)
     {
       /** Reset the iterator to a non-contiguous position */
       colIt->toSite(pos, last - 1);
@@ -356,8 +395,67 @@ double PhyloP::pval(const ColumnIterator::ColumnMap *cmap)
       _msa->ss->col_tuples[0][i] = 'N';
     }
   }
-  
-  //finally, compute the score!
+
+  // the score only depends on the column, so look it up
+  if (_cacheSize == 0 || packColumn() == false)
+  {
+    ++_cacheMisses;
+    return score();
+  }
+  hal_size_t hash = 0;
+  for (hal_size_t i = 0; i < _cacheKeyWords; ++i)
+  {
+    hash = (hash ^ _key[i]) * 0x9e3779b97f4a7c15ULL;
+  }
+  hal_size_t slot = ((hash >> 32) ^ hash) & (_cacheSize - 1);
+  vector<hal_size_t>::iterator slotKey = 
+     _cacheKeys.begin() + slot * _cacheKeyWords;
+  if (_cacheUsed[slot] == true && equal(_key.begin(), _key.end(), slotKey))
+  {
+    ++_cacheHits;
+    return _cacheValues[slot];
+  }
+  ++_cacheMisses;
+  double pval = score();
+  copy(_key.begin(), _key.end(), slotKey);
+  _cacheValues[slot] = pval;
+  _cacheUsed[slot] = true;
+  return pval;
+}
+
+bool PhyloP::packColumn()
+{
+  const char* column = _msa->ss->col_tuples[0];
+  for (hal_size_t i = 0; i < _cacheKeyWords; ++i)
+  {
+    hal_size_t word = 0;
+    hal_size_t end = (i + 1) * basesPerKeyWord;
+    if (end > (hal_size_t)_msa->nseqs)
+    {
+      end = _msa->nseqs;
+    }
+    for (hal_size_t j = i * basesPerKeyWord; j < end; ++j)
+    {
+      hal_size_t code;
+      switch (column[j])
+      {
+      case 'A': code = 1; break;
+      case 'C': code = 2; break;
+      case 'G': code = 3; break;
+      case 'T': code = 4; break;
+      case 'N': code = 5; break;
+      default: return false;
+      }
+      word = (word << 3) | code;
+    }
+    _key[i] = word;
+  }
+  return true;
+}
+
+// compute phyloP score for the column in _msa
+double PhyloP::score()
+{
   double alt_lnl, null_lnl, this_scale, delta_lnl, pval;
   int sigfigs=4;  //same value used in phyloP code
 
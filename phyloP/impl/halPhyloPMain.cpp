@@ -9,19 +9,49 @@
 #include <cstdlib>
 #include <iostream>
 #include <fstream>
+#include <sstream>
 #include <algorithm>
+#include <deque>
+#include <pthread.h>
 #include "halPhyloP.h"
 #include "halPhyloPBed.h"
 
 #undef min
+#undef max
 using namespace std;
 using namespace hal;
 
+// bases per slice when scoring with several threads
+static const hal_size_t sliceLength = 100000;
+
+/** A range of a reference sequence to score */
+struct PhyloPRange
+{
+   string _sequenceName;
+   hal_index_t _start;
+   hal_size_t _length;
+   // false if the range continues the previous one
+   bool _printHeader;
+};
+
 /** If given genome-relative coordinates, map them to a series of 
  * sequence subranges */
-static void printGenome(PhyloP *phyloP,
-                        const Genome* genome, const Sequence* sequence,
-                        hal_size_t start, hal_size_t length, hal_size_t step);
+static void getRanges(const Genome* genome, const Sequence* sequence,
+                      hal_size_t start, hal_size_t length, 
+                      vector<PhyloPRange>& ranges);
+
+/** Open every genome, so that the threads never do it on a shared
+ * alignment */
+static void openAllGenomes(AlignmentConstPtr alignment);
+
+/** Score the ranges in slices on several threads, each with its own
+ * handle to the alignment and its own PhyloP (model, fit data and
+ * column cache), and write the slices in order */
+static void printRangesWithThreads(const vector<PhyloPRange>& ranges,
+                                   const vector<PhyloP*>& phyloPs,
+                                   const vector<ostringstream*>& streams,
+                                   const vector<const Genome*>& refGenomes,
+                                   hal_size_t step, ostream& outStream);
 
 
 static CLParserPtr initParser()
@@ -71,6 +101,20 @@ static CLParserPtr initParser()
 			   "conservation/acceleration in this subtree "
 			   "relative to the rest of the tree", "\"\"");
   optionsParser->addOption("prec", "Number of decimal places in wig output", 3);
+  optionsParser->addOption("cacheSize", "Number of alignment column patterns "
+                           "whose scores are kept, so that a column with "
+                           "the same bases as one already seen is not "
+                           "scored again (0 to disable)",
+                           PhyloP::DefaultCacheSize);
+  optionsParser->addOptionFlag("verbose", "Print the fraction of columns "
+                               "whose score was found in the cache to "
+                               "stderr", false);
+  optionsParser->addOption("numThreads", "Number of threads.  The reference "
+                           "is scored in slices, handed out to the threads "
+                           "and written in order.  The HAL file must be "
+                           "memory-mapped (see halMMapConvert) or HDF5 must "
+                           "be thread-safe.  Cannot be used with --refBed",
+                           1);
   
   optionsParser->setDescription("Make PhyloP wiggle plot for a genome.");
   return optionsParser;
@@ -92,6 +136,9 @@ int main(int argc, char** argv)
   hal_size_t step;
   string refBedPath;
   hal_size_t prec;
+  hal_size_t cacheSize;
+  bool verbose;
+  hal_size_t numThreads;
   try
   {
     optionsParser->parseOptions(argc, argv);
@@ -109,6 +156,17 @@ int main(int argc, char** argv)
     std::transform(dupMask.begin(), dupMask.end(), dupMask.begin(), ::tolower);
     refBedPath = optionsParser->getOption<string>("refBed");
     prec = optionsParser->getOption<hal_size_t>("prec");
+    cacheSize = optionsParser->getOption<hal_size_t>("cacheSize");
+    verbose = optionsParser->getFlag("verbose");
+    numThreads = optionsParser->getOption<hal_size_t>("numThreads");
+    if (numThreads == 0)
+    {
+      throw hal_exception("--numThreads must be at least 1");
+    }
+    if (numThreads > 1 && refBedPath != "\"\"")
+    {
+      throw hal_exception("--numThreads cannot be used with --refBed");
+    }
   }
   catch(exception& e)
   {
@@ -123,8 +181,9 @@ int main(int argc, char** argv)
      * via a path to a .hal file.  Options don't necessarily need to
      * come from the optionsParser -- see other interfaces in 
      * hal/api/inc/halAlignmentInstance.h */
-    AlignmentConstPtr alignment = openHalAlignmentReadOnly(halPath, 
-                                                           optionsParser);
+    vector<AlignmentConstPtr> alignments = 
+       openHalAlignmentReadOnlyPerThread(halPath, optionsParser, numThreads);
+    AlignmentConstPtr alignment = alignments[0];
 
     if (alignment->getNumGenomes() == 0)
     {
@@ -176,30 +235,103 @@ int main(int argc, char** argv)
     outStream.setf(ios::fixed, ios::floatfield);
     outStream.precision(prec);
     
-    PhyloP phyloP;
-    phyloP.init(alignment, modPath, &outStream, dupMask == "soft" , dupType,
-		"CONACC", subtree);
-
-    ifstream refBedStream;
-    if (refBedPath != "\"\"")
+    hal_size_t cacheHits = 0;
+    hal_size_t cacheMisses = 0;
+    if (numThreads == 1)
     {
-      ifstream bedFileStream;
-      if (refBedPath != "stdin")
+      PhyloP phyloP;
+      phyloP.init(alignment, modPath, &outStream, dupMask == "soft" , 
+                  dupType, "CONACC", subtree);
+      phyloP.setCacheSize(cacheSize);
+
+      if (refBedPath != "\"\"")
       {
-        bedFileStream.open(refBedPath.c_str());
-        if (!refBedStream)
+        ifstream bedFileStream;
+        if (refBedPath != "stdin")
         {
-          throw hal_exception("Error opening " + refBedPath);
+          bedFileStream.open(refBedPath.c_str());
+          if (!bedFileStream)
+          {
+            throw hal_exception("Error opening " + refBedPath);
+          }
         }
+        istream& bedStream = refBedPath != "stdin" ? bedFileStream : cin;
+        PhyloPBed phyloPBed(alignment, refGenome, refSequence, 
+                            start, length, step, phyloP, outStream);
+        phyloPBed.scan(&bedStream);
       }
-      istream& bedStream = refBedPath != "stdin" ? bedFileStream : cin;
-      PhyloPBed phyloPBed(alignment, refGenome, refSequence, 
-                          start, length, step, phyloP, outStream);
-      phyloPBed.scan(&bedStream);
+      else
+      {
+        vector<PhyloPRange> ranges;
+        getRanges(refGenome, refSequence, start, length, ranges);
+        for (size_t i = 0; i < ranges.size(); ++i)
+        {
+          const Sequence* sequence = 
+             refGenome->getSequence(ranges[i]._sequenceName);
+          phyloP.processSequence(sequence, ranges[i]._start, 
+                                 ranges[i]._length, step);
+        }
+      }
+      cacheHits = phyloP.getCacheHits();
+      cacheMisses = phyloP.getCacheMisses();
     }
     else
     {
-      printGenome(&phyloP, refGenome, refSequence, start, length, step);
+      vector<PhyloPRange> ranges;
+      getRanges(refGenome, refSequence, start, length, ranges);
+
+      // everything that touches the alignments and the model files is
+      // set up here, before the threads start
+      vector<PhyloP*> phyloPs;
+      vector<ostringstream*> streams;
+      vector<const Genome*> refGenomes;
+      try
+      {
+        for (hal_size_t i = 0; i < numThreads; ++i)
+        {
+          openAllGenomes(alignments[i]);
+          refGenomes.push_back(alignments[i]->openGenome(
+                                 refGenome->getName()));
+          streams.push_back(new ostringstream());
+          streams.back()->setf(ios::fixed, ios::floatfield);
+          streams.back()->precision(prec);
+          phyloPs.push_back(new PhyloP());
+          phyloPs.back()->init(alignments[i], modPath, streams.back(),
+                               dupMask == "soft", dupType, "CONACC", 
+                               subtree);
+          phyloPs.back()->setCacheSize(cacheSize);
+        }
+        printRangesWithThreads(ranges, phyloPs, streams, refGenomes, step,
+                               outStream);
+      }
+      catch (...)
+      {
+        for (size_t i = 0; i < phyloPs.size(); ++i)
+        {
+          delete phyloPs[i];
+        }
+        for (size_t i = 0; i < streams.size(); ++i)
+        {
+          delete streams[i];
+        }
+        throw;
+      }
+      for (size_t i = 0; i < phyloPs.size(); ++i)
+      {
+        cacheHits += phyloPs[i]->getCacheHits();
+        cacheMisses += phyloPs[i]->getCacheMisses();
+        delete phyloPs[i];
+        delete streams[i];
+      }
+    }
+
+    if (verbose == true)
+    {
+      hal_size_t numColumns = cacheHits + cacheMisses;
+      cerr << "column score cache hits: " << cacheHits
+           << " / " << numColumns << " ("
+           << (numColumns > 0 ? 100. * cacheHits / numColumns : 0.)
+           << "%)" << endl;
     }
   }
   catch(hal_exception& e)
@@ -225,13 +357,18 @@ int main(int argc, char** argv)
  * for the hal::Sequence interface.  We can convert between the two by 
  * adding or subtracting the sequence start position (in the example it woudl
  * be 0 for ChrA and 500 for ChrB) */
-void printGenome(PhyloP *phyloP, 
-                 const Genome* genome, const Sequence* sequence,
-                 hal_size_t start, hal_size_t length, hal_size_t step)
+void getRanges(const Genome* genome, const Sequence* sequence,
+               hal_size_t start, hal_size_t length, 
+               vector<PhyloPRange>& ranges)
 {
+  PhyloPRange range;
+  range._printHeader = true;
   if (sequence != NULL)
   {
-    phyloP->processSequence(sequence, start, length, step);
+    range._sequenceName = sequence->getName();
+    range._start = start;
+    range._length = length;
+    ranges.push_back(range);
   }
   else
   {
@@ -264,10 +401,222 @@ void printGenome(PhyloP *phyloP,
         hal_size_t readStart = seqStart >= start ? 0 : start - seqStart;
         hal_size_t readLen = min(seqLen - readStart, length);
         readLen = min(readLen, length - runningLength);
-        phyloP->processSequence(sequence, readStart, readLen, step);
+        range._sequenceName = sequence->getName();
+        range._start = readStart;
+        range._length = readLen;
+        ranges.push_back(range);
         runningLength += readLen;
       }
     }
   }
 }
 
+void openAllGenomes(AlignmentConstPtr alignment)
+{
+  deque<string> bfQueue;
+  bfQueue.push_back(alignment->getRootName());
+  while (bfQueue.empty() == false)
+  {
+    string name = bfQueue.front();
+    bfQueue.pop_front();
+    alignment->openGenome(name);
+    vector<string> childNames = alignment->getChildNames(name);
+    bfQueue.insert(bfQueue.end(), childNames.begin(), childNames.end());
+  }
+}
+
+/** Slices shared by the worker threads.  Slices are handed out in
+ * order, and the calling thread writes their output in the same order.
+ * Workers stop taking new slices when they get _window slices ahead of
+ * the writer so that the output doesn't pile up in memory */
+struct PhyloPSliceQueue
+{
+   vector<PhyloPRange> _slices;
+   hal_size_t _step;
+   vector<string*> _output;
+   size_t _nextSlice;
+   size_t _nextWrite;
+   size_t _window;
+   bool _abort;
+   string _error;
+   pthread_mutex_t _mutex;
+   pthread_cond_t _cond;
+};
+
+struct PhyloPThread
+{
+   PhyloPSliceQueue* _queue;
+   PhyloP* _phyloP;
+   ostringstream* _stream;
+   const Genome* _refGenome;
+};
+
+static void* phyloPWorker(void* arg)
+{
+  PhyloPThread* thread = static_cast<PhyloPThread*>(arg);
+  PhyloPSliceQueue* queue = thread->_queue;
+  for (;;)
+  {
+    pthread_mutex_lock(&queue->_mutex);
+    while (queue->_abort == false && 
+           queue->_nextSlice < queue->_slices.size() &&
+           queue->_nextSlice >= queue->_nextWrite + queue->_window)
+    {
+      pthread_cond_wait(&queue->_cond, &queue->_mutex);
+    }
+    if (queue->_abort == true || queue->_nextSlice >= queue->_slices.size())
+    {
+      pthread_mutex_unlock(&queue->_mutex);
+      break;
+    }
+    size_t i = queue->_nextSlice++;
+    pthread_mutex_unlock(&queue->_mutex);
+
+    string* output = NULL;
+    string error;
+    try
+    {
+      const PhyloPRange& slice = queue->_slices[i];
+      const Sequence* sequence = 
+         thread->_refGenome->getSequence(slice._sequenceName);
+      thread->_stream->str("");
+      thread->_phyloP->processSequence(sequence, slice._start, 
+                                       slice._length, queue->_step,
+                                       slice._printHeader);
+      output = new string(thread->_stream->str());
+    }
+    catch (exception& e)
+    {
+      error = e.what();
+    }
+
+    pthread_mutex_lock(&queue->_mutex);
+    if (output != NULL)
+    {
+      queue->_output[i] = output;
+    }
+    else
+    {
+      queue->_error = error;
+      queue->_abort = true;
+    }
+    pthread_cond_broadcast(&queue->_cond);
+    pthread_mutex_unlock(&queue->_mutex);
+  }
+  return NULL;
+}
+
+void printRangesWithThreads(const vector<PhyloPRange>& ranges,
+                            const vector<PhyloP*>& phyloPs,
+                            const vector<ostringstream*>& streams,
+                            const vector<const Genome*>& refGenomes,
+                            hal_size_t step, ostream& outStream)
+{
+  size_t numThreads = phyloPs.size();
+  PhyloPSliceQueue queue;
+
+  // cut the ranges into slices that start on a step, so that each one 
+  // scores the same columns as the whole range would.  only the first 
+  // slice of a range has a fixedStep line, so the wiggle doesn't depend
+  // on the number of threads
+  hal_size_t maxSliceLength = max(sliceLength / step, (hal_size_t)1) * step;
+  for (size_t i = 0; i < ranges.size(); ++i)
+  {
+    const Sequence* sequence = 
+       refGenomes[0]->getSequence(ranges[i]._sequenceName);
+    hal_size_t seqLen = sequence->getSequenceLength();
+    PhyloPRange slice = ranges[i];
+    hal_size_t length = slice._length;
+    if (length == 0 && (hal_size_t)slice._start <= seqLen)
+    {
+      length = seqLen - slice._start;
+    }
+    // bad ranges are passed on whole, for processSequence() to reject
+    if (length == 0 || slice._start + length > seqLen)
+    {
+      queue._slices.push_back(slice);
+      continue;
+    }
+    hal_size_t end = slice._start + length;
+    for (hal_size_t first = slice._start; first < end; 
+         first += maxSliceLength)
+    {
+      slice._start = first;
+      slice._length = min(maxSliceLength, end - first);
+      slice._printHeader = first == (hal_size_t)ranges[i]._start;
+      queue._slices.push_back(slice);
+    }
+  }
+
+  queue._step = step;
+  queue._output.assign(queue._slices.size(), NULL);
+  queue._nextSlice = 0;
+  queue._nextWrite = 0;
+  queue._window = 4 * numThreads;
+  queue._abort = false;
+  pthread_mutex_init(&queue._mutex, NULL);
+  pthread_cond_init(&queue._cond, NULL);
+
+  vector<PhyloPThread> args(numThreads);
+  vector<pthread_t> threads;
+  for (size_t i = 0; i < numThreads; ++i)
+  {
+    args[i]._queue = &queue;
+    args[i]._phyloP = phyloPs[i];
+    args[i]._stream = streams[i];
+    args[i]._refGenome = refGenomes[i];
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, phyloPWorker, &args[i]) != 0)
+    {
+      pthread_mutex_lock(&queue._mutex);
+      queue._error = "halPhyloP: unable to create thread";
+      queue._abort = true;
+      pthread_mutex_unlock(&queue._mutex);
+      break;
+    }
+    threads.push_back(thread);
+  }
+
+  // write the slices in order as they are finished
+  for (size_t i = 0; i < queue._slices.size(); ++i)
+  {
+    pthread_mutex_lock(&queue._mutex);
+    while (queue._abort == false && queue._output[i] == NULL)
+    {
+      pthread_cond_wait(&queue._cond, &queue._mutex);
+    }
+    if (queue._abort == true)
+    {
+      pthread_mutex_unlock(&queue._mutex);
+      break;
+    }
+    string* output = queue._output[i];
+    queue._output[i] = NULL;
+    ++queue._nextWrite;
+    pthread_cond_broadcast(&queue._cond);
+    pthread_mutex_unlock(&queue._mutex);
+
+    outStream << *output;
+    delete output;
+  }
+  outStream.flush();
+
+  pthread_mutex_lock(&queue._mutex);
+  queue._abort = true;
+  pthread_cond_broadcast(&queue._cond);
+  pthread_mutex_unlock(&queue._mutex);
+  for (size_t i = 0; i < threads.size(); ++i)
+  {
+    pthread_join(threads[i], NULL);
+  }
+  for (size_t i = 0; i < queue._output.size(); ++i)
+  {
+    delete queue._output[i];
+  }
+  pthread_cond_destroy(&queue._cond);
+  pthread_mutex_destroy(&queue._mutex);
+  if (queue._error.empty() == false)
+  {
+    throw hal_exception(queue._error);
+  }
+}
@@ -10,6 +10,7 @@
 
 #include <cstdlib>
 #include <string>
+#include <vector>
 #include "hal.h"
 
 extern "C"{
@@ -49,16 +50,46 @@ public:
              const std::string& phyloPMode = "CONACC",
              const std::string& subtree = "\"\"");
 
+   /** Print the wiggle of a range of a sequence
+    * @param printHeader Begin with a fixedStep line (can be left out
+    * when the range continues the one printed before, with the same
+    * step) */
    void processSequence(const Sequence* sequence,
                         hal_index_t start,
                         hal_size_t length,
-                        hal_size_t step);
+                        hal_size_t step,
+                        bool printHeader = true);
+
+   /** Set the number of column patterns whose scores are remembered
+    * (rounded up to a power of 2; 0 to compute every column).  Columns
+    * with the same bases for every species in the model get the same
+    * score, so in conserved regions most columns are found in the
+    * cache.  A pattern replaces whatever pattern was in its slot. */
+   void setCacheSize(hal_size_t numPatterns);
+
+   /** Number of columns whose score was found in the cache */
+   hal_size_t getCacheHits() const;
+   
+   /** Number of columns whose score was computed */
+   hal_size_t getCacheMisses() const;
+
+   static const hal_size_t DefaultCacheSize;
 
 protected:
 
    // return phyloP score 
    double pval(const ColumnIterator::ColumnMap *cmap);  
 
+   // score the column in _msa
+   double score();
+
+   // pack the column in _msa into _key (3 bits per species).  returns
+   // false if it has a character that can't be packed
+   bool packColumn();
+
+   // size the cache for the species in _msa, and empty it
+   void resetCache();
+
    void clear();
 
 protected:
@@ -81,7 +112,28 @@ protected:
    List *_outsideNodes;
    mode_type _mode;
    MSA* _msa;
+
+   // direct-mapped table of column scores, _cacheKeyWords words of
+   // key per slot
+   hal_size_t _cacheSize;
+   hal_size_t _cacheKeyWords;
+   std::vector<hal_size_t> _cacheKeys;
+   std::vector<double> _cacheValues;
+   std::vector<bool> _cacheUsed;
+   std::vector<hal_size_t> _key;
+   hal_size_t _cacheHits;
+   hal_size_t _cacheMisses;
 };
 
+inline hal_size_t PhyloP::getCacheHits() const
+{
+  return _cacheHits;
+}
+
+inline hal_size_t PhyloP::getCacheMisses() const
+{
+  return _cacheMisses;
+}
+
 }
 #endif
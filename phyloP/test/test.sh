@@ -1,3 +1,8 @@
 hal2maf blanchette.hal blanchette.maf --refGenome HUMAN
-halPhyloP blanchette.hal HUMAN blanchette.mod fromHal
+halPhyloP blanchette.hal HUMAN blanchette.mod fromHal --verbose
+halPhyloP blanchette.hal HUMAN blanchette.mod fromHalNoCache --cacheSize 0
+cmp fromHal fromHalNoCache
+halMMapConvert blanchette.hal blanchette.mmap.hal
+halPhyloP blanchette.mmap.hal HUMAN blanchette.mod fromHalThreads --numThreads 4
+cmp fromHal fromHalThreads
 phyloP -i MAF --method LRT --mode CONACC --wig-scores blanchette.mod blanchette.maf > fromMaf
@@ -6,6 +6,7 @@
 
 #include <cstdlib>
 #include <iostream>
+#include <pthread.h>
 #include "halStats.h"
 
 using namespace std;
@@ -33,6 +34,8 @@ static void printNumSegments(ostream& os, AlignmentConstPtr alignment,
                              const string& genomeName); 
 static void printBaseComp(ostream& os, AlignmentConstPtr alignment, 
                           const string& baseCompPair);
+static void printBaseCompWig(ostream& os, AlignmentConstPtr alignment, 
+                             const string& windowPair, bool gc);
 static void printGenomeMetaData(ostream &os, AlignmentConstPtr alignment,
                           const string &genomeName);
 static void printChromSizes(ostream& os, AlignmentConstPtr alignment, 
@@ -43,7 +46,9 @@ static void printCoverage(ostream& os, AlignmentConstPtr alignment,
                                  const string& genomeName);
 static void printSegments(ostream& os, AlignmentConstPtr alignment,
                           const string& genomeName, bool top);
-static void printAllCoverage(ostream& os, AlignmentConstPtr alignment);
+static void printAllCoverage(ostream& os, AlignmentConstPtr alignment,
+                             const string& path, CLParserConstPtr options,
+                             hal_size_t numThreads);
 
 int main(int argc, char** argv)
 {
@@ -87,7 +92,22 @@ int main(int argc, char** argv)
                            "value is of the form genome,step.  Ex: "
                            "--baseComp human,1000.  The ouptut is of the form "
                            "fraction_of_As fraction_of_Gs fraction_of_Cs "
-                           "fraction_of_Ts.", 
+                           "fraction_of_Ts.  A step of 1 counts every base "
+                           "(and is much faster than a step of 2).", 
+                           "\"\"");
+  optionsParser->addOption("gcPercent", "print the percentage of G and C "
+                           "bases (out of A, C, G and T) in non-overlapping "
+                           "windows of the given genome, in variableStep "
+                           "WIG format (for wigToBigWig).  Windows "
+                           "with no A, C, G or T are skipped.  Parameter "
+                           "value is of the form genome,windowSize.  Ex: "
+                           "--gcPercent human,5",
+                           "\"\"");
+  optionsParser->addOption("maskPercent", "print the percentage of "
+                           "soft-masked (lower case) bases in "
+                           "non-overlapping windows of the given genome, in "
+                           "variableStep WIG format.  Parameter value is "
+                           "of the form genome,windowSize",
                            "\"\"");
   optionsParser->addOption("genomeMetaData", "print metadata for given genome, "
                            "one entry per line, tab-seperated.", "\"\"");
@@ -115,6 +135,11 @@ int main(int argc, char** argv)
   optionsParser->addOptionFlag("allCoverage",
                                "print histogram of coverage from all genomes to"
                                " all genomes", false);
+  optionsParser->addOption("numThreads",
+                           "number of threads to use for --allCoverage.  "
+                           "More than one needs a memory-mapped hal file "
+                           "or an HDF5 library built with "
+                           "--enable-threadsafe", 1);
 
 
   string path;
@@ -132,6 +157,8 @@ int main(int argc, char** argv)
   string nameForBL;
   string numSegmentsGenome;
   string baseCompPair;
+  string gcPercentPair;
+  string maskPercentPair;
   string genomeMetaData;
   string chromSizesFromGenome;
   string percentID;
@@ -139,6 +166,7 @@ int main(int argc, char** argv)
   string topSegments;
   string bottomSegments;
   bool allCoverage;
+  hal_size_t numThreads;
   try
   {
     optionsParser->parseOptions(argc, argv);
@@ -157,6 +185,8 @@ int main(int argc, char** argv)
     nameForBL = optionsParser->getOption<string>("branchLength");
     numSegmentsGenome = optionsParser->getOption<string>("numSegments");
     baseCompPair = optionsParser->getOption<string>("baseComp");
+    gcPercentPair = optionsParser->getOption<string>("gcPercent");
+    maskPercentPair = optionsParser->getOption<string>("maskPercent");
     genomeMetaData = optionsParser->getOption<string>("genomeMetaData");
     chromSizesFromGenome = optionsParser->getOption<string>("chromSizes");
     percentID = optionsParser->getOption<string>("percentID");
@@ -164,6 +194,7 @@ int main(int argc, char** argv)
     topSegments = optionsParser->getOption<string>("topSegments");
     bottomSegments = optionsParser->getOption<string>("bottomSegments");
     allCoverage = optionsParser->getFlag("allCoverage");
+    numThreads = optionsParser->getOption<hal_size_t>("numThreads");
 
     size_t optCount = listGenomes == true ? 1 : 0;
     if (sequencesFromGenome != "\"\"") ++optCount;
@@ -179,6 +210,8 @@ int main(int argc, char** argv)
     if (nameForBL != "\"\"") ++optCount;
     if (numSegmentsGenome != "\"\"") ++optCount;
     if (baseCompPair != "\"\"") ++optCount;
+    if (gcPercentPair != "\"\"") ++optCount;
+    if (maskPercentPair != "\"\"") ++optCount;
     if (genomeMetaData != "\"\"") ++optCount;
     if (chromSizesFromGenome != "\"\"") ++optCount;
     if (percentID != "\"\"") ++optCount;
@@ -191,11 +224,16 @@ int main(int argc, char** argv)
       throw hal_exception("--genomes, --sequences, --tree, --span, --spanRoot, "
                           "--branches, --sequenceStats, --children, --parent, "
                           "--bedSequences, --root, --numSegments, --baseComp, "
+                          "--gcPercent, --maskPercent, "
                           "--genomeMetaData, --chromSizes, --percentID, "
                           "--coverage,  --topSegments, --bottomSegments, "
                           "--allCoverage "
                           "and --branchLength options are exclusive");
     }
+    if (numThreads == 0)
+    {
+      throw hal_exception("--numThreads must be at least 1");
+    }
   }
   catch(exception& e)
   {
@@ -263,6 +301,14 @@ int main(int argc, char** argv)
     {
       printBaseComp(cout, alignment, baseCompPair);
     }
+    else if (gcPercentPair != "\"\"")
+    {
+      printBaseCompWig(cout, alignment, gcPercentPair, true);
+    }
+    else if (maskPercentPair != "\"\"")
+    {
+      printBaseCompWig(cout, alignment, maskPercentPair, false);
+    }
     else if (genomeMetaData != "\"\"")
     {
       printGenomeMetaData(cout, alignment, genomeMetaData);
@@ -284,7 +330,7 @@ int main(int argc, char** argv)
     else if (bottomSegments != "\"\"") {
       printSegments(cout, alignment, bottomSegments, false);
     } else if (allCoverage) {
-      printAllCoverage(cout, alignment);
+      printAllCoverage(cout, alignment, path, optionsParser, numThreads);
     }
     else
     {
@@ -583,6 +629,18 @@ void printBaseComp(ostream& os, AlignmentConstPtr alignment,
     step = len - 1;
   }
 
+  if (step <= 1)
+  {
+    // count straight from the packed DNA rather than base by base
+    BaseCounts counts;
+    genome->getBaseCounts(0, len, counts);
+    numA = counts._a;
+    numC = counts._c;
+    numG = counts._g;
+    numT = counts._t;
+    step = len + 1;
+  }
+
   DNAIteratorConstPtr dna = genome->getDNAIterator();
   for (hal_size_t i = 0; i < len; i += step)
   {
@@ -617,6 +675,67 @@ void printBaseComp(ostream& os, AlignmentConstPtr alignment,
      << (double)numT / total << '\n';
 }
 
+void printBaseCompWig(ostream& os, AlignmentConstPtr alignment, 
+                      const string& windowPair, bool gc)
+{
+  string genomeName;
+  hal_size_t windowSize = 0;
+  vector<string> tokens = chopString(windowPair, ",");
+  if (tokens.size() == 2)
+  {
+    genomeName = tokens[0];
+    stringstream ss(tokens[1]);
+    ss >> windowSize;
+  }
+  if (windowSize == 0)
+  {
+    stringstream ss;
+    ss << "Invalid value for --" << (gc ? "gcPercent" : "maskPercent")
+       << ": " << windowPair << ".  Must be of format genomeName,windowSize";
+    throw hal_exception(ss.str());
+  }
+  const Genome* genome = alignment->openGenome(genomeName);
+  if (genome == NULL)
+  {
+    throw hal_exception(string("Genome ") + genomeName + " not found.");
+  }
+  if (genome->getNumSequences() == 0)
+  {
+    return;
+  }
+
+  SequenceIteratorConstPtr seqIt = genome->getSequenceIterator();
+  SequenceIteratorConstPtr seqEnd = genome->getSequenceEndIterator();
+  for (; !seqIt->equals(seqEnd); seqIt->toNext())
+  {
+    const Sequence* sequence = seqIt->getSequence();
+    hal_size_t len = sequence->getSequenceLength();
+    // the span of a variableStep section is fixed, so the last window
+    // (if it's short) gets a section of its own
+    hal_size_t span = 0;
+    for (hal_size_t start = 0; start < len; start += windowSize)
+    {
+      hal_size_t length = min(windowSize, len - start);
+      BaseCounts counts;
+      sequence->getBaseCounts(start, length, counts);
+      hal_size_t acgt = counts._a + counts._c + counts._g + counts._t;
+      if (gc == true && acgt == 0)
+      {
+        continue;
+      }
+      if (length != span)
+      {
+        span = length;
+        os << "variableStep chrom=" << sequence->getName() 
+           << " span=" << span << '\n';
+      }
+      double percent = gc ? 100. * (counts._g + counts._c) / acgt :
+         100. * counts._masked / length;
+      os << start + 1 << '\t' << percent << '\n';
+    }
+  }
+}
+
 void printGenomeMetaData(ostream &os, AlignmentConstPtr alignment,
                          const string &genomeName)
 {
@@ -882,92 +1001,138 @@ static void printSegments(ostream& os, AlignmentConstPtr alignment,
   }
 }
 
-// Print coverage for all leaves vs. all leaves efficiently.
-static void printAllCoverage(ostream& os, AlignmentConstPtr alignment)
+// Coverage histograms from one thread's part of the alignment, keyed 
+// by genome pairs of that thread's handle.
+typedef map<pair<const Genome *, const Genome *>, vector<hal_size_t> > 
+CoverageHistograms;
+
+struct AllCoverageThread
 {
-  vector<string> leafNames = alignment->getLeafNamesBelow(alignment->getRootName());
-  vector<const Genome *> leafGenomes;
-  for (hal_size_t i = 0; i < leafNames.size(); i++) {
-    const Genome *genome = alignment->openGenome(leafNames[i]);
-    assert(genome != NULL);
-    leafGenomes.push_back(genome);
-  }
-  ColumnIterator::VisitCache visitCache;
-  map<pair<const Genome *, const Genome *>, vector<hal_size_t> *> histograms;
-  for (hal_size_t i = 0; i < leafGenomes.size(); i++) {
-    const Genome *genome = leafGenomes[i];
-    // Follow paralogies, but ignore ancestors.
-    ColumnIteratorPtr colIt = genome->getColumnIterator(NULL, 0, 0,
-                                                        NULL_INDEX, false,
-                                                        true, false, true);
-    colIt->setVisitCache(&visitCache);
-    // So that we don't accidentally visit the first column if it's
-    // already been visited.
-    colIt->toSite(0, genome->getSequenceLength() - 1);
-    while(1) {
-      const ColumnIterator::ColumnMap *cmap = colIt->getColumnMap();
-      // Temporary collecting of per-genome sites mapped, since it's
-      // organized in the column map by sequence, not genome.
-      map<const Genome *, hal_size_t> numSitesMapped;
-      for (ColumnIterator::ColumnMap::const_iterator colMapIt = cmap->begin();
-           colMapIt != cmap->end(); colMapIt++) {
-        if (colMapIt->second->empty()) {
-          // There are empty entries in the column map.
-          continue;
-        }
-        const Genome *genome = colMapIt->first->getGenome();
-        if (!numSitesMapped.count(genome)) {
-          // Initialize map entry
-          numSitesMapped[genome] = 0;
-        }
-        const ColumnIterator::DNASet *dnaSet = colMapIt->second;
-        numSitesMapped[genome] = numSitesMapped[genome] + dnaSet->size();
+  AlignmentConstPtr _alignment;
+  AllColumnIterator::Scan *_scan;
+  hal_size_t _part;
+  CoverageHistograms _histograms;
+  string _error;
+};
+
+static void countAllCoverage(AllCoverageThread *thread)
+{
+  CoverageHistograms &histograms = thread->_histograms;
+  // Follow paralogies, but ignore ancestors.
+  AllColumnIterator allIt(thread->_alignment, thread->_scan, thread->_part,
+                          false, true);
+  for (; !allIt.atEnd(); allIt.toRight()) {
+    ColumnIteratorConstPtr colIt = allIt.getColumnIterator();
+    const ColumnIterator::ColumnMap *cmap = colIt->getColumnMap();
+    // Temporary collecting of per-genome sites mapped, since it's
+    // organized in the column map by sequence, not genome.
+    map<const Genome *, hal_size_t> numSitesMapped;
+    for (ColumnIterator::ColumnMap::const_iterator colMapIt = cmap->begin();
+         colMapIt != cmap->end(); colMapIt++) {
+      if (colMapIt->second->empty()) {
+        // There are empty entries in the column map.
+        continue;
       }
-      // O(n^2) in the number of genomes in the column -- doesn't seem
-      // like there is a better way, since coverage isn't quite
-      // symmetric.
-      for (map<const Genome *, hal_size_t>::const_iterator it = numSitesMapped.begin();
-           it != numSitesMapped.end(); it++) {
-        for(map<const Genome *, hal_size_t>::const_iterator it2 = numSitesMapped.begin();
-           it2 != numSitesMapped.end(); it2++) {
-          pair<const Genome *, const Genome *> key = make_pair(it->first, it2->first);
-          if (!histograms.count(key)) {
-            // Initialize map
-            histograms[key] = new vector<hal_size_t>;
-          }
-          vector<hal_size_t> *histogram = histograms[key];
-          if (histogram->size() < it2->second) {
-            histogram->resize(it2->second, 0);
-          }
-          for (hal_size_t i = 0; i < it2->second; i++) {
-            (*histogram)[i] = histogram->at(i) + numSitesMapped[it->first];
-          }
+      const Genome *genome = colMapIt->first->getGenome();
+      numSitesMapped[genome] += colMapIt->second->size();
+    }
+    // O(n^2) in the number of genomes in the column -- doesn't seem
+    // like there is a better way, since coverage isn't quite
+    // symmetric.
+    for (map<const Genome *, hal_size_t>::const_iterator it = numSitesMapped.begin();
+         it != numSitesMapped.end(); it++) {
+      for(map<const Genome *, hal_size_t>::const_iterator it2 = numSitesMapped.begin();
+         it2 != numSitesMapped.end(); it2++) {
+        vector<hal_size_t> &histogram = 
+           histograms[make_pair(it->first, it2->first)];
+        if (histogram.size() < it2->second) {
+          histogram.resize(it2->second, 0);
+        }
+        for (hal_size_t i = 0; i < it2->second; i++) {
+          histogram[i] += it->second;
         }
       }
-      if (colIt->getReferenceSequencePosition() % 1000 == 0) {
-        colIt->defragment();
+    }
+    if (colIt->getReferenceSequencePosition() % 1000 == 0) {
+      colIt->defragment();
+    }
+  }
+}
+
+static void *allCoverageWorker(void *arg)
+{
+  AllCoverageThread *thread = static_cast<AllCoverageThread *>(arg);
+  try {
+    countAllCoverage(thread);
+  } catch (exception &e) {
+    thread->_error = e.what();
+  }
+  return NULL;
+}
+
+// Print coverage for all leaves vs. all leaves efficiently.  Every
+// column is visited once (see AllColumnIterator), with each thread
+// taking a slice of every leaf, and the threads' histograms are added
+// up at the end.
+static void printAllCoverage(ostream& os, AlignmentConstPtr alignment,
+                             const string& path, CLParserConstPtr options,
+                             hal_size_t numThreads)
+{
+  vector<AlignmentConstPtr> alignments(1, alignment);
+  if (numThreads > 1) {
+    alignments = openHalAlignmentReadOnlyPerThread(path, options, numThreads);
+  }
+  AllColumnIterator::Scan scan(alignment, numThreads);
+  vector<AllCoverageThread> threads(numThreads);
+  for (hal_size_t i = 0; i < numThreads; i++) {
+    threads[i]._alignment = alignments[i];
+    threads[i]._scan = &scan;
+    threads[i]._part = i;
+  }
+  if (numThreads == 1) {
+    countAllCoverage(&threads[0]);
+  } else {
+    vector<pthread_t> pthreads(numThreads);
+    for (hal_size_t i = 0; i < numThreads; i++) {
+      if (pthread_create(&pthreads[i], NULL, allCoverageWorker, 
+                         &threads[i]) != 0) {
+        // the scan can't finish without every part
+        cerr << "halStats: unable to create thread" << endl;
+        exit(1);
       }
-      if (colIt->lastColumn()) {
-        // Break here--the column iterator will crash if we try to go further.
-        break;
+    }
+    for (hal_size_t i = 0; i < numThreads; i++) {
+      pthread_join(pthreads[i], NULL);
+    }
+    for (hal_size_t i = 0; i < numThreads; i++) {
+      if (!threads[i]._error.empty()) {
+        throw hal_exception(threads[i]._error);
       }
-      colIt->toRight();
     }
-    // Copy over the updated visit cache information so we can supply it to the next genome.
-    visitCache.clear();
-    ColumnIterator::VisitCache *newVisitCache = colIt->getVisitCache();
-    for(ColumnIterator::VisitCache::iterator it = newVisitCache->begin();
-        it != newVisitCache->end(); it++) {
-      visitCache[it->first] = new PositionCache(*it->second);
+  }
+
+  // Genome pointers differ between handles, so add up by name
+  map<pair<string, string>, vector<hal_size_t> > histograms;
+  for (hal_size_t t = 0; t < numThreads; t++) {
+    for (CoverageHistograms::const_iterator it = threads[t]._histograms.begin();
+         it != threads[t]._histograms.end(); it++) {
+      vector<hal_size_t> &histogram = 
+         histograms[make_pair(it->first.first->getName(),
+                              it->first.second->getName())];
+      if (histogram.size() < it->second.size()) {
+        histogram.resize(it->second.size(), 0);
+      }
+      for (hal_size_t i = 0; i < it->second.size(); i++) {
+        histogram[i] += it->second[i];
+      }
     }
   }
 
   hal_size_t maxHistLength = 0;
-  for (map<pair<const Genome *, const Genome *>, vector<hal_size_t> *>::iterator histIt = histograms.begin();
+  for (map<pair<string, string>, vector<hal_size_t> >::iterator histIt = histograms.begin();
        histIt != histograms.end(); histIt++) {
-    vector <hal_size_t> *histogram = histIt->second;
-    if (histogram->size() > maxHistLength) {
-      maxHistLength = histogram->size();
+    if (histIt->second.size() > maxHistLength) {
+      maxHistLength = histIt->second.size();
     }
   }
 
@@ -976,16 +1141,16 @@ static void printAllCoverage(ostream& os, AlignmentConstPtr alignment)
     os << ", sitesCovered" << i + 1 << "Times";
   }
   os << endl;
-  for (map<pair<const Genome *, const Genome *>, vector<hal_size_t> *>::iterator histIt = histograms.begin();
+  for (map<pair<string, string>, vector<hal_size_t> >::iterator histIt = histograms.begin();
        histIt != histograms.end(); histIt++) {
-    string fromName = histIt->first.second->getName();
-    string toName = histIt->first.first->getName();
+    const string &fromName = histIt->first.second;
+    const string &toName = histIt->first.first;
     os << fromName;
     os << ", " << toName;
-    vector <hal_size_t> *histogram = histIt->second;
+    const vector<hal_size_t> &histogram = histIt->second;
     for(hal_size_t i = 0; i < maxHistLength; i++) {
-      if (i < histogram->size()) {
-        os << ", " << (double) histogram->at(i);
+      if (i < histogram.size()) {
+        os << ", " << (double) histogram[i];
       } else {
         os << ", " << 0;
       }